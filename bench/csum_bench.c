@@ -0,0 +1,295 @@
+
+//
+// Copyright (c) 2024-2026, Denny Page
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+//
+// Internet checksum equivalence test and microbenchmark
+//
+// The test compares every checksum implementation supported by the CPU with a
+// 16 bit reference sum across lengths, alignments and data patterns. The
+// benchmark reports the time per checksum of each implementation. Results are
+// written as JSON lines.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "common.h"
+
+
+// Equivalence test limits
+#define TEST_MAX_ALIGN          64
+#define TEST_MAX_LEN            2048
+#define TEST_JUMBO_LEN          65535
+
+// Benchmark lengths and default time for each
+static const unsigned int       bench_len_list[] = { 20, 64, 256, 576, 1500, 4096, 9000 };
+#define BENCH_LEN_COUNT         (sizeof(bench_len_list) / sizeof(bench_len_list[0]))
+#define DEFAULT_BENCH_MILLIS    200
+
+// Test buffer, with room for the longest test at any alignment
+static uint8_t                  buffer[TEST_JUMBO_LEN + TEST_MAX_ALIGN];
+
+// Data patterns for the test
+static const char *             pattern_list[] = { "random", "ones", "zeros" };
+#define PATTERN_COUNT           (sizeof(pattern_list) / sizeof(pattern_list[0]))
+
+// Benchmark result sink
+static volatile uint16_t        bench_sink;
+
+
+
+//
+// Monotonic time in nanoseconds
+//
+static uint64_t monotonic_ns(void)
+{
+    struct timespec             ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+//
+// Fill the buffer with a data pattern
+//
+static void fill_buffer(
+    unsigned int                pattern)
+{
+    unsigned int                index;
+
+    switch (pattern)
+    {
+    case 0:
+        srandom(1);
+        for (index = 0; index < sizeof(buffer); index++)
+        {
+            buffer[index] = (uint8_t) random();
+        }
+        break;
+
+    case 1:
+        memset(buffer, 0xff, sizeof(buffer));
+        break;
+
+    default:
+        memset(buffer, 0, sizeof(buffer));
+        break;
+    }
+}
+
+
+//
+// Reference internet checksum, summed as 16 bit words in network byte order
+//
+static uint16_t reference_csum(
+    const uint8_t *             data,
+    unsigned int                len)
+{
+    uint32_t                    sum = 0;
+    unsigned int                index;
+
+    for (index = 0; index + 1 < len; index += 2)
+    {
+        sum += (uint32_t) data[index] << 8 | data[index + 1];
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    if (index < len)
+    {
+        sum += (uint32_t) data[index] << 8;
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+
+    return (uint16_t) ~sum;
+}
+
+
+//
+// Compare a checksum implementation with the reference
+//
+static unsigned int test_len(
+    const inet_csum_impl_t *    impl,
+    const char *                pattern,
+    unsigned int                align,
+    unsigned int                len,
+    unsigned long *             cases)
+{
+    const uint8_t *             data = buffer + align;
+    uint16_t                    csum;
+    uint16_t                    expected;
+
+    // The result is in the byte order of the data
+    csum = inet_csum((const uint16_t *) data, (int) len);
+    expected = htons(reference_csum(data, len));
+    *cases += 1;
+
+    if (csum != expected)
+    {
+        fprintf(stderr, "csum %s: pattern %s align %u len %u: 0x%04x, expected 0x%04x\n",
+                impl->name, pattern, align, len, ntohs(csum), ntohs(expected));
+        return 1;
+    }
+
+    return 0;
+}
+
+
+//
+// Test a checksum implementation
+//
+static unsigned int test_impl(
+    const inet_csum_impl_t *    impl)
+{
+    unsigned long               cases = 0;
+    unsigned int                failures = 0;
+    unsigned int                pattern;
+    unsigned int                align;
+    unsigned int                len;
+
+    inet_csum_select(impl);
+
+    for (pattern = 0; pattern < PATTERN_COUNT; pattern++)
+    {
+        fill_buffer(pattern);
+
+        for (align = 0; align < TEST_MAX_ALIGN; align++)
+        {
+            for (len = 0; len <= TEST_MAX_LEN; len++)
+            {
+                failures += test_len(impl, pattern_list[pattern], align, len, &cases);
+            }
+            failures += test_len(impl, pattern_list[pattern], align, TEST_JUMBO_LEN, &cases);
+        }
+    }
+
+    printf("{\"test\":\"csum\",\"impl\":\"%s\",\"cases\":%lu,\"failures\":%u}\n", impl->name, cases, failures);
+    return failures;
+}
+
+
+//
+// Benchmark a checksum implementation
+//
+static void bench_impl(
+    const inet_csum_impl_t *    impl,
+    unsigned int                millis)
+{
+    uint64_t                    start;
+    uint64_t                    elapsed;
+    uint64_t                    limit = (uint64_t) millis * 1000000;
+    unsigned long               ops;
+    unsigned int                len_index;
+    unsigned int                len;
+    unsigned int                index;
+
+    inet_csum_select(impl);
+    fill_buffer(0);
+
+    for (len_index = 0; len_index < BENCH_LEN_COUNT; len_index++)
+    {
+        len = bench_len_list[len_index];
+        ops = 0;
+
+        start = monotonic_ns();
+        do
+        {
+            for (index = 0; index < 1024; index++)
+            {
+                bench_sink = inet_csum((const uint16_t *) buffer, (int) len);
+            }
+            ops += 1024;
+            elapsed = monotonic_ns() - start;
+        } while (elapsed < limit);
+
+        printf("{\"bench\":\"csum\",\"impl\":\"%s\",\"len\":%u,\"ops\":%lu,\"ns_per_op\":%.2f,\"gbps\":%.2f}\n",
+               impl->name, len, ops, (double) elapsed / ops, (double) len * 8 * ops / elapsed);
+    }
+}
+
+
+//
+// Main
+//
+int main(
+    int                         argc,
+    char * const                argv[])
+{
+    const inet_csum_impl_t *    impl;
+    unsigned int                test = 0;
+    unsigned int                millis = DEFAULT_BENCH_MILLIS;
+    unsigned int                failures = 0;
+    unsigned int                index;
+    int                         opt;
+
+    while ((opt = getopt(argc, argv, "tm:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            test = 1;
+            break;
+
+        case 'm':
+            millis = (unsigned int) strtoul(optarg, NULL, 10);
+            if (millis < 1)
+            {
+                millis = 1;
+            }
+            break;
+
+        default:
+            fprintf(stderr, "Usage:\n");
+            fprintf(stderr, "  %s [-t] [-m millis]\n", argv[0]);
+            fprintf(stderr, "\n");
+            fprintf(stderr, "  options:\n");
+            fprintf(stderr, "    -t run the equivalence test rather than the benchmark\n");
+            fprintf(stderr, "    -m benchmark time for each length in milliseconds (default %u)\n", DEFAULT_BENCH_MILLIS);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (index = 0; (impl = inet_csum_impl(index)) != NULL; index++)
+    {
+        if (test)
+        {
+            failures += test_impl(impl);
+        }
+        else
+        {
+            bench_impl(impl, millis);
+        }
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+
+//
+// Copyright (c) 2024-2026, Denny Page
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+//
+// Event manager timer microbenchmark
+//
+// The benchmark fills the timer heap of an event manager with synthetic timers
+// and reports the time per operation of evm_add_timer and evm_del_timer for a
+// range of heap sizes. Timers are not run. Results are written as JSON lines.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "common.h"
+
+
+// Globals normally defined by mcast-bridge
+unsigned int                    debug_level = 0;
+unsigned int                    debug_log_sample = 0;
+unsigned int                    debug_log_rate = 0;
+
+// Benchmark heap sizes and default time for each
+static const unsigned int       bench_size_list[] = { 64, 1024, 16384, 262144 };
+#define BENCH_SIZE_COUNT        (sizeof(bench_size_list) / sizeof(bench_size_list[0]))
+#define DEFAULT_BENCH_MILLIS    200
+
+// Range of timer durations in milliseconds
+#define BENCH_TIMER_MILLIS      260000
+
+// Benchmark timers and their durations
+static evm_timer_t *            timer_list;
+static unsigned int *           millis_list;
+
+
+
+//
+// Monotonic time in nanoseconds
+//
+static uint64_t monotonic_ns(void)
+{
+    struct timespec             ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+//
+// Timer callback (never called)
+//
+static void bench_timeout(
+    __attribute__ ((unused))
+    void *                      closure)
+{
+}
+
+
+//
+// Report a result
+//
+static void bench_report(
+    const char *                op,
+    unsigned int                size,
+    unsigned long               ops,
+    uint64_t                    elapsed)
+{
+    printf("{\"bench\":\"evm_timer\",\"op\":\"%s\",\"timers\":%u,\"ops\":%lu,\"ns_per_op\":%.2f}\n",
+           op, size, ops, (double) elapsed / ops);
+}
+
+
+//
+// Benchmark the timer operations for a heap size
+//
+static void bench_size(
+    unsigned int                size,
+    unsigned int                millis)
+{
+    evm_t *                     evm;
+    uint64_t                    start;
+    uint64_t                    limit = (uint64_t) millis * 1000000;
+    uint64_t                    add_elapsed = 0;
+    uint64_t                    del_elapsed = 0;
+    uint64_t                    elapsed;
+    unsigned long               ops;
+    unsigned int                index;
+
+    evm = evm_create(1, (int) size);
+    if (evm == NULL)
+    {
+        fatal("Cannot create event manager\n");
+    }
+
+    // Fill and empty the heap
+    // NB: Timers are deleted in random order to exercise both sift directions
+    ops = 0;
+    do
+    {
+        start = monotonic_ns();
+        for (index = 0; index < size; index++)
+        {
+            evm_add_timer(evm, &timer_list[index], millis_list[index], bench_timeout, NULL);
+        }
+        add_elapsed += monotonic_ns() - start;
+
+        start = monotonic_ns();
+        for (index = 0; index < size; index++)
+        {
+            evm_del_timer(evm, &timer_list[millis_list[index] % size]);
+        }
+        for (index = 0; index < size; index++)
+        {
+            evm_del_timer(evm, &timer_list[index]);
+        }
+        del_elapsed += monotonic_ns() - start;
+
+        ops += size;
+    } while (add_elapsed + del_elapsed < limit);
+    bench_report("add", size, ops, add_elapsed);
+    bench_report("del", size, ops, del_elapsed);
+
+    // Reschedule timers in a full heap, as a group or source refresh does
+    for (index = 0; index < size; index++)
+    {
+        evm_add_timer(evm, &timer_list[index], millis_list[index], bench_timeout, NULL);
+    }
+    ops = 0;
+    start = monotonic_ns();
+    do
+    {
+        for (index = 0; index < 1024; index++)
+        {
+            evm_add_timer(evm, &timer_list[millis_list[(ops + index) % size] % size],
+                          millis_list[(ops + index + 1) % size], bench_timeout, NULL);
+        }
+        ops += 1024;
+        elapsed = monotonic_ns() - start;
+    } while (elapsed < limit);
+    bench_report("reschedule", size, ops, elapsed);
+
+    for (index = 0; index < size; index++)
+    {
+        evm_del_timer(evm, &timer_list[index]);
+    }
+}
+
+
+//
+// Main
+//
+int main(
+    int                         argc,
+    char * const                argv[])
+{
+    unsigned int                millis = DEFAULT_BENCH_MILLIS;
+    unsigned int                max_size = bench_size_list[BENCH_SIZE_COUNT - 1];
+    unsigned int                index;
+    int                         opt;
+
+    while ((opt = getopt(argc, argv, "m:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            millis = (unsigned int) strtoul(optarg, NULL, 10);
+            if (millis < 1)
+            {
+                millis = 1;
+            }
+            break;
+
+        default:
+            fprintf(stderr, "Usage:\n");
+            fprintf(stderr, "  %s [-m millis]\n", argv[0]);
+            fprintf(stderr, "\n");
+            fprintf(stderr, "  options:\n");
+            fprintf(stderr, "    -m benchmark time for each heap size in milliseconds (default %u)\n", DEFAULT_BENCH_MILLIS);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    timer_list = calloc(max_size, sizeof(evm_timer_t));
+    millis_list = calloc(max_size, sizeof(unsigned int));
+    if (timer_list == NULL || millis_list == NULL)
+    {
+        fatal("Cannot allocate memory for timers\n");
+    }
+
+    srandom(1);
+    for (index = 0; index < max_size; index++)
+    {
+        millis_list[index] = (unsigned int) random() % BENCH_TIMER_MILLIS;
+    }
+
+    for (index = 0; index < BENCH_SIZE_COUNT; index++)
+    {
+        bench_size(bench_size_list[index], millis);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,412 @@
+
+//
+// Copyright (c) 2024-2026, Denny Page
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+//
+// IGMP group table and report parser microbenchmark
+//
+// The benchmark registers synthetic interfaces and groups with the IGMP
+// module, then reports the time per group lookup for a range of group table
+// sizes, and the time per IGMP v3 report for a range of report sizes. Reports
+// are complete Ethernet frames processed as if received by pcap. Results are
+// written as JSON lines.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include "common.h"
+#include "protocols.h"
+
+
+// Benchmark entry points of igmp.c (built with IGMP_BENCH defined)
+extern void igmp_bench_initialize(void);
+extern unsigned int igmp_bench_find_group(
+    unsigned int                interface_index,
+    const uint8_t *             mcast_addr);
+extern void igmp_bench_process_packet(
+    unsigned int                interface_index,
+    const unsigned char *       packet,
+    unsigned int                packet_len);
+
+
+// Globals normally defined by mcast-bridge
+unsigned int                    debug_level = 0;
+unsigned int                    debug_log_sample = 0;
+unsigned int                    debug_log_rate = 0;
+unsigned int                    non_configured_groups = 256;
+querier_mode_type_t             igmp_querier_mode = QUERIER_MODE_NEVER;
+
+// Configured group table sizes, one interface for each
+static const unsigned int       bench_group_list[] = { 16, 256, 4096 };
+#define BENCH_GROUP_COUNT       (sizeof(bench_group_list) / sizeof(bench_group_list[0]))
+#define DEFAULT_BENCH_MILLIS    200
+
+// Report sizes in group records, and sources in each include mode record
+static const unsigned int       bench_record_list[] = { 1, 16, 64 };
+#define BENCH_RECORD_COUNT      (sizeof(bench_record_list) / sizeof(bench_record_list[0]))
+#define BENCH_SOURCE_COUNT      4
+
+// Interface used for the report benchmark
+#define REPORT_INTERFACE        1
+
+// Offsets of the IP header and IGMP report in a frame, and the size of the largest report
+#define IP_OFFSET               (sizeof(mcb_ethernet_t))
+#define IGMP_OFFSET             (sizeof(mcb_ethernet_t) + sizeof(mcb_ip4_t) + sizeof(mcb_ip4_ra_opt_t))
+#define REPORT_BUFFER_SIZE      (IGMP_OFFSET + sizeof(mcb_igmp_v3_report_t) + \
+                                 64 * (sizeof(mcb_igmp_v3_group_record_t) + BENCH_SOURCE_COUNT * MCB_IP4_ADDR_LEN))
+
+// Synthetic bridge interfaces
+static bridge_interface_t       bench_interface_list[BENCH_GROUP_COUNT];
+
+// Lookup addresses
+#define LOOKUP_COUNT            1024
+static uint8_t                  lookup_list[LOOKUP_COUNT][MCB_IP4_ADDR_LEN];
+
+// Report buffer
+static uint8_t                  report_buffer[REPORT_BUFFER_SIZE];
+
+// Calls from the IGMP module, and the benchmark result sink
+static unsigned long            outbound_calls;
+static unsigned long            source_filter_calls;
+static volatile unsigned int    bench_sink;
+
+
+
+//
+// Monotonic time in nanoseconds
+//
+static uint64_t monotonic_ns(void)
+{
+    struct timespec             ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+//
+// Interface calls from the IGMP module
+//
+void interface_activate_outbound(
+    __attribute__ ((unused))
+    bridge_interface_t *        bridge_interface)
+{
+    outbound_calls += 1;
+}
+
+void interface_deactivate_outbound(
+    __attribute__ ((unused))
+    bridge_interface_t *        bridge_interface)
+{
+    outbound_calls += 1;
+}
+
+void interface_set_source_filter(
+    __attribute__ ((unused))
+    bridge_interface_t *        bridge_interface,
+    __attribute__ ((unused))
+    const void *                mcast_addr,
+    __attribute__ ((unused))
+    const void *                source_list,
+    __attribute__ ((unused))
+    unsigned int                source_count)
+{
+    source_filter_calls += 1;
+}
+
+
+//
+// Set a configured group address (239.1.0.0 + index)
+//
+static void group_addr(
+    unsigned int                index,
+    uint8_t *                   addr)
+{
+    uint32_t                    haddr;
+
+    haddr = htonl(0xef010000 + index);
+    memcpy(addr, &haddr, MCB_IP4_ADDR_LEN);
+}
+
+
+//
+// Register the synthetic interfaces and groups
+//
+static void setup_interfaces(void)
+{
+    bridge_interface_t *        bridge_interface;
+    struct in_addr              mcast_addr;
+    unsigned int                interface_index;
+    unsigned int                group_index;
+    char                        name[16];
+
+    for (interface_index = 0; interface_index < BENCH_GROUP_COUNT; interface_index++)
+    {
+        bridge_interface = &bench_interface_list[interface_index];
+
+        snprintf(name, sizeof(name), "bench%u", interface_index);
+        bridge_interface->name = strdup(name);
+        bridge_interface->if_index = interface_index + 1;
+        bridge_interface->outbound_configuration = INTERFACE_CONFIG_DYNAMIC;
+        bridge_interface->mac_addr[0] = 0x02;
+        bridge_interface->mac_addr[5] = (uint8_t) (interface_index + 1);
+        bridge_interface->ipv4_addr.s_addr = htonl(0x0a000001 + (interface_index << 8));
+
+        for (group_index = 0; group_index < bench_group_list[interface_index]; group_index++)
+        {
+            group_addr(group_index, (uint8_t *) &mcast_addr);
+            igmp_register_interface(bridge_interface, &mcast_addr);
+        }
+    }
+
+    igmp_bench_initialize();
+}
+
+
+//
+// Benchmark group lookups
+//
+static void bench_find_group(
+    unsigned int                millis)
+{
+    uint64_t                    start;
+    uint64_t                    elapsed;
+    uint64_t                    limit = (uint64_t) millis * 1000000;
+    unsigned long               ops;
+    unsigned int                interface_index;
+    unsigned int                groups;
+    unsigned int                miss;
+    unsigned int                index;
+    unsigned int                found;
+
+    for (interface_index = 0; interface_index < BENCH_GROUP_COUNT; interface_index++)
+    {
+        groups = bench_group_list[interface_index];
+
+        // Configured groups (hits) and groups that are not configured (misses)
+        for (miss = 0; miss < 2; miss++)
+        {
+            srandom(1);
+            for (index = 0; index < LOOKUP_COUNT; index++)
+            {
+                group_addr(miss ? groups + (unsigned int) random() % 65536 :
+                                  (unsigned int) random() % groups, lookup_list[index]);
+            }
+
+            ops = 0;
+            found = 0;
+            start = monotonic_ns();
+            do
+            {
+                for (index = 0; index < LOOKUP_COUNT; index++)
+                {
+                    found += igmp_bench_find_group(interface_index, lookup_list[index]);
+                }
+                ops += LOOKUP_COUNT;
+                elapsed = monotonic_ns() - start;
+            } while (elapsed < limit);
+            bench_sink = found;
+
+            printf("{\"bench\":\"igmp_find_group\",\"groups\":%u,\"lookup\":\"%s\",\"ops\":%lu,\"ns_per_op\":%.2f}\n",
+                   groups, miss ? "miss" : "hit", ops, (double) elapsed / ops);
+        }
+    }
+}
+
+
+//
+// Build an IGMP v3 report frame
+//
+// Returns the frame length
+//
+static unsigned int build_report(
+    unsigned int                record_count,
+    unsigned int                source_count)
+{
+    mcb_ethernet_t *            ethernet;
+    mcb_ip4_t *                 ip;
+    mcb_ip4_ra_opt_t *          ip_ra;
+    mcb_igmp_v3_report_t *      report;
+    mcb_igmp_v3_group_record_t *record;
+    uint8_t *                   ptr;
+    unsigned int                igmp_len;
+    unsigned int                record_index;
+    unsigned int                source_index;
+    uint32_t                    haddr;
+
+    memset(report_buffer, 0, sizeof(report_buffer));
+
+    ethernet = (mcb_ethernet_t *) report_buffer;
+    ip = (mcb_ip4_t *) (report_buffer + IP_OFFSET);
+    ip_ra = (mcb_ip4_ra_opt_t *) (report_buffer + IP_OFFSET + sizeof(mcb_ip4_t));
+    report = (mcb_igmp_v3_report_t *) (report_buffer + IGMP_OFFSET);
+
+    // Build the group records
+    ptr = (uint8_t *) report + sizeof(mcb_igmp_v3_report_t);
+    for (record_index = 0; record_index < record_count; record_index++)
+    {
+        record = (mcb_igmp_v3_group_record_t *) ptr;
+        record->type = source_count ? MCB_REC_MODE_IS_INCLUDE : MCB_REC_MODE_IS_EXCLUDE;
+        record->num_srcs = htons(source_count);
+        group_addr(record_index, record->group);
+        for (source_index = 0; source_index < source_count; source_index++)
+        {
+            haddr = htonl(0x0a640001 + source_index);
+            memcpy(record->srcs[source_index], &haddr, MCB_IP4_ADDR_LEN);
+        }
+        ptr += sizeof(mcb_igmp_v3_group_record_t) + source_count * MCB_IP4_ADDR_LEN;
+    }
+    igmp_len = (unsigned int) (ptr - (uint8_t *) report);
+
+    // Build the IGMP v3 report header
+    report->type = MCB_IGMP_V3_REPORT;
+    report->num_groups = htons(record_count);
+    report->csum = inet_csum((uint16_t *) (report_buffer + IGMP_OFFSET), (int) igmp_len);
+
+    // Build the IP header and Router Alert option
+    ip->version = 4;
+    ip->header_len = (sizeof(mcb_ip4_t) + sizeof(mcb_ip4_ra_opt_t)) >> 2;
+    ip->total_len = htons(sizeof(mcb_ip4_t) + sizeof(mcb_ip4_ra_opt_t) + igmp_len);
+    ip->tos = MCB_IP4_TOS_IC;
+    ip->ttl = 1;
+    ip->protocol = MCB_IP4_PROTOCOL_IGMP;
+    haddr = htonl(0x0a000102);
+    memcpy(ip->src, &haddr, MCB_IP4_ADDR_LEN);
+    haddr = htonl(MCB_IP4_ALL_REPORTS);
+    memcpy(ip->dst, &haddr, MCB_IP4_ADDR_LEN);
+    ip_ra->type = MCB_IP4_OPT_RA;
+    ip_ra->length = 4;
+    ip->csum = inet_csum((uint16_t *) (report_buffer + IP_OFFSET), sizeof(mcb_ip4_t) + sizeof(mcb_ip4_ra_opt_t));
+
+    // Build the Ethernet header
+    ethernet->type = htons(MCB_ETHERNET_TYPE_IP4);
+    ethernet->dst[0] = 0x01;
+    ethernet->dst[2] = 0x5e;
+    ethernet->dst[5] = 0x16;
+    ethernet->src[0] = 0x02;
+    ethernet->src[5] = 0xfe;
+
+    return (unsigned int) (ptr - report_buffer);
+}
+
+
+//
+// Benchmark the IGMP v3 report parser
+//
+// NB: The first report activates the groups, and the following reports
+//     refresh them, as periodic reports from a listener do.
+//
+static void bench_v3_report(
+    unsigned int                millis)
+{
+    uint64_t                    start;
+    uint64_t                    elapsed;
+    uint64_t                    limit = (uint64_t) millis * 1000000;
+    unsigned long               ops;
+    unsigned int                record_index;
+    unsigned int                source_count;
+    unsigned int                records;
+    unsigned int                len;
+    unsigned int                index;
+
+    for (source_count = 0; source_count <= BENCH_SOURCE_COUNT; source_count += BENCH_SOURCE_COUNT)
+    {
+        for (record_index = 0; record_index < BENCH_RECORD_COUNT; record_index++)
+        {
+            records = bench_record_list[record_index];
+            len = build_report(records, source_count);
+
+            outbound_calls = 0;
+            source_filter_calls = 0;
+            ops = 0;
+            start = monotonic_ns();
+            do
+            {
+                for (index = 0; index < 256; index++)
+                {
+                    igmp_bench_process_packet(REPORT_INTERFACE, report_buffer, len);
+                }
+                ops += 256;
+                elapsed = monotonic_ns() - start;
+            } while (elapsed < limit);
+
+            printf("{\"bench\":\"igmp_v3_report\",\"records\":%u,\"sources\":%u,\"len\":%u,\"ops\":%lu,"
+                   "\"ns_per_op\":%.2f,\"ns_per_record\":%.2f,\"outbound_calls\":%lu,\"source_filter_calls\":%lu}\n",
+                   records, source_count, len, ops, (double) elapsed / ops, (double) elapsed / ops / records,
+                   outbound_calls, source_filter_calls);
+        }
+    }
+}
+
+
+//
+// Main
+//
+int main(
+    int                         argc,
+    char * const                argv[])
+{
+    unsigned int                millis = DEFAULT_BENCH_MILLIS;
+    int                         opt;
+
+    while ((opt = getopt(argc, argv, "m:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            millis = (unsigned int) strtoul(optarg, NULL, 10);
+            if (millis < 1)
+            {
+                millis = 1;
+            }
+            break;
+
+        default:
+            fprintf(stderr, "Usage:\n");
+            fprintf(stderr, "  %s [-m millis]\n", argv[0]);
+            fprintf(stderr, "\n");
+            fprintf(stderr, "  options:\n");
+            fprintf(stderr, "    -m benchmark time for each case in milliseconds (default %u)\n", DEFAULT_BENCH_MILLIS);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    initialize_inet_csum();
+    setup_interfaces();
+
+    bench_find_group(millis);
+    bench_v3_report(millis);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,285 @@
+#!/bin/sh
+#
+# Copyright (c) 2024-2026, Denny Page
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+#
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+# PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+# TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+# NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+
+#
+# Network namespace forwarding benchmark
+#
+# Each bridge instance gets one network namespace per interface, connected to
+# the host by a veth pair. The first interface of each bridge is the inbound
+# interface and the others are outbound. mcast-bridge runs on the host with a
+# generated configuration, mcast-sr sends load into each inbound namespace and
+# analyzes it in each outbound namespace, and the bridge counters are collected
+# from the statistics socket afterwards.
+#
+# The sender totals and the bridge counters are written to stdout as JSON
+# lines. The full sender, analyzer and bridge output is kept in the output
+# directory. Requires root, iproute2 and socat (Linux only).
+#
+
+set -u
+
+bridges=1
+interfaces=2
+rate=100000
+size=256
+burst=32
+duration=10
+dataplane=""
+outdir=""
+
+bindir=$(cd "$(dirname "$0")/.." && pwd)
+mcast_bridge=${MCAST_BRIDGE:-$bindir/mcast-bridge}
+mcast_sr=${MCAST_SR:-$bindir/mcast-sr}
+
+usage()
+{
+    echo "Usage:" >&2
+    echo "  $0 [-b bridges] [-i interfaces] [-r pps] [-l size] [-B burst] [-d seconds] [-D dataplane] [-o dir]" >&2
+    echo "" >&2
+    echo "  options:" >&2
+    echo "    -b number of bridge instances (default $bridges)" >&2
+    echo "    -i number of interfaces in each bridge instance, one inbound (default $interfaces)" >&2
+    echo "    -r load rate of each sender in packets per second (default $rate)" >&2
+    echo "    -l load datagram payload size (default $size)" >&2
+    echo "    -B load datagrams sent per burst (default $burst)" >&2
+    echo "    -d load duration in seconds (default $duration)" >&2
+    echo "    -D bridge dataplane (default is the mcast-bridge default)" >&2
+    echo "    -o output directory (default is a temporary directory)" >&2
+    exit 1
+}
+
+while getopts "b:i:r:l:B:d:D:o:" opt
+do
+    case $opt in
+        b) bridges=$OPTARG ;;
+        i) interfaces=$OPTARG ;;
+        r) rate=$OPTARG ;;
+        l) size=$OPTARG ;;
+        B) burst=$OPTARG ;;
+        d) duration=$OPTARG ;;
+        D) dataplane=$OPTARG ;;
+        o) outdir=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+
+if [ "$bridges" -lt 1 ] || [ "$bridges" -gt 200 ] || [ "$interfaces" -lt 2 ] || [ "$interfaces" -gt 200 ]
+then
+    echo "$0: bridges must be 1-200 and interfaces 2-200" >&2
+    exit 1
+fi
+
+# The benchmark needs root to create namespaces
+if [ "$(id -u)" -ne 0 ]
+then
+    echo "{\"bench\":\"netns\",\"skipped\":\"requires root\"}"
+    exit 0
+fi
+
+for cmd in ip socat "$mcast_bridge" "$mcast_sr"
+do
+    if ! command -v "$cmd" > /dev/null 2>&1
+    then
+        echo "$0: $cmd not found" >&2
+        exit 1
+    fi
+done
+
+if [ -z "$outdir" ]
+then
+    outdir=$(mktemp -d /tmp/netns-bench.XXXXXX)
+fi
+mkdir -p "$outdir"
+config="$outdir/mcast-bridge.conf"
+socket="$outdir/mcast-bridge.sock"
+
+bridge_pid=""
+analyzer_pids=""
+sender_pids=""
+
+# Names of the namespace and host side veth of an interface
+ns_name() { echo "mcb-b$1-i$2"; }
+host_name() { echo "mcb$1h$2"; }
+
+
+#
+# Remove everything the benchmark created
+#
+cleanup()
+{
+    for pid in $sender_pids $analyzer_pids $bridge_pid
+    do
+        kill "$pid" 2> /dev/null
+    done
+    wait 2> /dev/null
+
+    b=0
+    while [ $b -lt "$bridges" ]
+    do
+        i=0
+        while [ $i -lt "$interfaces" ]
+        do
+            ip netns del "$(ns_name $b $i)" 2> /dev/null
+            i=$((i + 1))
+        done
+        b=$((b + 1))
+    done
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+
+#
+# Build the namespaces and veth pairs, and write the configuration
+#
+echo "stats-socket = $socket" > "$config"
+
+b=0
+while [ $b -lt "$bridges" ]
+do
+    inbound=""
+    outbound=""
+
+    i=0
+    while [ $i -lt "$interfaces" ]
+    do
+        ns=$(ns_name $b $i)
+        host=$(host_name $b $i)
+
+        ip netns add "$ns" || exit 1
+        ip link add "$host" type veth peer name veth0 netns "$ns" || exit 1
+        ip addr add "10.$((b + 1)).$i.1/24" dev "$host"
+        ip link set "$host" up
+        ip netns exec "$ns" ip addr add "10.$((b + 1)).$i.2/24" dev veth0
+        ip netns exec "$ns" ip link set lo up
+        ip netns exec "$ns" ip link set veth0 up
+        ip netns exec "$ns" ip route add 239.0.0.0/8 dev veth0
+
+        if [ $i -eq 0 ]
+        then
+            inbound=$host
+        else
+            outbound="${outbound:+$outbound, }$host"
+        fi
+        i=$((i + 1))
+    done
+
+    {
+        echo ""
+        echo "[$((7500 + b))]"
+        echo "    ipv4-address = 239.1.$b.1"
+        echo "    inbound-interfaces = $inbound"
+        echo "    outbound-interfaces = $outbound"
+        echo "    static-inbound-interfaces = $inbound"
+        echo "    static-outbound-interfaces = $outbound"
+        if [ -n "$dataplane" ]
+        then
+            echo "    dataplane = $dataplane"
+        fi
+    } >> "$config"
+
+    b=$((b + 1))
+done
+
+
+#
+# Start the bridge and wait for the statistics socket
+#
+"$mcast_bridge" -f -c "$config" > "$outdir/mcast-bridge.log" 2>&1 &
+bridge_pid=$!
+
+wait_count=0
+while [ ! -S "$socket" ]
+do
+    if ! kill -0 "$bridge_pid" 2> /dev/null || [ $wait_count -ge 50 ]
+    then
+        echo "$0: mcast-bridge failed to start (see $outdir/mcast-bridge.log)" >&2
+        exit 1
+    fi
+    sleep 0.1
+    wait_count=$((wait_count + 1))
+done
+
+
+#
+# Start the analyzers, then run the senders
+#
+b=0
+while [ $b -lt "$bridges" ]
+do
+    i=1
+    while [ $i -lt "$interfaces" ]
+    do
+        ip netns exec "$(ns_name $b $i)" "$mcast_sr" -a -j -i veth0 -p $((7500 + b)) "239.1.$b.1" \
+            > "$outdir/rx-$b-$i.json" 2> /dev/null &
+        analyzer_pids="$analyzer_pids $!"
+        i=$((i + 1))
+    done
+    b=$((b + 1))
+done
+sleep 1
+
+b=0
+while [ $b -lt "$bridges" ]
+do
+    ip netns exec "$(ns_name $b 0)" "$mcast_sr" -s -j -i veth0 -p $((7500 + b)) \
+        -r "$rate" -l "$size" -B "$burst" -d "$duration" "239.1.$b.1" \
+        > "$outdir/tx-$b.json" 2> /dev/null &
+    sender_pids="$sender_pids $!"
+    b=$((b + 1))
+done
+for pid in $sender_pids
+do
+    wait "$pid"
+done
+sender_pids=""
+
+# Allow the analyzers to report the tail of the load
+sleep 2
+for pid in $analyzer_pids
+do
+    kill "$pid" 2> /dev/null
+done
+analyzer_pids=""
+
+
+#
+# Collect the results
+#
+echo json | socat - UNIX-CONNECT:"$socket" > "$outdir/bridge.json"
+
+echo "{\"bench\":\"netns\",\"bridges\":$bridges,\"interfaces\":$interfaces,\"rate_pps\":$rate,\"size\":$size,\"burst\":$burst,\"duration\":$duration,\"dataplane\":\"${dataplane:-default}\",\"output\":\"$outdir\"}"
+b=0
+while [ $b -lt "$bridges" ]
+do
+    grep '"report":"total"' "$outdir/tx-$b.json"
+    b=$((b + 1))
+done
+cat "$outdir/bridge.json"
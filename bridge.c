@@ -28,287 +28,2855 @@
 //
 
 
+// Linux requires _GNU_SOURCE for recvmmsg/sendmmsg
+#if defined(__linux__)
+# define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <pthread.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#if defined(__linux__)
+# include <sched.h>
+typedef cpu_set_t               bridge_cpuset_t;
+#elif defined(__FreeBSD__)
+# include <pthread_np.h>
+# include <sys/cpuset.h>
+typedef cpuset_t                bridge_cpuset_t;
+#endif
 
 #include "common.h"
 
+#if defined(USE_EVENTFD)
+# include <sys/eventfd.h>
+#endif
+
+
+// Batched socket I/O (recvmmsg/sendmmsg)
+// NB: Where not available, batches are received by looping recvmsg
+//     and sent by looping sendto.
+#if defined(__linux__) || defined(__FreeBSD__)
+# define USE_MMSG
+#endif
+
+// Maximum number of packets received and forwarded per batch
+#define BRIDGE_BATCH_SIZE       32
+
+// Maximum number of batches processed per socket per event wait
+#define BRIDGE_DRAIN_BUDGET     8
+
+// Rate limit queue size for each shaped outbound interface, in packets and bytes
+// NB: The byte size must be able to hold a maximum sized (coalesced) packet
+#define SHAPER_QUEUE_COUNT      256
+#define SHAPER_QUEUE_BYTES      (8 * MCAST_MAX_PACKET_SIZE)
+
+// Rate limit token bucket depth, in milliseconds at the configured rate
+#define SHAPER_DEPTH_MILLIS     2
+
+// Maximum interval credited to the rate limit token bucket, in nanoseconds
+// NB: This must be at least SHAPER_DEPTH_MILLIS, and also bounds the token
+//     arithmetic to avoid overflow at the maximum configurable rate
+#define SHAPER_MAX_INTERVAL     10000000
+
+// Duplicate suppression table geometry. Each bucket fits in a cache line.
+// NB: The bucket count must be a power of 2
+#define DEDUP_BUCKET_COUNT      1024
+#define DEDUP_BUCKET_WAYS       (CACHE_LINE_SIZE / sizeof(bridge_dedup_entry_t))
+
+// Number of entries in a worker command channel (must be a power of 2)
+#define BRIDGE_CHANNEL_SIZE     1024
+
+// Size of the receive control message buffer for each packet
+#if defined(USE_RECVIF_PKTINFO)
+# define BRIDGE_RECV_CMSG_SIZE  CMSG_SPACE(256)
+#elif defined(USE_UDP_OFFLOAD) || defined(USE_RXQ_OVFL) || defined(USE_RX_TIMESTAMP) || defined(USE_GROUP_LIST)
+# define BRIDGE_RECV_CMSG_SIZE  (CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct timespec)) + \
+                                 CMSG_SPACE(sizeof(struct in6_pktinfo)))
+#endif
 
 
-// Thread local storage for bridge threads
+// Duplicate suppression fingerprint of a recently received packet
 typedef struct
 {
-    bridge_instance_t *         bridge;
+    uint64_t                    fingerprint;
+    uint64_t                    time;
+} bridge_dedup_entry_t;
+
+// Fingerprints of recently received packets for a bridge instance
+//
+// Fingerprints are a hash of the group, length and payload of a packet. By
+// default the source address is not part of the fingerprint, because a bridge
+// forwards packets with its own source address, so a copy reflected by another
+// bridge arrives from a different source. With duplicate-match-source, the
+// source address is included so that identical payloads from different senders
+// are not dropped. Each bucket holds the most recent fingerprints that map to
+// it, and a new fingerprint replaces the oldest entry in its bucket.
+//
+// NB: The table is only used by the worker thread that owns the bridge instance.
+typedef struct bridge_dedup
+{
+    // Window in nanoseconds
+    uint64_t                    window;
+
+    // Length of the source address included in the fingerprint (0 if none)
+    size_t                      source_len;
+
+    struct
+    {
+        bridge_dedup_entry_t    entry[DEDUP_BUCKET_WAYS];
+    } __attribute__ ((aligned(CACHE_LINE_SIZE))) bucket[DEDUP_BUCKET_COUNT];
+} bridge_dedup_t;
+
+// Worker command channel entry
+typedef struct
+{
+    unsigned int                sequence;
+    bridge_interface_t *        bridge_interface;
+} bridge_command_t;
+
+// Worker command channel
+//
+// The control plane threads record the state they want for an interface in
+// the interface itself (see interface_request_update), and post the interface
+// to the worker, which applies the requested state between batches. An
+// interface is only posted if it is not already pending, so repeated changes
+// are coalesced, and a change is never lost if the worker falls behind.
+//
+// The channel is a bounded multiple producer, single consumer ring. The
+// sequence number of each entry indicates whether the entry is free for the
+// producer claiming its position, or holds an interface for the consumer. If
+// the ring is full, the producer sets the overflow flag rather than waiting,
+// and the worker looks for pending interfaces in all of its bridge instances.
+// The worker is woken with an eventfd (a pipe on other platforms), which is
+// only signaled when a wakeup is not already pending.
+typedef struct bridge_channel
+{
+    // Wakeup descriptors (the same descriptor for an eventfd)
+    int                         read_fd;
+    int                         write_fd;
+    unsigned int                wakeup_pending;
+
+    // Were interfaces left out of a full ring?
+    unsigned int                overflow;
+
+    // Next position to be claimed by a producer
+    unsigned int                tail __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+    // Next position to be consumed (worker only)
+    unsigned int                head __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+    bridge_command_t            entry[BRIDGE_CHANNEL_SIZE];
+} bridge_channel_t;
+
+// Thread local storage for bridge worker threads
+typedef struct
+{
+    // Worker index, CPU affinity (-1 if none) and NUMA node the worker is
+    // placed on (-1 if none)
+    unsigned int                worker_index;
+    int                         cpu;
+    int                         numa_node;
+
+    // Busy poll rather than wait for packets?
+    unsigned int                busy_poll;
+
+    // Bridge instances, sockets and rate limit timers assigned to the worker
+    bridge_instance_t **        bridge_list;
+    unsigned int                bridge_count;
+    unsigned int                socket_count;
+    unsigned int                timer_count;
+
     evm_t *                     evm;
 
-    socket_address_t            src_addr;
-    socklen_t                   src_addr_len;
-    unsigned char               packet_buffer[MCAST_MAX_PACKET_SIZE];
+    // Command channel, and the bridge instances with fanout lists to be rebuilt
+    // after executing the commands
+    bridge_channel_t *          channel;
+    bridge_instance_t **        fanout_update_list;
 
-    // Structures for recvmsg
-    struct msghdr               recv_msg;
-    struct iovec                recv_iovec;
-#if defined(USE_RECVIF_PKTINFO)
-    char                        cmsg_buf[CMSG_SPACE(256)];
+    // Inbound interface for each packet in the current batch. NULL if the
+    // packet is to be dropped.
+    bridge_interface_t *        batch_interface[BRIDGE_BATCH_SIZE];
+
+    // Index in the bridge group list of the group each packet in the current
+    // batch was sent to
+    unsigned int                batch_group[BRIDGE_BATCH_SIZE];
+
+    // Source address of each packet in the current batch
+    socket_address_t            src_addr[BRIDGE_BATCH_SIZE];
+
+#if defined(USE_RX_TIMESTAMP)
+    // Kernel receive timestamp of each packet in the current batch, in
+    // nanoseconds. Zero if the packet has no timestamp.
+    uint64_t                    rx_timestamp[BRIDGE_BATCH_SIZE];
+#endif
+
+    // Structures for receive
+    struct iovec                recv_iovec[BRIDGE_BATCH_SIZE];
+#if defined(USE_MMSG)
+    struct mmsghdr              recv_msgs[BRIDGE_BATCH_SIZE];
+#else
+    struct msghdr               recv_msgs[BRIDGE_BATCH_SIZE];
+#endif
+#if defined(BRIDGE_RECV_CMSG_SIZE)
+    char                        cmsg_buf[BRIDGE_BATCH_SIZE][BRIDGE_RECV_CMSG_SIZE];
+#endif
+
+    // Structures for send
+    struct iovec                send_iovec[BRIDGE_BATCH_SIZE];
+#if defined(USE_MMSG)
+    struct mmsghdr              send_msgs[BRIDGE_BATCH_SIZE];
+#endif
+
+#if defined(USE_UDP_OFFLOAD)
+    // Segment size of each coalesced packet in the current batch. Zero if
+    // the packet is a single datagram.
+    unsigned int                segment_size[BRIDGE_BATCH_SIZE];
+
+    // UDP_SEGMENT control message for each coalesced packet
+    char                        segment_cmsg_buf[BRIDGE_BATCH_SIZE][CMSG_SPACE(sizeof(uint16_t))];
 #endif
+
+    // Packet buffers, and the size of each buffer. The buffers are carved from
+    // the packet buffer arena shared by all workers, or from an arena allocated
+    // by the worker itself (NULL if none).
+    unsigned char *             packet_buffer[BRIDGE_BATCH_SIZE];
+    size_t                      packet_buffer_size;
+    unsigned char *             packet_arena;
+    size_t                      packet_arena_size;
 } bridge_local_storage_t;
 
+// Access the msghdr for a receive batch entry
+#if defined(USE_MMSG)
+# define RECV_MSG(ls, i)        (&(ls)->recv_msgs[(i)].msg_hdr)
+#else
+# define RECV_MSG(ls, i)        (&(ls)->recv_msgs[(i)])
+#endif
+
+
+// Queued packet for a rate limited interface
+typedef struct bridge_shaper_entry
+{
+    // Location of the packet in the queue buffer
+    unsigned int                offset;
+    unsigned int                length;
+
+    // Group the packet was sent to, and the interface it was received on (NULL
+    // if the interface has been removed)
+    unsigned int                group_index;
+    bridge_interface_t *        inbound;
+
+    // Source address of the packet
+    socket_address_t            src_addr;
+
+#if defined(USE_UDP_OFFLOAD)
+    // Segment size if the packet is coalesced
+    unsigned int                segment_size;
+#endif
+
+#if defined(USE_RX_TIMESTAMP)
+    // Kernel receive timestamp
+    uint64_t                    rx_timestamp;
+#endif
+} bridge_shaper_entry_t;
+
+// Token bucket and queue for a rate limited interface
+//
+// Tokens are measured in byte nanoseconds (bytes * 10^9), and a packet may be
+// sent while the token count is positive. The token count may go negative,
+// allowing a packet larger than the bucket depth to be sent. Packets that
+// cannot be sent immediately are copied to the queue, and sent from a timer
+// as tokens become available. If the queue is full, the oldest packet is
+// dropped.
+//
+// NB: The shaper is only used by the worker thread that owns the bridge instance.
+typedef struct bridge_shaper
+{
+    // Rate in bytes per second, and bucket depth in byte nanoseconds
+    uint64_t                    rate;
+    int64_t                     depth;
+
+    // Current tokens, and the time they were last updated
+    int64_t                     tokens;
+    uint64_t                    update_time;
+
+    // Timer for sending queued packets
+    evm_timer_t                 timer;
+
+    // Queued packets
+    unsigned int                head;
+    unsigned int                count;
+    bridge_shaper_entry_t       entry[SHAPER_QUEUE_COUNT];
+    unsigned char               buffer[SHAPER_QUEUE_BYTES];
+} bridge_shaper_t;
+
 
 // Thread local storage key
 static pthread_key_t            thread_local_storage_key;
 
+// Bridge workers
+// NB: The list is only used by the main thread
+static bridge_local_storage_t ** worker_list = NULL;
+static unsigned int             worker_count = 0;
+
 
+
+#if defined(USE_UDP_OFFLOAD)
 //
-// Process an incoming packet
+// Set the segment size of a batch entry and prepare the corresponding
+// UDP_SEGMENT control message for forwarding
 //
-static void bridge_receive(
-    void *                      arg)
+static void bridge_set_segment_size(
+    bridge_local_storage_t *    local_storage,
+    unsigned int                index,
+    unsigned int                segment_size)
 {
-    bridge_interface_t *        bridge_interface = arg;
-    bridge_instance_t *         bridge;
-    bridge_local_storage_t *    local_storage;
-    ssize_t                     bytes;
-    socket_address_t *          dst_addr;
-    socklen_t                   dst_addr_len;
-    bridge_interface_t *        peer;
-    unsigned int                peer_index;
-    char                        src_addr_str[INET6_ADDRSTRLEN] = {0};
+    struct msghdr               segment_msg;
+    struct cmsghdr *            cmsg;
+    uint16_t                    gso_size;
 
-    // Get the thread local storage
-    local_storage = pthread_getspecific(thread_local_storage_key);
-    if (local_storage == NULL)
+    local_storage->segment_size[index] = segment_size;
+    if (segment_size == 0)
     {
-        fatal("pthread_getspecific failed\n");
+        return;
     }
 
-    // Get the bridge instance
-    bridge = &bridge_list[bridge_interface->bridge_index];
-    dst_addr = &bridge->dst_addr;
-    dst_addr_len = bridge->dst_addr_len;
+    // Build the UDP_SEGMENT control message
+    memset(&segment_msg, 0, sizeof(segment_msg));
+    segment_msg.msg_control = local_storage->segment_cmsg_buf[index];
+    segment_msg.msg_controllen = sizeof(local_storage->segment_cmsg_buf[index]);
+    cmsg = CMSG_FIRSTHDR(&segment_msg);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(gso_size));
+    gso_size = (uint16_t) segment_size;
+    memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+}
 
-    // Receive the packet
-    local_storage->recv_msg.msg_namelen = sizeof(local_storage->src_addr);
-    bytes = recvmsg(bridge_interface->sock, &local_storage->recv_msg, 0);
-    if (bytes == -1)
-    {
-        if (errno != EAGAIN && errno != EWOULDBLOCK)
-        {
-            logger("Bridge(%s/%u): recvmsg error on interface %s: %s\n",
-                AF_FAMILY_TO_STRING(bridge->family), bridge->port,
-                bridge_interface->name, strerror(errno));
-        }
-        return;
-    }
-    local_storage->src_addr_len = local_storage->recv_msg.msg_namelen;
 
-#if defined(USE_RECVIF_PKTINFO)
-    {
-        struct cmsghdr *        cmsg;
-        bridge_interface_t *    new_interface = NULL;
-        unsigned int            recv_if_index = 0;
-        unsigned int            index;
+//
+// Determine the segment size of a received packet
+//
+static void bridge_receive_segment_size(
+    bridge_local_storage_t *    local_storage,
+    unsigned int                index)
+{
+    struct msghdr *             msg = RECV_MSG(local_storage, index);
+    struct cmsghdr *            cmsg;
+    unsigned int                segment_size = 0;
+    int                         gro_size;
 
-        if (bridge->family == AF_INET)
+    // Find the GRO segment size, if any
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO)
         {
-            for (cmsg = CMSG_FIRSTHDR(&local_storage->recv_msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&local_storage->recv_msg, cmsg))
+            memcpy(&gro_size, CMSG_DATA(cmsg), sizeof(gro_size));
+            if (gro_size > 0 && (size_t) gro_size < local_storage->send_iovec[index].iov_len)
             {
-                if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVIF)
-                {
-                    struct sockaddr_dl * sa_dl = (struct sockaddr_dl *) CMSG_DATA(cmsg);
-                    recv_if_index = sa_dl->sdl_index;
-                    break;
-                }
+                segment_size = (unsigned int) gro_size;
             }
+            break;
         }
-        else
+    }
+
+    bridge_set_segment_size(local_storage, index, segment_size);
+}
+
+
+//
+// Send a coalesced packet to a peer interface as individual datagrams
+//
+// Returns 0 on success, -1 on failure with errno set
+//
+static int bridge_send_segments(
+    bridge_local_storage_t *    local_storage,
+    bridge_interface_t *        peer,
+    const socket_address_t *    dst_addr,
+    unsigned int                packet_index)
+{
+    bridge_instance_t *         bridge = peer->bridge;
+    const unsigned char *       segment = local_storage->send_iovec[packet_index].iov_base;
+    size_t                      remaining = local_storage->send_iovec[packet_index].iov_len;
+    size_t                      segment_size = local_storage->segment_size[packet_index];
+    size_t                      len;
+
+    while (remaining)
+    {
+        len = remaining < segment_size ? remaining : segment_size;
+        if (sendto(peer->sock, segment, len, 0, &dst_addr->sa, bridge->dst_addr_len) == -1)
         {
-            for (cmsg = CMSG_FIRSTHDR(&local_storage->recv_msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&local_storage->recv_msg, cmsg))
-            {
-                if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO)
-                {
-                    struct in6_pktinfo * pkt_info = (struct in6_pktinfo *) CMSG_DATA(cmsg);
-                    recv_if_index = pkt_info->ipi6_ifindex;
-                    break;
-                }
-            }
+            return -1;
         }
+        segment += len;
+        remaining -= len;
+    }
 
-        // If the recieve interface doesn't match, look for the correct interface
-        if (recv_if_index != bridge_interface->if_index)
-        {
-            for (index = 0; index < bridge->interface_count; index++)
-            {
-                if (bridge->interface_list[index].if_index == recv_if_index)
-                {
-                    new_interface = &bridge->interface_list[index];
-                    break;
-                }
-            }
+    return 0;
+}
+#endif
 
-            // If no interface is found, skip this message
-            if (new_interface == NULL)
-            {
-                return;
-            }
 
-            // Assign the correct interface to the packet
-            bridge_interface = new_interface;
+//
+// Get the IP address of a source socket address
+//
+static const void * bridge_source_addr(
+    const bridge_instance_t *   bridge,
+    const socket_address_t *    src_addr)
+{
+    if (bridge->family == AF_INET)
+    {
+        return &src_addr->sin.sin_addr;
+    }
+    return &src_addr->sin6.sin6_addr;
+}
+
+
+//
+// Determine the number of datagrams in a batch entry
+//
+static unsigned int bridge_datagram_count(
+    bridge_local_storage_t *    local_storage,
+    unsigned int                index)
+{
+#if defined(USE_UDP_OFFLOAD)
+    unsigned int                segment_size = local_storage->segment_size[index];
+
+    if (segment_size)
+    {
+        return (unsigned int) ((local_storage->send_iovec[index].iov_len + segment_size - 1) / segment_size);
+    }
+#else
+    (void) local_storage;
+    (void) index;
+#endif
+
+    return 1;
+}
+
+
+#if defined(USE_RXQ_OVFL)
+//
+// Update the kernel drop count of an interface from a received packet
+//
+// NB: The drop count reported by the kernel is the running total for the socket
+//
+static void bridge_receive_drop_count(
+    bridge_local_storage_t *    local_storage,
+    bridge_interface_t *        bridge_interface,
+    unsigned int                index)
+{
+    struct msghdr *             msg = RECV_MSG(local_storage, index);
+    struct cmsghdr *            cmsg;
+    uint32_t                    drops;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+        {
+            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            COUNTER_SET(bridge_interface->counters->rx_overflow, drops);
+            break;
         }
     }
+}
 #endif
 
-    // If the interface is not active, drop the packet
-    if (bridge_interface->inbound_active == 0)
+
+#if defined(USE_RX_TIMESTAMP)
+//
+// Determine the kernel receive timestamp of a received packet
+//
+static void bridge_receive_timestamp(
+    bridge_local_storage_t *    local_storage,
+    unsigned int                index)
+{
+    struct msghdr *             msg = RECV_MSG(local_storage, index);
+    struct cmsghdr *            cmsg;
+    struct timespec             ts;
+
+    local_storage->rx_timestamp[index] = 0;
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
     {
-        return;
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            local_storage->rx_timestamp[index] = (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+            break;
+        }
     }
+}
+#endif
 
-    // Save the source address for logging
-    if (debug_level >= 4)
+
+#if defined(USE_MROUTE) && !defined(SO_ATTACH_FILTER)
+//
+// Determine if a packet received by a kernel dataplane bridge was forwarded by the kernel
+//
+// NB: The kernel cannot forward packets received with a TTL/hop limit of 1. Copies
+//     of forwarded packets looped back to an outbound interface carry the
+//     decremented TTL/hop limit, and are only distinguished by it.
+//
+static int bridge_receive_kernel_forwarded(
+    bridge_local_storage_t *    local_storage,
+    unsigned int                index)
+{
+    struct msghdr *             msg = RECV_MSG(local_storage, index);
+    struct cmsghdr *            cmsg;
+    unsigned char               ttl;
+    int                         hop_limit;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
     {
-        if (bridge->family == AF_INET)
+        if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVTTL)
         {
-            inet_ntop(AF_INET, &local_storage->src_addr.sin.sin_addr, src_addr_str, sizeof(src_addr_str));
+            memcpy(&ttl, CMSG_DATA(cmsg), sizeof(ttl));
+            return ttl > 1;
         }
-        else
+        if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_HOPLIMIT)
         {
-            inet_ntop(AF_INET6, &local_storage->src_addr.sin6.sin6_addr, src_addr_str, sizeof(src_addr_str));
+            memcpy(&hop_limit, CMSG_DATA(cmsg), sizeof(hop_limit));
+            return hop_limit > 1;
         }
     }
+    return 0;
+}
+#endif
 
-    // Forward the packet to outbound peer interfaces
-    for (peer_index = 0; peer_index < bridge->interface_count; peer_index++)
+
+//
+// Receive a batch of packets from an interface socket
+//
+// Returns the number of packets received
+//
+static unsigned int bridge_receive_batch(
+    bridge_local_storage_t *    local_storage,
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    struct msghdr *             msg;
+    unsigned int                count;
+    unsigned int                index;
+
+    // Reset the per message lengths
+    for (index = 0; index < BRIDGE_BATCH_SIZE; index++)
+    {
+        msg = RECV_MSG(local_storage, index);
+        msg->msg_namelen = sizeof(local_storage->src_addr[index]);
+#if defined(BRIDGE_RECV_CMSG_SIZE)
+        msg->msg_controllen = sizeof(local_storage->cmsg_buf[index]);
+#endif
+    }
+
+#if defined(USE_MMSG)
     {
-        peer = &bridge->interface_list[peer_index];
+        int                     r;
 
-        // If the peer is me, or the peer is not active, skip it
-        if (peer == bridge_interface || peer->outbound_active == 0)
+        r = recvmmsg(bridge_interface->sock, local_storage->recv_msgs, BRIDGE_BATCH_SIZE, 0, NULL);
+        COUNTER_ADD(bridge_interface->counters->rx_calls, 1);
+        if (r == -1)
         {
-            continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                logger("Bridge(%s/%u): recvmmsg error on interface %s: %s\n",
+                    AF_FAMILY_TO_STRING(bridge->family), bridge->port,
+                    bridge_interface->name, strerror(errno));
+                COUNTER_ADD(bridge_interface->counters->rx_errors, 1);
+            }
+            return 0;
         }
+        count = (unsigned int) r;
 
-        if (bridge->family == AF_INET6)
+        for (index = 0; index < count; index++)
         {
-            // Set the destination scope ID
-            dst_addr->sin6.sin6_scope_id = peer->if_index;
+            local_storage->send_iovec[index].iov_len = local_storage->recv_msgs[index].msg_len;
+#if defined(USE_UDP_OFFLOAD)
+            bridge_receive_segment_size(local_storage, index);
+#endif
+#if defined(USE_RX_TIMESTAMP)
+            bridge_receive_timestamp(local_storage, index);
+#endif
         }
 
-        // Send the packet
-        if (sendto(peer->sock, local_storage->packet_buffer, bytes, 0, &dst_addr->sa, dst_addr_len) == -1)
+#if defined(USE_RXQ_OVFL)
+        // The last packet carries the most recent drop count
+        if (count)
         {
-            if (errno != ENETDOWN)
-            {
-                logger("Bridge(%s/%u): sendto error on interface %s: %s\n",
-                    AF_FAMILY_TO_STRING(bridge->family), bridge->port,
-                    peer->name, strerror(errno));
-            }
-            continue;
+            bridge_receive_drop_count(local_storage, bridge_interface, count - 1);
         }
+#endif
+    }
+#else
+    {
+        ssize_t                 bytes;
 
-        if (debug_level >= 4)
+        for (count = 0; count < BRIDGE_BATCH_SIZE; count++)
         {
-            logger("Bridge(%s/%u): Forwarded %lu bytes from %s on %s to %s\n",
-                AF_FAMILY_TO_STRING(bridge->family), bridge->port, (unsigned long) bytes,
-                src_addr_str, bridge_interface->name, peer->name);
+            bytes = recvmsg(bridge_interface->sock, &local_storage->recv_msgs[count], 0);
+            COUNTER_ADD(bridge_interface->counters->rx_calls, 1);
+            if (bytes == -1)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    logger("Bridge(%s/%u): recvmsg error on interface %s: %s\n",
+                        AF_FAMILY_TO_STRING(bridge->family), bridge->port,
+                        bridge_interface->name, strerror(errno));
+                    COUNTER_ADD(bridge_interface->counters->rx_errors, 1);
+                }
+                break;
+            }
+            local_storage->send_iovec[count].iov_len = bytes;
         }
     }
+#endif
+
+    return count;
 }
 
 
+#if defined(USE_RECVIF_PKTINFO)
 //
-// Bridge thread
+// Determine the receiving interface of a packet
 //
-__attribute__ ((noreturn))
-static void * bridge_thread(
-    void *                      arg)
+// Returns NULL if the interface is not part of the bridge
+//
+static bridge_interface_t * bridge_receive_interface(
+    struct msghdr *             msg,
+    bridge_interface_t *        bridge_interface)
 {
-    bridge_local_storage_t *    local_storage = (bridge_local_storage_t *) arg;
-    int                         r;
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    struct cmsghdr *            cmsg;
+    unsigned int                recv_if_index = 0;
 
-    // Set the thread local storage
-    r = pthread_setspecific(thread_local_storage_key, local_storage);
-    if (r)
+    if (bridge->family == AF_INET)
     {
-        fatal("pthread_setspecific: %s\n", strerror(r));
+        for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+        {
+            if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVIF)
+            {
+                struct sockaddr_dl * sa_dl = (struct sockaddr_dl *) CMSG_DATA(cmsg);
+                recv_if_index = sa_dl->sdl_index;
+                break;
+            }
+        }
+    }
+    else
+    {
+        for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+        {
+            if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO)
+            {
+                struct in6_pktinfo * pkt_info = (struct in6_pktinfo *) CMSG_DATA(cmsg);
+                recv_if_index = pkt_info->ipi6_ifindex;
+                break;
+            }
+        }
     }
 
-    // Run the event loop
-    evm_loop(local_storage->evm);
+    // Look up the interface
+    if (recv_if_index < bridge->if_index_table_size)
+    {
+        return bridge->if_index_table[recv_if_index];
+    }
+
+    return NULL;
 }
 
 
 //
-// Start the bridge threads
+// Create the interface index lookup table for a bridge instance
 //
-void start_bridges(void)
+static void bridge_create_if_index_table(
+    bridge_instance_t *         bridge)
 {
-    bridge_instance_t *         bridge;
     bridge_interface_t *        bridge_interface;
-    unsigned int                bridge_index;
     unsigned int                interface_index;
-    bridge_local_storage_t *    local_storage;
-    pthread_t                   thread_id;
-    int                         r;
+    unsigned int                table_size = 0;
 
-    // Create the thread local storage key
-    r = pthread_key_create(&thread_local_storage_key, NULL);
-    if (r)
+    // Determine the table size
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
     {
-        fatal("pthread_key_create: %s\n", strerror(r));
+        if (bridge->interface_list[interface_index]->if_index >= table_size)
+        {
+            table_size = bridge->interface_list[interface_index]->if_index + 1;
+        }
     }
 
-    // Start the bridge threads. Each bridge instance (IP family & port number) has its own thread.
-    // NB: All but the last thread ID created is discarded/lost.
-    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    // Allocate and populate the table
+    bridge->if_index_table = calloc(table_size, sizeof(bridge_interface_t *));
+    if (bridge->if_index_table == NULL)
     {
-        bridge = &bridge_list[bridge_index];
+        fatal("Cannot allocate memory for interface index table: %s\n", strerror(errno));
+    }
+    bridge->if_index_table_size = table_size;
 
-        // Allocate the thread local storage
-        local_storage = calloc(1, sizeof(bridge_local_storage_t));
-        if (local_storage == NULL)
-        {
-            fatal("Cannot allocate memory: %s\n", strerror(errno));
-        }
-        local_storage->bridge = bridge;
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        bridge_interface = bridge->interface_list[interface_index];
+        bridge->if_index_table[bridge_interface->if_index] = bridge_interface;
+    }
+}
+#endif
 
-        // Initialize recvmsg structures
-        local_storage->recv_msg.msg_name = &local_storage->src_addr;
-        local_storage->recv_msg.msg_namelen = sizeof(local_storage->src_addr);
-        local_storage->recv_msg.msg_iov = &local_storage->recv_iovec;
-        local_storage->recv_msg.msg_iovlen = 1;
-        local_storage->recv_iovec.iov_base = local_storage->packet_buffer;
-        local_storage->recv_iovec.iov_len = sizeof(local_storage->packet_buffer);
-    #if defined(USE_RECVIF_PKTINFO)
-        local_storage->recv_msg.msg_control = local_storage->cmsg_buf;
-        local_storage->recv_msg.msg_controllen = sizeof(local_storage->cmsg_buf);
-    #endif
 
-        // Create the event manager
-        local_storage->evm = evm_create(bridge->interface_count, 0);
-        if (local_storage->evm == NULL)
-        {
-            fatal("Cannot create event manager\n");
+#if defined(USE_GROUP_LIST)
+//
+// Determine the group a received packet was sent to
+//
+// Returns the index of the group in the bridge group list, or -1 if the packet
+// was not sent to a group of the bridge
+//
+static int bridge_receive_group(
+    struct msghdr *             msg,
+    const bridge_instance_t *   bridge)
+{
+    struct cmsghdr *            cmsg;
+    struct in_pktinfo           pkt_info;
+    struct in6_pktinfo          pkt_info6;
+    unsigned int                group_index;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+        if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO)
+        {
+            memcpy(&pkt_info, CMSG_DATA(cmsg), sizeof(pkt_info));
+            for (group_index = 0; group_index < bridge->group_count; group_index++)
+            {
+                if (bridge->group_list[group_index].sin.sin_addr.s_addr == pkt_info.ipi_addr.s_addr)
+                {
+                    return (int) group_index;
+                }
+            }
+            break;
+        }
+        if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO)
+        {
+            memcpy(&pkt_info6, CMSG_DATA(cmsg), sizeof(pkt_info6));
+            for (group_index = 0; group_index < bridge->group_count; group_index++)
+            {
+                if (IN6_ARE_ADDR_EQUAL(&bridge->group_list[group_index].sin6.sin6_addr, &pkt_info6.ipi6_addr))
+                {
+                    return (int) group_index;
+                }
+            }
+            break;
+        }
+    }
+
+    return -1;
+}
+#endif
+
+
+//
+// Get the name of the inbound interface of a packet being sent
+//
+// Returns NULL if the packet was queued for a rate limited interface and the
+// inbound interface has since been removed
+//
+static const char * bridge_inbound_name(
+    const bridge_local_storage_t * local_storage,
+    unsigned int                packet_index)
+{
+    const bridge_interface_t *  inbound = local_storage->batch_interface[packet_index];
+
+    return inbound ? inbound->name : NULL;
+}
+
+
+//
+// Record and report a send error
+//
+static void bridge_send_error(
+    bridge_interface_t *        peer,
+    const char *                operation,
+    int                         error)
+{
+    bridge_instance_t *         bridge = peer->bridge;
+
+    if (error == ENOBUFS || error == EAGAIN)
+    {
+        COUNTER_ADD(peer->counters->tx_nobufs, 1);
+    }
+    else
+    {
+        COUNTER_ADD(peer->counters->tx_errors, 1);
+    }
+
+    if (error != ENETDOWN)
+    {
+        logger("Bridge(%s/%u): %s error on interface %s: %s\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port,
+            operation, peer->name, strerror(error));
+    }
+}
+
+
+//
+// Send a batch of packets for a group to a peer interface
+//
+static void bridge_send_batch(
+    bridge_local_storage_t *    local_storage,
+    bridge_interface_t *        peer,
+    unsigned int                group_index,
+    unsigned int *              packet_index_list,
+    unsigned int                packet_count)
+{
+    bridge_instance_t *         bridge = peer->bridge;
+    socket_address_t            send_addr;
+    socket_address_t *          dst_addr = &send_addr;
+    socklen_t                   dst_addr_len = bridge->dst_addr_len;
+    unsigned int                packet_index;
+    unsigned int                index;
+    uint64_t                    datagrams;
+    uint64_t                    bytes;
+#if defined(USE_RX_TIMESTAMP)
+    uint64_t                    now;
+#endif
+
+    // Copy the destination, setting the scope ID for the peer
+    // NB: The group list of the bridge instance is not modified, as it is also
+    //     read by the control plane
+    memcpy(&send_addr, &bridge->group_list[group_index], dst_addr_len);
+    if (bridge->family == AF_INET6)
+    {
+        send_addr.sin6.sin6_scope_id = peer->if_index;
+    }
+
+#if defined(USE_MMSG)
+    {
+        struct msghdr *         msg;
+        unsigned int            sent;
+        int                     r;
+
+        // Build the send list
+        for (index = 0; index < packet_count; index++)
+        {
+            packet_index = packet_index_list[index];
+            msg = &local_storage->send_msgs[index].msg_hdr;
+            msg->msg_name = dst_addr;
+            msg->msg_namelen = dst_addr_len;
+            msg->msg_iov = &local_storage->send_iovec[packet_index];
+            msg->msg_iovlen = 1;
+            msg->msg_control = NULL;
+            msg->msg_controllen = 0;
+            msg->msg_flags = 0;
+#if defined(USE_UDP_OFFLOAD)
+            // Coalesced packets are sent with the received segment size
+            if (local_storage->segment_size[packet_index])
+            {
+                msg->msg_control = local_storage->segment_cmsg_buf[packet_index];
+                msg->msg_controllen = sizeof(local_storage->segment_cmsg_buf[packet_index]);
+            }
+#endif
+        }
+
+        // Send the packets
+        // NB: If a send fails, the failed packet is dropped and sending resumes with the next packet
+        sent = 0;
+        while (sent < packet_count)
+        {
+            r = sendmmsg(peer->sock, &local_storage->send_msgs[sent], packet_count - sent, 0);
+            COUNTER_ADD(peer->counters->tx_calls, 1);
+            if (r == -1)
+            {
+#if defined(USE_UDP_OFFLOAD)
+                // If segmentation offload was refused (e.g. the segment size exceeds the
+                // peer MTU or the device lacks checksum offload), fall back to sending
+                // the segments individually
+                if (local_storage->segment_size[packet_index_list[sent]] &&
+                    (errno == EINVAL || errno == EIO || errno == EMSGSIZE) &&
+                    bridge_send_segments(local_storage, peer, dst_addr, packet_index_list[sent]) == 0)
+                {
+                    sent += 1;
+                    continue;
+                }
+#endif
+                bridge_send_error(peer, "sendmmsg", errno);
+                packet_index_list[sent] = BRIDGE_BATCH_SIZE;
+                sent += 1;
+                continue;
+            }
+            sent += r;
+        }
+    }
+#else
+    {
+        struct iovec *          iovec;
+
+        for (index = 0; index < packet_count; index++)
+        {
+            iovec = &local_storage->send_iovec[packet_index_list[index]];
+            COUNTER_ADD(peer->counters->tx_calls, 1);
+            if (sendto(peer->sock, iovec->iov_base, iovec->iov_len, 0, &dst_addr->sa, dst_addr_len) == -1)
+            {
+                bridge_send_error(peer, "sendto", errno);
+                packet_index_list[index] = BRIDGE_BATCH_SIZE;
+            }
+        }
+    }
+#endif
+
+    // Count the packets sent and record their forwarding latency
+#if defined(USE_RX_TIMESTAMP)
+    now = latency_now();
+#endif
+    datagrams = 0;
+    bytes = 0;
+    for (index = 0; index < packet_count; index++)
+    {
+        packet_index = packet_index_list[index];
+        if (packet_index < BRIDGE_BATCH_SIZE)
+        {
+            datagrams += bridge_datagram_count(local_storage, packet_index);
+            bytes += local_storage->send_iovec[packet_index].iov_len;
+#if defined(USE_RX_TIMESTAMP)
+            latency_record(bridge->latency, local_storage->rx_timestamp[packet_index], now);
+#endif
+        }
+    }
+    COUNTER_ADD(peer->counters->tx_packets, datagrams);
+    COUNTER_ADD(peer->counters->tx_bytes, bytes);
+
+    if (debug_level >= 4)
+    {
+        for (index = 0; index < packet_count; index++)
+        {
+            // Skip packets that were not sent
+            packet_index = packet_index_list[index];
+            if (packet_index >= BRIDGE_BATCH_SIZE)
+            {
+                continue;
+            }
+
+#if defined(USE_UDP_OFFLOAD)
+            if (local_storage->segment_size[packet_index])
+            {
+                log_packet(LOG_EVENT_FORWARDED_SEGMENTS, bridge, bridge_inbound_name(local_storage, packet_index),
+                    peer->name, bridge_source_addr(bridge, &local_storage->src_addr[packet_index]),
+                    (unsigned int) local_storage->send_iovec[packet_index].iov_len,
+                    local_storage->segment_size[packet_index]);
+                continue;
+            }
+#endif
+            log_packet(LOG_EVENT_FORWARDED, bridge, bridge_inbound_name(local_storage, packet_index),
+                peer->name, bridge_source_addr(bridge, &local_storage->src_addr[packet_index]),
+                (unsigned int) local_storage->send_iovec[packet_index].iov_len, 0);
+        }
+    }
+}
+
+
+//
+// Get the current monotonic time in nanoseconds
+//
+static uint64_t bridge_now(void)
+{
+    struct timespec             ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+//
+// Add the tokens accumulated since the last update to a token bucket
+//
+static void bridge_shaper_refill(
+    bridge_shaper_t *           shaper)
+{
+    uint64_t                    now;
+    uint64_t                    interval;
+
+    now = bridge_now();
+    interval = now - shaper->update_time;
+    if (interval > SHAPER_MAX_INTERVAL)
+    {
+        interval = SHAPER_MAX_INTERVAL;
+    }
+    shaper->update_time = now;
+
+    shaper->tokens += (int64_t) (interval * shaper->rate);
+    if (shaper->tokens > shaper->depth)
+    {
+        shaper->tokens = shaper->depth;
+    }
+}
+
+
+//
+// Drop the oldest packet in a rate limit queue
+//
+static void bridge_shaper_drop(
+    bridge_interface_t *        peer)
+{
+    bridge_shaper_t *           shaper = peer->shaper;
+    uint64_t                    datagrams = 1;
+
+#if defined(USE_UDP_OFFLOAD)
+    bridge_shaper_entry_t *     entry = &shaper->entry[shaper->head];
+
+    if (entry->segment_size)
+    {
+        datagrams = (entry->length + entry->segment_size - 1) / entry->segment_size;
+    }
+#endif
+    COUNTER_ADD(peer->counters->tx_dropped, datagrams);
+
+    shaper->head = (shaper->head + 1) % SHAPER_QUEUE_COUNT;
+    shaper->count -= 1;
+}
+
+
+//
+// Find space for a packet in the buffer of a rate limit queue
+//
+// Returns the offset in the buffer, or -1 if there is insufficient space
+//
+// NB: Packets are stored contiguously in the order they are queued, wrapping
+//     to the start of the buffer when the end is reached.
+//
+static int bridge_shaper_space(
+    const bridge_shaper_t *     shaper,
+    unsigned int                length)
+{
+    const bridge_shaper_entry_t * first;
+    const bridge_shaper_entry_t * last;
+    unsigned int                end;
+
+    if (shaper->count == 0)
+    {
+        return 0;
+    }
+
+    first = &shaper->entry[shaper->head];
+    last = &shaper->entry[(shaper->head + shaper->count - 1) % SHAPER_QUEUE_COUNT];
+    end = last->offset + last->length;
+
+    if (last->offset >= first->offset)
+    {
+        // The queued packets do not wrap. Use the space after the last packet, or
+        // before the first.
+        if (end + length <= SHAPER_QUEUE_BYTES)
+        {
+            return (int) end;
+        }
+        if (length < first->offset)
+        {
+            return 0;
+        }
+    }
+    else
+    {
+        // The queued packets wrap. Use the space between the last and first packets.
+        if (end + length < first->offset)
+        {
+            return (int) end;
+        }
+    }
+
+    return -1;
+}
+
+
+//
+// Add a packet in the current batch to the rate limit queue of a peer
+// interface, dropping the oldest packets as required
+//
+static void bridge_shaper_enqueue(
+    bridge_local_storage_t *    local_storage,
+    bridge_interface_t *        peer,
+    unsigned int                group_index,
+    unsigned int                packet_index)
+{
+    bridge_shaper_t *           shaper = peer->shaper;
+    bridge_shaper_entry_t *     entry;
+    unsigned int                length = (unsigned int) local_storage->send_iovec[packet_index].iov_len;
+    int                         offset;
+
+    // Make room for the packet
+    if (shaper->count == SHAPER_QUEUE_COUNT)
+    {
+        bridge_shaper_drop(peer);
+    }
+    while ((offset = bridge_shaper_space(shaper, length)) < 0)
+    {
+        bridge_shaper_drop(peer);
+    }
+
+    // Add the packet
+    entry = &shaper->entry[(shaper->head + shaper->count) % SHAPER_QUEUE_COUNT];
+    shaper->count += 1;
+
+    entry->offset = (unsigned int) offset;
+    entry->length = length;
+    entry->group_index = group_index;
+    entry->inbound = local_storage->batch_interface[packet_index];
+    memcpy(&entry->src_addr, &local_storage->src_addr[packet_index], sizeof(entry->src_addr));
+#if defined(USE_UDP_OFFLOAD)
+    entry->segment_size = local_storage->segment_size[packet_index];
+#endif
+#if defined(USE_RX_TIMESTAMP)
+    entry->rx_timestamp = local_storage->rx_timestamp[packet_index];
+#endif
+    memcpy(&shaper->buffer[entry->offset], local_storage->send_iovec[packet_index].iov_base, length);
+}
+
+
+// Send queued packets to a rate limited peer interface
+static void bridge_shaper_timer(
+    void *                      arg);
+
+
+//
+// Schedule sending of the queued packets of a rate limited peer interface
+//
+static void bridge_shaper_schedule(
+    bridge_local_storage_t *    local_storage,
+    bridge_interface_t *        peer)
+{
+    bridge_shaper_t *           shaper = peer->shaper;
+    uint64_t                    millis = 1;
+
+    if (shaper->count == 0 || shaper->timer.heap_index)
+    {
+        return;
+    }
+
+    // Wait until the token count is positive
+    if (shaper->tokens <= 0)
+    {
+        millis = (uint64_t) -shaper->tokens / shaper->rate / 1000000 + 1;
+    }
+
+    evm_add_timer(local_storage->evm, &shaper->timer, (unsigned int) millis, bridge_shaper_timer, peer);
+}
+
+
+//
+// Send queued packets to a rate limited peer interface as tokens are available
+//
+static void bridge_shaper_timer(
+    void *                      arg)
+{
+    bridge_interface_t *        peer = arg;
+    bridge_shaper_t *           shaper = peer->shaper;
+    bridge_local_storage_t *    local_storage;
+    bridge_shaper_entry_t *     entry;
+    unsigned int                send_list[BRIDGE_BATCH_SIZE];
+    unsigned int                send_count;
+    unsigned int                group_index;
+    unsigned int                index;
+
+    // Get the thread local storage
+    local_storage = pthread_getspecific(thread_local_storage_key);
+    if (local_storage == NULL)
+    {
+        fatal("pthread_getspecific failed\n");
+    }
+
+    // Discard the queue if the interface is no longer active
+    if (__atomic_load_n(&peer->outbound_active, __ATOMIC_RELAXED) == 0)
+    {
+        while (shaper->count)
+        {
+            bridge_shaper_drop(peer);
+        }
+        return;
+    }
+
+    bridge_shaper_refill(shaper);
+
+    // Send runs of queued packets for the same group
+    // NB: The batch structures of the thread local storage are not in use outside
+    //     of bridge_receive, and the queued packets are sent directly from the
+    //     queue buffer.
+    while (shaper->count && shaper->tokens > 0)
+    {
+        group_index = shaper->entry[shaper->head].group_index;
+        send_count = 0;
+        while (shaper->count && shaper->tokens > 0 && send_count < BRIDGE_BATCH_SIZE)
+        {
+            entry = &shaper->entry[shaper->head];
+            if (entry->group_index != group_index)
+            {
+                break;
+            }
+
+            local_storage->send_iovec[send_count].iov_base = &shaper->buffer[entry->offset];
+            local_storage->send_iovec[send_count].iov_len = entry->length;
+            local_storage->batch_interface[send_count] = entry->inbound;
+            memcpy(&local_storage->src_addr[send_count], &entry->src_addr, sizeof(entry->src_addr));
+#if defined(USE_UDP_OFFLOAD)
+            bridge_set_segment_size(local_storage, send_count, entry->segment_size);
+#endif
+#if defined(USE_RX_TIMESTAMP)
+            local_storage->rx_timestamp[send_count] = entry->rx_timestamp;
+#endif
+            send_list[send_count] = send_count;
+            send_count += 1;
+
+            shaper->tokens -= (int64_t) entry->length * 1000000000;
+            shaper->head = (shaper->head + 1) % SHAPER_QUEUE_COUNT;
+            shaper->count -= 1;
+        }
+
+        bridge_send_batch(local_storage, peer, group_index, send_list, send_count);
+
+        // Restore the receive buffers
+        for (index = 0; index < send_count; index++)
+        {
+            local_storage->send_iovec[index].iov_base = local_storage->packet_buffer[index];
+        }
+    }
+
+    bridge_shaper_schedule(local_storage, peer);
+}
+
+
+//
+// Send a batch of packets for a group to a rate limited peer interface
+//
+// Packets are sent immediately while tokens are available and no packets are
+// queued. The remaining packets are queued.
+//
+static void bridge_shape_batch(
+    bridge_local_storage_t *    local_storage,
+    bridge_interface_t *        peer,
+    unsigned int                group_index,
+    unsigned int *              packet_index_list,
+    unsigned int                packet_count)
+{
+    bridge_shaper_t *           shaper = peer->shaper;
+    unsigned int                send_count = 0;
+    unsigned int                index;
+
+    bridge_shaper_refill(shaper);
+
+    // Send what the tokens allow
+    if (shaper->count == 0)
+    {
+        while (send_count < packet_count && shaper->tokens > 0)
+        {
+            shaper->tokens -= (int64_t) local_storage->send_iovec[packet_index_list[send_count]].iov_len * 1000000000;
+            send_count += 1;
+        }
+        if (send_count)
+        {
+            bridge_send_batch(local_storage, peer, group_index, packet_index_list, send_count);
+        }
+    }
+
+    // Queue the rest
+    for (index = send_count; index < packet_count; index++)
+    {
+        bridge_shaper_enqueue(local_storage, peer, group_index, packet_index_list[index]);
+    }
+
+    bridge_shaper_schedule(local_storage, peer);
+}
+
+
+//
+// Mix data into a duplicate suppression fingerprint
+//
+static uint64_t bridge_dedup_mix(
+    uint64_t                    hash,
+    const unsigned char *       data,
+    size_t                      len)
+{
+    uint64_t                    word;
+
+    while (len >= sizeof(word))
+    {
+        memcpy(&word, data, sizeof(word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 29;
+        data += sizeof(word);
+        len -= sizeof(word);
+    }
+    if (len)
+    {
+        word = 0;
+        memcpy(&word, data, len);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+    }
+
+    return hash;
+}
+
+
+//
+// Calculate the duplicate suppression fingerprint of a packet
+//
+// NB: This is a fast non-cryptographic hash, processing the source address (if
+//     any) and payload 8 bytes at a time, with the murmur3 finalizer
+//
+static uint64_t bridge_dedup_fingerprint(
+    const unsigned char *       data,
+    size_t                      len,
+    unsigned int                group_index,
+    const void *                source,
+    size_t                      source_len)
+{
+    uint64_t                    hash;
+
+    hash = ((uint64_t) group_index << 32 | len) * 0x9e3779b97f4a7c15ULL;
+    hash = bridge_dedup_mix(hash, source, source_len);
+    hash = bridge_dedup_mix(hash, data, len);
+
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
+//
+// Check for a duplicate of a recently received packet
+//
+// Returns non-zero if the packet is a duplicate. Otherwise the packet is added
+// to the table.
+//
+static int bridge_dedup_check(
+    bridge_dedup_t *            dedup,
+    const struct iovec *        iovec,
+    unsigned int                group_index,
+    const void *                source,
+    uint64_t                    now)
+{
+    bridge_dedup_entry_t *      entry;
+    bridge_dedup_entry_t *      oldest;
+    uint64_t                    fingerprint;
+    unsigned int                way;
+
+    fingerprint = bridge_dedup_fingerprint(iovec->iov_base, iovec->iov_len, group_index, source, dedup->source_len);
+    entry = dedup->bucket[fingerprint & (DEDUP_BUCKET_COUNT - 1)].entry;
+
+    oldest = &entry[0];
+    for (way = 0; way < DEDUP_BUCKET_WAYS; way++)
+    {
+        if (entry[way].fingerprint == fingerprint && entry[way].time && now - entry[way].time <= dedup->window)
+        {
+            return 1;
+        }
+        if (entry[way].time < oldest->time)
+        {
+            oldest = &entry[way];
+        }
+    }
+
+    oldest->fingerprint = fingerprint;
+    oldest->time = now;
+    return 0;
+}
+
+
+//
+// Create the duplicate suppression table for a bridge instance
+//
+static void bridge_create_dedup(
+    bridge_instance_t *         bridge)
+{
+    bridge_dedup_t *            dedup;
+    int                         r;
+
+    r = posix_memalign((void **) &dedup, CACHE_LINE_SIZE, sizeof(bridge_dedup_t));
+    if (r != 0)
+    {
+        fatal("Cannot allocate memory for duplicate suppression table: %s\n", strerror(r));
+    }
+    memset(dedup, 0, sizeof(bridge_dedup_t));
+    dedup->window = (uint64_t) bridge->duplicate_window * 1000000;
+    if (bridge->duplicate_match_source)
+    {
+        dedup->source_len = (bridge->family == AF_INET) ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+    }
+
+    bridge->dedup = dedup;
+}
+
+
+//
+// Apply a changed duplicate window to the duplicate suppression table of a
+// bridge instance
+//
+// NB: This must only be called by the worker that owns the bridge instance
+//
+void bridge_update_dedup(
+    bridge_instance_t *         bridge)
+{
+    unsigned int                duplicate_window = __atomic_load_n(&bridge->duplicate_window, __ATOMIC_RELAXED);
+
+    if (bridge->dedup == NULL || duplicate_window == 0)
+    {
+        return;
+    }
+
+    bridge->dedup->window = (uint64_t) duplicate_window * 1000000;
+}
+
+
+//
+// Create the token bucket and queue for a rate limited interface
+//
+static void bridge_create_shaper(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_shaper_t *           shaper;
+
+    shaper = calloc(1, sizeof(bridge_shaper_t));
+    if (shaper == NULL)
+    {
+        fatal("Cannot allocate memory for rate limit queue: %s\n", strerror(errno));
+    }
+
+    shaper->rate = bridge_interface->rate_limit;
+    shaper->depth = (int64_t) (shaper->rate * SHAPER_DEPTH_MILLIS * 1000000);
+    shaper->tokens = shaper->depth;
+    shaper->update_time = bridge_now();
+
+    bridge_interface->shaper = shaper;
+}
+
+
+//
+// Apply a changed rate limit to the rate limit queue of an interface
+//
+// Returns 1 if the rate was changed, 0 otherwise.
+//
+// NB: This must only be called by the worker that owns the bridge instance
+//
+unsigned int bridge_update_shaper(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_shaper_t *           shaper = bridge_interface->shaper;
+    uint64_t                    rate_limit = __atomic_load_n(&bridge_interface->rate_limit, __ATOMIC_RELAXED);
+
+    if (shaper == NULL || rate_limit == 0 || rate_limit == shaper->rate)
+    {
+        return 0;
+    }
+
+    shaper->rate = rate_limit;
+    shaper->depth = (int64_t) (shaper->rate * SHAPER_DEPTH_MILLIS * 1000000);
+    if (shaper->tokens > shaper->depth)
+    {
+        shaper->tokens = shaper->depth;
+    }
+
+    return 1;
+}
+
+
+//
+// Delete the token bucket and queue of a rate limited interface
+//
+// NB: This must only be called by the worker that owns the bridge instance
+//
+static void bridge_delete_shaper(
+    bridge_local_storage_t *    local_storage,
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_shaper_t *           shaper = bridge_interface->shaper;
+
+    if (shaper == NULL)
+    {
+        return;
+    }
+
+    evm_del_timer(local_storage->evm, &shaper->timer);
+    free(shaper);
+    bridge_interface->shaper = NULL;
+    local_storage->timer_count -= 1;
+}
+
+
+//
+// Process incoming packets
+//
+// Returns non-zero if more packets may be waiting
+//
+static unsigned int bridge_receive(
+    void *                      arg)
+{
+    bridge_interface_t *        bridge_interface = arg;
+    bridge_instance_t *         bridge;
+    bridge_local_storage_t *    local_storage;
+    bridge_interface_t *        inbound;
+    bridge_interface_t *        peer;
+    const bridge_fanout_t *     fanout;
+    const bridge_source_filter_t * filter;
+    unsigned int                peer_index;
+    unsigned int                packet_count;
+    unsigned int                packet_index;
+    unsigned int                run_start;
+    unsigned int                run_end;
+    unsigned int                send_list[BRIDGE_BATCH_SIZE];
+    unsigned int                send_count;
+    unsigned int                group_index;
+#if defined(USE_GROUP_LIST)
+    int                         group;
+#endif
+    uint64_t                    datagrams;
+    uint64_t                    bytes;
+    uint64_t                    now = 0;
+
+    // Get the thread local storage
+    local_storage = pthread_getspecific(thread_local_storage_key);
+    if (local_storage == NULL)
+    {
+        fatal("pthread_getspecific failed\n");
+    }
+
+    // Get the bridge instance
+    bridge = bridge_interface->bridge;
+
+    // Receive the packets
+    packet_count = bridge_receive_batch(local_storage, bridge_interface);
+    if (packet_count == 0)
+    {
+        return 0;
+    }
+    if (bridge->dedup)
+    {
+        now = bridge_now();
+    }
+
+    // Determine the inbound interface and group for each packet
+    for (packet_index = 0; packet_index < packet_count; packet_index++)
+    {
+#if defined(USE_RECVIF_PKTINFO)
+        local_storage->batch_interface[packet_index] = bridge_receive_interface(RECV_MSG(local_storage, packet_index), bridge_interface);
+#else
+        local_storage->batch_interface[packet_index] = bridge_interface;
+#endif
+        local_storage->batch_group[packet_index] = 0;
+
+        // Drop datagrams that exceed the maximum packet size
+        if (RECV_MSG(local_storage, packet_index)->msg_flags & MSG_TRUNC)
+        {
+            inbound = local_storage->batch_interface[packet_index];
+            if (inbound)
+            {
+                COUNTER_ADD(inbound->counters->rx_errors, 1);
+                if (debug_level >= 4)
+                {
+                    log_packet(LOG_EVENT_DROPPED_TOO_LARGE, bridge, inbound->name, NULL, NULL, 0, bridge->max_packet_size);
+                }
+            }
+            local_storage->batch_interface[packet_index] = NULL;
+            continue;
+        }
+
+#if defined(USE_MROUTE) && !defined(SO_ATTACH_FILTER)
+        // Drop packets forwarded by the kernel
+        if (bridge->dataplane == DATAPLANE_KERNEL && bridge_receive_kernel_forwarded(local_storage, packet_index))
+        {
+            local_storage->batch_interface[packet_index] = NULL;
+            continue;
+        }
+#endif
+
+#if defined(USE_GROUP_LIST)
+        if (bridge->group_count > 1)
+        {
+            group = bridge_receive_group(RECV_MSG(local_storage, packet_index), bridge);
+            if (group < 0)
+            {
+                local_storage->batch_interface[packet_index] = NULL;
+                continue;
+            }
+            local_storage->batch_group[packet_index] = (unsigned int) group;
+        }
+#endif
+
+        // Drop duplicates of recently received packets
+        if (bridge->dedup && local_storage->batch_interface[packet_index] &&
+            bridge_dedup_check(bridge->dedup, &local_storage->send_iovec[packet_index],
+                               local_storage->batch_group[packet_index],
+                               bridge_source_addr(bridge, &local_storage->src_addr[packet_index]), now))
+        {
+            inbound = local_storage->batch_interface[packet_index];
+            COUNTER_ADD(inbound->counters->rx_duplicates, 1);
+            if (debug_level >= 4)
+            {
+                log_packet(LOG_EVENT_DROPPED_DUPLICATE, bridge, inbound->name, NULL, NULL, 0, 0);
+            }
+            local_storage->batch_interface[packet_index] = NULL;
+        }
+    }
+
+    // Forward each run of packets received on the same inbound interface for
+    // the same group to the active outbound peers of that interface
+    for (run_start = 0; run_start < packet_count; run_start = run_end)
+    {
+        inbound = local_storage->batch_interface[run_start];
+        group_index = local_storage->batch_group[run_start];
+        for (run_end = run_start + 1; run_end < packet_count; run_end++)
+        {
+            if (local_storage->batch_interface[run_end] != inbound ||
+                local_storage->batch_group[run_end] != group_index)
+            {
+                break;
+            }
+        }
+
+        // Drop packets received on interfaces that are not part of the bridge
+        if (inbound == NULL)
+        {
+            continue;
+        }
+
+        // Count the packets received
+        datagrams = 0;
+        bytes = 0;
+        for (packet_index = run_start; packet_index < run_end; packet_index++)
+        {
+            datagrams += bridge_datagram_count(local_storage, packet_index);
+            bytes += local_storage->send_iovec[packet_index].iov_len;
+        }
+        COUNTER_ADD(inbound->counters->rx_packets, datagrams);
+        COUNTER_ADD(inbound->counters->rx_bytes, bytes);
+
+        fanout = inbound->fanout;
+        if (fanout->peer_count == 0)
+        {
+            // Count the packets dropped for lack of an active inbound or outbound interface
+            if (__atomic_load_n(&inbound->inbound_active, __ATOMIC_RELAXED) == 0)
+            {
+                COUNTER_ADD(inbound->counters->rx_inactive, datagrams);
+            }
+            else
+            {
+                COUNTER_ADD(inbound->counters->rx_no_outbound, datagrams);
+            }
+            continue;
+        }
+
+        for (peer_index = 0; peer_index < fanout->peer_count; peer_index++)
+        {
+            peer = fanout->peer_list[peer_index];
+
+            // Collect the packets for this peer, dropping packets from sources
+            // the peer's listeners have not asked for
+            filter = peer->source_filter[group_index];
+            send_count = 0;
+            for (packet_index = run_start; packet_index < run_end; packet_index++)
+            {
+                if (filter && interface_source_allowed(filter, bridge_source_addr(bridge, &local_storage->src_addr[packet_index])) == 0)
+                {
+                    COUNTER_ADD(peer->counters->tx_filtered, bridge_datagram_count(local_storage, packet_index));
+                    continue;
+                }
+                send_list[send_count] = packet_index;
+                send_count += 1;
+            }
+            if (send_count == 0)
+            {
+                continue;
+            }
+
+            // Send the packets
+            if (peer->shaper)
+            {
+                bridge_shape_batch(local_storage, peer, group_index, send_list, send_count);
+            }
+            else
+            {
+                bridge_send_batch(local_storage, peer, group_index, send_list, send_count);
+            }
+        }
+    }
+
+    // A full batch indicates there may be more packets waiting
+    return packet_count == BRIDGE_BATCH_SIZE;
+}
+
+
+//
+// Create the command channel of a bridge worker
+//
+static bridge_channel_t * bridge_create_channel(void)
+{
+    bridge_channel_t *          channel;
+    unsigned int                index;
+#if !defined(USE_EVENTFD)
+    int                         fds[2];
+    int                         r;
+#endif
+
+    channel = calloc(1, sizeof(bridge_channel_t));
+    if (channel == NULL)
+    {
+        fatal("Cannot allocate memory for command channel: %s\n", strerror(errno));
+    }
+    for (index = 0; index < BRIDGE_CHANNEL_SIZE; index++)
+    {
+        channel->entry[index].sequence = index;
+    }
+
+#if defined(USE_EVENTFD)
+    channel->read_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (channel->read_fd == -1)
+    {
+        fatal("eventfd failed: %s\n", strerror(errno));
+    }
+    channel->write_fd = channel->read_fd;
+#else
+    r = pipe(fds);
+    if (r == -1)
+    {
+        fatal("pipe failed: %s\n", strerror(errno));
+    }
+    (void) fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    (void) fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    channel->read_fd = fds[0];
+    channel->write_fd = fds[1];
+#endif
+
+    return channel;
+}
+
+
+//
+// Post an updated interface to the worker that owns a bridge instance
+//
+// NB: The caller marks the interface as pending before posting it. If the
+//     channel is full, the overflow flag is set instead.
+//
+void bridge_post_update(
+    bridge_instance_t *         bridge,
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_channel_t *          channel = bridge->channel;
+    bridge_command_t *          entry;
+    unsigned int                position;
+    unsigned int                sequence;
+#if defined(USE_EVENTFD)
+    uint64_t                    value = 1;
+#else
+    uint8_t                     value = 1;
+#endif
+
+    // Claim a position
+    position = __atomic_load_n(&channel->tail, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        entry = &channel->entry[position & (BRIDGE_CHANNEL_SIZE - 1)];
+        sequence = __atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE);
+        if (sequence == position)
+        {
+            if (__atomic_compare_exchange_n(&channel->tail, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                // Fill in the entry and hand it to the worker
+                entry->bridge_interface = bridge_interface;
+                __atomic_store_n(&entry->sequence, position + 1, __ATOMIC_RELEASE);
+                break;
+            }
+        }
+        else if ((int) (sequence - position) < 0)
+        {
+            // The channel is full. The worker will find the interface pending.
+            __atomic_store_n(&channel->overflow, 1, __ATOMIC_SEQ_CST);
+            break;
+        }
+        else
+        {
+            position = __atomic_load_n(&channel->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    // Wake the worker if a wakeup is not already pending
+    if (__atomic_exchange_n(&channel->wakeup_pending, 1, __ATOMIC_SEQ_CST) == 0)
+    {
+        if (write(channel->write_fd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+        {
+            logger("Bridge(%s/%u): Cannot wake worker: %s\n",
+                AF_FAMILY_TO_STRING(bridge->family), bridge->port, strerror(errno));
+        }
+    }
+}
+
+
+//
+// Apply the requested state of a pending interface
+//
+// NB: The pending flag is cleared before the requested state is read, so that
+//     a change made while the state is being applied posts the interface again.
+//
+static void bridge_channel_update(
+    bridge_local_storage_t *    local_storage,
+    bridge_interface_t *        bridge_interface,
+    unsigned int *              update_count)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+
+    if (__atomic_exchange_n(&bridge_interface->update_pending, 0, __ATOMIC_SEQ_CST) == 0)
+    {
+        return;
+    }
+
+    interface_apply_update(bridge_interface);
+    if (bridge->fanout_pending == 0)
+    {
+        bridge->fanout_pending = 1;
+        local_storage->fanout_update_list[*update_count] = bridge;
+        *update_count += 1;
+    }
+}
+
+
+//
+// Apply the updates posted to a bridge worker
+//
+// Updates are applied between batches. The duplicate window and fanout lists of
+// each bridge instance affected are updated once all the pending interfaces
+// have been updated.
+//
+static void bridge_channel_receive(
+    void *                      arg)
+{
+    bridge_local_storage_t *    local_storage = arg;
+    bridge_channel_t *          channel = local_storage->channel;
+    bridge_command_t *          entry;
+    bridge_instance_t *         bridge;
+    unsigned int                update_count = 0;
+    unsigned int                update_index;
+    unsigned int                bridge_index;
+    unsigned int                interface_index;
+    uint64_t                    value;
+
+    // Clear the wakeup before looking for updates, so that an update posted
+    // after the channel is found to be empty signals a new wakeup
+    while (read(channel->read_fd, &value, sizeof(value)) > 0)
+    {
+    }
+    __atomic_store_n(&channel->wakeup_pending, 0, __ATOMIC_SEQ_CST);
+
+    for (;;)
+    {
+        entry = &channel->entry[channel->head & (BRIDGE_CHANNEL_SIZE - 1)];
+        if (__atomic_load_n(&entry->sequence, __ATOMIC_ACQUIRE) != channel->head + 1)
+        {
+            break;
+        }
+
+        bridge_channel_update(local_storage, entry->bridge_interface, &update_count);
+
+        // Return the entry to the producers
+        __atomic_store_n(&entry->sequence, channel->head + BRIDGE_CHANNEL_SIZE, __ATOMIC_RELEASE);
+        channel->head += 1;
+    }
+
+    // If the ring overflowed, look for pending interfaces in all the bridge
+    // instances of the worker
+    if (__atomic_exchange_n(&channel->overflow, 0, __ATOMIC_SEQ_CST))
+    {
+        for (bridge_index = 0; bridge_index < local_storage->bridge_count; bridge_index++)
+        {
+            bridge = local_storage->bridge_list[bridge_index];
+            for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+            {
+                bridge_channel_update(local_storage, bridge->interface_list[interface_index], &update_count);
+            }
+        }
+    }
+
+    // Apply the duplicate windows and rebuild the fanout lists
+    for (update_index = 0; update_index < update_count; update_index++)
+    {
+        bridge = local_storage->fanout_update_list[update_index];
+        bridge->fanout_pending = 0;
+        bridge_update_dedup(bridge);
+        interface_update_fanout(bridge);
+    }
+}
+
+
+//
+// Determine the size of each packet buffer of a worker, rounded to a cache line
+//
+static size_t bridge_packet_buffer_stride(
+    const bridge_local_storage_t * local_storage)
+{
+    return (local_storage->packet_buffer_size + CACHE_LINE_SIZE - 1) & ~((size_t) CACHE_LINE_SIZE - 1);
+}
+
+
+//
+// Map a packet buffer arena
+//
+static unsigned char * bridge_map_packet_arena(
+    size_t                      arena_size)
+{
+    unsigned char *             arena;
+
+    arena = mmap(NULL, arena_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (arena == MAP_FAILED)
+    {
+        fatal("Cannot allocate memory for packet buffers: %s\n", strerror(errno));
+    }
+#if defined(MADV_HUGEPAGE)
+    (void) madvise(arena, arena_size, MADV_HUGEPAGE);
+#endif
+
+    return arena;
+}
+
+
+//
+// Assign the packet buffers of a worker from an arena
+//
+// Returns the arena position following the buffers
+//
+static unsigned char * bridge_assign_packet_buffers(
+    bridge_local_storage_t *    local_storage,
+    unsigned char *             arena)
+{
+    size_t                      stride;
+    unsigned int                index;
+
+    stride = bridge_packet_buffer_stride(local_storage);
+    for (index = 0; index < BRIDGE_BATCH_SIZE; index++)
+    {
+        local_storage->packet_buffer[index] = arena;
+        local_storage->recv_iovec[index].iov_base = arena;
+        local_storage->recv_iovec[index].iov_len = local_storage->packet_buffer_size;
+        local_storage->send_iovec[index].iov_base = arena;
+        arena += stride;
+    }
+
+    return arena;
+}
+
+
+//
+// Allocate the packet buffers of a worker from the calling thread
+//
+// The buffers are touched before use so that their pages are allocated on the
+// NUMA node the calling thread is running on. Buffers previously allocated by
+// the worker are released.
+//
+static void bridge_create_local_packet_buffers(
+    bridge_local_storage_t *    local_storage)
+{
+    unsigned char *             arena;
+    size_t                      arena_size;
+
+    arena_size = bridge_packet_buffer_stride(local_storage) * BRIDGE_BATCH_SIZE;
+    if (arena_size == 0)
+    {
+        return;
+    }
+
+    arena = bridge_map_packet_arena(arena_size);
+    memset(arena, 0, arena_size);
+    (void) bridge_assign_packet_buffers(local_storage, arena);
+
+    if (local_storage->packet_arena)
+    {
+        (void) munmap(local_storage->packet_arena, local_storage->packet_arena_size);
+    }
+    local_storage->packet_arena = arena;
+    local_storage->packet_arena_size = arena_size;
+}
+
+
+#if defined(USE_NUMA_PLACEMENT)
+//
+// Determine the NUMA node of the inbound interfaces of a bridge instance
+//
+// Returns the node of the first inbound interface whose device reports one,
+// or -1 if none do (such as virtual interfaces).
+//
+static int bridge_numa_node(
+    const bridge_instance_t *   bridge)
+{
+    const bridge_interface_t *  bridge_interface;
+    unsigned int                interface_index;
+    char                        path[128];
+    FILE *                      fp;
+    int                         node;
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        bridge_interface = bridge->interface_list[interface_index];
+        if (bridge_interface->inbound_configuration == INTERFACE_CONFIG_NONE)
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/sys/class/net/%s/device/numa_node", bridge_interface->name);
+        fp = fopen(path, "r");
+        if (fp == NULL)
+        {
+            continue;
+        }
+        if (fscanf(fp, "%d", &node) != 1)
+        {
+            node = -1;
+        }
+        fclose(fp);
+
+        if (node >= 0)
+        {
+            return node;
+        }
+    }
+
+    return -1;
+}
+
+
+//
+// Determine the CPUs of a NUMA node
+//
+// Returns the number of CPUs in the set, or 0 if they cannot be determined
+//
+static unsigned int bridge_numa_cpuset(
+    int                         numa_node,
+    bridge_cpuset_t *           cpuset)
+{
+    char                        path[128];
+    char                        buffer[1024];
+    char *                      p;
+    char *                      end;
+    FILE *                      fp;
+    unsigned long               first;
+    unsigned long               last;
+    unsigned int                count = 0;
+
+    CPU_ZERO(cpuset);
+
+    // The list is of the form "0-11,24-35"
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", numa_node);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return 0;
+    }
+    p = fgets(buffer, sizeof(buffer), fp);
+    fclose(fp);
+    if (p == NULL)
+    {
+        return 0;
+    }
+
+    while (*p >= '0' && *p <= '9')
+    {
+        first = strtoul(p, &end, 10);
+        last = first;
+        p = end;
+        if (*p == '-')
+        {
+            last = strtoul(p + 1, &end, 10);
+            p = end;
+        }
+
+        for (; first <= last && first < CPU_SETSIZE; first++)
+        {
+            CPU_SET(first, cpuset);
+            count += 1;
+        }
+
+        if (*p == ',')
+        {
+            p++;
+        }
+    }
+
+    return count;
+}
+#endif
+
+
+//
+// Bridge worker thread
+//
+__attribute__ ((noreturn))
+static void * bridge_thread(
+    void *                      arg)
+{
+    bridge_local_storage_t *    local_storage = (bridge_local_storage_t *) arg;
+    int                         r;
+
+    // Set the CPU affinity
+#if defined(USE_CPU_AFFINITY)
+    if (local_storage->cpu >= 0)
+    {
+        bridge_cpuset_t         cpuset;
+
+        CPU_ZERO(&cpuset);
+        CPU_SET(local_storage->cpu, &cpuset);
+        r = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+        if (r)
+        {
+            fatal("Cannot set affinity of bridge worker %u to CPU %d: %s\n",
+                local_storage->worker_index, local_storage->cpu, strerror(r));
+        }
+    }
+#endif
+
+    // Set the NUMA node affinity, and allocate the packet buffers on the node
+#if defined(USE_NUMA_PLACEMENT)
+    if (local_storage->numa_node >= 0)
+    {
+        bridge_cpuset_t         cpuset;
+
+        if (bridge_numa_cpuset(local_storage->numa_node, &cpuset) == 0)
+        {
+            logger("Bridge worker %u: Cannot determine the CPUs of NUMA node %d\n",
+                local_storage->worker_index, local_storage->numa_node);
+        }
+        else
+        {
+            r = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+            if (r)
+            {
+                fatal("Cannot set affinity of bridge worker %u to NUMA node %d: %s\n",
+                    local_storage->worker_index, local_storage->numa_node, strerror(r));
+            }
+        }
+
+        bridge_create_local_packet_buffers(local_storage);
+    }
+#endif
+
+    // Set the thread local storage
+    r = pthread_setspecific(thread_local_storage_key, local_storage);
+    if (r)
+    {
+        fatal("pthread_setspecific: %s\n", strerror(r));
+    }
+
+    // Run the event loop
+    evm_loop(local_storage->evm);
+}
+
+
+//
+// Create the thread local storage for a bridge worker, and add it to the
+// worker list
+//
+static bridge_local_storage_t * bridge_create_worker(
+    int                         cpu,
+    int                         numa_node)
+{
+    bridge_local_storage_t *    local_storage;
+    bridge_local_storage_t **   list;
+    struct msghdr *             msg;
+    unsigned int                index;
+
+    // Allocate the thread local storage
+    local_storage = calloc(1, sizeof(bridge_local_storage_t));
+    list = realloc(worker_list, (worker_count + 1) * sizeof(bridge_local_storage_t *));
+    if (local_storage == NULL || list == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+    local_storage->worker_index = worker_count;
+    local_storage->cpu = cpu;
+    local_storage->numa_node = numa_node;
+
+    // Initialize receive and send structures
+    for (index = 0; index < BRIDGE_BATCH_SIZE; index++)
+    {
+        msg = RECV_MSG(local_storage, index);
+        msg->msg_name = &local_storage->src_addr[index];
+        msg->msg_namelen = sizeof(local_storage->src_addr[index]);
+        msg->msg_iov = &local_storage->recv_iovec[index];
+        msg->msg_iovlen = 1;
+    #if defined(BRIDGE_RECV_CMSG_SIZE)
+        msg->msg_control = local_storage->cmsg_buf[index];
+        msg->msg_controllen = sizeof(local_storage->cmsg_buf[index]);
+    #endif
+    }
+
+    // Add the worker to the list
+    list[worker_count] = local_storage;
+    worker_list = list;
+    worker_count += 1;
+
+    return local_storage;
+}
+
+
+//
+// Find the worker for a bridge instance, creating a worker if required
+//
+// See start_bridges. A worker created here has no event manager until it is
+// started.
+//
+static bridge_local_storage_t * bridge_find_worker(
+    const bridge_instance_t *   bridge)
+{
+    bridge_local_storage_t *    local_storage;
+    unsigned int                worker_index;
+    unsigned int                index;
+    int                         cpu;
+    int                         numa_node;
+
+#if defined(USE_CPU_AFFINITY)
+    if (bridge->cpu >= CPU_SETSIZE)
+    {
+        fatal("Bridge(%s/%u): CPU %d exceeds the maximum supported (%d)\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port, bridge->cpu, CPU_SETSIZE - 1);
+    }
+#endif
+
+    // Resolve automatic CPU placement
+    cpu = bridge->cpu;
+    numa_node = -1;
+#if defined(USE_NUMA_PLACEMENT)
+    if (cpu == BRIDGE_CPU_AUTO)
+    {
+        cpu = -1;
+        numa_node = bridge_numa_node(bridge);
+        if (debug_level)
+        {
+            if (numa_node >= 0)
+            {
+                logger("Bridge(%s/%u): Placed on NUMA node %d\n",
+                    AF_FAMILY_TO_STRING(bridge->family), bridge->port, numa_node);
+            }
+            else
+            {
+                logger("Bridge(%s/%u): NUMA node of the inbound interfaces is unknown, not placed\n",
+                    AF_FAMILY_TO_STRING(bridge->family), bridge->port);
+            }
+        }
+    }
+#endif
+
+    if (worker_thread_count == 0 || (bridge->busy_poll && cpu < 0 && numa_node < 0))
+    {
+        // Each bridge instance has its own worker, except that the instances of a
+        // port range section share the worker of the other instances of the family
+        for (worker_index = worker_thread_count; worker_index < worker_count; worker_index++)
+        {
+            local_storage = worker_list[worker_index];
+            for (index = 0; index < local_storage->bridge_count; index++)
+            {
+                if (local_storage->bridge_list[index]->section == bridge->section &&
+                    local_storage->bridge_list[index]->family == bridge->family)
+                {
+                    return local_storage;
+                }
+            }
+        }
+
+        // Reuse a worker left without bridge instances by a reload
+        for (worker_index = worker_thread_count; worker_index < worker_count; worker_index++)
+        {
+            local_storage = worker_list[worker_index];
+            if (local_storage->bridge_count == 0 && local_storage->cpu == cpu && local_storage->numa_node == numa_node)
+            {
+                return local_storage;
+            }
+        }
+    }
+    else if (cpu >= 0)
+    {
+        // Find the pinned worker for the CPU
+        for (worker_index = worker_thread_count; worker_index < worker_count; worker_index++)
+        {
+            if (worker_list[worker_index]->cpu == cpu)
+            {
+                return worker_list[worker_index];
+            }
+        }
+    }
+    else if (numa_node >= 0)
+    {
+        // Find the placed worker for the NUMA node
+        for (worker_index = worker_thread_count; worker_index < worker_count; worker_index++)
+        {
+            if (worker_list[worker_index]->numa_node == numa_node)
+            {
+                return worker_list[worker_index];
+            }
+        }
+    }
+    else
+    {
+        // Use the least loaded shared worker
+        worker_index = 0;
+        for (index = 1; index < worker_thread_count; index++)
+        {
+            if (worker_list[index]->socket_count < worker_list[worker_index]->socket_count)
+            {
+                worker_index = index;
+            }
+        }
+        return worker_list[worker_index];
+    }
+
+    // Create a new worker
+    return bridge_create_worker(cpu, numa_node);
+}
+
+
+//
+// Find the worker that owns a bridge instance
+//
+static bridge_local_storage_t * bridge_owner(
+    const bridge_instance_t *   bridge)
+{
+    unsigned int                worker_index;
+
+    for (worker_index = 0; worker_index < worker_count; worker_index++)
+    {
+        if (worker_list[worker_index]->channel && worker_list[worker_index]->channel == bridge->channel)
+        {
+            return worker_list[worker_index];
+        }
+    }
+
+    fatal("Bridge(%s/%u): Worker not found\n", AF_FAMILY_TO_STRING(bridge->family), bridge->port);
+}
+
+
+//
+// Add a bridge instance to the bridge instances, sockets and rate limit timers
+// of a worker
+//
+// NB: This must only be called by the worker, or before the worker is started
+//
+static void bridge_worker_add(
+    bridge_local_storage_t *    local_storage,
+    bridge_instance_t *         bridge)
+{
+    bridge_interface_t *        bridge_interface;
+    bridge_instance_t **        list;
+    unsigned int                interface_index;
+    size_t                      packet_size;
+
+    // Add the bridge instance to the list, and make room for it in the fanout update list
+    list = realloc(local_storage->bridge_list, (local_storage->bridge_count + 1) * sizeof(bridge_instance_t *));
+    if (list == NULL)
+    {
+        fatal("Cannot allocate memory for bridge list: %s\n", strerror(errno));
+    }
+    list[local_storage->bridge_count] = bridge;
+    local_storage->bridge_list = list;
+    local_storage->bridge_count += 1;
+
+    list = realloc(local_storage->fanout_update_list, local_storage->bridge_count * sizeof(bridge_instance_t *));
+    if (list == NULL)
+    {
+        fatal("Cannot allocate memory for fanout update list: %s\n", strerror(errno));
+    }
+    local_storage->fanout_update_list = list;
+
+    local_storage->socket_count += bridge->interface_count;
+    if (bridge->busy_poll)
+    {
+        local_storage->busy_poll = 1;
+    }
+
+    // Socket dataplane packets are received into the worker packet buffers
+    if (bridge->dataplane == DATAPLANE_SOCKET || bridge->dataplane == DATAPLANE_XDP ||
+        bridge->dataplane == DATAPLANE_KERNEL)
+    {
+        packet_size = bridge->udp_offload ? MCAST_MAX_PACKET_SIZE : bridge->max_packet_size;
+        if (packet_size > local_storage->packet_buffer_size)
+        {
+            local_storage->packet_buffer_size = packet_size;
+        }
+    }
+
+    // Create the duplicate suppression table
+    if (bridge->duplicate_window)
+    {
+        bridge_create_dedup(bridge);
+    }
+
+    // Create the rate limit queues
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        bridge_interface = bridge->interface_list[interface_index];
+        if (bridge_interface->rate_limit)
+        {
+            bridge_create_shaper(bridge_interface);
+            local_storage->timer_count += 1;
+        }
+    }
+}
+
+
+//
+// Add the sockets of a bridge instance to the event manager of a worker
+//
+// Interface changes are applied by the worker from here on.
+//
+// NB: This must only be called by the worker, or before the worker is started
+//
+static void bridge_worker_attach(
+    bridge_local_storage_t *    local_storage,
+    bridge_instance_t *         bridge)
+{
+    bridge_interface_t *        bridge_interface;
+    unsigned int                interface_index;
+
+    if (debug_level)
+    {
+        logger("Bridge(%s/%u): Assigned to worker %u\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port, local_storage->worker_index);
+    }
+
+    bridge->channel = local_storage->channel;
+
+#if defined(USE_IO_URING)
+    if (bridge->dataplane == DATAPLANE_IO_URING)
+    {
+        uring_register_bridge(local_storage->evm, bridge);
+        return;
+    }
+#endif
+
+#if defined(USE_RECVIF_PKTINFO)
+    // Receive on the socket of the first interface only
+    bridge_create_if_index_table(bridge);
+    evm_add_drain_socket(local_storage->evm, bridge->interface_list[0]->sock,
+        bridge_receive, bridge->interface_list[0], BRIDGE_DRAIN_BUDGET);
+    return;
+#endif
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        bridge_interface = bridge->interface_list[interface_index];
+
+#if defined(USE_PACKET_RING)
+        if (bridge->dataplane == DATAPLANE_PACKET_RING)
+        {
+            packet_ring_register(local_storage->evm, bridge_interface);
+            continue;
+        }
+#endif
+
+        evm_add_drain_socket(local_storage->evm, bridge_interface->sock,
+            bridge_receive, bridge_interface, BRIDGE_DRAIN_BUDGET);
+    }
+}
+
+
+//
+// Create the event manager and command channel of a worker
+//
+static void bridge_worker_create_evm(
+    bridge_local_storage_t *    local_storage)
+{
+    local_storage->evm = evm_create(local_storage->socket_count + 1, local_storage->timer_count);
+    if (local_storage->evm == NULL)
+    {
+        fatal("Cannot create event manager\n");
+    }
+
+    // Create the command channel
+    local_storage->channel = bridge_create_channel();
+    evm_add_socket(local_storage->evm, local_storage->channel->read_fd, bridge_channel_receive, local_storage);
+
+    if (local_storage->busy_poll)
+    {
+        evm_set_busy_poll(local_storage->evm, 1);
+        if (debug_level)
+        {
+            logger("Worker %u: Busy polling%s\n", local_storage->worker_index,
+                local_storage->cpu < 0 && local_storage->numa_node < 0 ? " without CPU affinity" : "");
+        }
+    }
+}
+
+
+//
+// Start the thread of a worker
+//
+static void bridge_worker_start(
+    bridge_local_storage_t *    local_storage)
+{
+    pthread_t                   thread_id;
+    int                         r;
+
+    // NB: The thread ID is discarded
+    r = pthread_create(&thread_id, NULL, &bridge_thread, local_storage);
+    if (r != 0)
+    {
+        fatal("cannot create bridge thread: %s\n", strerror(r));
+    }
+}
+
+
+//
+// Allocate the packet buffers of the bridge workers
+//
+// The buffers of all workers are carved from a single allocation, backed by
+// huge pages where available. Workers placed on a NUMA node allocate their
+// own buffers once running on the node. The buffer size of each worker is the
+// largest packet size of its bridge instances, and buffers are placed on cache
+// line boundaries.
+//
+static void bridge_create_packet_buffers(
+    bridge_local_storage_t **   worker_list,
+    unsigned int                worker_count)
+{
+    bridge_local_storage_t *    local_storage;
+    unsigned char *             arena;
+    size_t                      arena_size = 0;
+    unsigned int                worker_index;
+
+    // Determine the arena size
+    for (worker_index = 0; worker_index < worker_count; worker_index++)
+    {
+        if (worker_list[worker_index]->numa_node < 0)
+        {
+            arena_size += bridge_packet_buffer_stride(worker_list[worker_index]) * BRIDGE_BATCH_SIZE;
+        }
+    }
+    if (arena_size == 0)
+    {
+        return;
+    }
+
+    // Allocate the arena
+    arena = bridge_map_packet_arena(arena_size);
+
+    // Assign the buffers
+    for (worker_index = 0; worker_index < worker_count; worker_index++)
+    {
+        local_storage = worker_list[worker_index];
+        if (local_storage->numa_node < 0)
+        {
+            arena = bridge_assign_packet_buffers(local_storage, arena);
+        }
+    }
+}
+
+
+//
+// Start the bridge worker threads
+//
+// If the number of worker threads is not configured, each bridge instance
+// (IP family & port number) has its own worker. Otherwise, bridge instances
+// without a CPU affinity are shared among the configured number of workers,
+// and bridge instances with a CPU affinity are grouped into one pinned
+// worker per CPU. Bridge instances with automatic CPU placement are treated
+// as having an affinity for the NUMA node of their inbound interfaces, or as
+// having no affinity if the node cannot be determined. Busy poll bridge
+// instances without a CPU affinity are never assigned to the shared workers.
+// A worker busy polls if any of its bridge instances use busy poll mode.
+//
+void start_bridges(void)
+{
+    bridge_local_storage_t *    local_storage;
+    unsigned int                bridge_index;
+    unsigned int                worker_index;
+    int                         r;
+
+    // Create the thread local storage key
+    r = pthread_key_create(&thread_local_storage_key, NULL);
+    if (r)
+    {
+        fatal("pthread_key_create: %s\n", strerror(r));
+    }
+
+    // Create the shared workers
+    for (worker_index = 0; worker_index < worker_thread_count; worker_index++)
+    {
+        (void) bridge_create_worker(-1, -1);
+    }
+
+    // Assign the bridge instances to workers
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge_worker_add(bridge_find_worker(bridge_list[bridge_index]), bridge_list[bridge_index]);
+    }
+
+    // Allocate the packet buffers
+    bridge_create_packet_buffers(worker_list, worker_count);
+
+    // Create the event managers, add the sockets of the bridge instances, and
+    // start the worker threads. Workers without any bridge instances are not
+    // started.
+    for (worker_index = 0; worker_index < worker_count; worker_index++)
+    {
+        local_storage = worker_list[worker_index];
+        if (local_storage->bridge_count == 0)
+        {
+            continue;
+        }
+
+        bridge_worker_create_evm(local_storage);
+        for (bridge_index = 0; bridge_index < local_storage->bridge_count; bridge_index++)
+        {
+            bridge_worker_attach(local_storage, local_storage->bridge_list[bridge_index]);
         }
+        bridge_worker_start(local_storage);
+    }
+}
+
+
+//
+// Get the thread local storage of the calling worker
+//
+static bridge_local_storage_t * bridge_local_storage(void)
+{
+    bridge_local_storage_t *    local_storage;
+
+    local_storage = pthread_getspecific(thread_local_storage_key);
+    if (local_storage == NULL)
+    {
+        fatal("pthread_getspecific failed\n");
+    }
+
+    return local_storage;
+}
+
+
+//
+// Add an interface to a bridge instance (worker side of bridge_add_interface)
+//
+static void bridge_add_interface_call(
+    void *                      arg)
+{
+    bridge_interface_t *        bridge_interface = arg;
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    bridge_local_storage_t *    local_storage = bridge_local_storage();
+
+    local_storage->socket_count += 1;
+    if (bridge_interface->rate_limit)
+    {
+        bridge_create_shaper(bridge_interface);
+        local_storage->timer_count += 1;
+    }
+    evm_grow(local_storage->evm, local_storage->socket_count + 1, local_storage->timer_count);
+
+    interface_apply_add(bridge_interface);
+
+#if defined(USE_RECVIF_PKTINFO)
+    // The bridge instance receives on the socket of its first interface
+    free(bridge->if_index_table);
+    bridge_create_if_index_table(bridge);
+#else
+    evm_add_drain_socket(local_storage->evm, bridge_interface->sock,
+        bridge_receive, bridge_interface, BRIDGE_DRAIN_BUDGET);
+#endif
+
+    interface_update_fanout(bridge);
+}
+
+
+//
+// Add an interface to a running socket dataplane bridge instance
+//
+// The worker that owns the bridge instance adds the interface to the interface
+// list, grows the fanout lists, activates the interface and starts receiving
+// on its socket.
+//
+void bridge_add_interface(
+    bridge_interface_t *        bridge_interface)
+{
+    evm_call(bridge_owner(bridge_interface->bridge)->evm, bridge_add_interface_call, bridge_interface);
+}
+
+
+//
+// Remove an interface from a bridge instance (worker side of
+// bridge_remove_interface)
+//
+static void bridge_remove_interface_call(
+    void *                      arg)
+{
+    bridge_interface_t *        bridge_interface = arg;
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    bridge_local_storage_t *    local_storage = bridge_local_storage();
+    bridge_interface_t *        peer;
+    bridge_shaper_t *           shaper;
+    unsigned int                peer_index;
+    unsigned int                index;
+
+    // Apply any posted updates, so that the channel no longer refers to the interface
+    bridge_channel_receive(local_storage);
+
+    // Deactivate the interface and remove it from the bridge instance
+    interface_apply_remove(bridge_interface);
+#if defined(USE_RECVIF_PKTINFO)
+    free(bridge->if_index_table);
+    bridge_create_if_index_table(bridge);
+#else
+    evm_del_socket(local_storage->evm, bridge_interface->sock);
+#endif
+    local_storage->socket_count -= 1;
+    bridge_delete_shaper(local_storage, bridge_interface);
+    interface_update_fanout(bridge);
 
-        // Add the interface sockets to the event manager
-        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    // Packets queued for rate limited peers are no longer attributed to the interface
+    for (peer_index = 0; peer_index < bridge->interface_count; peer_index++)
+    {
+        peer = bridge->interface_list[peer_index];
+        shaper = peer->shaper;
+        if (shaper == NULL)
+        {
+            continue;
+        }
+        for (index = 0; index < shaper->count; index++)
         {
-            bridge_interface = &bridge->interface_list[interface_index];
+            if (shaper->entry[(shaper->head + index) % SHAPER_QUEUE_COUNT].inbound == bridge_interface)
+            {
+                shaper->entry[(shaper->head + index) % SHAPER_QUEUE_COUNT].inbound = NULL;
+            }
+        }
+    }
+}
+
+
+//
+// Remove an interface from a running socket dataplane bridge instance
+//
+// The worker that owns the bridge instance applies any pending updates,
+// deactivates the interface, leaving its groups, removes it from the interface
+// and fanout lists, and stops receiving on its socket. The caller closes the
+// socket.
+//
+// NB: Under IP_RECVIF, the first interface of a bridge instance cannot be
+//     removed, as the bridge instance receives on its socket
+//
+void bridge_remove_interface(
+    bridge_interface_t *        bridge_interface)
+{
+    evm_call(bridge_owner(bridge_interface->bridge)->evm, bridge_remove_interface_call, bridge_interface);
+}
+
+
+//
+// Assign a bridge instance to a running worker (worker side of
+// bridge_add_bridge)
+//
+static void bridge_add_bridge_call(
+    void *                      arg)
+{
+    bridge_instance_t *         bridge = arg;
+    bridge_local_storage_t *    local_storage = bridge_local_storage();
+    size_t                      packet_buffer_size = local_storage->packet_buffer_size;
+
+    bridge_worker_add(local_storage, bridge);
+    evm_grow(local_storage->evm, local_storage->socket_count + 1, local_storage->timer_count);
+
+    // Replace the packet buffers if the bridge instance receives larger packets
+    if (local_storage->packet_buffer_size > packet_buffer_size)
+    {
+        bridge_create_local_packet_buffers(local_storage);
+    }
+
+    bridge_worker_attach(local_storage, bridge);
+    evm_set_busy_poll(local_storage->evm, local_storage->busy_poll);
+}
+
+
+//
+// Assign a socket dataplane bridge instance to a worker after startup
+//
+// The bridge instance is assigned as it would be at startup. If this requires
+// a new worker, the worker is started, otherwise the bridge instance is added
+// by the running worker.
+//
+void bridge_add_bridge(
+    bridge_instance_t *         bridge)
+{
+    bridge_local_storage_t *    local_storage;
+
+    local_storage = bridge_find_worker(bridge);
+    if (local_storage->evm)
+    {
+        evm_call(local_storage->evm, bridge_add_bridge_call, bridge);
+        return;
+    }
+
+    // Start a new worker
+    bridge_worker_add(local_storage, bridge);
+    if (local_storage->numa_node < 0)
+    {
+        bridge_create_local_packet_buffers(local_storage);
+    }
+    bridge_worker_create_evm(local_storage);
+    bridge_worker_attach(local_storage, bridge);
+    bridge_worker_start(local_storage);
+}
+
+
+//
+// Remove a bridge instance from its worker (worker side of bridge_remove_bridge)
+//
+static void bridge_remove_bridge_call(
+    void *                      arg)
+{
+    bridge_instance_t *         bridge = arg;
+    bridge_local_storage_t *    local_storage = bridge_local_storage();
+    unsigned int                interface_index;
+    unsigned int                bridge_index;
+
+    // Apply any posted updates, so that the channel no longer refers to the bridge instance
+    bridge_channel_receive(local_storage);
+
+    // Stop receiving, and delete the rate limit queues
+#if defined(USE_RECVIF_PKTINFO)
+    evm_del_socket(local_storage->evm, bridge->interface_list[0]->sock);
+    free(bridge->if_index_table);
+    bridge->if_index_table = NULL;
+#endif
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+#if !defined(USE_RECVIF_PKTINFO)
+        evm_del_socket(local_storage->evm, bridge->interface_list[interface_index]->sock);
+#endif
+        bridge_delete_shaper(local_storage, bridge->interface_list[interface_index]);
+    }
+    local_storage->socket_count -= bridge->interface_count;
 
-            evm_add_socket(local_storage->evm, bridge_interface->sock,
-                bridge_receive, bridge_interface);
+    free(bridge->dedup);
+    bridge->dedup = NULL;
+    bridge->channel = NULL;
+
+    // Remove the bridge instance from the worker
+    for (bridge_index = 0; bridge_index < local_storage->bridge_count; bridge_index++)
+    {
+        if (local_storage->bridge_list[bridge_index] == bridge)
+        {
+            local_storage->bridge_count -= 1;
+            local_storage->bridge_list[bridge_index] = local_storage->bridge_list[local_storage->bridge_count];
+            break;
         }
+    }
 
-        // Start the thread
-        r = pthread_create(&thread_id, NULL, &bridge_thread, local_storage);
-        if (r != 0)
+    // The worker busy polls while any of its bridge instances use busy poll mode
+    local_storage->busy_poll = 0;
+    for (bridge_index = 0; bridge_index < local_storage->bridge_count; bridge_index++)
+    {
+        if (local_storage->bridge_list[bridge_index]->busy_poll)
         {
-            fatal("cannot create bridge thread: %s\n", strerror(r));
+            local_storage->busy_poll = 1;
         }
     }
+    evm_set_busy_poll(local_storage->evm, local_storage->busy_poll);
+}
+
+
+//
+// Remove a socket dataplane bridge instance from its worker after startup
+//
+// The worker applies any pending updates and stops receiving on the sockets of
+// the bridge instance. The caller closes the sockets. A worker left without
+// bridge instances remains idle until a bridge instance is assigned to it.
+//
+void bridge_remove_bridge(
+    bridge_instance_t *         bridge)
+{
+    evm_call(bridge_owner(bridge)->evm, bridge_remove_bridge_call, bridge);
 }
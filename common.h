@@ -52,6 +52,107 @@
 #endif
 
 
+// Multiple multicast groups per bridge instance, identified by the destination
+// address of each received packet
+#if defined(IP_PKTINFO) && defined(IPV6_RECVPKTINFO) && !defined(USE_RECVIF_PKTINFO)
+# define USE_GROUP_LIST
+#endif
+
+
+// UDP receive coalescing and segmentation offload (GRO/GSO)
+#if defined(__linux__)
+# include <netinet/udp.h>
+# if defined(UDP_GRO) && defined(UDP_SEGMENT)
+#  define USE_UDP_OFFLOAD
+# endif
+#endif
+
+
+// Thread CPU affinity
+#if defined(__linux__) || defined(__FreeBSD__)
+# define USE_CPU_AFFINITY
+# define MAX_CPU_AFFINITY       1024
+#endif
+
+// Placement of bridge workers on the NUMA node of their inbound interfaces
+#if defined(__linux__)
+# define USE_NUMA_PLACEMENT
+#endif
+
+
+// Packet ring (AF_PACKET TPACKET_V3) dataplane
+#if defined(__linux__)
+# define USE_PACKET_RING
+#endif
+
+
+// Capture IGMP and MLD packets as an all-multicast AF_PACKET member rather than in promiscuous mode
+#if defined(__linux__)
+# define USE_PACKET_ALLMULTI
+#endif
+
+
+// XDP redirect dataplane
+#if defined(__linux__)
+# define USE_XDP
+#endif
+
+
+// io_uring dataplane
+#if defined(__linux__)
+# define USE_IO_URING
+#endif
+
+
+// Kernel multicast forwarding dataplane
+#if defined(__linux__) || defined(__FreeBSD__)
+# define USE_MROUTE
+#endif
+
+
+// Socket receive queue overflow (kernel drop) counts
+#if defined(SO_RXQ_OVFL)
+# define USE_RXQ_OVFL
+#endif
+
+
+// Kernel receive timestamps for forwarding latency
+#if defined(SO_TIMESTAMPNS)
+# define USE_RX_TIMESTAMP
+#endif
+
+
+// Socket pacing for outbound rate limits
+#if defined(SO_MAX_PACING_RATE)
+# define USE_PACING_RATE
+#endif
+
+
+// Socket busy polling for busy poll mode
+#if defined(SO_BUSY_POLL)
+# define USE_BUSY_POLL
+#endif
+
+
+// Event file descriptor for waking bridge workers
+#if defined(__linux__)
+# define USE_EVENTFD
+#endif
+
+
+// SIMD internet checksums, selected by the CPU features at run time on x86
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define USE_CSUM_SSE2
+# define USE_CSUM_AVX2
+#elif defined(__ARM_NEON) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+# define USE_CSUM_NEON
+#endif
+
+
+// Cache line size used to separate data written by different threads
+#define CACHE_LINE_SIZE         64
+
+
 // Version number of mcast-bridge
 #define VERSION                 "1.6.0"
 
@@ -90,26 +191,171 @@ typedef enum interface_config_type
     INTERFACE_CONFIG_FORCED     = 3
 } interface_config_type_t;
 
+// Dataplane type
+typedef enum dataplane_type
+{
+    DATAPLANE_SOCKET            = 0,
+    DATAPLANE_PACKET_RING       = 1,
+    DATAPLANE_XDP               = 2,
+    DATAPLANE_IO_URING          = 3,
+    DATAPLANE_KERNEL            = 4
+} dataplane_type_t;
+
+// Forwarding counters for an interface
+//
+// NB: Counters are only written by the worker thread that owns the bridge
+//     instance, and are read without locking by the statistics reporters.
+//     Each interface's counters are allocated on their own cache lines so
+//     that updates do not share lines with the control plane.
+typedef struct bridge_counters
+{
+    // Inbound
+    uint64_t                    rx_packets;
+    uint64_t                    rx_bytes;
+    uint64_t                    rx_inactive;
+    uint64_t                    rx_no_outbound;
+    uint64_t                    rx_errors;
+    uint64_t                    rx_overflow;
+    uint64_t                    rx_duplicates;
+    uint64_t                    rx_calls;
+
+    // Outbound
+    uint64_t                    tx_packets;
+    uint64_t                    tx_bytes;
+    uint64_t                    tx_errors;
+    uint64_t                    tx_nobufs;
+    uint64_t                    tx_dropped;
+    uint64_t                    tx_filtered;
+    uint64_t                    tx_calls;
+} bridge_counters_t;
+
+// Update or read a counter
+#define COUNTER_ADD(counter, value) __atomic_store_n(&(counter), (counter) + (value), __ATOMIC_RELAXED)
+#define COUNTER_SET(counter, value) __atomic_store_n(&(counter), (value), __ATOMIC_RELAXED)
+#define COUNTER_GET(counter)        __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+// Forwarding latency histogram for a bridge instance
+//
+// Latencies are recorded in nanoseconds in log-linear buckets. Values below
+// 2^(LATENCY_SUB_BUCKET_BITS + 1) each have their own bucket, and each power
+// of 2 above that is divided into 2^LATENCY_SUB_BUCKET_BITS buckets, giving a
+// worst case relative error of about 3%. Values beyond the last bucket
+// (about 68 seconds) are recorded in the last bucket.
+//
+// NB: As with the counters, the histogram is only written by the worker
+//     thread that owns the bridge instance.
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_BUCKET_COUNT    1024
+typedef struct bridge_latency
+{
+    uint64_t                    max;
+    uint64_t                    bucket[LATENCY_BUCKET_COUNT];
+} bridge_latency_t;
+
+// Outbound fanout list for an inbound interface
+typedef struct bridge_fanout
+{
+    unsigned int                peer_count;
+    struct bridge_interface *   peer_list[];
+} bridge_fanout_t;
+
+// Maximum number of sources tracked for a group from IGMP v3 and MLD v2 source
+// lists. Groups with more sources are forwarded from any source.
+#define MAX_GROUP_SOURCES       32
+
+// Source filter for a group on an outbound interface
+//
+// Packets for the group are only forwarded to the interface if their source
+// address is in the list. The list is sorted so that it can be searched with a
+// binary search.
+typedef struct bridge_source_filter
+{
+    // Index of the group in the group list of the bridge instance
+    unsigned int                group_index;
+
+    // Forward packets from any source? (used to remove a filter)
+    unsigned int                any_source;
+
+    // Source addresses (source_count addresses of address_len bytes)
+    unsigned int                address_len;
+    unsigned int                source_count;
+    uint8_t                     source_list[];
+} bridge_source_filter_t;
+
 // Interface structure
+//
+// NB: The fields used to forward each packet are grouped in the first cache
+//     line, and the configuration and addresses only used by the control plane
+//     start on the following line. Each interface is allocated on a cache line
+//     boundary so that its forwarding fields occupy a single line, and is not
+//     moved once allocated.
 typedef struct bridge_interface
 {
-    // The bridge instance this interface belongs to
-    unsigned int                bridge_index;
-
     // Interface socket
     int                         sock;
 
-    // What is the interface configured for?
-    interface_config_type_t     inbound_configuration;
-    interface_config_type_t     outbound_configuration;
+    // Interface index (also the IPv6 scope id of packets sent to the interface)
+    unsigned int                if_index;
 
     // Is the interface currently active?
     unsigned int                inbound_active;
     unsigned int                outbound_active;
 
-    // Interface name, index and addresses
-    char *                      name;
-    unsigned int                if_index;
+    // The bridge instance this interface belongs to
+    struct bridge_instance *    bridge;
+
+    // Active outbound peers for packets received on this interface. The
+    // fanout list is rebuilt by the worker that owns the bridge instance
+    // between batches (see interface_update_fanout).
+    bridge_fanout_t *           fanout;
+
+    // Source filters for the groups of the bridge instance, indexed by group
+    // (NULL if packets from any source are forwarded). Filters are built from the
+    // IGMP v3 and MLD v2 source lists of dynamic interfaces, and are replaced by
+    // the worker that owns the bridge instance.
+    bridge_source_filter_t **   source_filter;
+
+    // Forwarding counters
+    bridge_counters_t *         counters;
+
+    // Token bucket and queue used to shape packets sent to the interface (NULL
+    // if the interface is not rate limited)
+    struct bridge_shaper *      shaper;
+
+    // Packet ring (packet ring dataplane only)
+    struct packet_ring *        packet_ring;
+
+    // Interface name
+    char *                      name __attribute__ ((aligned(CACHE_LINE_SIZE)));
+
+    // XDP device map mirroring the fanout list (XDP dataplane only)
+    int                         xdp_devmap_fd;
+
+    // What is the interface configured for?
+    interface_config_type_t     inbound_configuration;
+    interface_config_type_t     outbound_configuration;
+
+    // Number of groups of the bridge instance with active listeners on a dynamic
+    // outbound interface. The interface is active while any group is active.
+    unsigned int                outbound_group_count;
+
+    // Outbound state requested by the control plane. The worker that owns the
+    // bridge instance applies the requested state when the interface is marked
+    // as updated (see interface_apply_update).
+    unsigned int                outbound_request;
+
+    // Source filters requested for the groups of the bridge instance, indexed by
+    // group (NULL if no change is pending)
+    bridge_source_filter_t **   source_filter_request;
+
+    // Is an update of the interface pending in the worker command channel?
+    unsigned int                update_pending;
+
+    // Outbound rate limit in bytes per second (0 if none). Changes are applied
+    // by the worker as part of an update.
+    uint64_t                    rate_limit;
+
+    // Interface addresses
     struct in_addr              ipv4_addr;
     struct in6_addr             ipv6_addr;
     struct in6_addr             ipv6_addr_ll;
@@ -117,6 +363,10 @@ typedef struct bridge_interface
 } bridge_interface_t;
 
 
+// Bridge instance CPU affinity that places the worker on the NUMA node of the
+// inbound interfaces
+#define BRIDGE_CPU_AUTO         (-2)
+
 // Instance structure
 typedef struct bridge_instance
 {
@@ -124,19 +374,96 @@ typedef struct bridge_instance
     unsigned short              family;
     unsigned short              port;
 
-    // Multicast address
+    // Multicast address (the first group)
     socket_address_t            dst_addr;
     socklen_t                   dst_addr_len;
 
+    // Multicast groups, starting with dst_addr. Packets are forwarded to the group
+    // they were received for.
+    // NB: More than one group requires the socket dataplane
+    socket_address_t *          group_list;
+    unsigned int                group_count;
+
+    // Configuration section the bridge instance was defined in. Instances of a
+    // section with a port range share a worker unless threads are configured.
+    unsigned int                section;
+
+    // Dataplane used to forward packets
+    dataplane_type_t            dataplane;
+
+    // Use UDP receive coalescing and segmentation offload?
+    unsigned int                udp_offload;
+
+    // Busy poll rather than wait for packets?
+    unsigned int                busy_poll;
+
+    // Window in milliseconds within which duplicates of a received packet are
+    // dropped (0 if none), and the fingerprints of recently received packets.
+    // Changes to the window are applied by the worker as part of an update.
+    unsigned int                duplicate_window;
+    struct bridge_dedup *       dedup;
+
+    // Include the source address when matching duplicates?
+    unsigned int                duplicate_match_source;
+
+    // Largest UDP payload received. Larger datagrams are dropped.
+    // NB: Coalesced packets may be up to MCAST_MAX_PACKET_SIZE when UDP offload is enabled
+    unsigned int                max_packet_size;
+
+    // CPU the bridge worker is pinned to (-1 if none, BRIDGE_CPU_AUTO to place
+    // the worker on the NUMA node of the inbound interfaces)
+    int                         cpu;
+
+    // io_uring engine (io_uring dataplane only)
+    struct uring_engine *       uring;
+
+    // Forwarding latency histogram
+    bridge_latency_t *          latency;
+
     // Interfaces that are part of this bridge instance
-    bridge_interface_t *        interface_list;
+    bridge_interface_t **       interface_list;
     unsigned int                interface_count;
+
+#if defined(USE_RECVIF_PKTINFO)
+    // Interfaces of this bridge instance indexed by interface index (NULL if not part
+    // of the bridge instance). Built when the bridge instance is assigned to its worker,
+    // and rebuilt when interfaces are added or removed.
+    // NB: The sockets are not bound to an interface, so the bridge instance receives on
+    //     the socket of its first interface only, with the groups for all inbound
+    //     interfaces joined on that socket. The other sockets are used for sending.
+    bridge_interface_t **       if_index_table;
+    unsigned int                if_index_table_size;
+#endif
+
+    // Command channel of the worker that owns the bridge instance (NULL until
+    // the workers are started). Interfaces with a changed requested state are
+    // posted to the worker, which applies the state between batches.
+    struct bridge_channel *     channel;
+
+    // Fanout lists need to be rebuilt after applying updates (worker only)
+    unsigned int                fanout_pending;
 } bridge_instance_t;
 
 
 // Event manager types
 typedef void *                  evm_t;
 typedef void                    (*evm_callback_t) (void * closure);
+typedef unsigned int            (*evm_drain_callback_t) (void * closure);
+
+// Event manager timer
+//
+// NB: Timers are embedded in the structure they are associated with, and the
+//     timer itself is the handle used to reschedule or delete it. A zeroed
+//     timer is not scheduled. A timer must not be moved or cleared while it
+//     is scheduled.
+typedef struct evm_timer
+{
+    struct timespec             timespec;
+    unsigned long               sequence;
+    evm_callback_t              callback;
+    void *                      closure;
+    unsigned int                heap_index;
+} evm_timer_t;
 
 // Querier mode type
 typedef enum querier_mode_type
@@ -147,6 +474,21 @@ typedef enum querier_mode_type
     QUERIER_MODE_DEFER          = 3
 } querier_mode_type_t;
 
+// Log event type
+typedef enum log_event
+{
+    LOG_EVENT_MESSAGE               = 0,
+    LOG_EVENT_FORWARDED             = 1,
+    LOG_EVENT_FORWARDED_SEGMENTS    = 2,
+    LOG_EVENT_FORWARDED_FRAME       = 3,
+    LOG_EVENT_DROPPED_TOO_LARGE     = 4,
+    LOG_EVENT_DROPPED_DUPLICATE     = 5,
+    LOG_EVENT_DROPPED_MTU           = 6,
+    LOG_EVENT_DROPPED_RING_FULL     = 7,
+    LOG_EVENT_DROPPED_NO_SEND_SLOTS = 8,
+    LOG_EVENT_DROPPED_QUEUE_FULL    = 9
+} log_event_t;
+
 
 //
 // Global definitions
@@ -157,6 +499,10 @@ extern const char *             config_filename;
 extern unsigned int             non_configured_groups;
 extern querier_mode_type_t      igmp_querier_mode;
 extern querier_mode_type_t      mld_querier_mode;
+extern unsigned int             worker_thread_count;
+extern const char *             stats_socket_path;
+extern unsigned int             debug_log_sample;
+extern unsigned int             debug_log_rate;
 
 // Debug level, defined in main.c
 // 0 = No debugging
@@ -167,10 +513,18 @@ extern querier_mode_type_t      mld_querier_mode;
 extern unsigned int             debug_level;
 
 // Instances, defined in config.c
-extern bridge_instance_t *      bridge_list;
+// NB: Instances are not moved once allocated
+extern bridge_instance_t **     bridge_list;
 extern unsigned int             bridge_list_allocated;
 extern unsigned int             bridge_list_count;
 
+// Lock held while the bridge list or the interface lists of the bridge
+// instances are changed after startup, and by other threads reading them
+// NB: The workers do not take the lock. Interface lists are only changed by
+//     the worker that owns the bridge instance, at the request of the main
+//     thread.
+extern pthread_mutex_t          bridge_list_lock;
+
 
 //
 // Global functions
@@ -188,17 +542,59 @@ extern void fatal(
     const char *       format,
     ...);
 
+// Initialize logging
+extern void initialize_log(
+    unsigned int                foreground,
+    unsigned int                use_syslog);
+
+// Start the logging thread
+extern void start_log(void);
+
+// Write any pending log entries
+extern void log_flush(void);
+
+// Record a bridge packet forwarding debug event
+extern void log_packet(
+    log_event_t                 event,
+    const bridge_instance_t *   bridge,
+    const char *                inbound,
+    const char *                outbound,
+    const void *                src_addr,
+    unsigned int                len,
+    unsigned int                value);
+
 // Config processing
 extern void read_config(void);
+extern void reload_config(void);
 extern void dump_config(void);
 
 // Map an interface configuration type to a string
 const char * interface_config_type_to_string(
     interface_config_type_t     interface_config_type);
 
+// Map a dataplane type to a string
+const char * dataplane_type_to_string(
+    dataplane_type_t            dataplane_type);
+
 // Initialize the socket infrastructure
 extern void initialize_interfaces(void);
 
+// Add an interface to a bridge instance after startup
+extern void interface_add(
+    bridge_interface_t *        bridge_interface);
+
+// Remove an interface from a bridge instance after startup
+extern void interface_remove(
+    bridge_interface_t *        bridge_interface);
+
+// Add a bridge instance after startup
+extern void interface_add_bridge(
+    bridge_instance_t *         bridge);
+
+// Remove a bridge instance after startup
+extern void interface_remove_bridge(
+    bridge_instance_t *         bridge);
+
 // Activate an outbound interface
 extern void interface_activate_outbound(
     bridge_interface_t *      bridge_interface);
@@ -207,13 +603,74 @@ extern void interface_activate_outbound(
 extern void interface_deactivate_outbound(
     bridge_interface_t *      bridge_interface);
 
-// Register IGMP interest for an interface
+// Apply the requested outbound state of an interface without updating the
+// fanout lists
+extern void interface_apply_update(
+    bridge_interface_t *        bridge_interface);
+
+// Add an interface to the interface list of its bridge instance and activate
+// it, without updating the fanout lists
+extern void interface_apply_add(
+    bridge_interface_t *        bridge_interface);
+
+// Deactivate an interface and remove it from the interface list of its bridge
+// instance, without updating the fanout lists
+extern void interface_apply_remove(
+    bridge_interface_t *        bridge_interface);
+
+// Set the source filter for a group on an outbound interface
+extern void interface_set_source_filter(
+    bridge_interface_t *        bridge_interface,
+    const void *                mcast_addr,
+    const void *                source_list,
+    unsigned int                source_count);
+
+// Change the outbound rate limit of a rate limited interface
+extern void interface_set_rate_limit(
+    bridge_interface_t *        bridge_interface,
+    uint64_t                    rate_limit);
+
+// Change the duplicate suppression window of a bridge instance
+extern void interface_set_duplicate_window(
+    bridge_instance_t *         bridge,
+    unsigned int                duplicate_window);
+
+// Is a source address permitted by a source filter?
+extern int interface_source_allowed(
+    const bridge_source_filter_t * filter,
+    const void *                src_addr);
+
+// Rebuild and publish the outbound fanout lists for a bridge instance
+extern void interface_update_fanout(
+    bridge_instance_t *         bridge);
+
+// Register IGMP interest in a group for an interface
 extern void igmp_register_interface(
-    bridge_interface_t *      bridge_interface);
+    bridge_interface_t *      bridge_interface,
+    const struct in_addr *    mcast_addr);
 
-// Register IGMP interest for an interface
+// Register MLD interest in a group for an interface
 extern void mld_register_interface(
-    bridge_interface_t *      bridge_interface);
+    bridge_interface_t *      bridge_interface,
+    const struct in6_addr *   mcast_addr);
+
+// Register IGMP interest in a group for an interface after startup
+extern void igmp_add_interface(
+    bridge_interface_t *        bridge_interface,
+    const struct in_addr *      mcast_addr);
+
+// Remove an interface from IGMP monitoring
+extern void igmp_remove_interface(
+    bridge_interface_t *        bridge_interface);
+
+// Register MLD interest in a group for an interface after startup
+extern void mld_add_interface(
+    bridge_interface_t *        bridge_interface,
+    const struct in6_addr *     mcast_addr);
+
+// Remove an interface from MLD monitoring
+extern void mld_remove_interface(
+    bridge_interface_t *        bridge_interface);
 
 // Create an event manager instance
 void * evm_create(
@@ -227,9 +684,40 @@ extern void evm_add_socket(
     evm_callback_t              callback,
     void *                      closure);
 
-// Add a timer to the event manager
+// Add a drain socket to the event manager
+extern void evm_add_drain_socket(
+    evm_t *                     evm,
+    int                         fd,
+    evm_drain_callback_t        callback,
+    void *                      closure,
+    unsigned int                budget);
+
+// Grow an event manager to hold at least the given number of sockets and timers
+extern void evm_grow(
+    evm_t *                     evm,
+    int                         max_socket_count,
+    int                         max_timer_count);
+
+// Delete a socket from the event manager
+extern void evm_del_socket(
+    evm_t *                     evm,
+    int                         fd);
+
+// Set or clear busy poll mode
+extern void evm_set_busy_poll(
+    evm_t *                     evm,
+    unsigned int                busy_poll);
+
+// Run a function on the thread running the event manager loop
+extern void evm_call(
+    evm_t *                     evm,
+    evm_callback_t              callback,
+    void *                      closure);
+
+// Add a timer to the event manager, or reschedule it if already scheduled
 extern void evm_add_timer(
     evm_t *                     evm,
+    evm_timer_t *               timer,
     unsigned int                millis,
     evm_callback_t              callback,
     void *                      closure);
@@ -237,8 +725,7 @@ extern void evm_add_timer(
 // Delete a timer from the event manager
 extern void evm_del_timer(
     evm_t *                     evm,
-    evm_callback_t              callback,
-    void *                      closure);
+    evm_timer_t *               timer);
 
 // Event manager loop
 __attribute__ ((noreturn))
@@ -264,11 +751,128 @@ extern void start_mld(void);
 // The main bridge loops
 extern void start_bridges(void);
 
+// Add an interface to a running bridge instance
+extern void bridge_add_interface(
+    bridge_interface_t *        bridge_interface);
+
+// Remove an interface from a running bridge instance
+extern void bridge_remove_interface(
+    bridge_interface_t *        bridge_interface);
+
+// Assign a bridge instance to a worker after startup
+extern void bridge_add_bridge(
+    bridge_instance_t *         bridge);
+
+// Remove a bridge instance from its worker
+extern void bridge_remove_bridge(
+    bridge_instance_t *         bridge);
+
+// Post an updated interface to the worker that owns a bridge instance
+extern void bridge_post_update(
+    bridge_instance_t *         bridge,
+    bridge_interface_t *        bridge_interface);
+
+// Apply a changed rate limit to the rate limit queue of an interface
+extern unsigned int bridge_update_shaper(
+    bridge_interface_t *        bridge_interface);
+
+// Apply a changed duplicate window to the duplicate suppression table of a
+// bridge instance
+extern void bridge_update_dedup(
+    bridge_instance_t *         bridge);
+
+// Log the forwarding statistics
+extern void stats_log(void);
+
+// Get the current time for latency recording, in nanoseconds
+extern uint64_t latency_now(void);
+
+// Record the forwarding latency of a packet received at rx_time
+extern void latency_record(
+    bridge_latency_t *          latency,
+    uint64_t                    rx_time,
+    uint64_t                    now);
+
+// Initialize and start the statistics socket
+extern void initialize_stats(void);
+extern void start_stats(void);
+
+// Create the packet ring for an interface
+extern void packet_ring_create(
+    bridge_interface_t *        bridge_interface);
+
+// Add the packet ring for an interface to an event manager
+extern void packet_ring_register(
+    evm_t *                     evm,
+    bridge_interface_t *        bridge_interface);
+
+// Initialize the XDP dataplane
+extern void xdp_initialize(void);
+
+// Create the io_uring engine for a bridge
+extern void uring_create(
+    bridge_instance_t *         bridge);
+
+// Add the io_uring engine for a bridge to an event manager
+extern void uring_register_bridge(
+    evm_t *                     evm,
+    bridge_instance_t *         bridge);
+
+// Synchronize the XDP device map of an interface with its fanout list
+extern void xdp_update_devmap(
+    bridge_interface_t *        bridge_interface);
+
+// Initialize and start the kernel dataplane
+extern void mroute_initialize(void);
+extern void start_mroute(void);
+
+// Synchronize the kernel forwarding entries of a bridge instance with its fanout lists
+extern void mroute_update_bridge(
+    bridge_instance_t *         bridge);
+
 // Calculate the relative number of milliseconds between ts1 and ts2
 extern long timespec_delta_millis(
     const struct timespec *     ts1,
     const struct timespec *     ts2);
 
+// Add a number of milliseconds to a timespec
+extern void timespec_add_millis(
+    struct timespec *           ts,
+    unsigned int                millis);
+
+// Calculate a hash of an address
+uint32_t addr_hash(
+    const uint8_t *             addr,
+    unsigned int                len);
+
+// Internet checksum implementation
+typedef struct
+{
+    const char *                name;
+    uint64_t                    (*partial)(uint64_t sum, const void * data, unsigned int len);
+} inet_csum_impl_t;
+
+// Get a checksum implementation supported by the CPU
+const inet_csum_impl_t * inet_csum_impl(
+    unsigned int                index);
+
+// Select the checksum implementation
+void inet_csum_select(
+    const inet_csum_impl_t *    impl);
+
+// Select the preferred checksum implementation supported by the CPU
+void initialize_inet_csum(void);
+
+// Add data to a partial internet checksum
+uint64_t inet_csum_partial(
+    uint64_t                    sum,
+    const void *                data,
+    unsigned int                len);
+
+// Fold a partial internet checksum into 16 bits
+uint16_t inet_csum_fold(
+    uint64_t                    sum);
+
 // Calculate an internet checksum
 uint16_t inet_csum(
     const uint16_t *            addr,
@@ -30,14 +30,18 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
+#include <setjmp.h>
 #include <ctype.h>
 #include <ifaddrs.h>
 #include <errno.h>
+#include <unistd.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 
 #if defined(__FreeBSD__) || defined (__APPLE__)
 # define USE_SOCKADDR_DL
@@ -52,7 +56,18 @@
 // Limits for internal configuration arrays
 #define MAX_INPUT_LINE                  16384
 #define MAX_LIST_ARRAY                  1024
-#define MAX_INTERFACES                  64
+#define MAX_GROUPS                      64
+
+// Minimum configurable maximum packet size
+#define MIN_MAX_PACKET_SIZE             64
+
+// Duplicate suppression window range (milliseconds)
+#define MIN_DUPLICATE_WINDOW            1
+#define MAX_DUPLICATE_WINDOW            10000
+
+// Outbound rate limit range (bits per second)
+#define MIN_RATE_LIMIT                  64000ULL
+#define MAX_RATE_LIMIT                  100000000000ULL
 
 // Keys for configuration sections
 #define KEY_IPV4_ADDRESS                "ipv4-address"
@@ -61,6 +76,37 @@
 #define KEY_OUTBOUND_INTERFACES         "outbound-interfaces"
 #define KEY_STATIC_INBOUND_INTERFACES   "static-inbound-interfaces"
 #define KEY_STATIC_OUTBOUND_INTERFACES  "static-outbound-interfaces"
+#define KEY_UDP_OFFLOAD                 "udp-offload"
+#define KEY_CPU                         "cpu"
+#define KEY_DATAPLANE                   "dataplane"
+#define KEY_OUTBOUND_RATE_LIMIT         "outbound-rate-limit"
+#define KEY_MODE                        "mode"
+#define KEY_MAX_PACKET_SIZE             "max-packet-size"
+#define KEY_DUPLICATE_WINDOW            "duplicate-window"
+#define KEY_DUPLICATE_MATCH_SOURCE      "duplicate-match-source"
+
+// Dataplane names
+#define DATAPLANE_NAME_SOCKET           "socket"
+#define DATAPLANE_NAME_PACKET_RING      "packet-ring"
+#define DATAPLANE_NAME_XDP              "xdp"
+#define DATAPLANE_NAME_IO_URING         "io-uring"
+#define DATAPLANE_NAME_KERNEL           "kernel"
+
+#define MODE_NAME_EVENT                 "event"
+#define MODE_NAME_BUSY_POLL             "busy-poll"
+
+#define CPU_NAME_AUTO                   "auto"
+
+// Keys for global options
+#define KEY_THREADS                     "threads"
+#define KEY_STATS_SOCKET                "stats-socket"
+#define KEY_DEBUG_LOG_SAMPLE            "debug-log-sample"
+#define KEY_DEBUG_LOG_RATE              "debug-log-rate"
+
+// Limits for global options
+#define MAX_THREADS                     1024
+#define MAX_DEBUG_LOG_SAMPLE            1000000
+#define MAX_DEBUG_LOG_RATE              1000000
 
 // Determine if an address is an IPv4 Link Local address (169.254.0.0/16)
 #define MCB_ADDR_IS_IPV4_LL(addr)       ((ntohl(addr) & 0xffff0000) == 0xa9fe0000)
@@ -83,9 +129,11 @@ typedef struct draft_interface
 {
     char *                      name;
     unsigned int                if_index;
+    unsigned int                mtu;
 
     interface_config_type_t     inbound_configuration;
     interface_config_type_t     outbound_configuration;
+    uint64_t                    rate_limit;
 
     unsigned int                has_ipv4_addr;
     unsigned int                has_ipv4_addr_ll;
@@ -104,14 +152,27 @@ typedef struct draft_interface
 // Draft bridge structure
 typedef struct draft_bridge
 {
+    unsigned int                section;
     unsigned short              port;
-    unsigned int                has_ipv4_mcast_addr;
-    unsigned int                has_ipv6_mcast_addr;
-
-    struct in_addr              ipv4_mcast_addr;
-    struct in6_addr             ipv6_mcast_addr;
-
-    draft_interface_t           interfaces[MAX_INTERFACES];
+    unsigned short              port_last;
+    unsigned int                ipv4_mcast_addr_count;
+    unsigned int                ipv6_mcast_addr_count;
+
+    struct in_addr              ipv4_mcast_addr[MAX_GROUPS];
+    struct in6_addr             ipv6_mcast_addr[MAX_GROUPS];
+
+    dataplane_type_t            dataplane;
+    unsigned int                udp_offload;
+    unsigned int                busy_poll;
+    unsigned int                max_packet_size;
+    unsigned int                duplicate_window;
+    unsigned int                duplicate_match_source;
+    unsigned int                has_cpu;
+    unsigned int                cpu;
+    unsigned int                cpu_auto;
+
+    draft_interface_t *         interfaces;
+    unsigned int                interface_allocated;
     unsigned int                interface_count;
 
     unsigned int                inbound_ipv4_count;
@@ -125,18 +186,174 @@ typedef struct draft_bridge
     draft_interface_t *         last_outbound_ipv6_interface;
 } draft_bridge_t;
 
+// Parsed configuration
+typedef struct parsed_config
+{
+    bridge_instance_t **        bridge_list;
+    unsigned int                bridge_list_allocated;
+    unsigned int                bridge_list_count;
+
+    unsigned int                worker_thread_count;
+    const char *                stats_socket_path;
+    unsigned int                debug_log_sample;
+    unsigned int                debug_log_rate;
+} parsed_config_t;
+
 
-// OS ifaddrs list
+// Entry of the ifaddrs index
+typedef struct ifaddr_index_entry
+{
+    struct ifaddrs *            ifaddr;
+    unsigned int                position;
+} ifaddr_index_entry_t;
+
+
+// OS ifaddrs list, and an index of the list sorted by interface name
 static struct ifaddrs *         ifaddr_list;
+static ifaddr_index_entry_t *   ifaddr_index = NULL;
+static unsigned int             ifaddr_index_count = 0;
 
 // Current configuration line
 static unsigned int             config_lineno = 0;
 
+// Configuration file and draft bridge being parsed
+static FILE *                   config_fp = NULL;
+static draft_bridge_t           draft_bridge;
+
+// Where to resume when the configuration file is invalid (NULL if errors in the
+// file are fatal)
+static jmp_buf *                config_error_jmp = NULL;
+
 // Bridge list (finalized configuration)
-bridge_instance_t *             bridge_list = NULL;
+bridge_instance_t **            bridge_list = NULL;
 unsigned int                    bridge_list_allocated = 0;
 unsigned int                    bridge_list_count = 0;
 
+// Lock for changes to the bridge list after startup
+pthread_mutex_t                 bridge_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+//
+// Report an error in the configuration file
+//
+// Errors are fatal, except while reloading, when the error is logged and
+// parsing is abandoned.
+//
+__attribute__ ((noreturn, format (printf, 1, 2)))
+static void config_error(
+    const char *                format,
+    ...)
+{
+    char                        message[1024];
+    va_list                     args;
+
+    va_start(args, format);
+    (void) vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    if (config_error_jmp)
+    {
+        logger("%s", message);
+        longjmp(*config_error_jmp, 1);
+    }
+
+    fatal("%s", message);
+}
+
+
+//
+// Compare two ifaddrs index entries
+//
+// NB: Entries of the same interface are kept in list order so that the first
+//     address of each type in the list is the one selected.
+//
+static int compare_ifaddr_index_entries(
+    const void *                a,
+    const void *                b)
+{
+    const ifaddr_index_entry_t * entry_a = a;
+    const ifaddr_index_entry_t * entry_b = b;
+    int                         r;
+
+    r = strcmp(entry_a->ifaddr->ifa_name, entry_b->ifaddr->ifa_name);
+    if (r == 0)
+    {
+        r = (entry_a->position > entry_b->position) - (entry_a->position < entry_b->position);
+    }
+
+    return r;
+}
+
+
+//
+// Build the ifaddrs index
+//
+static void build_ifaddr_index(void)
+{
+    struct ifaddrs *            ifaddr_ptr;
+    unsigned int                count = 0;
+
+    for (ifaddr_ptr = ifaddr_list; ifaddr_ptr != NULL; ifaddr_ptr = ifaddr_ptr->ifa_next)
+    {
+        count += 1;
+    }
+
+    ifaddr_index_count = 0;
+    ifaddr_index = NULL;
+    if (count == 0)
+    {
+        return;
+    }
+
+    ifaddr_index = calloc(count, sizeof(ifaddr_index_entry_t));
+    if (ifaddr_index == NULL)
+    {
+        fatal("Cannot allocate memory for ifaddrs index: %s\n", strerror(errno));
+    }
+    for (ifaddr_ptr = ifaddr_list; ifaddr_ptr != NULL; ifaddr_ptr = ifaddr_ptr->ifa_next)
+    {
+        ifaddr_index[ifaddr_index_count].ifaddr = ifaddr_ptr;
+        ifaddr_index[ifaddr_index_count].position = ifaddr_index_count;
+        ifaddr_index_count += 1;
+    }
+
+    qsort(ifaddr_index, ifaddr_index_count, sizeof(ifaddr_index_entry_t), compare_ifaddr_index_entries);
+}
+
+
+//
+// Find the first ifaddrs index entry of an interface
+//
+// Returns ifaddr_index_count if the interface is not in the index
+//
+static unsigned int find_ifaddr_index_entry(
+    const char *                name)
+{
+    unsigned int                low = 0;
+    unsigned int                high = ifaddr_index_count;
+    unsigned int                middle;
+
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        if (strcmp(ifaddr_index[middle].ifaddr->ifa_name, name) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low < ifaddr_index_count && strcmp(ifaddr_index[low].ifaddr->ifa_name, name) == 0)
+    {
+        return low;
+    }
+
+    return ifaddr_index_count;
+}
 
 
 //
@@ -149,16 +366,19 @@ static draft_interface_t * add_draft_interface(
     draft_interface_t *         interface;
     unsigned int                if_index;
     unsigned int                interface_index;
+    unsigned int                entry_index;
     struct ifaddrs *            ifaddr_ptr;
     struct sockaddr *           sa;
     struct sockaddr_in *        sin;
     struct sockaddr_in6 *       sin6;
+    struct ifreq                ifr;
+    int                         sock;
 
     // Get the interface index
     if_index = if_nametoindex(name);
     if (if_index == 0)
     {
-        fatal("%s line %u: Interface \"%s\" does not exist\n", config_filename, config_lineno, name);
+        config_error("%s line %u: Interface \"%s\" does not exist\n", config_filename, config_lineno, name);
     }
 
     // Is the interface already in the list?
@@ -172,10 +392,23 @@ static draft_interface_t * add_draft_interface(
         }
     }
 
-    // Safety check
-    if (draft_bridge->interface_count >= MAX_INTERFACES)
+    // Grow the list if necessary
+    if (draft_bridge->interface_count >= draft_bridge->interface_allocated)
     {
-        fatal("%s line %u: Maximum number of interfaces (%u) exceeded\n", config_filename, config_lineno, MAX_INTERFACES);
+        if (draft_bridge->interface_allocated == 0)
+        {
+            draft_bridge->interface_allocated = 8;
+        }
+        else
+        {
+            draft_bridge->interface_allocated *= 2;
+        }
+
+        draft_bridge->interfaces = realloc(draft_bridge->interfaces, draft_bridge->interface_allocated * sizeof(draft_interface_t));
+        if (draft_bridge->interfaces == NULL)
+        {
+            fatal("Cannot allocate memory for draft interface list: %s\n", strerror(errno));
+        }
     }
 
     // Add a new interface to the list
@@ -191,101 +424,116 @@ static draft_interface_t * add_draft_interface(
         fatal("Cannot allocate memory: %s\n", strerror(errno));
     }
 
-    // Search the ifaddr list for the interface
-    for (ifaddr_ptr = ifaddr_list; ifaddr_ptr != NULL; ifaddr_ptr = ifaddr_ptr->ifa_next)
+    // Get the interface MTU
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == -1)
     {
-        if (strcmp(ifaddr_ptr->ifa_name, name) == 0)
+        config_error("socket creation failed: %s\n", strerror(errno));
+    }
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, name, sizeof(ifr.ifr_name) - 1);
+    if (ioctl(sock, SIOCGIFMTU, &ifr) == -1)
+    {
+        config_error("%s line %u: Cannot get the MTU of interface \"%s\": %s\n", config_filename, config_lineno, name, strerror(errno));
+    }
+    interface->mtu = (unsigned int) ifr.ifr_mtu;
+    close(sock);
+
+    // Search the ifaddr index for the interface
+    for (entry_index = find_ifaddr_index_entry(name);
+         entry_index < ifaddr_index_count && strcmp(ifaddr_index[entry_index].ifaddr->ifa_name, name) == 0;
+         entry_index += 1)
+    {
+        ifaddr_ptr = ifaddr_index[entry_index].ifaddr;
+        sa = ifaddr_ptr->ifa_addr;
+        if (sa)
         {
-            sa = ifaddr_ptr->ifa_addr;
-            if (sa)
+            // Confirm the interface is up and supports multicast
+            if ((ifaddr_ptr->ifa_flags & IFF_UP) == 0)
             {
-                // Confirm the interface is up and supports multicast
-                if ((ifaddr_ptr->ifa_flags & IFF_UP) == 0)
-                {
-                    fatal("%s line %u: Interface \"%s\" is not up\n", config_filename, config_lineno, interface->name);
-                }
-                if ((ifaddr_ptr->ifa_flags & IFF_MULTICAST) == 0)
-                {
-                    fatal("%s line %u: Interface \"%s\" does not support multicast\n", config_filename, config_lineno, interface->name);
-                }
+                config_error("%s line %u: Interface \"%s\" is not up\n", config_filename, config_lineno, interface->name);
+            }
+            if ((ifaddr_ptr->ifa_flags & IFF_MULTICAST) == 0)
+            {
+                config_error("%s line %u: Interface \"%s\" does not support multicast\n", config_filename, config_lineno, interface->name);
+            }
 
-                // Save the MAC address
+            // Save the MAC address
 #if defined(USE_SOCKADDR_DL)
-                if (sa->sa_family == AF_LINK)
-                {
-                    struct sockaddr_dl * sdl = (struct sockaddr_dl *) sa;
-                    uint8_t * mac = (uint8_t *) LLADDR(sdl);
-                    memcpy(interface->mac_addr, mac, sizeof(interface->mac_addr));
-                    continue;
-                }
+            if (sa->sa_family == AF_LINK)
+            {
+                struct sockaddr_dl * sdl = (struct sockaddr_dl *) sa;
+                uint8_t * mac = (uint8_t *) LLADDR(sdl);
+                memcpy(interface->mac_addr, mac, sizeof(interface->mac_addr));
+                continue;
+            }
 #else
-                if (sa->sa_family == AF_PACKET)
-                {
-                    struct sockaddr_ll * sll = (struct sockaddr_ll *) sa;
-                    uint8_t * mac = (uint8_t *) sll->sll_addr;
-                    memcpy(interface->mac_addr, mac, sizeof(interface->mac_addr));
-                    continue;
-                }
+            if (sa->sa_family == AF_PACKET)
+            {
+                struct sockaddr_ll * sll = (struct sockaddr_ll *) sa;
+                uint8_t * mac = (uint8_t *) sll->sll_addr;
+                memcpy(interface->mac_addr, mac, sizeof(interface->mac_addr));
+                continue;
+            }
 #endif
 
-                // Save IPv4 addresses
-                if (sa->sa_family == AF_INET)
-                {
-                    sin = (struct sockaddr_in *) sa;
+            // Save IPv4 addresses
+            if (sa->sa_family == AF_INET)
+            {
+                sin = (struct sockaddr_in *) sa;
 
-                    // Is it a link local address?
-                    if (MCB_ADDR_IS_IPV4_LL(sin->sin_addr.s_addr))
+                // Is it a link local address?
+                if (MCB_ADDR_IS_IPV4_LL(sin->sin_addr.s_addr))
+                {
+                    if (interface->has_ipv4_addr_ll == 0)
                     {
-                        if (interface->has_ipv4_addr_ll == 0)
-                        {
-                            // Save the link-local address
-                            memcpy(&interface->ipv4_addr_ll, &sin->sin_addr, sizeof(interface->ipv4_addr_ll));
-                            interface->has_ipv4_addr_ll = 1;
-                        }
+                        // Save the link-local address
+                        memcpy(&interface->ipv4_addr_ll, &sin->sin_addr, sizeof(interface->ipv4_addr_ll));
+                        interface->has_ipv4_addr_ll = 1;
                     }
-                    else
+                }
+                else
+                {
+                    if (interface->has_ipv4_addr == 0)
                     {
-                        if (interface->has_ipv4_addr == 0)
-                        {
-                            // Save the routable address
-                            memcpy(&interface->ipv4_addr, &sin->sin_addr, sizeof(interface->ipv4_addr));
-                            interface->has_ipv4_addr = 1;
-                        }
+                        // Save the routable address
+                        memcpy(&interface->ipv4_addr, &sin->sin_addr, sizeof(interface->ipv4_addr));
+                        interface->has_ipv4_addr = 1;
                     }
-                    continue;
                 }
+                continue;
+            }
 
-                // Save IPv6 addresses
-                if (sa->sa_family == AF_INET6)
-                {
-                    sin6 = (struct sockaddr_in6 *) sa;
+            // Save IPv6 addresses
+            if (sa->sa_family == AF_INET6)
+            {
+                sin6 = (struct sockaddr_in6 *) sa;
 
-                    if (MCB_ADDR_IS_IPV6_LL(sin6->sin6_addr.s6_addr))
+                if (MCB_ADDR_IS_IPV6_LL(sin6->sin6_addr.s6_addr))
+                {
+                    if (interface->has_ipv6_addr_ll == 0)
                     {
-                        if (interface->has_ipv6_addr_ll == 0)
-                        {
-                            // Save the link-local address
-                            memcpy(&interface->ipv6_addr_ll, &sin6->sin6_addr, sizeof(interface->ipv6_addr_ll));
-                            interface->has_ipv6_addr_ll = 1;
-                        }
+                        // Save the link-local address
+                        memcpy(&interface->ipv6_addr_ll, &sin6->sin6_addr, sizeof(interface->ipv6_addr_ll));
+                        interface->has_ipv6_addr_ll = 1;
                     }
-                    else if (MCB_ADDR_IS_IPV6_ULA(sin6->sin6_addr.s6_addr))
+                }
+                else if (MCB_ADDR_IS_IPV6_ULA(sin6->sin6_addr.s6_addr))
+                {
+                    if (interface->has_ipv6_addr_ula == 0)
                     {
-                        if (interface->has_ipv6_addr_ula == 0)
-                        {
-                            // Save the unique-local address
-                            memcpy(&interface->ipv6_addr_ula, &sin6->sin6_addr, sizeof(interface->ipv6_addr_ula));
-                            interface->has_ipv6_addr_ula = 1;
-                        }
+                        // Save the unique-local address
+                        memcpy(&interface->ipv6_addr_ula, &sin6->sin6_addr, sizeof(interface->ipv6_addr_ula));
+                        interface->has_ipv6_addr_ula = 1;
                     }
-                    else
+                }
+                else
+                {
+                    if (interface->has_ipv6_addr == 0)
                     {
-                        if (interface->has_ipv6_addr == 0)
-                        {
-                            // Save the global address
-                            memcpy(&interface->ipv6_addr, &sin6->sin6_addr, sizeof(interface->ipv6_addr));
-                            interface->has_ipv6_addr = 1;
-                        }
+                        // Save the global address
+                        memcpy(&interface->ipv6_addr, &sin6->sin6_addr, sizeof(interface->ipv6_addr));
+                        interface->has_ipv6_addr = 1;
                     }
                 }
             }
@@ -320,7 +568,7 @@ static draft_interface_t * add_draft_interface(
     // Ensure the interface has at least one IP address
     if (interface->has_ipv4_addr == 0 && interface->has_ipv6_addr == 0)
     {
-        fatal("%s line %u: Interface \"%s\" does not have an IP address\n", config_filename, config_lineno, name);
+        config_error("%s line %u: Interface \"%s\" does not have an IP address\n", config_filename, config_lineno, name);
     }
 
     return interface;
@@ -340,14 +588,69 @@ static void validate_draft_bridge(
     unsigned int                interface_index;
 
     // Ensure the bridge has at least one multicast group address
-    if (draft_bridge->has_ipv4_mcast_addr == 0 && draft_bridge->has_ipv6_mcast_addr == 0)
+    if (draft_bridge->ipv4_mcast_addr_count == 0 && draft_bridge->ipv6_mcast_addr_count == 0)
+    {
+        config_error("Bridge %u does not have a multicast group address\n", draft_bridge->port);
+    }
+
+    // Multiple groups are only supported by the socket dataplane
+    if (draft_bridge->ipv4_mcast_addr_count > 1 || draft_bridge->ipv6_mcast_addr_count > 1)
+    {
+#if defined(USE_GROUP_LIST)
+        if (draft_bridge->dataplane != DATAPLANE_SOCKET)
+        {
+            config_error("Bridge %u: Multiple multicast group addresses cannot be used with the %s dataplane\n",
+                draft_bridge->port, dataplane_type_to_string(draft_bridge->dataplane));
+        }
+#else
+        config_error("Bridge %u: Multiple multicast group addresses are not supported on this platform\n", draft_bridge->port);
+#endif
+    }
+
+    // UDP offload only applies to the socket dataplane
+    if (draft_bridge->udp_offload && draft_bridge->dataplane != DATAPLANE_SOCKET)
     {
-        fatal("Bridge %u does not have a multicast group address\n", draft_bridge->port);
+        config_error("Bridge %u: UDP offload cannot be used with the %s dataplane\n",
+            draft_bridge->port, dataplane_type_to_string(draft_bridge->dataplane));
+    }
+
+    // Duplicate suppression only applies to the socket dataplane, and cannot
+    // identify datagrams within coalesced packets
+    if (draft_bridge->duplicate_window)
+    {
+        if (draft_bridge->dataplane != DATAPLANE_SOCKET)
+        {
+            config_error("Bridge %u: Duplicate suppression cannot be used with the %s dataplane\n",
+                draft_bridge->port, dataplane_type_to_string(draft_bridge->dataplane));
+        }
+        if (draft_bridge->udp_offload)
+        {
+            config_error("Bridge %u: Duplicate suppression cannot be used with UDP offload\n", draft_bridge->port);
+        }
+    }
+    else if (draft_bridge->duplicate_match_source)
+    {
+        config_error("Bridge %u: %s requires %s\n", draft_bridge->port, KEY_DUPLICATE_MATCH_SOURCE, KEY_DUPLICATE_WINDOW);
     }
 
     // Count the number of inbound and outbound interfaces
     for (interface_index = 0; interface_index < draft_bridge->interface_count; interface_index += 1)
     {
+        // Rate limits only apply to outbound interfaces of the socket dataplane
+        if (draft_bridge->interfaces[interface_index].rate_limit)
+        {
+            if (draft_bridge->interfaces[interface_index].outbound_configuration == INTERFACE_CONFIG_NONE)
+            {
+                config_error("Bridge %u: Rate limited interface %s is not an outbound interface\n",
+                    draft_bridge->port, draft_bridge->interfaces[interface_index].name);
+            }
+            if (draft_bridge->dataplane != DATAPLANE_SOCKET)
+            {
+                config_error("Bridge %u: Outbound rate limits cannot be used with the %s dataplane\n",
+                    draft_bridge->port, dataplane_type_to_string(draft_bridge->dataplane));
+            }
+        }
+
         if (draft_bridge->interfaces[interface_index].inbound_configuration != INTERFACE_CONFIG_NONE)
         {
             inbound_count += 1;
@@ -384,11 +687,11 @@ static void validate_draft_bridge(
     // Ensure the bridge has at least one inbound and outbound interface
     if (inbound_count == 0)
     {
-        fatal("Bridge %u does not have any inbound interfaces\n", draft_bridge->port);
+        config_error("Bridge %u does not have any inbound interfaces\n", draft_bridge->port);
     }
     if (outbound_count == 0)
     {
-        fatal("Bridge %u does not have any outbound interfaces\n", draft_bridge->port);
+        config_error("Bridge %u does not have any outbound interfaces\n", draft_bridge->port);
     }
 
     // If there is only one inbound interface, ensure it not listed as an outbound interface
@@ -396,7 +699,7 @@ static void validate_draft_bridge(
     {
         if (last_inbound_interface->outbound_configuration != INTERFACE_CONFIG_NONE)
         {
-            fatal("Bridge %u has a single inbound interface (%s) which is also declared as an outbound interface\n",
+            config_error("Bridge %u has a single inbound interface (%s) which is also declared as an outbound interface\n",
             draft_bridge->port, last_inbound_interface->name);
         }
     }
@@ -406,48 +709,48 @@ static void validate_draft_bridge(
     {
         if (last_outbound_interface->inbound_configuration != INTERFACE_CONFIG_NONE)
         {
-            fatal("Bridge %u has a single outbound interface (%s) which is also declared as an inbound interface\n",
+            config_error("Bridge %u has a single outbound interface (%s) which is also declared as an inbound interface\n",
             draft_bridge->port, last_outbound_interface->name);
         }
     }
 
     // If using IPv4, ensure we have at least one unique inbound and outbound interface with an IPv4 address
-    if (draft_bridge->has_ipv4_mcast_addr)
+    if (draft_bridge->ipv4_mcast_addr_count)
     {
         if (draft_bridge->inbound_ipv4_count == 0)
         {
-            fatal("Bridge %u has an IPv4 multicast group address, but does not have an IPv4 enabled inbound interface\n", draft_bridge->port);
+            config_error("Bridge %u has an IPv4 multicast group address, but does not have an IPv4 enabled inbound interface\n", draft_bridge->port);
         }
         if (draft_bridge->outbound_ipv4_count == 0)
         {
-            fatal("Bridge %u has an IPv4 multicast group address, but does not have an IPv4 enabled outbound interface\n", draft_bridge->port);
+            config_error("Bridge %u has an IPv4 multicast group address, but does not have an IPv4 enabled outbound interface\n", draft_bridge->port);
         }
         if (draft_bridge->inbound_ipv4_count == 1 && draft_bridge->outbound_ipv4_count == 1)
         {
             if (draft_bridge->last_inbound_ipv4_interface == draft_bridge->last_outbound_ipv4_interface)
             {
-                fatal("Bridge %u has an IPv4 multicast group address, but has only one IPv4 enabled interface (%s)\n",
+                config_error("Bridge %u has an IPv4 multicast group address, but has only one IPv4 enabled interface (%s)\n",
                     draft_bridge->port, draft_bridge->last_inbound_ipv4_interface->name);
             }
         }
     }
 
     // If using IPv6, ensure we have at least one unique inbound and outbound interface with an IPv6 address
-    if (draft_bridge->has_ipv6_mcast_addr)
+    if (draft_bridge->ipv6_mcast_addr_count)
     {
         if (draft_bridge->inbound_ipv6_count == 0)
         {
-            fatal("Bridge %u has an IPv6 multicast group address, but does not have an IPv6 enabled inbound interface\n", draft_bridge->port);
+            config_error("Bridge %u has an IPv6 multicast group address, but does not have an IPv6 enabled inbound interface\n", draft_bridge->port);
         }
         if (draft_bridge->outbound_ipv6_count == 0)
         {
-            fatal("Bridge %u has an IPv6 multicast group address, but does not have an IPv6 enabled outbound interface\n", draft_bridge->port);
+            config_error("Bridge %u has an IPv6 multicast group address, but does not have an IPv6 enabled outbound interface\n", draft_bridge->port);
         }
         if (draft_bridge->inbound_ipv6_count == 1 && draft_bridge->outbound_ipv6_count == 1)
         {
             if (draft_bridge->last_inbound_ipv6_interface == draft_bridge->last_outbound_ipv6_interface)
             {
-                fatal("Bridge %u has an IPv6 multicast group address, but has only one IPv6 enabled interface (%s)\n",
+                config_error("Bridge %u has an IPv6 multicast group address, but has only one IPv6 enabled interface (%s)\n",
                     draft_bridge->port, draft_bridge->last_inbound_ipv6_interface->name);
             }
         }
@@ -459,16 +762,18 @@ static void validate_draft_bridge(
 // Add an IPv4 or IPv6 bridge based on a draft bridge
 //
 static void add_bridge(
+    parsed_config_t *           config,
     struct draft_bridge *       draft_bridge,
     unsigned int                family)
 {
-    unsigned int                bridge_index;
     bridge_instance_t *         bridge;
     bridge_interface_t *        interface;
     draft_interface_t *         draft_interface;
     unsigned int                draft_interface_index;
-    unsigned int                outbound_index;
-    unsigned int                inbound_index;
+    unsigned int                interface_index;
+    unsigned int                static_outbound_count;
+    unsigned int                group_index;
+    int                         r;
 
     // Sanity checks
     if (family == AF_INET)
@@ -487,51 +792,81 @@ static void add_bridge(
     }
 
     // Do we need to (re)allocate the bridge list?
-    if (bridge_list_count >= bridge_list_allocated)
+    if (config->bridge_list_count >= config->bridge_list_allocated)
     {
         // Determine the new allocation size
-        if (bridge_list_allocated == 0)
+        if (config->bridge_list_allocated == 0)
         {
-            bridge_list_allocated = 1;
+            config->bridge_list_allocated = 1;
         }
         else
         {
-            bridge_list_allocated *= 2;
+            config->bridge_list_allocated *= 2;
         }
 
-        bridge_list = realloc(bridge_list, bridge_list_allocated * sizeof(bridge_instance_t));
-        if (bridge_list == NULL)
+        config->bridge_list = realloc(config->bridge_list, config->bridge_list_allocated * sizeof(bridge_instance_t *));
+        if (config->bridge_list == NULL)
         {
             fatal("Cannot allocate memory for bridge list: %s\n", strerror(errno));
         }
     }
 
+    // Allocate the bridge
+    bridge = calloc(1, sizeof(bridge_instance_t));
+    if (bridge == NULL)
+    {
+        fatal("Cannot allocate memory for bridge: %s\n", strerror(errno));
+    }
+
     // Add the bridge
-    bridge_index = bridge_list_count;
-    bridge_list_count += 1;
+    config->bridge_list[config->bridge_list_count] = bridge;
+    config->bridge_list_count += 1;
 
     // Initialize the bridge
-    bridge = &bridge_list[bridge_index];
-    memset(bridge, 0, sizeof(*bridge));
     bridge->family = family;
     bridge->port = draft_bridge->port;
-    if (family == AF_INET)
+    bridge->section = draft_bridge->section;
+    bridge->dataplane = draft_bridge->dataplane;
+    bridge->udp_offload = draft_bridge->udp_offload;
+    bridge->busy_poll = draft_bridge->busy_poll;
+    bridge->max_packet_size = draft_bridge->max_packet_size;
+    bridge->duplicate_window = draft_bridge->duplicate_window;
+    bridge->duplicate_match_source = draft_bridge->duplicate_match_source;
+    bridge->cpu = draft_bridge->has_cpu ? (int) draft_bridge->cpu : -1;
+    if (draft_bridge->cpu_auto)
     {
-        bridge->dst_addr.sin.sin_family = family;
-        bridge->dst_addr.sin.sin_port = htons(draft_bridge->port);
-        memcpy(&bridge->dst_addr.sin.sin_addr, &draft_bridge->ipv4_mcast_addr, sizeof(struct in_addr));
-        bridge->dst_addr_len = sizeof(struct sockaddr_in);
+        bridge->cpu = BRIDGE_CPU_AUTO;
     }
-    else
+
+    // Allocate the group list
+    bridge->group_count = (family == AF_INET) ? draft_bridge->ipv4_mcast_addr_count : draft_bridge->ipv6_mcast_addr_count;
+    bridge->group_list = calloc(bridge->group_count, sizeof(socket_address_t));
+    if (bridge->group_list == NULL)
+    {
+        fatal("Cannot allocate memory for group list: %s\n", strerror(errno));
+    }
+
+    // Set the groups
+    for (group_index = 0; group_index < bridge->group_count; group_index += 1)
     {
-        bridge->dst_addr.sin6.sin6_family = AF_INET6;
-        bridge->dst_addr.sin6.sin6_port = htons(draft_bridge->port);
-        memcpy(&bridge->dst_addr.sin6.sin6_addr, &draft_bridge->ipv6_mcast_addr, sizeof(struct in6_addr));
-        bridge->dst_addr_len = sizeof(struct sockaddr_in6);
+        if (family == AF_INET)
+        {
+            bridge->group_list[group_index].sin.sin_family = family;
+            bridge->group_list[group_index].sin.sin_port = htons(draft_bridge->port);
+            memcpy(&bridge->group_list[group_index].sin.sin_addr, &draft_bridge->ipv4_mcast_addr[group_index], sizeof(struct in_addr));
+        }
+        else
+        {
+            bridge->group_list[group_index].sin6.sin6_family = AF_INET6;
+            bridge->group_list[group_index].sin6.sin6_port = htons(draft_bridge->port);
+            memcpy(&bridge->group_list[group_index].sin6.sin6_addr, &draft_bridge->ipv6_mcast_addr[group_index], sizeof(struct in6_addr));
+        }
     }
+    memcpy(&bridge->dst_addr, &bridge->group_list[0], sizeof(bridge->dst_addr));
+    bridge->dst_addr_len = (family == AF_INET) ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
 
     // Allocate the interface list
-    bridge->interface_list = calloc(draft_bridge->interface_count, sizeof(bridge_interface_t));
+    bridge->interface_list = calloc(draft_bridge->interface_count, sizeof(bridge_interface_t *));
     if (bridge->interface_list == NULL)
     {
         fatal("Failed to allocate interface list for %s bridge %u\n", family == AF_INET ? "IPv4" : "IPv6", draft_bridge->port);
@@ -558,15 +893,36 @@ static void add_bridge(
             }
         }
 
+        // The default maximum packet size is the largest inbound interface MTU
+        if (draft_bridge->max_packet_size == 0 && draft_interface->inbound_configuration != INTERFACE_CONFIG_NONE &&
+            draft_interface->mtu > bridge->max_packet_size)
+        {
+            bridge->max_packet_size = draft_interface->mtu;
+        }
+
+        // Allocate the interface on a cache line boundary (see bridge_interface_t)
+        r = posix_memalign((void **) &interface, CACHE_LINE_SIZE, sizeof(bridge_interface_t));
+        if (r != 0)
+        {
+            fatal("Failed to allocate interface %s for %s bridge %u\n", draft_interface->name,
+                family == AF_INET ? "IPv4" : "IPv6", draft_bridge->port);
+        }
+        memset(interface, 0, sizeof(bridge_interface_t));
+
         // Assign the interface
-        interface = &bridge->interface_list[bridge->interface_count];
+        bridge->interface_list[bridge->interface_count] = interface;
         bridge->interface_count += 1;
 
         // Assign the interface values
-        interface->bridge_index = bridge_index;
+        interface->bridge = bridge;
         interface->inbound_configuration = draft_interface->inbound_configuration;
         interface->outbound_configuration = draft_interface->outbound_configuration;
-        interface->name = draft_interface->name;
+        interface->rate_limit = draft_interface->rate_limit / 8;
+        interface->name = strdup(draft_interface->name);
+        if (interface->name == NULL)
+        {
+            fatal("Cannot allocate memory for interface name: %s\n", strerror(errno));
+        }
         interface->if_index = draft_interface->if_index;
         memcpy(interface->mac_addr, draft_interface->mac_addr, sizeof(interface->mac_addr));
         if (family == AF_INET)
@@ -580,22 +936,34 @@ static void add_bridge(
         }
     }
 
+    // Insure the maximum packet size is within range
+    if (bridge->max_packet_size < MIN_MAX_PACKET_SIZE)
+    {
+        bridge->max_packet_size = MIN_MAX_PACKET_SIZE;
+    }
+    else if (bridge->max_packet_size > MCAST_MAX_PACKET_SIZE)
+    {
+        bridge->max_packet_size = MCAST_MAX_PACKET_SIZE;
+    }
+
     // If an outbound interface is static, associated dynamic inbound interfaces are forced to static
-    for (outbound_index = 0; outbound_index < bridge->interface_count; outbound_index += 1)
+    static_outbound_count = 0;
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index += 1)
     {
-        if (bridge->interface_list[outbound_index].outbound_configuration == INTERFACE_CONFIG_STATIC)
+        if (bridge->interface_list[interface_index]->outbound_configuration == INTERFACE_CONFIG_STATIC)
         {
-            for (inbound_index = 0; inbound_index < bridge->interface_count; inbound_index += 1)
-            {
-                if (inbound_index == outbound_index)
-                {
-                    continue;
-                }
-                if (bridge->interface_list[inbound_index].inbound_configuration == INTERFACE_CONFIG_DYNAMIC)
-                {
-                    bridge->interface_list[inbound_index].inbound_configuration = INTERFACE_CONFIG_FORCED;
-                }
-            }
+            static_outbound_count += 1;
+        }
+    }
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index += 1)
+    {
+        interface = bridge->interface_list[interface_index];
+
+        // Is there a static outbound interface other than this one?
+        if (interface->inbound_configuration == INTERFACE_CONFIG_DYNAMIC &&
+            static_outbound_count > (interface->outbound_configuration == INTERFACE_CONFIG_STATIC ? 1u : 0u))
+        {
+            interface->inbound_configuration = INTERFACE_CONFIG_FORCED;
         }
     }
 }
@@ -652,7 +1020,7 @@ static char * split_keyvalue(
     value = strchr(line, '=');
     if (value == NULL)
     {
-        fatal("%s line %u: Syntax error - missing assignment\n", config_filename, config_lineno);
+        config_error("%s line %u: Syntax error - missing assignment\n", config_filename, config_lineno);
     }
     *value = '\0';
 
@@ -660,14 +1028,14 @@ static char * split_keyvalue(
     trim_trailing_whitespace(line);
     if (*line == '\0')
     {
-        fatal("%s line %u: Syntax error - missing key\n", config_filename, config_lineno);
+        config_error("%s line %u: Syntax error - missing key\n", config_filename, config_lineno);
     }
 
     // Trim the value and ensure it is not empty
     value = trim_leading_whitespace(value + 1);
     if (*value == '\0')
     {
-        fatal("%s line %u: Syntax error - missing value\n", config_filename, config_lineno);
+        config_error("%s line %u: Syntax error - missing value\n", config_filename, config_lineno);
     }
 
     return (value);
@@ -693,7 +1061,7 @@ static unsigned int split_comma_list(
         {
             if (index + 1 >= MAX_LIST_ARRAY)
             {
-                fatal("%s line %u: Invalid list - elements exceed max allowed (%u)\n", config_filename, config_lineno, MAX_LIST_ARRAY);
+                config_error("%s line %u: Invalid list - elements exceed max allowed (%u)\n", config_filename, config_lineno, MAX_LIST_ARRAY);
             }
 
             // Terminate the current element
@@ -703,14 +1071,14 @@ static unsigned int split_comma_list(
             // Ensure the current element is not empty
             if (*array[index] == '\0')
             {
-                fatal("%s line %u: Invalid list - empty element\n", config_filename, config_lineno);
+                config_error("%s line %u: Invalid list - empty element\n", config_filename, config_lineno);
             }
 
             // Insure the next element is not empty
             str = trim_leading_whitespace(str + 1);
             if (*str == '\0')
             {
-                fatal("%s line %u: Invalid list - empty element\n", config_filename, config_lineno);
+                config_error("%s line %u: Invalid list - empty element\n", config_filename, config_lineno);
             }
 
             // Add the new element to the array
@@ -760,217 +1128,1165 @@ static char * read_line(
 
 
 //
-// Read and process the config file
+// Parse a boolean (yes/no) value
 //
-void read_config(void)
+static unsigned int parse_boolean(
+    const char *                value)
 {
-    FILE *                      fp;
-    char                        buffer[MAX_INPUT_LINE];
-    char *                      list_array[MAX_LIST_ARRAY];
-    unsigned int                list_array_count;
-    unsigned int                list_array_index;
-    char *                      line;
-    char *                      value;
-    draft_bridge_t              draft_bridge;
-    draft_interface_t *         draft_interface;
-    unsigned long               lport;
-    unsigned int                len;
-    int                         r;
-
-    // Open the config file
-    fp = fopen(config_filename, "r");
-    if (fp == NULL)
+    if (strcmp(value, "yes") == 0)
     {
-        fatal("Unable to open config file \"%s\"\n", config_filename);
+        return 1;
     }
-
-    // Get the ifaddrs list
-    if (getifaddrs(&ifaddr_list) == -1)
+    if (strcmp(value, "no") == 0)
     {
-        fatal("getifaddrs failed: %s\n", strerror(errno));
+        return 0;
     }
 
-    // Process sections
-    line = read_line(fp, buffer);
-    while (line && line[0] == '[')
-    {
-        // Ignore leading whitespace
-        line = trim_leading_whitespace(line + 1);
+    config_error("%s line %u: Invalid boolean value \"%s\" (must be yes or no)\n", config_filename, config_lineno, value);
+}
 
-        // Ensure the section name (port number) is terminated
-        len = strlen(line);
-        if (len == 0 || line[len - 1] != ']')
-        {
-            fatal("%s line %u: Syntax error\n", config_filename, config_lineno);
-        }
-        line[len - 1] = '\0';
 
-        // Ignore trailing whitespace
-        trim_trailing_whitespace(line);
+//
+// Parse an unsigned number value
+//
+static unsigned int parse_number(
+    const char *                value,
+    unsigned long               min,
+    unsigned long               max)
+{
+    unsigned long               number = 0;
 
-        // Insure the port number is valid
-        lport = 0;
-        if (strlen(line) && strspn(line, "0123456789") == strlen(line))
-        {
-            lport = strtoul(line, NULL, 10);
-        }
-        if (lport < 1 || lport > 65535)
+    if (strspn(value, "0123456789") == strlen(value) && strlen(value) <= 10)
+    {
+        number = strtoul(value, NULL, 10);
+        if (number >= min && number <= max)
         {
-            fatal("%s line %u: Invalid port number\n", config_filename, config_lineno);
+            return (unsigned int) number;
         }
+    }
 
-        // Clear the draft bridge
-        memset(&draft_bridge, 0, sizeof(draft_bridge));
+    config_error("%s line %u: Invalid value \"%s\" (must be between %lu and %lu)\n", config_filename, config_lineno, value, min, max);
+}
 
-        // Set the port
-        draft_bridge.port = (unsigned short) lport;
 
-        // Read the rest of the bridge section
-        while ((line = read_line(fp, buffer)))
+//
+// Parse a rate value in bits per second, with an optional K, M or G suffix
+//
+static uint64_t parse_rate(
+    const char *                value)
+{
+    uint64_t                    rate = 0;
+    uint64_t                    multiplier = 1;
+    size_t                      len;
+
+    len = strspn(value, "0123456789");
+    if (len && len <= 12)
+    {
+        switch (value[len])
         {
-            if (*line == '[')
-            {
+            case '\0':
                 break;
+            case 'k':
+            case 'K':
+                multiplier = 1000ULL;
+                break;
+            case 'm':
+            case 'M':
+                multiplier = 1000000ULL;
+                break;
+            case 'g':
+            case 'G':
+                multiplier = 1000000000ULL;
+                break;
+            default:
+                multiplier = 0;
+                break;
+        }
+
+        if (multiplier && (value[len] == '\0' || value[len + 1] == '\0'))
+        {
+            rate = strtoull(value, NULL, 10) * multiplier;
+            if (rate >= MIN_RATE_LIMIT && rate <= MAX_RATE_LIMIT)
+            {
+                return rate;
+            }
+        }
+    }
+
+    config_error("%s line %u: Invalid rate \"%s\" (must be between %lluK and %lluG)\n", config_filename, config_lineno, value,
+        MIN_RATE_LIMIT / 1000, MAX_RATE_LIMIT / 1000000000);
+}
+
+
+//
+// Free the interfaces of the draft bridge
+//
+static void free_draft_interfaces(void)
+{
+    unsigned int                interface_index;
+
+    for (interface_index = 0; interface_index < draft_bridge.interface_count; interface_index++)
+    {
+        free(draft_bridge.interfaces[interface_index].name);
+    }
+    free(draft_bridge.interfaces);
+
+    draft_bridge.interfaces = NULL;
+    draft_bridge.interface_allocated = 0;
+    draft_bridge.interface_count = 0;
+}
+
+
+//
+// Release the file, draft bridge and interface address list used for parsing
+//
+static void release_parse_state(void)
+{
+    if (config_fp)
+    {
+        fclose(config_fp);
+        config_fp = NULL;
+    }
+
+    free_draft_interfaces();
+
+    free(ifaddr_index);
+    ifaddr_index = NULL;
+    ifaddr_index_count = 0;
+    if (ifaddr_list)
+    {
+        freeifaddrs(ifaddr_list);
+        ifaddr_list = NULL;
+    }
+}
+
+
+//
+// Parse the configuration file
+//
+static void parse_config(
+    parsed_config_t *           config)
+{
+    char                        buffer[MAX_INPUT_LINE];
+    char *                      list_array[MAX_LIST_ARRAY];
+    unsigned int                list_array_count;
+    unsigned int                list_array_index;
+    char *                      line;
+    char *                      value;
+    draft_interface_t *         draft_interface;
+    struct in_addr *            mcast_addr;
+    struct in6_addr *           mcast_addr6;
+    unsigned int                group_index;
+    unsigned int                section = 0;
+    unsigned long               lport;
+    unsigned long               lport_last;
+    unsigned int                len;
+    int                         r;
+
+    // Open the config file
+    config_lineno = 0;
+    config_fp = fopen(config_filename, "r");
+    if (config_fp == NULL)
+    {
+        config_error("Unable to open config file \"%s\"\n", config_filename);
+    }
+
+    // Get the ifaddrs list
+    if (getifaddrs(&ifaddr_list) == -1)
+    {
+        config_error("getifaddrs failed: %s\n", strerror(errno));
+    }
+    build_ifaddr_index();
+
+    // Process global options
+    line = read_line(config_fp, buffer);
+    while (line && line[0] != '[')
+    {
+        // Split the key/value pair
+        value = split_keyvalue(line);
+
+        if (strcmp(line, KEY_THREADS) == 0)
+        {
+            config->worker_thread_count = parse_number(value, 1, MAX_THREADS);
+        }
+        else if (strcmp(line, KEY_STATS_SOCKET) == 0)
+        {
+            if (value[0] != '/')
+            {
+                config_error("%s line %u: Statistics socket \"%s\" must be an absolute path\n", config_filename, config_lineno, value);
+            }
+            config->stats_socket_path = strdup(value);
+            if (config->stats_socket_path == NULL)
+            {
+                fatal("Cannot allocate memory for statistics socket path: %s\n", strerror(errno));
+            }
+        }
+        else if (strcmp(line, KEY_DEBUG_LOG_SAMPLE) == 0)
+        {
+            config->debug_log_sample = parse_number(value, 1, MAX_DEBUG_LOG_SAMPLE);
+        }
+        else if (strcmp(line, KEY_DEBUG_LOG_RATE) == 0)
+        {
+            config->debug_log_rate = parse_number(value, 1, MAX_DEBUG_LOG_RATE);
+        }
+        else
+        {
+            config_error("%s line %u: Unknown global parameter \"%s\"\n", config_filename, config_lineno, line);
+        }
+
+        line = read_line(config_fp, buffer);
+    }
+
+    // Process sections
+    while (line && line[0] == '[')
+    {
+        // Ignore leading whitespace
+        line = trim_leading_whitespace(line + 1);
+
+        // Ensure the section name (port number) is terminated
+        len = strlen(line);
+        if (len == 0 || line[len - 1] != ']')
+        {
+            config_error("%s line %u: Syntax error\n", config_filename, config_lineno);
+        }
+        line[len - 1] = '\0';
+
+        // Ignore trailing whitespace
+        trim_trailing_whitespace(line);
+
+        // Split off the last port of a port range
+        value = strchr(line, '-');
+        if (value)
+        {
+            *value = '\0';
+            trim_trailing_whitespace(line);
+            value = trim_leading_whitespace(value + 1);
+        }
+
+        // Insure the port number is valid
+        lport = 0;
+        if (strlen(line) && strspn(line, "0123456789") == strlen(line))
+        {
+            lport = strtoul(line, NULL, 10);
+        }
+        if (lport < 1 || lport > 65535)
+        {
+            config_error("%s line %u: Invalid port number\n", config_filename, config_lineno);
+        }
+
+        // Insure the last port number of a range is valid
+        lport_last = lport;
+        if (value)
+        {
+            lport_last = 0;
+            if (strlen(value) && strspn(value, "0123456789") == strlen(value))
+            {
+                lport_last = strtoul(value, NULL, 10);
+            }
+            if (lport_last < lport || lport_last > 65535)
+            {
+                config_error("%s line %u: Invalid port range\n", config_filename, config_lineno);
+            }
+        }
+
+        // Clear the draft bridge
+        memset(&draft_bridge, 0, sizeof(draft_bridge));
+
+        // Set the section and ports
+        draft_bridge.section = section;
+        section += 1;
+        draft_bridge.port = (unsigned short) lport;
+        draft_bridge.port_last = (unsigned short) lport_last;
+
+        // Read the rest of the bridge section
+        while ((line = read_line(config_fp, buffer)))
+        {
+            if (*line == '[')
+            {
+                break;
+            }
+
+            // Split the key/value pair
+            value = split_keyvalue(line);
+
+            if (strcmp(line, KEY_IPV4_ADDRESS) == 0)
+            {
+                // Store the multicast addresses
+                list_array_count = split_comma_list(value, list_array);
+                if (list_array_count == 0)
+                {
+                    config_error("%s line %u: Syntax error - missing address list\n", config_filename, config_lineno);
+                }
+                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
+                {
+                    value = list_array[list_array_index];
+                    if (draft_bridge.ipv4_mcast_addr_count >= MAX_GROUPS)
+                    {
+                        config_error("%s line %u: Maximum number of IPv4 multicast group addresses (%u) exceeded\n", config_filename, config_lineno, MAX_GROUPS);
+                    }
+                    mcast_addr = &draft_bridge.ipv4_mcast_addr[draft_bridge.ipv4_mcast_addr_count];
+                    r = inet_pton(AF_INET, value, mcast_addr);
+                    if (r <= 0)
+                    {
+                        config_error("%s line %u: Invalid IPv4 address \"%s\"\n", config_filename, config_lineno, value);
+                    }
+                    if (!IN_MULTICAST(ntohl(mcast_addr->s_addr)))
+                    {
+                        config_error("%s line %u: Invalid IPv4 multicast group address \"%s\"\n", config_filename, config_lineno, value);
+                    }
+                    if (MCB_ADDR_IS_IPV4_MC_LOCAL(ntohl(mcast_addr->s_addr)))
+                    {
+                        config_error("%s line %u: Multicast group address \"%s\" is link local (224.0.0.0/24) and cannot be bridged\n", config_filename, config_lineno, value);
+                    }
+                    for (group_index = 0; group_index < draft_bridge.ipv4_mcast_addr_count; group_index += 1)
+                    {
+                        if (draft_bridge.ipv4_mcast_addr[group_index].s_addr == mcast_addr->s_addr)
+                        {
+                            config_error("%s line %u: Duplicate multicast group address \"%s\"\n", config_filename, config_lineno, value);
+                        }
+                    }
+                    draft_bridge.ipv4_mcast_addr_count += 1;
+                }
             }
+            else if (strcmp(line, KEY_IPV6_ADDRESS) == 0)
+            {
+                // Store the multicast addresses
+                list_array_count = split_comma_list(value, list_array);
+                if (list_array_count == 0)
+                {
+                    config_error("%s line %u: Syntax error - missing address list\n", config_filename, config_lineno);
+                }
+                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
+                {
+                    value = list_array[list_array_index];
+                    if (draft_bridge.ipv6_mcast_addr_count >= MAX_GROUPS)
+                    {
+                        config_error("%s line %u: Maximum number of IPv6 multicast group addresses (%u) exceeded\n", config_filename, config_lineno, MAX_GROUPS);
+                    }
+                    mcast_addr6 = &draft_bridge.ipv6_mcast_addr[draft_bridge.ipv6_mcast_addr_count];
+                    r = inet_pton(AF_INET6, value, mcast_addr6);
+                    if (r <= 0)
+                    {
+                        config_error("%s line %u: Invalid IPv6 address \"%s\"\n", config_filename, config_lineno, value);
+                    }
+                    if (!IN6_IS_ADDR_MULTICAST(mcast_addr6))
+                    {
+                        config_error("%s line %u: Invalid IPv6 multicast group address \"%s\"\n", config_filename, config_lineno, value);
+                    }
+                    if (MCB_ADDR_IS_IPV6_MC_LOCAL(mcast_addr6->s6_addr))
+                    {
+                        config_error("%s line %u: Multicast group address \"%s\" is link local (ff02::/16) and cannot be bridged\n", config_filename, config_lineno, value);
+                    }
+                    for (group_index = 0; group_index < draft_bridge.ipv6_mcast_addr_count; group_index += 1)
+                    {
+                        if (IN6_ARE_ADDR_EQUAL(&draft_bridge.ipv6_mcast_addr[group_index], mcast_addr6))
+                        {
+                            config_error("%s line %u: Duplicate multicast group address \"%s\"\n", config_filename, config_lineno, value);
+                        }
+                    }
+                    draft_bridge.ipv6_mcast_addr_count += 1;
+                }
+            }
+            else if (strcmp(line, KEY_INBOUND_INTERFACES) == 0)
+            {
+                // Add the interfaces
+                list_array_count = split_comma_list(value, list_array);
+                if (list_array_count == 0)
+                {
+                    config_error("%s line %u: Syntax error - missing interface list\n", config_filename, config_lineno);
+                }
+                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
+                {
+                    draft_interface = add_draft_interface(&draft_bridge, list_array[list_array_index]);
+                    if (draft_interface->inbound_configuration != INTERFACE_CONFIG_STATIC)
+                    {
+                        draft_interface->inbound_configuration = INTERFACE_CONFIG_DYNAMIC;
+                    }
+                }
+            }
+            else if (strcmp(line, KEY_OUTBOUND_INTERFACES) == 0)
+            {
+                // Add the interfaces
+                list_array_count = split_comma_list(value, list_array);
+                if (list_array_count == 0)
+                {
+                    config_error("%s line %u: Syntax error - missing interface list\n", config_filename, config_lineno);
+                }
+                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
+                {
+                    draft_interface = add_draft_interface(&draft_bridge,  list_array[list_array_index]);
+                    if (draft_interface->outbound_configuration != INTERFACE_CONFIG_STATIC)
+                    {
+                        draft_interface->outbound_configuration = INTERFACE_CONFIG_DYNAMIC;
+                    }
+                }
+            }
+            else if (strcmp(line, KEY_STATIC_INBOUND_INTERFACES) == 0)
+            {
+                // Add the interfaces
+                list_array_count = split_comma_list(value, list_array);
+                if (list_array_count == 0)
+                {
+                    config_error("%s line %u: Syntax error - missing interface list\n", config_filename, config_lineno);
+                }
+                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
+                {
+                    draft_interface = add_draft_interface(&draft_bridge, list_array[list_array_index]);
+                    draft_interface->inbound_configuration = INTERFACE_CONFIG_STATIC;
+                }
+            }
+            else if (strcmp(line, KEY_STATIC_OUTBOUND_INTERFACES) == 0)
+            {
+                // Add the interfaces
+                list_array_count = split_comma_list(value, list_array);
+                if (list_array_count == 0)
+                {
+                    config_error("%s line %u: Syntax error - missing interface list\n", config_filename, config_lineno);
+                }
+                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
+                {
+                    draft_interface = add_draft_interface(&draft_bridge,  list_array[list_array_index]);
+                    draft_interface->outbound_configuration = INTERFACE_CONFIG_STATIC;
+                }
+            }
+            else if (strcmp(line, KEY_OUTBOUND_RATE_LIMIT) == 0)
+            {
+                // Set the rate limit of the interfaces
+                list_array_count = split_comma_list(value, list_array);
+                if (list_array_count == 0)
+                {
+                    config_error("%s line %u: Syntax error - missing interface list\n", config_filename, config_lineno);
+                }
+                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
+                {
+                    value = strchr(list_array[list_array_index], ':');
+                    if (value == NULL)
+                    {
+                        config_error("%s line %u: Syntax error - rate limit for \"%s\" must be interface:rate\n",
+                            config_filename, config_lineno, list_array[list_array_index]);
+                    }
+                    *value = '\0';
+                    draft_interface = add_draft_interface(&draft_bridge, list_array[list_array_index]);
+                    draft_interface->rate_limit = parse_rate(value + 1);
+                }
+            }
+            else if (strcmp(line, KEY_UDP_OFFLOAD) == 0)
+            {
+                draft_bridge.udp_offload = parse_boolean(value);
+#if !defined(USE_UDP_OFFLOAD)
+                if (draft_bridge.udp_offload)
+                {
+                    config_error("%s line %u: UDP offload is not supported on this platform\n", config_filename, config_lineno);
+                }
+#endif
+            }
+            else if (strcmp(line, KEY_DATAPLANE) == 0)
+            {
+                if (strcmp(value, DATAPLANE_NAME_SOCKET) == 0)
+                {
+                    draft_bridge.dataplane = DATAPLANE_SOCKET;
+                }
+                else if (strcmp(value, DATAPLANE_NAME_PACKET_RING) == 0)
+                {
+#if defined(USE_PACKET_RING)
+                    draft_bridge.dataplane = DATAPLANE_PACKET_RING;
+#else
+                    config_error("%s line %u: The %s dataplane is not supported on this platform\n", config_filename, config_lineno, value);
+#endif
+                }
+                else if (strcmp(value, DATAPLANE_NAME_XDP) == 0)
+                {
+#if defined(USE_XDP)
+                    draft_bridge.dataplane = DATAPLANE_XDP;
+#else
+                    config_error("%s line %u: The %s dataplane is not supported on this platform\n", config_filename, config_lineno, value);
+#endif
+                }
+                else if (strcmp(value, DATAPLANE_NAME_IO_URING) == 0)
+                {
+#if defined(USE_IO_URING)
+                    draft_bridge.dataplane = DATAPLANE_IO_URING;
+#else
+                    config_error("%s line %u: The %s dataplane is not supported on this platform\n", config_filename, config_lineno, value);
+#endif
+                }
+                else if (strcmp(value, DATAPLANE_NAME_KERNEL) == 0)
+                {
+#if defined(USE_MROUTE)
+                    draft_bridge.dataplane = DATAPLANE_KERNEL;
+#else
+                    config_error("%s line %u: The %s dataplane is not supported on this platform\n", config_filename, config_lineno, value);
+#endif
+                }
+                else
+                {
+                    config_error("%s line %u: Unknown dataplane \"%s\"\n", config_filename, config_lineno, value);
+                }
+            }
+            else if (strcmp(line, KEY_MODE) == 0)
+            {
+                if (strcmp(value, MODE_NAME_EVENT) == 0)
+                {
+                    draft_bridge.busy_poll = 0;
+                }
+                else if (strcmp(value, MODE_NAME_BUSY_POLL) == 0)
+                {
+                    draft_bridge.busy_poll = 1;
+                }
+                else
+                {
+                    config_error("%s line %u: Unknown mode \"%s\"\n", config_filename, config_lineno, value);
+                }
+            }
+            else if (strcmp(line, KEY_MAX_PACKET_SIZE) == 0)
+            {
+                draft_bridge.max_packet_size = parse_number(value, MIN_MAX_PACKET_SIZE, MCAST_MAX_PACKET_SIZE);
+            }
+            else if (strcmp(line, KEY_DUPLICATE_WINDOW) == 0)
+            {
+                draft_bridge.duplicate_window = parse_number(value, MIN_DUPLICATE_WINDOW, MAX_DUPLICATE_WINDOW);
+            }
+            else if (strcmp(line, KEY_DUPLICATE_MATCH_SOURCE) == 0)
+            {
+                draft_bridge.duplicate_match_source = parse_boolean(value);
+            }
+            else if (strcmp(line, KEY_CPU) == 0)
+            {
+#if defined(USE_CPU_AFFINITY)
+                if (strcmp(value, CPU_NAME_AUTO) == 0)
+                {
+#if defined(USE_NUMA_PLACEMENT)
+                    draft_bridge.cpu_auto = 1;
+#else
+                    config_error("%s line %u: Automatic CPU placement is not supported on this platform\n", config_filename, config_lineno);
+#endif
+                }
+                else
+                {
+                    draft_bridge.cpu = parse_number(value, 0, MAX_CPU_AFFINITY - 1);
+                    draft_bridge.cpu_auto = 0;
+                }
+                draft_bridge.has_cpu = 1;
+#else
+                config_error("%s line %u: CPU affinity is not supported on this platform\n", config_filename, config_lineno);
+#endif
+            }
+            else
+            {
+                config_error("%s line %u: Unknown interface parameter \"%s\"\n", config_filename, config_lineno, line);
+            }
+        }
+
+        // Validate the draft
+        validate_draft_bridge(&draft_bridge);
+
+        // Add the bridges for each port
+        for (lport = draft_bridge.port; lport <= draft_bridge.port_last; lport += 1)
+        {
+            draft_bridge.port = (unsigned short) lport;
+
+            // Add an IPv4 bridge if configured
+            if (draft_bridge.ipv4_mcast_addr_count && draft_bridge.inbound_ipv4_count && draft_bridge.outbound_ipv4_count)
+            {
+                add_bridge(config, &draft_bridge, AF_INET);
+            }
+
+            // Add an IPv6 bridge if configured
+            if (draft_bridge.ipv6_mcast_addr_count && draft_bridge.inbound_ipv6_count && draft_bridge.outbound_ipv6_count)
+            {
+                add_bridge(config, &draft_bridge, AF_INET6);
+            }
+        }
+
+        // Release the draft interfaces
+        free_draft_interfaces();
+    }
+
+    // Ensure we reached the end of the file
+    if (line != NULL)
+    {
+        config_error("%s line %u: Syntax error\n", config_filename, config_lineno);
+    }
+
+    // Ensure we have at least one bridge
+    if (config->bridge_list_count == 0)
+    {
+        config_error("%s line %u: No port bridges defined\n", config_filename, config_lineno);
+    }
+
+    // Clean up
+    release_parse_state();
+}
+
+
+//
+// Parse the configuration file without exiting if the file is invalid
+//
+// Returns 0 if the file was parsed, or -1 if it is invalid (the error is logged)
+//
+static int try_parse_config(
+    parsed_config_t *           config)
+{
+    jmp_buf                     env;
+
+    if (setjmp(env) != 0)
+    {
+        config_error_jmp = NULL;
+        release_parse_state();
+        return -1;
+    }
+
+    config_error_jmp = &env;
+    parse_config(config);
+    config_error_jmp = NULL;
+
+    return 0;
+}
+
+
+//
+// Read the configuration file
+//
+void read_config(void)
+{
+    parsed_config_t             config;
+
+    memset(&config, 0, sizeof(config));
+    parse_config(&config);
+
+    bridge_list = config.bridge_list;
+    bridge_list_allocated = config.bridge_list_allocated;
+    bridge_list_count = config.bridge_list_count;
+    worker_thread_count = config.worker_thread_count;
+    stats_socket_path = config.stats_socket_path;
+    debug_log_sample = config.debug_log_sample;
+    debug_log_rate = config.debug_log_rate;
+}
+
+
+//
+// Free a bridge instance interface
+//
+static void free_bridge_interface(
+    bridge_interface_t *        bridge_interface)
+{
+    free(bridge_interface->name);
+    free(bridge_interface);
+}
+
+
+//
+// Free a bridge instance and its interfaces
+//
+// NB: Interfaces taken over by the live configuration are NULL
+//
+static void free_bridge(
+    bridge_instance_t *         bridge)
+{
+    unsigned int                interface_index;
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        if (bridge->interface_list[interface_index])
+        {
+            free_bridge_interface(bridge->interface_list[interface_index]);
+        }
+    }
+    free(bridge->interface_list);
+    free(bridge->group_list);
+    free(bridge);
+}
+
+
+//
+// Free a parsed configuration
+//
+// NB: Bridge instances taken over by the live configuration are NULL
+//
+static void free_parsed_config(
+    parsed_config_t *           config)
+{
+    unsigned int                bridge_index;
+
+    for (bridge_index = 0; bridge_index < config->bridge_list_count; bridge_index++)
+    {
+        if (config->bridge_list[bridge_index])
+        {
+            free_bridge(config->bridge_list[bridge_index]);
+        }
+    }
+
+    free(config->bridge_list);
+    free((void *) config->stats_socket_path);
+}
+
+
+//
+// Find a bridge instance in a bridge list by family and port
+//
+static bridge_instance_t * find_bridge(
+    bridge_instance_t **        list,
+    unsigned int                count,
+    unsigned short              family,
+    unsigned short              port)
+{
+    unsigned int                bridge_index;
+
+    for (bridge_index = 0; bridge_index < count; bridge_index++)
+    {
+        if (list[bridge_index]->family == family && list[bridge_index]->port == port)
+        {
+            return list[bridge_index];
+        }
+    }
+
+    return NULL;
+}
+
+
+//
+// Find an interface of a bridge instance by name
+//
+static bridge_interface_t * find_bridge_interface(
+    bridge_instance_t *         bridge,
+    const char *                name)
+{
+    unsigned int                interface_index;
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        if (strcmp(bridge->interface_list[interface_index]->name, name) == 0)
+        {
+            return bridge->interface_list[interface_index];
+        }
+    }
+
+    return NULL;
+}
+
+
+//
+// Do two bridge instances of the same family have the same multicast groups?
+//
+// NB: Only the group addresses are compared. Other fields of the live group
+//     list, such as the IPv6 scope ID, are not part of the configuration.
+//
+static int same_group_list(
+    const bridge_instance_t *   bridge,
+    const bridge_instance_t *   reload)
+{
+    unsigned int                group_index;
 
-            // Split the key/value pair
-            value = split_keyvalue(line);
+    if (reload->group_count != bridge->group_count)
+    {
+        return 0;
+    }
 
-            if (strcmp(line, KEY_IPV4_ADDRESS) == 0)
+    for (group_index = 0; group_index < bridge->group_count; group_index++)
+    {
+        if (bridge->family == AF_INET)
+        {
+            if (reload->group_list[group_index].sin.sin_addr.s_addr != bridge->group_list[group_index].sin.sin_addr.s_addr)
             {
-                // Store the multicast address
-                r = inet_pton(AF_INET, value, &draft_bridge.ipv4_mcast_addr);
-                if (r <= 0)
-                {
-                    fatal("%s line %u: Invalid IPv4 address \"%s\"\n", config_filename, config_lineno, value);
-                }
-                if (!IN_MULTICAST(ntohl(draft_bridge.ipv4_mcast_addr.s_addr)))
-                {
-                    fatal("%s line %u: Invalid IPv4 multicast group address \"%s\"\n", config_filename, config_lineno, value);
-                }
-                if (MCB_ADDR_IS_IPV4_MC_LOCAL(ntohl(draft_bridge.ipv4_mcast_addr.s_addr)))
-                {
-                    fatal("%s line %u: Multicast group address \"%s\" is link local (224.0.0.0/24) and cannot be bridged\n", config_filename, config_lineno, value);
-                }
-                draft_bridge.has_ipv4_mcast_addr = 1;
+                return 0;
             }
-            else if (strcmp(line, KEY_IPV6_ADDRESS) == 0)
+        }
+        else
+        {
+            if (IN6_ARE_ADDR_EQUAL(&reload->group_list[group_index].sin6.sin6_addr, &bridge->group_list[group_index].sin6.sin6_addr) == 0)
             {
-                // Store the multicast address
-                r = inet_pton(AF_INET6, value, &draft_bridge.ipv6_mcast_addr);
-                if (r <= 0)
-                {
-                    fatal("%s line %u: Invalid IPv6 address \"%s\"\n", config_filename, config_lineno, value);
-                }
-                if (!IN6_IS_ADDR_MULTICAST(&draft_bridge.ipv6_mcast_addr))
-                {
-                    fatal("%s line %u: Invalid IPv6 multicast group address \"%s\"\n", config_filename, config_lineno, value);
-                }
-                if (MCB_ADDR_IS_IPV6_MC_LOCAL(draft_bridge.ipv6_mcast_addr.s6_addr))
-                {
-                    fatal("%s line %u: Multicast group address \"%s\" is link local (ff02::/16) and cannot be bridged\n", config_filename, config_lineno, value);
-                }
-                draft_bridge.has_ipv6_mcast_addr = 1;
+                return 0;
             }
-            else if (strcmp(line, KEY_INBOUND_INTERFACES) == 0)
+        }
+    }
+
+    return 1;
+}
+
+
+//
+// Can an interface of a live bridge instance be removed or replaced?
+//
+// Interfaces are added and removed by the worker that owns the bridge instance,
+// which is only supported for the socket dataplane. Under IP_RECVIF, the bridge
+// instance receives on the socket of its first interface, which is kept.
+//
+static int can_remove_interface(
+    const bridge_instance_t *   bridge,
+    const bridge_interface_t *  bridge_interface)
+{
+    if (bridge->dataplane != DATAPLANE_SOCKET)
+    {
+        return 0;
+    }
+
+#if defined(USE_RECVIF_PKTINFO)
+    if (bridge_interface == bridge->interface_list[0])
+    {
+        return 0;
+    }
+#else
+    (void) bridge_interface;
+#endif
+
+    return 1;
+}
+
+
+//
+// Does a bridge instance use a group of a live kernel dataplane bridge instance?
+//
+// NB: The kernel forwards the whole group, so no other bridge instance may use it
+//
+static int uses_kernel_group(
+    const bridge_instance_t *   reload)
+{
+    const bridge_instance_t *   bridge;
+    unsigned int                bridge_index;
+    unsigned int                group_index;
+    unsigned int                reload_group_index;
+
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+        if (bridge->dataplane != DATAPLANE_KERNEL || bridge->family != reload->family)
+        {
+            continue;
+        }
+
+        for (group_index = 0; group_index < bridge->group_count; group_index++)
+        {
+            for (reload_group_index = 0; reload_group_index < reload->group_count; reload_group_index++)
             {
-                // Add the interfaces
-                list_array_count = split_comma_list(value, list_array);
-                if (list_array_count == 0)
-                {
-                    fatal("%s line %u: Syntax error - missing interface list\n", config_filename, config_lineno);
-                }
-                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
+                if (bridge->family == AF_INET)
                 {
-                    draft_interface = add_draft_interface(&draft_bridge, list_array[list_array_index]);
-                    if (draft_interface->inbound_configuration != INTERFACE_CONFIG_STATIC)
+                    if (reload->group_list[reload_group_index].sin.sin_addr.s_addr == bridge->group_list[group_index].sin.sin_addr.s_addr)
                     {
-                        draft_interface->inbound_configuration = INTERFACE_CONFIG_DYNAMIC;
+                        return 1;
                     }
                 }
-            }
-            else if (strcmp(line, KEY_OUTBOUND_INTERFACES) == 0)
-            {
-                // Add the interfaces
-                list_array_count = split_comma_list(value, list_array);
-                if (list_array_count == 0)
-                {
-                    fatal("%s line %u: Syntax error - missing interface list\n", config_filename, config_lineno);
-                }
-                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
+                else
                 {
-                    draft_interface = add_draft_interface(&draft_bridge,  list_array[list_array_index]);
-                    if (draft_interface->outbound_configuration != INTERFACE_CONFIG_STATIC)
+                    if (IN6_ARE_ADDR_EQUAL(&reload->group_list[reload_group_index].sin6.sin6_addr, &bridge->group_list[group_index].sin6.sin6_addr))
                     {
-                        draft_interface->outbound_configuration = INTERFACE_CONFIG_DYNAMIC;
+                        return 1;
                     }
                 }
             }
-            else if (strcmp(line, KEY_STATIC_INBOUND_INTERFACES) == 0)
+        }
+    }
+
+    return 0;
+}
+
+
+//
+// Compare a reloaded bridge instance with the live instance, and apply the
+// changes that can be made without disturbing the instance
+//
+// Removed interfaces are removed, added interfaces are added, and changed
+// interfaces are replaced, leaving the other interfaces untouched. Interfaces
+// added are taken over from the reloaded bridge instance.
+//
+// NB: The caller holds bridge_list_lock
+//
+// Returns the number of changes that require a restart
+//
+static unsigned int reload_bridge(
+    bridge_instance_t *         bridge,
+    bridge_instance_t *         reload,
+    unsigned int *              applied)
+{
+    bridge_interface_t *        bridge_interface;
+    bridge_interface_t *        reload_interface;
+    unsigned int                interface_index;
+    unsigned int                restart = 0;
+    const char *                family = AF_FAMILY_TO_STRING(bridge->family);
+
+    // Changes that require the sockets, groups or workers to be recreated
+    if (same_group_list(bridge, reload) == 0)
+    {
+        logger("Reload: Bridge(%s/%u): change to multicast addresses requires a restart\n", family, bridge->port);
+        restart += 1;
+    }
+    if (reload->dataplane != bridge->dataplane)
+    {
+        logger("Reload: Bridge(%s/%u): change to %s requires a restart\n", family, bridge->port, KEY_DATAPLANE);
+        restart += 1;
+    }
+    if (reload->udp_offload != bridge->udp_offload)
+    {
+        logger("Reload: Bridge(%s/%u): change to %s requires a restart\n", family, bridge->port, KEY_UDP_OFFLOAD);
+        restart += 1;
+    }
+    if (reload->busy_poll != bridge->busy_poll)
+    {
+        logger("Reload: Bridge(%s/%u): change to %s requires a restart\n", family, bridge->port, KEY_MODE);
+        restart += 1;
+    }
+    if (reload->max_packet_size != bridge->max_packet_size)
+    {
+        logger("Reload: Bridge(%s/%u): change to %s requires a restart\n", family, bridge->port, KEY_MAX_PACKET_SIZE);
+        restart += 1;
+    }
+    if (reload->cpu != bridge->cpu)
+    {
+        logger("Reload: Bridge(%s/%u): change to %s requires a restart\n", family, bridge->port, KEY_CPU);
+        restart += 1;
+    }
+    if (reload->duplicate_match_source != bridge->duplicate_match_source)
+    {
+        logger("Reload: Bridge(%s/%u): change to %s requires a restart\n", family, bridge->port, KEY_DUPLICATE_MATCH_SOURCE);
+        restart += 1;
+    }
+
+    // The duplicate window can be changed while duplicates are suppressed
+    if (reload->duplicate_window != bridge->duplicate_window)
+    {
+        if (reload->duplicate_window && bridge->dedup)
+        {
+            logger("Reload: Bridge(%s/%u): %s changed to %u\n", family, bridge->port, KEY_DUPLICATE_WINDOW, reload->duplicate_window);
+            interface_set_duplicate_window(bridge, reload->duplicate_window);
+            *applied += 1;
+        }
+        else
+        {
+            logger("Reload: Bridge(%s/%u): %s the %s requires a restart\n", family, bridge->port,
+                reload->duplicate_window ? "adding" : "removing", KEY_DUPLICATE_WINDOW);
+            restart += 1;
+        }
+    }
+
+    // Removed and changed interfaces
+    // NB: Interfaces added in place of changed interfaces are at the end of the
+    //     list, and match the reloaded configuration
+    interface_index = 0;
+    while (interface_index < bridge->interface_count)
+    {
+        bridge_interface = bridge->interface_list[interface_index];
+        reload_interface = find_bridge_interface(reload, bridge_interface->name);
+        if (reload_interface == NULL)
+        {
+            if (can_remove_interface(bridge, bridge_interface) == 0)
             {
-                // Add the interfaces
-                list_array_count = split_comma_list(value, list_array);
-                if (list_array_count == 0)
-                {
-                    fatal("%s line %u: Syntax error - missing interface list\n", config_filename, config_lineno);
-                }
-                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
-                {
-                    draft_interface = add_draft_interface(&draft_bridge, list_array[list_array_index]);
-                    draft_interface->inbound_configuration = INTERFACE_CONFIG_STATIC;
-                }
+                logger("Reload: Bridge(%s/%u): removal of interface %s requires a restart\n", family, bridge->port, bridge_interface->name);
+                restart += 1;
+                interface_index += 1;
+                continue;
             }
-            else if (strcmp(line, KEY_STATIC_OUTBOUND_INTERFACES) == 0)
+
+            logger("Reload: Bridge(%s/%u): interface %s removed\n", family, bridge->port, bridge_interface->name);
+            interface_remove(bridge_interface);
+            free_bridge_interface(bridge_interface);
+            *applied += 1;
+            continue;
+        }
+
+        if (reload_interface->inbound_configuration != bridge_interface->inbound_configuration ||
+            reload_interface->outbound_configuration != bridge_interface->outbound_configuration ||
+            reload_interface->if_index != bridge_interface->if_index)
+        {
+            if (can_remove_interface(bridge, bridge_interface))
             {
-                // Add the interfaces
-                list_array_count = split_comma_list(value, list_array);
-                if (list_array_count == 0)
-                {
-                    fatal("%s line %u: Syntax error - missing interface list\n", config_filename, config_lineno);
-                }
-                for (list_array_index = 0; list_array_index < list_array_count; list_array_index += 1)
-                {
-                    draft_interface = add_draft_interface(&draft_bridge,  list_array[list_array_index]);
-                    draft_interface->outbound_configuration = INTERFACE_CONFIG_STATIC;
-                }
+                logger("Reload: Bridge(%s/%u): interface %s changed\n", family, bridge->port, bridge_interface->name);
+                interface_remove(bridge_interface);
+                free_bridge_interface(bridge_interface);
+                reload_interface->bridge = bridge;
+                interface_add(reload_interface);
+                *applied += 1;
+                continue;
+            }
+
+            logger("Reload: Bridge(%s/%u): change to interface %s requires a restart\n", family, bridge->port, bridge_interface->name);
+            restart += 1;
+        }
+
+        // The rate limit can be changed while the interface is rate limited
+        if (reload_interface->rate_limit != bridge_interface->rate_limit)
+        {
+            if (reload_interface->rate_limit && bridge_interface->shaper)
+            {
+                logger("Reload: Bridge(%s/%u): %s of %s changed to %llu bits per second\n", family, bridge->port,
+                    KEY_OUTBOUND_RATE_LIMIT, bridge_interface->name, (unsigned long long) reload_interface->rate_limit * 8);
+                interface_set_rate_limit(bridge_interface, reload_interface->rate_limit);
+                *applied += 1;
             }
             else
             {
-                fatal("%s line %u: Unknown interface parameter \"%s\"\n", config_filename, config_lineno, line);
+                logger("Reload: Bridge(%s/%u): %s the %s of %s requires a restart\n", family, bridge->port,
+                    reload_interface->rate_limit ? "adding" : "removing", KEY_OUTBOUND_RATE_LIMIT, bridge_interface->name);
+                restart += 1;
             }
         }
 
-        // Validate the draft
-        validate_draft_bridge(&draft_bridge);
+        interface_index += 1;
+    }
+
+    // Added interfaces
+    for (interface_index = 0; interface_index < reload->interface_count; interface_index++)
+    {
+        reload_interface = reload->interface_list[interface_index];
+        if (find_bridge_interface(bridge, reload_interface->name))
+        {
+            continue;
+        }
 
-        // Add an IPv4 bridge if configured
-        if (draft_bridge.has_ipv4_mcast_addr && draft_bridge.inbound_ipv4_count && draft_bridge.outbound_ipv4_count)
+        if (bridge->dataplane != DATAPLANE_SOCKET)
         {
-            add_bridge(&draft_bridge, AF_INET);
+            logger("Reload: Bridge(%s/%u): addition of interface %s requires a restart\n", family, bridge->port, reload_interface->name);
+            restart += 1;
+            continue;
         }
 
-        // Add an IPv6 bridge if configured
-        if (draft_bridge.has_ipv6_mcast_addr && draft_bridge.inbound_ipv6_count && draft_bridge.outbound_ipv6_count)
+        logger("Reload: Bridge(%s/%u): interface %s added\n", family, bridge->port, reload_interface->name);
+        reload_interface->bridge = bridge;
+        interface_add(reload_interface);
+        *applied += 1;
+    }
+
+    // The interfaces added now belong to the live bridge instance
+    for (interface_index = 0; interface_index < reload->interface_count; interface_index++)
+    {
+        if (reload->interface_list[interface_index]->bridge == bridge)
         {
-            add_bridge(&draft_bridge, AF_INET6);
+            reload->interface_list[interface_index] = NULL;
         }
     }
 
-    // Ensure we reached the end of the file
-    if (line != NULL)
+    return restart;
+}
+
+
+//
+// Reload the configuration file
+//
+// The reloaded configuration is compared with the live configuration, and
+// the changes that can be made without disturbing the sockets, group
+// membership or IGMP/MLD state of unchanged bridge instances and interfaces
+// are applied. Socket dataplane bridge instances and interfaces are added and
+// removed. Other changes are logged and take effect at the next restart. If
+// the file is invalid, the error is logged and the live configuration is left
+// unchanged.
+//
+void reload_config(void)
+{
+    parsed_config_t             config;
+    bridge_instance_t *         bridge;
+    bridge_instance_t *         reload;
+    unsigned int                bridge_index;
+    unsigned int                applied = 0;
+    unsigned int                restart = 0;
+
+    memset(&config, 0, sizeof(config));
+    if (try_parse_config(&config) != 0)
     {
-        fatal("%s line %u: Syntax error\n", config_filename, config_lineno);
+        free_parsed_config(&config);
+        logger("Configuration reload failed: %s is not valid, configuration unchanged\n", config_filename);
+        return;
     }
 
-    // Ensure we have at least one bridge
-    if (bridge_list_count == 0)
+    // Global options
+    if (config.worker_thread_count != worker_thread_count)
+    {
+        logger("Reload: change to %s requires a restart\n", KEY_THREADS);
+        restart += 1;
+    }
+    if ((config.stats_socket_path == NULL) != (stats_socket_path == NULL) ||
+        (config.stats_socket_path && strcmp(config.stats_socket_path, stats_socket_path) != 0))
+    {
+        logger("Reload: change to %s requires a restart\n", KEY_STATS_SOCKET);
+        restart += 1;
+    }
+    if (config.debug_log_sample != debug_log_sample)
     {
-        fatal("%s line %u: No port bridges defined\n", config_filename, config_lineno);
+        logger("Reload: %s changed to %u\n", KEY_DEBUG_LOG_SAMPLE, config.debug_log_sample);
+        __atomic_store_n(&debug_log_sample, config.debug_log_sample, __ATOMIC_RELAXED);
+        applied += 1;
+    }
+    if (config.debug_log_rate != debug_log_rate)
+    {
+        logger("Reload: %s changed to %u\n", KEY_DEBUG_LOG_RATE, config.debug_log_rate);
+        __atomic_store_n(&debug_log_rate, config.debug_log_rate, __ATOMIC_RELAXED);
+        applied += 1;
     }
 
-    // Clean up
-    freeifaddrs(ifaddr_list);
-    fclose(fp);
+    pthread_mutex_lock(&bridge_list_lock);
+
+    // Removed and changed bridge instances
+    bridge_index = 0;
+    while (bridge_index < bridge_list_count)
+    {
+        bridge = bridge_list[bridge_index];
+        reload = find_bridge(config.bridge_list, config.bridge_list_count, bridge->family, bridge->port);
+        if (reload == NULL)
+        {
+            if (bridge->dataplane != DATAPLANE_SOCKET)
+            {
+                logger("Reload: removal of Bridge(%s/%u) requires a restart\n", AF_FAMILY_TO_STRING(bridge->family), bridge->port);
+                restart += 1;
+                bridge_index += 1;
+                continue;
+            }
+
+            logger("Reload: Bridge(%s/%u) removed\n", AF_FAMILY_TO_STRING(bridge->family), bridge->port);
+            interface_remove_bridge(bridge);
+            bridge_list_count -= 1;
+            memmove(&bridge_list[bridge_index], &bridge_list[bridge_index + 1],
+                (bridge_list_count - bridge_index) * sizeof(bridge_instance_t *));
+            free_bridge(bridge);
+            applied += 1;
+            continue;
+        }
+
+        // Port range sections are numbered as in the reloaded configuration, so
+        // that added instances of a section share the worker of its live instances
+        bridge->section = reload->section;
+
+        restart += reload_bridge(bridge, reload, &applied);
+        bridge_index += 1;
+    }
+
+    // Added bridge instances
+    for (bridge_index = 0; bridge_index < config.bridge_list_count; bridge_index++)
+    {
+        reload = config.bridge_list[bridge_index];
+        if (find_bridge(bridge_list, bridge_list_count, reload->family, reload->port))
+        {
+            continue;
+        }
+
+        if (reload->dataplane != DATAPLANE_SOCKET || uses_kernel_group(reload))
+        {
+            logger("Reload: addition of Bridge(%s/%u) requires a restart\n", AF_FAMILY_TO_STRING(reload->family), reload->port);
+            restart += 1;
+            continue;
+        }
+
+        // Take over the bridge instance
+        if (bridge_list_count >= bridge_list_allocated)
+        {
+            bridge_list_allocated = bridge_list_allocated ? bridge_list_allocated * 2 : 1;
+            bridge_list = realloc(bridge_list, bridge_list_allocated * sizeof(bridge_instance_t *));
+            if (bridge_list == NULL)
+            {
+                fatal("Cannot allocate memory for bridge list: %s\n", strerror(errno));
+            }
+        }
+        bridge_list[bridge_list_count] = reload;
+        bridge_list_count += 1;
+        config.bridge_list[bridge_index] = NULL;
+
+        logger("Reload: Bridge(%s/%u) added\n", AF_FAMILY_TO_STRING(reload->family), reload->port);
+        interface_add_bridge(reload);
+        applied += 1;
+    }
+
+    pthread_mutex_unlock(&bridge_list_lock);
+
+    free_parsed_config(&config);
+
+    logger("Configuration reloaded from %s: %u change%s applied, %u change%s pending restart\n", config_filename,
+        applied, applied == 1 ? "" : "s", restart, restart == 1 ? "" : "s");
 }
 
 
@@ -996,6 +2312,30 @@ const char * interface_config_type_to_string(
 }
 
 
+//
+// Map a dataplane type to a string
+//
+const char * dataplane_type_to_string(
+    dataplane_type_t            dataplane_type)
+{
+    switch (dataplane_type)
+    {
+        case DATAPLANE_SOCKET:
+            return DATAPLANE_NAME_SOCKET;
+        case DATAPLANE_PACKET_RING:
+            return DATAPLANE_NAME_PACKET_RING;
+        case DATAPLANE_XDP:
+            return DATAPLANE_NAME_XDP;
+        case DATAPLANE_IO_URING:
+            return DATAPLANE_NAME_IO_URING;
+        case DATAPLANE_KERNEL:
+            return DATAPLANE_NAME_KERNEL;
+        default:
+            return "unknown";
+    }
+}
+
+
 //
 // Dump the finalized bridges
 //
@@ -1005,15 +2345,34 @@ void dump_config(void)
     bridge_interface_t *        interface;
     unsigned int                bridge_index;
     unsigned int                interface_index;
+    unsigned int                group_index;
     unsigned short              family;
     char                        addr_str[INET6_ADDRSTRLEN];
 
+    // Print the global options
+    if (worker_thread_count)
+    {
+        printf("Worker threads: %u\n\n", worker_thread_count);
+    }
+    if (stats_socket_path)
+    {
+        printf("Statistics socket: %s\n\n", stats_socket_path);
+    }
+    if (debug_log_sample)
+    {
+        printf("Debug log sample: 1 in %u\n\n", debug_log_sample);
+    }
+    if (debug_log_rate)
+    {
+        printf("Debug log rate: %u per second\n\n", debug_log_rate);
+    }
+
     // Print the bridges
     printf("Bridges:\n");
     for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
     {
         // Port number and IP type
-        bridge = &bridge_list[bridge_index];
+        bridge = bridge_list[bridge_index];
         family = bridge->family;
 
         // Multicast address
@@ -1035,11 +2394,49 @@ void dump_config(void)
         // IP type, port and multicast address
         printf("  IPv%u, port %u, address %s\n", (family == AF_INET) ? 4 : 6, bridge->port, addr_str);
 
+        // Additional multicast addresses
+        for (group_index = 1; group_index < bridge->group_count; group_index++)
+        {
+            if (inet_ntop(family, (family == AF_INET) ? (void *) &bridge->group_list[group_index].sin.sin_addr :
+                                                        (void *) &bridge->group_list[group_index].sin6.sin6_addr,
+                          addr_str, sizeof(addr_str)) == NULL)
+            {
+                fatal("inet_ntop failed for IPv%u address: %s\n", (family == AF_INET) ? 4 : 6, strerror(errno));
+            }
+            printf("    Additional address %s\n", addr_str);
+        }
+        if (bridge->dataplane != DATAPLANE_SOCKET)
+        {
+            printf("    Dataplane %s\n", dataplane_type_to_string(bridge->dataplane));
+        }
+        if (bridge->udp_offload)
+        {
+            printf("    UDP offload enabled\n");
+        }
+        if (bridge->busy_poll)
+        {
+            printf("    Busy poll mode\n");
+        }
+        printf("    Maximum packet size %u\n", bridge->max_packet_size);
+        if (bridge->duplicate_window)
+        {
+            printf("    Duplicate window %u milliseconds%s\n", bridge->duplicate_window,
+                bridge->duplicate_match_source ? ", matching source" : "");
+        }
+        if (bridge->cpu >= 0)
+        {
+            printf("    CPU affinity %d\n", bridge->cpu);
+        }
+        else if (bridge->cpu == BRIDGE_CPU_AUTO)
+        {
+            printf("    CPU affinity auto\n");
+        }
+
         // Inbound interfaces
         printf("    Inbound interfaces:\n");
         for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
         {
-            interface = &bridge->interface_list[interface_index];
+            interface = bridge->interface_list[interface_index];
             if (interface->inbound_configuration == INTERFACE_CONFIG_NONE)
             {
                 continue;
@@ -1069,7 +2466,7 @@ void dump_config(void)
         printf("    Outbound interfaces:\n");
         for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
         {
-            interface = &bridge->interface_list[interface_index];
+            interface = bridge->interface_list[interface_index];
             if (interface->outbound_configuration == INTERFACE_CONFIG_NONE)
             {
                 continue;
@@ -1093,6 +2490,10 @@ void dump_config(void)
 
             // Print the interface details
             printf("      %s, %s, address %s\n", interface->name, interface_config_type_to_string(interface->outbound_configuration), addr_str);
+            if (interface->rate_limit)
+            {
+                printf("        Rate limit %llu bits per second\n", (unsigned long long) interface->rate_limit * 8);
+            }
         }
 
         printf("\n");
@@ -33,20 +33,38 @@
 #include <string.h>
 #include <time.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "common.h"
 
+#if defined(USE_EVENTFD)
+# include <sys/eventfd.h>
+#endif
+
 
 //
 // Note, this is a restricted use event manager:
-// The maximum number of socket and timer events is fixed at evm creation
+// The maximum number of socket and timer events is set at evm creation
 // to allow for preallocation of all memory. Malloc/calloc is not called
-// after evm creation.
+// after evm creation, unless the evm is explicitly grown by its owner.
 // The only socket event type is read available.
-// There is no way to remove a socket event.
-// The number of timers is expected to be very small.
+// Drain sockets have their callback invoked repeatedly until the callback
+// reports no more data or the per-socket budget is reached. Ready drain
+// sockets are serviced round-robin so that a busy socket cannot starve
+// the others.
+// Socket events may be removed by the thread running the loop, and the
+// slot of a removed socket is reused by the next socket added.
+// Other threads may run a function on the thread running the loop with
+// evm_call. The function is run between event dispatches, when no socket
+// callback is in progress, and the caller waits for it to complete.
+// Timers are kept in a binary min-heap of timers embedded in the caller's
+// structures, so adding, rescheduling and deleting a timer are O(log n) and
+// deletion does not require a search. Timers with the same expiration time
+// are dispatched in the order they were added.
 // Timer events resolution is 1 millisecond.
-// Timer callback/closure is used as the identifier for timer deletion.
+// In busy poll mode, the loop never waits. All drain sockets are serviced
+// continuously, and every EVM_BUSY_POLL_INTERVAL rounds the kernel is polled
+// for other socket events without waiting and timers are dispatched.
 //
 
 
@@ -69,6 +87,10 @@
 #endif
 
 
+// Number of drain rounds between event polls in busy poll mode
+#define EVM_BUSY_POLL_INTERVAL  64
+
+
 
 //
 // Internal event manager structures
@@ -77,25 +99,42 @@ typedef struct socket_event
 {
     int                         fd;
     evm_callback_t              callback;
+    evm_drain_callback_t        drain_callback;
     void *                      closure;
+    unsigned int                drain_budget;
+    unsigned int                drain_remaining;
 } socket_event_t;
 
-typedef struct timer_event
-{
-    struct timespec             timespec;
-    evm_callback_t              callback;
-    void *                      closure;
-} timer_event_t;
-
 typedef struct _evm
 {
+    // NB: Sockets are referenced by their index in the socket list, as the
+    //     list may be reallocated. A removed socket has an fd of -1.
     socket_event_t *            socket_list;
     int                         socket_list_allocated;
     int                         socket_list_count;
 
-    timer_event_t *             timer_list;
-    int                         timer_list_allocated;
-    int                         timer_list_count;
+    int *                       drain_list;
+    int                         drain_list_count;
+
+    // NB: Timer heap_index is the position in the heap plus 1
+    evm_timer_t **              timer_heap;
+    unsigned int                timer_heap_allocated;
+    unsigned int                timer_heap_count;
+    unsigned long               timer_sequence;
+
+    // Busy poll mode?
+    unsigned int                busy_poll;
+
+    // Function to be run by evm_call, and the descriptors used to wake the
+    // loop for it (the same descriptor for an eventfd)
+    pthread_mutex_t             call_mutex;
+    pthread_cond_t              call_cond;
+    evm_callback_t              call_callback;
+    void *                      call_closure;
+    unsigned long               call_sequence;
+    unsigned int                call_wakeup;
+    int                         call_read_fd;
+    int                         call_write_fd;
 
     int                         event_fd;
 #if defined(HAVE_EPOLL)
@@ -106,16 +145,101 @@ typedef struct _evm
 } _evm_t;
 
 
+//
+// Allocate or grow the socket lists of an event manager
+//
+static void evm_allocate_sockets(
+    _evm_t *                    evm,
+    int                         max_socket_count)
+{
+    void *                      p;
+
+    p = realloc(evm->socket_list, max_socket_count * sizeof(socket_event_t));
+    if (p == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+    evm->socket_list = p;
+    memset(&evm->socket_list[evm->socket_list_allocated], 0,
+        (max_socket_count - evm->socket_list_allocated) * sizeof(socket_event_t));
+
+    // Allocate the list of ready drain sockets
+    p = realloc(evm->drain_list, max_socket_count * sizeof(int));
+    if (p == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+    evm->drain_list = p;
+
+    // Allocate the socket event list
+#if defined(HAVE_EPOLL)
+    p = realloc(evm->events, max_socket_count * sizeof(struct epoll_event));
+#elif defined(HAVE_KQUEUE)
+    p = realloc(evm->events, max_socket_count * sizeof(struct kevent));
+#endif
+    if (p == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+    evm->events = p;
+
+    evm->socket_list_allocated = max_socket_count;
+}
+
+
+//
+// Allocate or grow the timer heap of an event manager
+//
+static void evm_allocate_timers(
+    _evm_t *                    evm,
+    unsigned int                max_timer_count)
+{
+    void *                      p;
+
+    p = realloc(evm->timer_heap, max_timer_count * sizeof(evm_timer_t *));
+    if (p == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+    evm->timer_heap = p;
+    evm->timer_heap_allocated = max_timer_count;
+}
+
+
+//
+// Wakeup for a function posted by evm_call
+//
+// NB: The function is run once the events of the current wait have been
+//     dispatched. See evm_run_call.
+//
+static void evm_call_wakeup(
+    void *                      arg)
+{
+    _evm_t *                    evm = arg;
+    uint64_t                    value;
+
+    while (read(evm->call_read_fd, &value, sizeof(value)) > 0)
+    {
+    }
+    evm->call_wakeup = 1;
+}
+
+
 //
 // Create an event manager instance
 //
-// NB: FD and timer counts are used to preallocate memory.
+// NB: FD and timer counts are used to preallocate memory. One additional
+//     socket is reserved for evm_call.
 //
 void * evm_create(
     int                         max_socket_count,
     int                         max_timer_count)
 {
     _evm_t *                    evm;
+#if !defined(USE_EVENTFD)
+    int                         fds[2];
+    int                         r;
+#endif
 
     evm = calloc(1, sizeof(_evm_t));
     if (evm == NULL)
@@ -123,82 +247,125 @@ void * evm_create(
         fatal("Cannot allocate memory: %s\n", strerror(errno));
     }
 
-    // Allocate the FD list
-    if (max_socket_count)
-    {
-        evm->socket_list = calloc(max_socket_count, sizeof(socket_event_t));
-        evm->socket_list_allocated = max_socket_count;
+    // Allocate the socket lists
+    evm_allocate_sockets(evm, max_socket_count + 1);
 
 #if defined(HAVE_EPOLL)
-        // Create the kernel event notifier
-        evm->event_fd = epoll_create(max_socket_count);
-        if (evm->event_fd < 0)
-        {
-            fatal("epoll_create: %s\n", strerror(errno));
-        }
-
-        // Create the socket event list
-        evm->events = calloc(max_socket_count, sizeof(struct epoll_event));
-        if (evm->events == NULL)
-        {
-            fatal("Cannot allocate memory: %s\n", strerror(errno));
-        }
+    // Create the kernel event notifier
+    evm->event_fd = epoll_create(max_socket_count + 1);
+    if (evm->event_fd < 0)
+    {
+        fatal("epoll_create: %s\n", strerror(errno));
+    }
 #elif defined(HAVE_KQUEUE)
-        // Create the kernel event notifier
-        evm->event_fd = kqueue();
-        if (evm->event_fd < 0)
-        {
-            fatal("kqueue: %s\n", strerror(errno));
-        }
-
-        // Create the socket event list
-        evm->events = calloc(max_socket_count, sizeof(struct kevent));
-        if (evm->events == NULL)
-        {
-            fatal("Cannot allocate memory: %s\n", strerror(errno));
-        }
+    // Create the kernel event notifier
+    evm->event_fd = kqueue();
+    if (evm->event_fd < 0)
+    {
+        fatal("kqueue: %s\n", strerror(errno));
+    }
 #endif
 
+    // Allocate the timer heap
+    if (max_timer_count)
+    {
+        evm_allocate_timers(evm, max_timer_count);
     }
 
-    // Allocate the timer list
-    if (max_timer_count)
+    // Create the evm_call wakeup
+    pthread_mutex_init(&evm->call_mutex, NULL);
+    pthread_cond_init(&evm->call_cond, NULL);
+#if defined(USE_EVENTFD)
+    evm->call_read_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (evm->call_read_fd == -1)
     {
-        evm->timer_list = calloc(max_timer_count, sizeof(timer_event_t));
-        evm->timer_list_allocated = max_timer_count;
+        fatal("eventfd failed: %s\n", strerror(errno));
     }
+    evm->call_write_fd = evm->call_read_fd;
+#else
+    r = pipe(fds);
+    if (r == -1)
+    {
+        fatal("pipe failed: %s\n", strerror(errno));
+    }
+    (void) fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    (void) fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    evm->call_read_fd = fds[0];
+    evm->call_write_fd = fds[1];
+#endif
+    evm_add_socket((evm_t *) evm, evm->call_read_fd, evm_call_wakeup, evm);
 
     return evm;
 }
 
 
 //
-// Add an socket to the event manager
+// Grow an event manager to hold at least the given number of sockets and timers
 //
-void evm_add_socket(
+// NB: Must be called by the thread running the loop (see evm_call), or before
+//     the loop is started. As with evm_create, one additional socket is
+//     reserved for evm_call.
+//
+void evm_grow(
     evm_t *                     evm_p,
+    int                         max_socket_count,
+    int                         max_timer_count)
+{
+    _evm_t *                    evm = (_evm_t *) evm_p;
+
+    if (max_socket_count + 1 > evm->socket_list_allocated)
+    {
+        evm_allocate_sockets(evm, max_socket_count + 1);
+    }
+    if ((unsigned int) max_timer_count > evm->timer_heap_allocated)
+    {
+        evm_allocate_timers(evm, max_timer_count);
+    }
+}
+
+
+//
+// Register a socket with the event manager
+//
+static void evm_register_socket(
+    _evm_t *                    evm,
     int                         fd,
     evm_callback_t              callback,
-    void *                      closure)
+    evm_drain_callback_t        drain_callback,
+    void *                      closure,
+    unsigned int                drain_budget)
 {
-    _evm_t *                    evm = (_evm_t *) evm_p;
+    socket_event_t *            evm_socket;
+    int                         index;
     int                         r;
 
-    if (evm->socket_list_count >= evm->socket_list_allocated)
+    // Reuse the slot of a removed socket if there is one
+    for (index = 0; index < evm->socket_list_count; index++)
+    {
+        if (evm->socket_list[index].fd == -1)
+        {
+            break;
+        }
+    }
+    if (index >= evm->socket_list_allocated)
     {
         fatal("evm_add_fd: Number of FDs (%d) exceeded.\n", evm->socket_list_allocated);
     }
 
-    evm->socket_list[evm->socket_list_count].fd = fd;
-    evm->socket_list[evm->socket_list_count].callback = callback;
-    evm->socket_list[evm->socket_list_count].closure = closure;
+    evm_socket = &evm->socket_list[index];
+    evm_socket->fd = fd;
+    evm_socket->callback = callback;
+    evm_socket->drain_callback = drain_callback;
+    evm_socket->closure = closure;
+    evm_socket->drain_budget = drain_budget;
 
 #if defined(HAVE_EPOLL)
     {
         struct epoll_event      event;
 
         event.events = EPOLLIN;
-        event.data.ptr = &evm->socket_list[evm->socket_list_count];
+        event.data.u64 = 0;
+        event.data.u32 = index;
         r = epoll_ctl(evm->event_fd, EPOLL_CTL_ADD, fd, &event);
         if (r < 0)
         {
@@ -209,7 +376,7 @@ void evm_add_socket(
     {
         struct kevent           event;
 
-        EV_SET(&event, fd, EVFILT_READ, EV_ADD, 0, 0, &evm->socket_list[evm->socket_list_count]);
+        EV_SET(&event, fd, EVFILT_READ, EV_ADD, 0, 0, (void *) (intptr_t) index);
         r = kevent(evm->event_fd, &event, 1, NULL, 0, NULL);
         if (r < 0)
         {
@@ -218,15 +385,305 @@ void evm_add_socket(
     }
 #endif
 
-    evm->socket_list_count += 1;
+    if (index == evm->socket_list_count)
+    {
+        evm->socket_list_count += 1;
+    }
+}
+
+
+//
+// Add an socket to the event manager
+//
+void evm_add_socket(
+    evm_t *                     evm_p,
+    int                         fd,
+    evm_callback_t              callback,
+    void *                      closure)
+{
+    evm_register_socket((_evm_t *) evm_p, fd, callback, NULL, closure, 0);
+}
+
+
+//
+// Add a drain socket to the event manager
+//
+// NB: The callback returns non-zero if more data may be available. The
+//     budget is the maximum number of callback invocations per event wait.
+//
+void evm_add_drain_socket(
+    evm_t *                     evm_p,
+    int                         fd,
+    evm_drain_callback_t        callback,
+    void *                      closure,
+    unsigned int                budget)
+{
+    if (budget == 0)
+    {
+        budget = 1;
+    }
+
+    evm_register_socket((_evm_t *) evm_p, fd, NULL, callback, closure, budget);
+}
+
+
+//
+// Delete a socket from the event manager
+//
+// NB: Must be called by the thread running the loop (see evm_call), or before
+//     the loop is started. The caller closes the socket after it is deleted.
+//
+void evm_del_socket(
+    evm_t *                     evm_p,
+    int                         fd)
+{
+    _evm_t *                    evm = (_evm_t *) evm_p;
+    int                         index;
+    int                         r;
+
+    for (index = 0; index < evm->socket_list_count; index++)
+    {
+        if (evm->socket_list[index].fd == fd)
+        {
+            break;
+        }
+    }
+    if (index >= evm->socket_list_count)
+    {
+        logger("evm_del_socket: fd %d not found\n", fd);
+        return;
+    }
+
+#if defined(HAVE_EPOLL)
+    r = epoll_ctl(evm->event_fd, EPOLL_CTL_DEL, fd, NULL);
+    if (r < 0)
+    {
+        logger("epoll_ctl (EPOLL_CTL_DEL): %s\n", strerror(errno));
+    }
+#elif defined(HAVE_KQUEUE)
+    {
+        struct kevent           event;
+
+        EV_SET(&event, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+        r = kevent(evm->event_fd, &event, 1, NULL, 0, NULL);
+        if (r < 0)
+        {
+            logger("kevent (EV_DELETE): %s\n", strerror(errno));
+        }
+    }
+#endif
+
+    evm->socket_list[index].fd = -1;
+    evm->socket_list[index].callback = NULL;
+    evm->socket_list[index].drain_callback = NULL;
+    evm->socket_list[index].closure = NULL;
+}
+
+
+//
+// Set or clear busy poll mode
+//
+// NB: In busy poll mode, evm_loop never blocks and will consume all
+//     available cycles of the CPU it runs on. Once the loop is started,
+//     the mode may only be changed by the thread running the loop (see
+//     evm_call).
+//
+void evm_set_busy_poll(
+    evm_t *                     evm_p,
+    unsigned int                busy_poll)
+{
+    ((_evm_t *) evm_p)->busy_poll = busy_poll;
+}
+
+
+//
+// Run a function on the thread running the event manager loop
+//
+// The function is run between event dispatches, and the caller waits for it
+// to complete. This is how other threads change the sockets, timers and
+// structures owned by the loop.
+//
+// NB: Must not be called by the thread running the loop. If the loop has not
+//     been started, the caller waits until it is.
+//
+void evm_call(
+    evm_t *                     evm_p,
+    evm_callback_t              callback,
+    void *                      closure)
+{
+    _evm_t *                    evm = (_evm_t *) evm_p;
+    unsigned long               sequence;
+#if defined(USE_EVENTFD)
+    uint64_t                    value = 1;
+#else
+    uint8_t                     value = 1;
+#endif
+
+    pthread_mutex_lock(&evm->call_mutex);
+
+    // Wait for any call in progress by another thread
+    while (evm->call_callback)
+    {
+        pthread_cond_wait(&evm->call_cond, &evm->call_mutex);
+    }
+
+    evm->call_callback = callback;
+    evm->call_closure = closure;
+    sequence = evm->call_sequence;
+
+    if (write(evm->call_write_fd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+    {
+        fatal("evm_call: Cannot wake event manager: %s\n", strerror(errno));
+    }
+
+    // Wait for the call to complete
+    while (evm->call_sequence == sequence)
+    {
+        pthread_cond_wait(&evm->call_cond, &evm->call_mutex);
+    }
+
+    pthread_mutex_unlock(&evm->call_mutex);
+}
+
+
+//
+// Run a function posted by evm_call
+//
+// NB: Called when the events of a wait have been dispatched and the drain
+//     list is empty.
+//
+static void evm_run_call(
+    _evm_t *                    evm)
+{
+    evm_callback_t              callback;
+    void *                      closure;
+
+    evm->call_wakeup = 0;
+
+    pthread_mutex_lock(&evm->call_mutex);
+    callback = evm->call_callback;
+    closure = evm->call_closure;
+    pthread_mutex_unlock(&evm->call_mutex);
+
+    if (callback == NULL)
+    {
+        return;
+    }
+
+    (*callback)(closure);
+
+    pthread_mutex_lock(&evm->call_mutex);
+    evm->call_callback = NULL;
+    evm->call_closure = NULL;
+    evm->call_sequence += 1;
+    pthread_cond_broadcast(&evm->call_cond);
+    pthread_mutex_unlock(&evm->call_mutex);
+}
+
+
+//
+// Determine if timer t1 expires before timer t2
+//
+static int evm_timer_before(
+    const evm_timer_t *         t1,
+    const evm_timer_t *         t2)
+{
+    if (t1->timespec.tv_sec != t2->timespec.tv_sec)
+    {
+        return t1->timespec.tv_sec < t2->timespec.tv_sec;
+    }
+    if (t1->timespec.tv_nsec != t2->timespec.tv_nsec)
+    {
+        return t1->timespec.tv_nsec < t2->timespec.tv_nsec;
+    }
+    return (long) (t1->sequence - t2->sequence) < 0;
+}
+
+
+//
+// Place a timer at a position in the heap
+//
+static void evm_timer_place(
+    _evm_t *                    evm,
+    unsigned int                position,
+    evm_timer_t *               timer)
+{
+    evm->timer_heap[position] = timer;
+    timer->heap_index = position + 1;
+}
+
+
+//
+// Restore the heap order for the timer at a position in the heap
+//
+static void evm_timer_sift(
+    _evm_t *                    evm,
+    unsigned int                position)
+{
+    evm_timer_t *               timer = evm->timer_heap[position];
+    unsigned int                parent;
+    unsigned int                child;
+
+    // Move the timer up while it expires before its parent
+    while (position > 0)
+    {
+        parent = (position - 1) / 2;
+        if (evm_timer_before(timer, evm->timer_heap[parent]) == 0)
+        {
+            break;
+        }
+        evm_timer_place(evm, position, evm->timer_heap[parent]);
+        position = parent;
+    }
+
+    // Move the timer down while a child expires before it
+    while (1)
+    {
+        child = position * 2 + 1;
+        if (child >= evm->timer_heap_count)
+        {
+            break;
+        }
+        if (child + 1 < evm->timer_heap_count && evm_timer_before(evm->timer_heap[child + 1], evm->timer_heap[child]))
+        {
+            child += 1;
+        }
+        if (evm_timer_before(evm->timer_heap[child], timer) == 0)
+        {
+            break;
+        }
+        evm_timer_place(evm, position, evm->timer_heap[child]);
+        position = child;
+    }
+
+    evm_timer_place(evm, position, timer);
+}
+
+
+//
+// Remove the timer at a position in the heap
+//
+static void evm_timer_remove(
+    _evm_t *                    evm,
+    unsigned int                position)
+{
+    evm->timer_heap[position]->heap_index = 0;
+
+    evm->timer_heap_count -= 1;
+    if (position < evm->timer_heap_count)
+    {
+        evm_timer_place(evm, position, evm->timer_heap[evm->timer_heap_count]);
+        evm_timer_sift(evm, position);
+    }
 }
 
 
 //
-// Add a timer to the event manager
+// Add a timer to the event manager, or reschedule it if already scheduled
 //
 void evm_add_timer(
     evm_t *                     evm_p,
+    evm_timer_t *               timer,
     unsigned int                millis,
     evm_callback_t              callback,
     void *                      closure)
@@ -235,11 +692,11 @@ void evm_add_timer(
     struct timespec             now;
     long                        sec;
     long                        nsec;
-    int                         index;
+    unsigned int                position;
 
-    if (evm->timer_list_count >= evm->timer_list_allocated)
+    if (timer->heap_index == 0 && evm->timer_heap_count >= evm->timer_heap_allocated)
     {
-        logger("evm_add_timer: Number of timers (%d) exceeded\n", evm->timer_list_allocated);
+        logger("evm_add_timer: Number of timers (%u) exceeded\n", evm->timer_heap_allocated);
         return;
     }
 
@@ -255,56 +712,239 @@ void evm_add_timer(
         nsec -= 1000000000L;
     }
 
-    // Find where in the list the timer should be inserted
-    // NB: the number of timers is expected to be small, so a linear search is acceptable
-    for (index = 0; index < evm->timer_list_count; index++)
+    // Set the timer
+    timer->timespec.tv_sec = sec;
+    timer->timespec.tv_nsec = nsec;
+    timer->sequence = evm->timer_sequence++;
+    timer->callback = callback;
+    timer->closure = closure;
+
+    // Insert the timer, or reposition it if it is already in the heap
+    if (timer->heap_index)
     {
-        if (sec < evm->timer_list[index].timespec.tv_sec ||
-            (sec == evm->timer_list[index].timespec.tv_sec &&
-             nsec < evm->timer_list[index].timespec.tv_nsec))
-        {
-            break;
-        }
+        position = timer->heap_index - 1;
     }
-
-    // Open the array if needed
-    if (index < evm->timer_list_count)
+    else
     {
-        memmove(&evm->timer_list[index + 1], &evm->timer_list[index], (evm->timer_list_count - index) * sizeof(timer_event_t));
+        position = evm->timer_heap_count;
+        evm->timer_heap_count += 1;
+        evm_timer_place(evm, position, timer);
     }
-
-    // Set the timer
-    evm->timer_list[index].timespec.tv_sec = sec;
-    evm->timer_list[index].timespec.tv_nsec = nsec;
-    evm->timer_list[index].callback = callback;
-    evm->timer_list[index].closure = closure;
-    evm->timer_list_count += 1;
+    evm_timer_sift(evm, position);
 }
 
 
 //
 // Delete a timer from the event manager
 //
+// NB: Deleting a timer that is not scheduled has no effect.
+//
 void evm_del_timer(
     evm_t *                     evm_p,
-    evm_callback_t              callback,
-    void *                      closure)
+    evm_timer_t *               timer)
 {
     _evm_t *                    evm = (_evm_t *) evm_p;
+
+    if (timer->heap_index)
+    {
+        evm_timer_remove(evm, timer->heap_index - 1);
+    }
+}
+
+
+//
+// Wait for socket events
+//
+// Returns the number of events
+//
+static int evm_wait(
+    _evm_t *                    evm,
+    long                        timeout)
+{
+    int                         num_events;
+
+#if defined(HAVE_EPOLL)
+    num_events = epoll_wait(evm->event_fd, evm->events, evm->socket_list_count, timeout);
+    if (num_events < 0 && errno != EINTR)
+    {
+        logger("epoll_wait: %s\n", strerror(errno));
+    }
+#elif defined(HAVE_KQUEUE)
+    {
+        struct timespec         ts;
+        struct timespec *       tsp = NULL;
+
+        // Convert the timeout to a timespec
+        if (timeout >= 0)
+        {
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000L;
+            tsp = &ts;
+        }
+
+        num_events = kevent(evm->event_fd, NULL, 0, evm->events, evm->socket_list_count, tsp);
+        if (num_events < 0 && errno != EINTR)
+        {
+            logger("kevent: %s\n", strerror(errno));
+        }
+    }
+#endif
+
+    return num_events;
+}
+
+
+//
+// Dispatch socket events
+//
+// NB: Ready drain sockets are added to the drain list rather than dispatched.
+//     In busy poll mode, drain sockets are always serviced and their events
+//     are ignored.
+//
+static void evm_dispatch_sockets(
+    _evm_t *                    evm,
+    int                         num_events)
+{
+    socket_event_t *            evm_socket;
+    int                         socket_index;
     int                         index;
 
-    // Find the timer in the list
-    for (index = 0; index < evm->timer_list_count; index++)
+    for (index = 0; index < num_events; index++)
     {
-        if (evm->timer_list[index].callback == callback && evm->timer_list[index].closure == closure)
+#if defined(HAVE_EPOLL)
+        socket_index = (int) evm->events[index].data.u32;
+#elif defined(HAVE_KQUEUE)
+        socket_index = (int) (intptr_t) evm->events[index].udata;
+#endif
+        evm_socket = &evm->socket_list[socket_index];
+
+        // Ignore events for sockets that have been deleted
+        if (evm_socket->fd == -1)
         {
-            // Remove the timer
-            evm->timer_list_count -= 1;
-            if (evm->timer_list_count > 0)
+            continue;
+        }
+
+        // Drain sockets are serviced separately
+        if (evm_socket->drain_callback)
+        {
+            if (evm->busy_poll == 0)
             {
-                memmove(&evm->timer_list[index], &evm->timer_list[index + 1], (evm->timer_list_count - index) * sizeof(timer_event_t));
+                evm_socket->drain_remaining = evm_socket->drain_budget;
+                evm->drain_list[evm->drain_list_count] = socket_index;
+                evm->drain_list_count += 1;
+            }
+            continue;
+        }
+
+        (*evm_socket->callback)(evm_socket->closure);
+    }
+}
+
+
+//
+// Service drain sockets round-robin until each is empty or has exhausted its budget
+//
+static void evm_service_drain_list(
+    _evm_t *                    evm)
+{
+    socket_event_t *            evm_socket;
+    int                         index;
+
+    while (evm->drain_list_count)
+    {
+        index = 0;
+        while (index < evm->drain_list_count)
+        {
+            evm_socket = &evm->socket_list[evm->drain_list[index]];
+            evm_socket->drain_remaining -= 1;
+
+            if ((*evm_socket->drain_callback)(evm_socket->closure) == 0 || evm_socket->drain_remaining == 0)
+            {
+                // Remove the socket from the ready list
+                // NB: The last socket in the list has not been serviced in this round yet
+                evm->drain_list_count -= 1;
+                evm->drain_list[index] = evm->drain_list[evm->drain_list_count];
+                continue;
+            }
+
+            index += 1;
+        }
+    }
+}
+
+
+//
+// Dispatch expired timers
+//
+static void evm_dispatch_timers(
+    _evm_t *                    evm)
+{
+    struct timespec             now;
+    evm_timer_t *               timer;
+
+    if (evm->timer_heap_count == 0)
+    {
+        return;
+    }
+
+    // Get the current time
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Process any expired timers
+    while (evm->timer_heap_count && timespec_delta_millis(&now, &evm->timer_heap[0]->timespec) <= 0)
+    {
+        // Remove the timer
+        // NB: The callback may add the timer again
+        timer = evm->timer_heap[0];
+        evm_timer_remove(evm, 0);
+
+        // Invoke the callback
+        (timer->callback)(timer->closure);
+    }
+}
+
+
+//
+// Event manager loop in busy poll mode
+//
+// NB: Returns if busy poll mode is cleared.
+//
+static void evm_busy_poll_loop(
+    _evm_t *                    evm)
+{
+    socket_event_t *            evm_socket;
+    unsigned int                round = 0;
+    int                         num_events;
+    int                         index;
+
+    while (evm->busy_poll)
+    {
+        // Service all drain sockets as though they were ready
+        for (index = 0; index < evm->socket_list_count; index++)
+        {
+            evm_socket = &evm->socket_list[index];
+            if (evm_socket->fd != -1 && evm_socket->drain_callback)
+            {
+                evm_socket->drain_remaining = evm_socket->drain_budget;
+                evm->drain_list[evm->drain_list_count] = index;
+                evm->drain_list_count += 1;
+            }
+        }
+        evm_service_drain_list(evm);
+
+        // Periodically poll for other socket events and dispatch timers
+        round += 1;
+        if (round >= EVM_BUSY_POLL_INTERVAL)
+        {
+            round = 0;
+
+            num_events = evm_wait(evm, 0);
+            evm_dispatch_sockets(evm, num_events);
+            evm_dispatch_timers(evm);
+            if (evm->call_wakeup)
+            {
+                evm_run_call(evm);
             }
-           break;
         }
     }
 }
@@ -320,22 +960,23 @@ void evm_loop(
     _evm_t *                    evm = (_evm_t *) evm_p;
     struct timespec             now;
     long                        timeout;
-    socket_event_t *            evm_socket;
     int                         num_events;
-    int                         index;
-    evm_callback_t              timer_callback;
-    void *                      timer_closure;
 
     while (1)
     {
+        if (evm->busy_poll)
+        {
+            evm_busy_poll_loop(evm);
+        }
+
         // Calculate the timeout
-        if (evm->timer_list_count)
+        if (evm->timer_heap_count)
         {
             // Get the current time
             clock_gettime(CLOCK_MONOTONIC, &now);
 
             // Calculate the timeout (1ms minimum)
-            timeout = timespec_delta_millis(&now, &evm->timer_list[0].timespec);
+            timeout = timespec_delta_millis(&now, &evm->timer_heap[0]->timespec);
             if (timeout < 1)
             {
                 timeout = 1;
@@ -346,69 +987,14 @@ void evm_loop(
             timeout = -1;
         }
 
-        // Wait for events
-#if defined(HAVE_EPOLL)
-        num_events = epoll_wait(evm->event_fd, evm->events, evm->socket_list_count, timeout);
-        if (num_events < 0 && errno != EINTR)
-        {
-            logger("epoll_wait: %s\n", strerror(errno));
-        }
-#elif defined(HAVE_KQUEUE)
-        {
-            struct timespec     ts;
-            struct timespec *   tsp = NULL;
-
-            // Convert the timeout to a timespec
-            if (timeout > 0)
-            {
-                ts.tv_sec = timeout / 1000;
-                ts.tv_nsec = (timeout % 1000) * 1000000L;
-                tsp = &ts;
-            }
-
-            num_events = kevent(evm->event_fd, NULL, 0, evm->events, evm->socket_list_count, tsp);
-            if (num_events < 0 && errno != EINTR)
-            {
-                logger("kevent: %s\n", strerror(errno));
-            }
-        }
-#endif
-
-        // Dispatch IO events
-        for (index = 0; index < num_events; index++)
+        // Wait for and dispatch events
+        num_events = evm_wait(evm, timeout);
+        evm_dispatch_sockets(evm, num_events);
+        evm_service_drain_list(evm);
+        evm_dispatch_timers(evm);
+        if (evm->call_wakeup)
         {
-#if defined(HAVE_EPOLL)
-            evm_socket = evm->events[index].data.ptr;
-#elif defined(HAVE_KQUEUE)
-            evm_socket = evm->events[index].udata;
-#endif
-
-            (*evm_socket->callback)(evm_socket->closure);
-        }
-
-        // Dispatch timers
-        if (evm->timer_list_count)
-        {
-            // Get the current time
-            clock_gettime(CLOCK_MONOTONIC, &now);
-
-            // Process any expired timers
-            while (evm->timer_list_count && timespec_delta_millis(&now, &evm->timer_list[0].timespec) <= 0)
-            {
-                // Save the timer callback/closure
-                timer_callback = evm->timer_list[0].callback;
-                timer_closure = evm->timer_list[0].closure;
-
-                // Remove the timer
-                evm->timer_list_count -= 1;
-                if (evm->timer_list_count)
-                {
-                    memmove(&evm->timer_list[0], &evm->timer_list[1], (evm->timer_list_count) * sizeof(timer_event_t));
-                }
-
-                // Invoke the callback
-                (timer_callback)(timer_closure);
-            }
+            evm_run_call(evm);
         }
     }
 }
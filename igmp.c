@@ -41,6 +41,10 @@
 #include "common.h"
 #include "protocols.h"
 
+#if defined(USE_PACKET_ALLMULTI)
+# include <linux/if_packet.h>
+#endif
+
 
 //
 // The IGMP implementation herein is primarily based on RFC 2236 and RFC 9976.
@@ -49,10 +53,12 @@
 //
 //  1. The implementation ignores all link-local scope multicast addresses (224.0.0.0/24).
 //
-//  2. The IGMPv3 implementation works at the IP group level only, ignoring all source
-//     specific address information. This is similar to some switches or routers with
-//     the forwarding method set to "IP Group Address" instead of "Source Specific IP
-//     Group Address".
+//  2. The IGMPv3 implementation tracks the sources of include mode listeners only.
+//     Exclude mode records, and v1 and v2 reports, are treated as listeners for any
+//     source, ignoring the sources excluded. No group and source specific queries are
+//     sent. When a listener blocks sources or changes to include mode, a group specific
+//     query is sent instead, and the sources of the listeners that remain are refreshed
+//     by their reports.
 //
 //  3. The implementation offers multiple querier modes:
 //     * Never - The querier function is disabled.
@@ -96,6 +102,24 @@
 // Grace period for protocol timeouts in milliseconds
 #define GRACE_MILLIS            10
 
+// Capture length for IGMP packets
+// NB: IGMP messages are not fragmented, so they cannot exceed the link MTU. This allows
+//     for a VLAN tag and jumbo frames.
+#define IGMP_SNAPLEN            (sizeof(mcb_ethernet_t) + 4 + 9216)
+
+// Maximum number of packets processed per pcap dispatch
+#define IGMP_DISPATCH_COUNT     64
+
+// Maximum number of pcap dispatches per interface per event wait
+#define IGMP_DRAIN_BUDGET       4
+
+
+// IGMP source structure
+typedef struct igmp_source
+{
+    uint8_t                     addr[MCB_IP4_ADDR_LEN];
+    struct timespec             deadline;
+} igmp_source_t;
 
 // IGMP group structure
 typedef struct igmp_interface   igmp_interface_t;
@@ -118,6 +142,27 @@ typedef struct igmp_group
     // IGMP parameters
     unsigned int                v1_host_present;
     unsigned int                group_queries_remaining;
+
+    // Group membership and v1 host present deadlines. Reports only move the
+    // deadlines, and each timer is rearmed for the remaining time if it expires
+    // before its deadline.
+    struct timespec             group_deadline;
+    struct timespec             v1_host_deadline;
+
+    // Source filter state. Listeners for any source hold the any source deadline,
+    // and include mode listeners hold the deadlines of their sources.
+    struct timespec             any_source_deadline;
+    igmp_source_t               source_list[MAX_GROUP_SOURCES];
+    unsigned int                source_count;
+
+    // Is a source filter published to the bridge interfaces?
+    unsigned int                source_filter_published;
+
+    // Timers for group membership, v1 host presence, group specific queries and source expiry
+    evm_timer_t                 group_timer;
+    evm_timer_t                 v1_host_timer;
+    evm_timer_t                 query_timer;
+    evm_timer_t                 source_timer;
 } igmp_group_t;
 
 // IGMP interface structure
@@ -129,6 +174,15 @@ typedef struct igmp_interface
     unsigned int                group_list_count;
     unsigned int                group_list_fixed_limit;
 
+    // Hash index of the group list by group address
+    // NB: Entries are group list indexes plus one, with zero indicating an empty entry
+    unsigned int *              group_hash;
+    unsigned int                group_hash_mask;
+
+    // Free list (stack) of group list indexes available for non configured groups
+    unsigned int *              group_free_list;
+    unsigned int                group_free_list_count;
+
     // Interface name, index and address
     char *                      name;
     unsigned int                if_index;
@@ -151,6 +205,11 @@ typedef struct igmp_interface
     // Number of startup queries remaining
     unsigned int                startup_queries_remaining;
 
+    // Timers for multicast router advertisements, general queries and querier timeout
+    evm_timer_t                 mrd_timer;
+    evm_timer_t                 general_query_timer;
+    evm_timer_t                 querier_timer;
+
     // Packet for multicast router advertisements
     uint8_t                     mrd_advertisement_packet[IGMP_MRD_BUFFER_SIZE];
 
@@ -164,7 +223,9 @@ typedef struct igmp_interface
 static evm_t *                  igmp_evm;
 
 // IGMP interface list
-static igmp_interface_t *       igmp_interface_list = NULL;
+// NB: Interfaces are not moved once allocated, as their groups and timers are
+//     referenced by the event manager
+static igmp_interface_t **      igmp_interface_list = NULL;
 static unsigned int             igmp_interface_list_allocated = 0;
 static unsigned int             igmp_interface_list_count = 0;
 
@@ -371,7 +432,7 @@ static void igmp_send_mrd_advertisement(
     }
 
     // Set a timer for the next advertisement
-    evm_add_timer(igmp_evm, millis, igmp_send_mrd_advertisement, igmp_interface);
+    evm_add_timer(igmp_evm, &igmp_interface->mrd_timer, millis, igmp_send_mrd_advertisement, igmp_interface);
 }
 
 
@@ -410,7 +471,7 @@ static void igmp_send_general_query(
     }
 
     // Set a timer for the next query
-    evm_add_timer(igmp_evm, millis, igmp_send_general_query, igmp_interface);
+    evm_add_timer(igmp_evm, &igmp_interface->general_query_timer, millis, igmp_send_general_query, igmp_interface);
 }
 
 
@@ -479,7 +540,7 @@ static void send_group_specific_query(
     igmp_group->group_queries_remaining -= 1;
     if (igmp_group->group_queries_remaining)
     {
-        evm_add_timer(igmp_evm, igmp_interface->querier_lastmbr_interval_tenths * 100, send_group_specific_query, igmp_group);
+        evm_add_timer(igmp_evm, &igmp_group->query_timer, igmp_interface->querier_lastmbr_interval_tenths * 100, send_group_specific_query, igmp_group);
         return;
     }
 }
@@ -533,6 +594,353 @@ static void igmp_querier_timeout(
 }
 
 
+//
+// Find the group hash entry for a group address
+//
+// NB: Returns the entry holding the address, or the empty entry that ends the probe sequence
+//
+static unsigned int igmp_group_hash_entry(
+    const igmp_interface_t *    igmp_interface,
+    const uint8_t *             mcast_addr)
+{
+    unsigned int                entry;
+
+    entry = addr_hash(mcast_addr, MCB_IP4_ADDR_LEN) & igmp_interface->group_hash_mask;
+    while (igmp_interface->group_hash[entry])
+    {
+        if (MCB_IP4_ADDR_CMP(igmp_interface->group_list[igmp_interface->group_hash[entry] - 1].mcast_addr, mcast_addr) == 0)
+        {
+            break;
+        }
+        entry = (entry + 1) & igmp_interface->group_hash_mask;
+    }
+
+    return entry;
+}
+
+
+//
+// Add a group to the group hash
+//
+static void igmp_group_hash_add(
+    igmp_interface_t *          igmp_interface,
+    const igmp_group_t *        igmp_group)
+{
+    unsigned int                entry;
+
+    entry = igmp_group_hash_entry(igmp_interface, igmp_group->mcast_addr);
+    igmp_interface->group_hash[entry] = (unsigned int) (igmp_group - igmp_interface->group_list) + 1;
+}
+
+
+//
+// Delete a group from the group hash
+//
+static void igmp_group_hash_del(
+    igmp_interface_t *          igmp_interface,
+    const igmp_group_t *        igmp_group)
+{
+    unsigned int                mask = igmp_interface->group_hash_mask;
+    unsigned int                entry;
+    unsigned int                next;
+    unsigned int                home;
+
+    entry = igmp_group_hash_entry(igmp_interface, igmp_group->mcast_addr);
+    if (igmp_interface->group_hash[entry] == 0)
+    {
+        return;
+    }
+
+    // Close the gap by shifting back any following entries in the probe sequence that
+    // would otherwise become unreachable
+    next = entry;
+    while (1)
+    {
+        next = (next + 1) & mask;
+        if (igmp_interface->group_hash[next] == 0)
+        {
+            break;
+        }
+
+        home = addr_hash(igmp_interface->group_list[igmp_interface->group_hash[next] - 1].mcast_addr, MCB_IP4_ADDR_LEN) & mask;
+        if (((next - home) & mask) >= ((next - entry) & mask))
+        {
+            igmp_interface->group_hash[entry] = igmp_interface->group_hash[next];
+            entry = next;
+        }
+    }
+
+    igmp_interface->group_hash[entry] = 0;
+}
+
+
+//
+// Get the group membership interval in milliseconds
+//
+static unsigned int igmp_membership_interval_millis(
+    const igmp_interface_t *    igmp_interface)
+{
+    return (igmp_interface->querier_robustness * igmp_interface->querier_interval_sec +
+            igmp_interface->querier_response_interval_tenths / 10) * 1000;
+}
+
+
+// Update the source filter of a group on expiry of the source timer
+static void igmp_source_timeout(
+    void *                      arg);
+
+
+//
+// Update the source filter of a group
+//
+// Expired sources are removed, the filter is published to the bridge interfaces
+// of the group if it has changed, and the source timer is scheduled for the next
+// deadline.
+//
+static void igmp_group_update_sources(
+    igmp_group_t *              igmp_group,
+    unsigned int                changed)
+{
+    igmp_source_t *             source;
+    uint8_t                     source_list[MAX_GROUP_SOURCES][MCB_IP4_ADDR_LEN];
+    struct timespec             now;
+    struct timespec             next;
+    unsigned int                have_next = 0;
+    unsigned int                any_source;
+    unsigned int                source_index;
+    unsigned int                interface_index;
+    char                        group_addr_str[INET_ADDRSTRLEN] = "unknown";
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Is there a listener for any source?
+    any_source = timespec_delta_millis(&now, &igmp_group->any_source_deadline) > 0;
+    if (any_source)
+    {
+        next = igmp_group->any_source_deadline;
+        have_next = 1;
+    }
+
+    // Remove the expired sources and find the next deadline
+    source_index = 0;
+    while (source_index < igmp_group->source_count)
+    {
+        source = &igmp_group->source_list[source_index];
+        if (timespec_delta_millis(&now, &source->deadline) <= 0)
+        {
+            igmp_group->source_count -= 1;
+            *source = igmp_group->source_list[igmp_group->source_count];
+            changed = 1;
+            continue;
+        }
+
+        if (have_next == 0 || timespec_delta_millis(&next, &source->deadline) < 0)
+        {
+            next = source->deadline;
+            have_next = 1;
+        }
+        MCB_IP4_ADDR_CPY(source_list[source_index], source->addr);
+        source_index += 1;
+    }
+
+    // Publish the filter if it has changed
+    if (any_source)
+    {
+        changed = igmp_group->source_filter_published;
+        igmp_group->source_filter_published = 0;
+    }
+    else if (igmp_group->source_filter_published == 0)
+    {
+        changed = 1;
+        igmp_group->source_filter_published = 1;
+    }
+    if (changed)
+    {
+        // Debug logging
+        if (debug_level >= 3)
+        {
+            inet_ntop(AF_INET, igmp_group->mcast_addr, group_addr_str, sizeof(group_addr_str));
+            if (any_source)
+            {
+                logger("IGMP(%s) [%s]: forwarding any source\n", igmp_group->igmp_interface->name, group_addr_str);
+            }
+            else
+            {
+                logger("IGMP(%s) [%s]: forwarding %u sources\n", igmp_group->igmp_interface->name,
+                    group_addr_str, source_index);
+            }
+        }
+
+        for (interface_index = 0; interface_index < igmp_group->bridge_interface_list_count; interface_index += 1)
+        {
+            interface_set_source_filter(igmp_group->bridge_interface_list[interface_index], igmp_group->mcast_addr,
+                any_source ? NULL : source_list, source_index);
+        }
+    }
+
+    // Schedule the source timer for the next deadline
+    // NB: As with the group timer, a timer that will expire before the deadline is left alone
+    if (have_next &&
+        (igmp_group->source_timer.heap_index == 0 ||
+         timespec_delta_millis(&next, &igmp_group->source_timer.timespec) > 0))
+    {
+        evm_add_timer(igmp_evm, &igmp_group->source_timer, (unsigned int) timespec_delta_millis(&now, &next),
+            igmp_source_timeout, igmp_group);
+    }
+}
+
+
+//
+// IGMP source timeout
+//
+static void igmp_source_timeout(
+    void *                      arg)
+{
+    igmp_group_update_sources(arg, 0);
+}
+
+
+//
+// Add sources to the source filter state of a group
+//
+// NB: A NULL source list indicates a listener for any source
+//
+static void igmp_group_add_sources(
+    igmp_interface_t *          igmp_interface,
+    igmp_group_t *              igmp_group,
+    const uint8_t *             srcs,
+    unsigned int                num_srcs)
+{
+    struct timespec             deadline;
+    unsigned int                changed = 0;
+    unsigned int                src_index;
+    unsigned int                source_index;
+
+    // Sources are only tracked for registered groups
+    if (igmp_group->bridge_interface_list_count == 0 || (srcs && num_srcs == 0))
+    {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    timespec_add_millis(&deadline, igmp_membership_interval_millis(igmp_interface));
+
+    if (srcs == NULL)
+    {
+        igmp_group->any_source_deadline = deadline;
+    }
+    for (src_index = 0; src_index < num_srcs; src_index += 1)
+    {
+        for (source_index = 0; source_index < igmp_group->source_count; source_index += 1)
+        {
+            if (MCB_IP4_ADDR_CMP(igmp_group->source_list[source_index].addr, srcs + src_index * MCB_IP4_ADDR_LEN) == 0)
+            {
+                break;
+            }
+        }
+
+        // If the source is new, add it
+        if (source_index >= igmp_group->source_count)
+        {
+            if (igmp_group->source_count >= MAX_GROUP_SOURCES)
+            {
+                igmp_log(igmp_interface, igmp_group->mcast_addr, "Source list full -- forwarding any source");
+                igmp_group->any_source_deadline = deadline;
+                break;
+            }
+            MCB_IP4_ADDR_CPY(igmp_group->source_list[source_index].addr, srcs + src_index * MCB_IP4_ADDR_LEN);
+            igmp_group->source_count += 1;
+            changed = 1;
+        }
+        igmp_group->source_list[source_index].deadline = deadline;
+    }
+
+    igmp_group_update_sources(igmp_group, changed);
+}
+
+
+//
+// Does the source filter state of a group hold any of a list of sources?
+//
+static unsigned int igmp_group_has_sources(
+    const igmp_group_t *        igmp_group,
+    const uint8_t *             srcs,
+    unsigned int                num_srcs)
+{
+    unsigned int                src_index;
+    unsigned int                source_index;
+
+    for (src_index = 0; src_index < num_srcs; src_index += 1)
+    {
+        for (source_index = 0; source_index < igmp_group->source_count; source_index += 1)
+        {
+            if (MCB_IP4_ADDR_CMP(igmp_group->source_list[source_index].addr, srcs + src_index * MCB_IP4_ADDR_LEN) == 0)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+//
+// Lower the source deadlines of a group
+//
+// NB: Listeners that remain respond to the group specific queries, restoring
+//     the deadlines of their sources
+//
+static void igmp_group_lower_sources(
+    igmp_group_t *              igmp_group,
+    unsigned int                millis)
+{
+    struct timespec             deadline;
+    unsigned int                source_index;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    timespec_add_millis(&deadline, millis);
+
+    if (timespec_delta_millis(&deadline, &igmp_group->any_source_deadline) > 0)
+    {
+        igmp_group->any_source_deadline = deadline;
+    }
+    for (source_index = 0; source_index < igmp_group->source_count; source_index += 1)
+    {
+        if (timespec_delta_millis(&deadline, &igmp_group->source_list[source_index].deadline) > 0)
+        {
+            igmp_group->source_list[source_index].deadline = deadline;
+        }
+    }
+
+    igmp_group_update_sources(igmp_group, 0);
+}
+
+
+//
+// Clear the source filter state of a group
+//
+static void igmp_group_clear_sources(
+    igmp_group_t *              igmp_group)
+{
+    unsigned int                interface_index;
+
+    evm_del_timer(igmp_evm, &igmp_group->source_timer);
+    memset(&igmp_group->any_source_deadline, 0, sizeof(igmp_group->any_source_deadline));
+    igmp_group->source_count = 0;
+
+    // Remove any published filter
+    if (igmp_group->source_filter_published)
+    {
+        igmp_group->source_filter_published = 0;
+        for (interface_index = 0; interface_index < igmp_group->bridge_interface_list_count; interface_index += 1)
+        {
+            interface_set_source_filter(igmp_group->bridge_interface_list[interface_index], igmp_group->mcast_addr, NULL, 0);
+        }
+    }
+}
+
+
 //
 // IGMP group timeout
 //
@@ -543,32 +951,63 @@ static void igmp_group_timeout(
     igmp_interface_t *          igmp_interface = igmp_group->igmp_interface;
     unsigned int                group_index;
     unsigned int                bridge_interface_index;
+    struct timespec             now;
+    long                        millis;
+
+    // If the deadline has been extended, rearm the timer for the remaining time
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    millis = timespec_delta_millis(&now, &igmp_group->group_deadline);
+    if (millis > 0)
+    {
+        evm_add_timer(igmp_evm, &igmp_group->group_timer, (unsigned int) millis, igmp_group_timeout, igmp_group);
+        return;
+    }
 
     igmp_log(igmp_interface, igmp_group->mcast_addr, "Group membership timeout");
 
     // Mark the group as inactive
     igmp_group->active = 0;
+    igmp_group_clear_sources(igmp_group);
 
-    // Is this one of the registered groups?
-    if (igmp_group->bridge_interface_list_count)
+    // Deactivate the outbound interfaces of a registered group
+    for (bridge_interface_index = 0; bridge_interface_index < igmp_group->bridge_interface_list_count; bridge_interface_index += 1)
+    {
+        interface_deactivate_outbound(igmp_group->bridge_interface_list[bridge_interface_index]);
+    }
+
+    // Configured and registered groups remain in the hash
+    group_index = (unsigned int) (igmp_group - igmp_interface->group_list);
+    if (igmp_group->bridge_interface_list_count || group_index < igmp_interface->group_list_fixed_limit)
     {
-        // deactivate the outbound interfaces
-        for (bridge_interface_index = 0; bridge_interface_index < igmp_group->bridge_interface_list_count; bridge_interface_index += 1)
-        {
-            interface_deactivate_outbound(igmp_group->bridge_interface_list[bridge_interface_index]);
-        }
         return;
     }
 
-    // Tighten up the group list count if possible
-    for (group_index = igmp_interface->group_list_count - 1; group_index > igmp_interface->group_list_fixed_limit; group_index -= 1)
+    // Remove the group from the hash and return the slot to the free list
+    igmp_group_hash_del(igmp_interface, igmp_group);
+    igmp_interface->group_free_list[igmp_interface->group_free_list_count] = group_index;
+    igmp_interface->group_free_list_count += 1;
+}
+
+
+//
+// Set the group membership deadline
+//
+// NB: Extending the deadline of a scheduled group timer only records the new
+//     deadline. The timer is only rescheduled if the deadline moves earlier.
+//
+static void igmp_group_set_deadline(
+    igmp_group_t *              igmp_group,
+    unsigned int                millis)
+{
+    clock_gettime(CLOCK_MONOTONIC, &igmp_group->group_deadline);
+    timespec_add_millis(&igmp_group->group_deadline, millis);
+
+    if (igmp_group->group_timer.heap_index &&
+        timespec_delta_millis(&igmp_group->group_timer.timespec, &igmp_group->group_deadline) >= 0)
     {
-        if (igmp_interface->group_list[group_index].active)
-        {
-            break;
-        }
-        igmp_interface->group_list_count -= 1;
+        return;
     }
+    evm_add_timer(igmp_evm, &igmp_group->group_timer, millis, igmp_group_timeout, igmp_group);
 }
 
 
@@ -579,6 +1018,17 @@ static void igmp_v1_host_timeout(
     void *                      arg)
 {
     igmp_group_t *              igmp_group = arg;
+    struct timespec             now;
+    long                        millis;
+
+    // If the deadline has been extended, rearm the timer for the remaining time
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    millis = timespec_delta_millis(&now, &igmp_group->v1_host_deadline);
+    if (millis > 0)
+    {
+        evm_add_timer(igmp_evm, &igmp_group->v1_host_timer, (unsigned int) millis, igmp_v1_host_timeout, igmp_group);
+        return;
+    }
 
     // Debug logging
     if (debug_level >= 3)
@@ -590,6 +1040,28 @@ static void igmp_v1_host_timeout(
 }
 
 
+//
+// Set the v1 host present deadline
+//
+// NB: As with the group membership deadline, the timer is only rescheduled if
+//     the deadline moves earlier.
+//
+static void igmp_v1_host_set_deadline(
+    igmp_group_t *              igmp_group,
+    unsigned int                millis)
+{
+    clock_gettime(CLOCK_MONOTONIC, &igmp_group->v1_host_deadline);
+    timespec_add_millis(&igmp_group->v1_host_deadline, millis);
+
+    if (igmp_group->v1_host_timer.heap_index &&
+        timespec_delta_millis(&igmp_group->v1_host_timer.timespec, &igmp_group->v1_host_deadline) >= 0)
+    {
+        return;
+    }
+    evm_add_timer(igmp_evm, &igmp_group->v1_host_timer, millis, igmp_v1_host_timeout, igmp_group);
+}
+
+
 //
 // Find a group in the group list for an interface
 //
@@ -597,8 +1069,8 @@ static igmp_group_t * igmp_interface_find_group(
     igmp_interface_t *          igmp_interface,
     const uint8_t *             mcast_addr)
 {
-    igmp_group_t *              igmp_group;
-    igmp_group_t *              first_empty_slot = NULL;
+    igmp_group_t *              first_empty_slot;
+    unsigned int                entry;
     unsigned int                group_index;
 
     // Ignore local scope multicast addresses (224.0.0.0/24)
@@ -607,55 +1079,34 @@ static igmp_group_t * igmp_interface_find_group(
             return NULL;
     }
 
-    // Look for the group in the fixed group list for the interface
-    for (group_index = 0; group_index < igmp_interface->group_list_fixed_limit; group_index += 1)
+    // Look for the group in the hash
+    // NB: The hash holds all configured groups and the active non configured groups
+    entry = igmp_group_hash_entry(igmp_interface, mcast_addr);
+    if (igmp_interface->group_hash[entry])
     {
-        igmp_group = &igmp_interface->group_list[group_index];
-
-        // If the group matches, return it
-        if (MCB_IP4_ADDR_CMP(igmp_group->mcast_addr, mcast_addr) == 0)
-        {
-            return igmp_group;
-        }
+        return &igmp_interface->group_list[igmp_interface->group_hash[entry] - 1];
     }
 
-    // Look for the group in the dynamic group list for the interface
-    for (group_index = igmp_interface->group_list_fixed_limit; group_index < igmp_interface->group_list_count; group_index += 1)
+    // If the group was not found, use the slot at the top of the free list
+    // NB: The slot remains on the free list until the group is activated
+    if (igmp_interface->group_free_list_count == 0)
     {
-        igmp_group = &igmp_interface->group_list[group_index];
-
-        // Is this slot active?
-        if (igmp_group->active)
-        {
-            // If the group exists, return it
-            if (MCB_IP4_ADDR_CMP(igmp_group->mcast_addr, mcast_addr) == 0)
-            {
-                return igmp_group;
-            }
-        }
-        else if (first_empty_slot == NULL)
-        {
-            // Make note the first empty slot we see
-            first_empty_slot = igmp_group;
-        }
+        igmp_log(igmp_interface, mcast_addr, "Group list full -- group ignored");
+        return NULL;
     }
-
-    // If the group was not found, and no existing empty slot was seen, see if we can add one
-    if (first_empty_slot == NULL)
+    group_index = igmp_interface->group_free_list[igmp_interface->group_free_list_count - 1];
+    first_empty_slot = &igmp_interface->group_list[group_index];
+    if (group_index >= igmp_interface->group_list_count)
     {
-        // Is the group list full?
-        if (igmp_interface->group_list_count >= igmp_interface->group_list_allocated)
-        {
-            igmp_log(igmp_interface, mcast_addr, "Group list full -- group ignored");
-            return NULL;
-        }
-
-        // Increase the list count
-        first_empty_slot = &igmp_interface->group_list[igmp_interface->group_list_count];
-        igmp_interface->group_list_count += 1;
+        igmp_interface->group_list_count = group_index + 1;
     }
 
-    // Clear the empty slot and set the address
+    // Cancel any timers remaining from the slot's previous use, then clear the
+    // empty slot and set the address
+    evm_del_timer(igmp_evm, &first_empty_slot->group_timer);
+    evm_del_timer(igmp_evm, &first_empty_slot->v1_host_timer);
+    evm_del_timer(igmp_evm, &first_empty_slot->query_timer);
+    evm_del_timer(igmp_evm, &first_empty_slot->source_timer);
     memset(first_empty_slot, 0, sizeof(*first_empty_slot));
     first_empty_slot->igmp_interface = igmp_interface;
     MCB_IP4_ADDR_CPY(first_empty_slot->mcast_addr, mcast_addr);
@@ -681,7 +1132,7 @@ static void handle_igmp_mrd_solicitation(
         logger("IGMP(%s) [%s]: received Multicast Router Solicitation\n", igmp_interface->name, src_addr_str);
     }
 
-    evm_del_timer(igmp_evm, igmp_send_mrd_advertisement, igmp_interface);
+    evm_del_timer(igmp_evm, &igmp_interface->mrd_timer);
     igmp_send_mrd_advertisement(igmp_interface);
 }
 
@@ -737,7 +1188,7 @@ static void handle_igmp_query(
                 igmp_querier_mode == QUERIER_MODE_DEFER)
             {
                 new_querier = 1;
-                evm_del_timer(igmp_evm, igmp_send_general_query, igmp_interface);
+                evm_del_timer(igmp_evm, &igmp_interface->general_query_timer);
             }
             else
             {
@@ -777,14 +1228,11 @@ static void handle_igmp_query(
         igmp_interface->querier_response_interval_tenths = timecode_8bit_decode(query->code);
     }
 
-    // Remove the existing querier timeout timer
-    evm_del_timer(igmp_evm, igmp_querier_timeout, igmp_interface);
-
-    // Set a timer to re-enable querying if the active querier times out
+    // Set (or reset) a timer to re-enable querying if the active querier times out
     millis = (igmp_interface->querier_robustness *
               igmp_interface->querier_interval_sec +
               igmp_interface->querier_response_interval_tenths / 20) * 1000;
-    evm_add_timer(igmp_evm, millis, igmp_querier_timeout, igmp_interface);
+    evm_add_timer(igmp_evm, &igmp_interface->querier_timer, millis, igmp_querier_timeout, igmp_interface);
 
     // If the S flag is set, we're done
     if (v3_flag && query->s_flag)
@@ -808,12 +1256,9 @@ static void handle_igmp_query(
             return;
         }
 
-        // Remove the existing group membership timer
-        evm_del_timer(igmp_evm, igmp_group_timeout, igmp_group);
-
-        // Set the group membership timer
+        // Reset the group membership timer
         millis = igmp_interface->querier_robustness * igmp_interface->querier_response_interval_tenths * 100 + GRACE_MILLIS;
-        evm_add_timer(igmp_evm, millis, igmp_group_timeout, igmp_group);
+        igmp_group_set_deadline(igmp_group, millis);
     }
 }
 
@@ -826,18 +1271,22 @@ static void igmp_join_common(
     igmp_group_t *              igmp_group)
 {
     unsigned int                interface_index;
-    unsigned int                millis;
 
-    // Was the group already active?
-    if (igmp_group->active)
-    {
-        // Cancel the existing group timeout
-        evm_del_timer(igmp_evm, igmp_group_timeout, igmp_group);
-    }
-    else
+    // Is the group becoming active?
+    if (igmp_group->active == 0)
     {
         igmp_group->active = 1;
 
+        // If this is a non configured group, take the slot off the free list and add the group to the hash
+        // NB: The slot is at the top of the free list (see igmp_interface_find_group). Groups registered
+        //     after startup are already in the hash.
+        if ((unsigned int) (igmp_group - igmp_interface->group_list) >= igmp_interface->group_list_fixed_limit &&
+            igmp_group->bridge_interface_list_count == 0)
+        {
+            igmp_interface->group_free_list_count -= 1;
+            igmp_group_hash_add(igmp_interface, igmp_group);
+        }
+
         // Activate the outbound interfaces
         for (interface_index = 0; interface_index < igmp_group->bridge_interface_list_count; interface_index += 1)
         {
@@ -845,10 +1294,8 @@ static void igmp_join_common(
         }
     }
 
-    // Set a timer for the group
-    millis = (igmp_interface->querier_robustness * igmp_interface->querier_interval_sec +
-              igmp_interface->querier_response_interval_tenths / 10) * 1000;
-    evm_add_timer(igmp_evm, millis, igmp_group_timeout, igmp_group);
+    // Set (or reset) the timer for the group
+    igmp_group_set_deadline(igmp_group, igmp_membership_interval_millis(igmp_interface));
 }
 
 
@@ -885,12 +1332,10 @@ static void igmp_leave_common(
         return;
     }
 
-    // Remove the existing group membership timer
-    evm_del_timer(igmp_evm, igmp_group_timeout, igmp_group);
-
-    // Set the group membership timer
+    // Reset the group membership timer and the source deadlines
     millis = igmp_interface->querier_robustness * igmp_interface->querier_lastmbr_interval_tenths * 100 + GRACE_MILLIS;
-    evm_add_timer(igmp_evm, millis, igmp_group_timeout, igmp_group);
+    igmp_group_set_deadline(igmp_group, millis);
+    igmp_group_lower_sources(igmp_group, millis);
 
     // Send the first query
     igmp_group->group_queries_remaining = igmp_interface->querier_robustness;
@@ -909,7 +1354,6 @@ static void handle_igmp_v1_report(
 {
     mcb_igmp_t *                igmp = (mcb_igmp_t *) igmp_buffer;
     igmp_group_t *              igmp_group;
-    unsigned int                millis;
     char                        src_addr_str[INET_ADDRSTRLEN] = "unknown";
     char                        group_addr_str[INET_ADDRSTRLEN] = "unknown";
 
@@ -927,21 +1371,9 @@ static void handle_igmp_v1_report(
         return;
     }
 
-    // Set or update the v1 host present timer
-    if (igmp_group->active && igmp_group->v1_host_present)
-    {
-        // Remove the existing v1 host presence timer
-        evm_del_timer(igmp_evm, igmp_v1_host_timeout, igmp_group);
-    }
-    else
-    {
-        igmp_group->v1_host_present = 1;
-    }
-
-    // Set a timer for the v1 host presence
-    millis = (igmp_interface->querier_robustness * igmp_interface->querier_interval_sec +
-              igmp_interface->querier_response_interval_tenths / 10) * 1000;
-    evm_add_timer(igmp_evm, millis, igmp_v1_host_timeout, igmp_group);
+    // Set (or extend) the deadline for the v1 host presence
+    igmp_group->v1_host_present = 1;
+    igmp_v1_host_set_deadline(igmp_group, igmp_membership_interval_millis(igmp_interface));
 
     // Debug logging
     if (debug_level >= 3)
@@ -952,6 +1384,7 @@ static void handle_igmp_v1_report(
     }
 
     // Update the group
+    igmp_group_add_sources(igmp_interface, igmp_group, NULL, 0);
     igmp_join_common(igmp_interface, igmp_group);
 }
 
@@ -993,6 +1426,7 @@ static void handle_igmp_v2_report(
     }
 
     // Update the group
+    igmp_group_add_sources(igmp_interface, igmp_group, NULL, 0);
     igmp_join_common(igmp_interface, igmp_group);
 }
 
@@ -1097,7 +1531,9 @@ static void handle_igmp_v3_report(
                 break;
 
             case MCB_REC_BLOCK_OLD_SOURCES:
-                if (group_record->num_srcs)
+                // Blocking sources that are not being forwarded changes nothing
+                if (group_record->num_srcs &&
+                    igmp_group_has_sources(igmp_group, (const uint8_t *) group_record->srcs, num_srcs) == 0)
                 {
                     continue;
                 }
@@ -1112,7 +1548,24 @@ static void handle_igmp_v3_report(
         // Update the group
         if (is_join)
         {
+            // NB: The sources are updated before the group is activated so that
+            //     the filter is in place before packets are forwarded
+            if (group_record->type == MCB_REC_MODE_IS_EXCLUDE || group_record->type == MCB_REC_CHANGE_TO_EXCLUDE)
+            {
+                igmp_group_add_sources(igmp_interface, igmp_group, NULL, 0);
+            }
+            else
+            {
+                igmp_group_add_sources(igmp_interface, igmp_group, (const uint8_t *) group_record->srcs, num_srcs);
+            }
             igmp_join_common(igmp_interface, igmp_group);
+
+            // A change to include mode may end the listener's interest in other
+            // sources, so query for the sources that remain wanted
+            if (group_record->type == MCB_REC_CHANGE_TO_INCLUDE && igmp_group->bridge_interface_list_count)
+            {
+                igmp_leave_common(igmp_interface, igmp_group);
+            }
         }
         else
         {
@@ -1165,13 +1618,11 @@ static void handle_igmp_v2_leave(
 //
 // Process an incoming packet
 //
-static void igmp_receive(
-    void *                      arg)
+static void igmp_process_packet(
+    igmp_interface_t *          igmp_interface,
+    const unsigned char *       packet,
+    unsigned int                packet_len)
 {
-    igmp_interface_t *          igmp_interface = arg;
-    struct pcap_pkthdr          pkthdr;
-    const unsigned char *       packet;
-    unsigned int                packet_len;
     const mcb_ethernet_t *      eth;
     const mcb_ip4_t *           ip;
     const mcb_ip4_ra_opt_t *    ip_ra;
@@ -1180,14 +1631,6 @@ static void igmp_receive(
     unsigned int                ip_total_len;
     uint16_t                    calculated_csum;
 
-    // Read the packet
-    packet = pcap_next(igmp_interface->pcap, &pkthdr);
-    if (packet == NULL)
-    {
-        return;
-    }
-    packet_len = pkthdr.caplen;
-
     // Confirm the header is large enough to contain ethernet and IPv4 headers
     if (packet_len < sizeof(mcb_ethernet_t) + sizeof(mcb_ip4_t))
     {
@@ -1322,12 +1765,58 @@ static void igmp_receive(
 }
 
 
+//
+// Process a packet delivered by pcap_dispatch
+//
+static void igmp_dispatch_packet(
+    unsigned char *             arg,
+    const struct pcap_pkthdr *  pkthdr,
+    const unsigned char *       packet)
+{
+    igmp_interface_t *          igmp_interface = (igmp_interface_t *) arg;
+
+    // Ignore packets that were truncated by the capture length
+    if (pkthdr->caplen < pkthdr->len)
+    {
+        igmp_log(igmp_interface, NULL, "Packet exceeds the capture length -- packet ignored");
+        return;
+    }
+
+    igmp_process_packet(igmp_interface, packet, pkthdr->caplen);
+}
+
+
+//
+// Receive all queued incoming packets (up to the dispatch count)
+//
+// Returns non-zero if more packets may be queued
+//
+static unsigned int igmp_receive(
+    void *                      arg)
+{
+    igmp_interface_t *          igmp_interface = arg;
+    int                         r;
+
+    r = pcap_dispatch(igmp_interface->pcap, IGMP_DISPATCH_COUNT, igmp_dispatch_packet, (unsigned char *) igmp_interface);
+    if (r < 0)
+    {
+        logger("IGMP(%s): pcap_dispatch failed: %s\n", igmp_interface->name, pcap_geterr(igmp_interface->pcap));
+        return 0;
+    }
+
+    return r >= IGMP_DISPATCH_COUNT;
+}
+
+
 // Pcap
 void igmp_pcap_create(
     igmp_interface_t *          igmp_interface)
 {
     pcap_t *                    pcap;
     struct bpf_program          program;
+#if defined(USE_PACKET_ALLMULTI)
+    struct packet_mreq          mreq;
+#endif
 
     int                         r;
     int                         fd;
@@ -1341,12 +1830,17 @@ void igmp_pcap_create(
     }
 
     // Set pcap options
-    r = pcap_set_snaplen(pcap, MCAST_MAX_PACKET_SIZE);
+    r = pcap_set_snaplen(pcap, IGMP_SNAPLEN);
     if (r != 0)
     {
         fatal("pcap_set_snaplen failed: %d\n", r);
     }
+#if defined(USE_PACKET_ALLMULTI)
+    // NB: All multicast membership is added after activation
+    r = pcap_set_promisc(pcap, 0);
+#else
     r = pcap_set_promisc(pcap, 1);
+#endif
     if (r != 0)
     {
         fatal("pcap_set_promisc failed: %d\n", r);
@@ -1379,13 +1873,36 @@ void igmp_pcap_create(
     }
     pcap_freecode(&program);
 
-    // Add the fd to the event manager
+    // Set non-blocking
+    r = pcap_setnonblock(pcap, 1, errbuf);
+    if (r != 0)
+    {
+        fatal("pcap_setnonblock failed: %s\n", errbuf);
+    }
+
+    // Get the fd
     fd = pcap_get_selectable_fd(pcap);
     if (fd < 0)
     {
         fatal("pcap_get_selectable_fd for IGMP interface %s failed: %s\n", igmp_interface->name, pcap_geterr(pcap));
     }
-    evm_add_socket(igmp_evm, fd, igmp_receive, igmp_interface);
+
+#if defined(USE_PACKET_ALLMULTI)
+    // Receive all multicast packets on the interface
+    // NB: The pcap fd is the AF_PACKET socket. Reports are sent to the group address, so
+    //     all multicast is required, but unicast traffic does not need to be received.
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.mr_ifindex = igmp_interface->if_index;
+    mreq.mr_type = PACKET_MR_ALLMULTI;
+    r = setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+    if (r == -1)
+    {
+        fatal("setsockopt (PACKET_ADD_MEMBERSHIP) for IGMP interface %s failed: %s\n", igmp_interface->name, strerror(errno));
+    }
+#endif
+
+    // Add the fd to the event manager
+    evm_add_drain_socket(igmp_evm, fd, igmp_receive, igmp_interface, IGMP_DRAIN_BUDGET);
 
     // Store the pcap session
     igmp_interface->pcap = pcap;
@@ -1393,106 +1910,138 @@ void igmp_pcap_create(
 
 
 //
-// Register a bridge interface for IGMP monitoring
+// Find the igmp interface for an interface index
 //
-void igmp_register_interface(
-    bridge_interface_t *        bridge_interface)
+static igmp_interface_t * igmp_find_interface(
+    unsigned int                if_index)
 {
-    bridge_instance_t *         bridge = &bridge_list[bridge_interface->bridge_index];
-    igmp_interface_t *          igmp_interface;
-    igmp_group_t *              igmp_group;
     unsigned int                interface_index;
-    unsigned int                group_index;
 
-    // Is the interface already in the igmp interface list?
     for (interface_index = 0; interface_index < igmp_interface_list_count; interface_index += 1)
     {
-        igmp_interface = &igmp_interface_list[interface_index];
-
-        if (bridge_interface->if_index == igmp_interface->if_index)
+        if (igmp_interface_list[interface_index]->if_index == if_index)
         {
-            break;
+            return igmp_interface_list[interface_index];
         }
     }
 
-    // If the interface wasn't found, add it
-    if (interface_index >= igmp_interface_list_count)
+    return NULL;
+}
+
+
+//
+// Create an igmp interface for a bridge interface and add it to the list
+//
+static igmp_interface_t * igmp_create_interface(
+    const bridge_interface_t *  bridge_interface)
+{
+    igmp_interface_t *          igmp_interface;
+
+    // Do we need to (re)allocate the igmp interface list?
+    if (igmp_interface_list_count >= igmp_interface_list_allocated)
     {
-        // Do we need to (re)allocate the igmp interface list?
-        if (interface_index >= igmp_interface_list_allocated)
+        // Determine the new allocation size
+        if (igmp_interface_list_allocated == 0)
         {
-            // Determine the new allocation size
-            if (igmp_interface_list_allocated == 0)
-            {
-                igmp_interface_list_allocated = 2;
-            }
-            else
-            {
-                igmp_interface_list_allocated *= 2;
-            }
+            igmp_interface_list_allocated = 2;
+        }
+        else
+        {
+            igmp_interface_list_allocated *= 2;
+        }
 
-            igmp_interface_list = realloc(igmp_interface_list, igmp_interface_list_allocated * sizeof(igmp_interface_t));
-            if (igmp_interface_list == NULL)
-            {
-                fatal("Cannot allocate memory for igmp interface list: %s\n", strerror(errno));
-            }
+        igmp_interface_list = realloc(igmp_interface_list, igmp_interface_list_allocated * sizeof(igmp_interface_t *));
+        if (igmp_interface_list == NULL)
+        {
+            fatal("Cannot allocate memory for igmp interface list: %s\n", strerror(errno));
         }
+    }
 
-        // Add the new igmp interface to the list
-        igmp_interface = &igmp_interface_list[interface_index];
-        igmp_interface_list_count += 1;
+    // Allocate the new igmp interface and add it to the list
+    igmp_interface = calloc(1, sizeof(igmp_interface_t));
+    if (igmp_interface == NULL)
+    {
+        fatal("Cannot allocate memory for igmp interface: %s\n", strerror(errno));
+    }
+    igmp_interface_list[igmp_interface_list_count] = igmp_interface;
+    igmp_interface_list_count += 1;
 
-        // Initialize the new igmp interface
-        memset(igmp_interface, 0, sizeof(*igmp_interface));
-        igmp_interface->name = bridge_interface->name;
-        igmp_interface->if_index = bridge_interface->if_index;
-        MCB_ETH_ADDR_CPY(igmp_interface->if_mac_addr, bridge_interface->mac_addr);
-        MCB_IP4_ADDR_CPY(igmp_interface->if_addr, &bridge_interface->ipv4_addr);
+    // Initialize the new igmp interface
+    igmp_interface->name = strdup(bridge_interface->name);
+    if (igmp_interface->name == NULL)
+    {
+        fatal("Cannot allocate memory for interface name: %s\n", strerror(errno));
     }
+    igmp_interface->if_index = bridge_interface->if_index;
+    MCB_ETH_ADDR_CPY(igmp_interface->if_mac_addr, bridge_interface->mac_addr);
+    MCB_IP4_ADDR_CPY(igmp_interface->if_addr, &bridge_interface->ipv4_addr);
+
+    return igmp_interface;
+}
+
+
+//
+// Find or add a configured group of an igmp interface
+//
+// NB: Only used before the group list is finalized
+//
+static igmp_group_t * igmp_add_group(
+    igmp_interface_t *          igmp_interface,
+    const struct in_addr *      mcast_addr)
+{
+    igmp_group_t *              igmp_group;
+    unsigned int                group_index;
 
     // Is the group already in the list for this igmp interface?
     for (group_index = 0; group_index < igmp_interface->group_list_count; group_index += 1)
     {
         igmp_group = &igmp_interface->group_list[group_index];
-        if (MCB_IP4_ADDR_CMP(igmp_group->mcast_addr, &bridge->dst_addr.sin.sin_addr) == 0)
+        if (MCB_IP4_ADDR_CMP(igmp_group->mcast_addr, mcast_addr) == 0)
         {
-            break;
+            return igmp_group;
         }
     }
 
-    // If the group wasn't found, add it
-    if (group_index >= igmp_interface->group_list_count)
+    // Do we need to (re)allocate the group list?
+    if (group_index >= igmp_interface->group_list_allocated)
     {
-        // Do we need to (re)allocate the group list?
-        if (group_index >= igmp_interface->group_list_allocated)
+        // Determine the new allocation size
+        if (igmp_interface->group_list_allocated == 0)
         {
-            // Determine the new allocation size
-            if (igmp_interface->group_list_allocated == 0)
-            {
-                igmp_interface->group_list_allocated = 1;
-            }
-            else
-            {
-                igmp_interface->group_list_allocated *= 2;
-            }
+            igmp_interface->group_list_allocated = 1;
+        }
+        else
+        {
+            igmp_interface->group_list_allocated *= 2;
+        }
 
-            igmp_interface->group_list = realloc(igmp_interface->group_list, igmp_interface->group_list_allocated * sizeof(igmp_group_t));
-            if (igmp_interface->group_list == NULL)
-            {
-                fatal("Cannot allocate memory for igmp group list: %s\n", strerror(errno));
-            }
+        igmp_interface->group_list = realloc(igmp_interface->group_list, igmp_interface->group_list_allocated * sizeof(igmp_group_t));
+        if (igmp_interface->group_list == NULL)
+        {
+            fatal("Cannot allocate memory for igmp group list: %s\n", strerror(errno));
         }
+    }
 
-        // Add a new igmp group to the igmp interface's list
-        igmp_group = &igmp_interface->group_list[group_index];
-        igmp_interface->group_list_count += 1;
+    // Add a new igmp group to the igmp interface's list
+    igmp_group = &igmp_interface->group_list[group_index];
+    igmp_interface->group_list_count += 1;
+
+    // Initialize the new group
+    memset(igmp_group, 0, sizeof(*igmp_group));
+    // NB: igmp->igmp_interface will be set after the group list is finalized
+    MCB_IP4_ADDR_CPY(igmp_group->mcast_addr, mcast_addr);
+
+    return igmp_group;
+}
 
-        // Initialize the new group
-        memset(igmp_group, 0, sizeof(*igmp_group));
-        // NB: igmp->igmp_interface will be set after the group list is finalized
-        MCB_IP4_ADDR_CPY(igmp_group->mcast_addr, &bridge->dst_addr.sin.sin_addr.s_addr);
-    }
 
+//
+// Add a bridge interface to the list of bridge interfaces of a group
+//
+static void igmp_group_add_bridge_interface(
+    igmp_group_t *              igmp_group,
+    bridge_interface_t *        bridge_interface)
+{
     // Do we need to (re)allocate the list of bridge interfaces for this group?
     if (igmp_group->bridge_interface_list_count >= igmp_group->bridge_interface_list_allocated)
     {
@@ -1519,6 +2068,26 @@ void igmp_register_interface(
 }
 
 
+//
+// Register a bridge interface for IGMP monitoring of a group
+//
+void igmp_register_interface(
+    bridge_interface_t *        bridge_interface,
+    const struct in_addr *      mcast_addr)
+{
+    igmp_interface_t *          igmp_interface;
+
+    // If the interface isn't already in the igmp interface list, add it
+    igmp_interface = igmp_find_interface(bridge_interface->if_index);
+    if (igmp_interface == NULL)
+    {
+        igmp_interface = igmp_create_interface(bridge_interface);
+    }
+
+    igmp_group_add_bridge_interface(igmp_add_group(igmp_interface, mcast_addr), bridge_interface);
+}
+
+
 //
 // IGMP thread
 //
@@ -1563,7 +2132,7 @@ static void igmp_dump_config(void)
 
     for (interface_index = 0; interface_index < igmp_interface_list_count; interface_index += 1)
     {
-        igmp_interface = &igmp_interface_list[interface_index];
+        igmp_interface = igmp_interface_list[interface_index];
         if (inet_ntop(AF_INET, igmp_interface->if_addr, addr_str, sizeof(addr_str)) == NULL)
         {
             snprintf(addr_str, sizeof(addr_str), "[unknown]");
@@ -1589,30 +2158,100 @@ static void igmp_dump_config(void)
 
 
 //
-// Initialize the IGMP infrastructure
+// Finalize the group table of an interface
 //
-void initialize_igmp(
-    unsigned int                dump_config)
+static void igmp_finalize_interface(
+    igmp_interface_t *          igmp_interface)
 {
-    igmp_interface_t *          igmp_interface;
     igmp_group_t *              igmp_group;
-    unsigned int                interface_index;
     unsigned int                group_index;
-    unsigned int                total_groups = 0;
-    uint32_t                    haddr;
+    unsigned int                hash_size;
 
-    // Nothing to do if there are no interfaces
-    if (igmp_interface_list_count < 1)
+    // Set the fixed group limit
+    igmp_interface->group_list_fixed_limit = igmp_interface->group_list_count;
+
+    // Adjust the group list size to allow for non configured groups
+    igmp_interface->group_list_allocated = igmp_interface->group_list_count + non_configured_groups;
+    igmp_interface->group_list = realloc(igmp_interface->group_list, igmp_interface->group_list_allocated * sizeof(igmp_group_t));
+    if (igmp_interface->group_list == NULL)
     {
-        return;
+        fatal("Cannot allocate memory for igmp group list: %s\n", strerror(errno));
     }
 
-    // Dump the IGMP configuration
-    if (dump_config)
+    // Initialize the new groups
+    memset(&igmp_interface->group_list[igmp_interface->group_list_count], 0,
+        (igmp_interface->group_list_allocated - igmp_interface->group_list_count) * sizeof(igmp_group_t));
+
+    // Now that all the (re)allocation is done, set the interface pointers in the groups
+    for (group_index = 0; group_index < igmp_interface->group_list_count; group_index += 1)
     {
-        igmp_dump_config();
+        igmp_group = &igmp_interface->group_list[group_index];
+        igmp_group->igmp_interface = igmp_interface;
     }
 
+    // Allocate the group hash with a load factor of at most one half
+    hash_size = 8;
+    while (hash_size < igmp_interface->group_list_allocated * 2)
+    {
+        hash_size *= 2;
+    }
+    igmp_interface->group_hash = calloc(hash_size, sizeof(unsigned int));
+    if (igmp_interface->group_hash == NULL)
+    {
+        fatal("Cannot allocate memory for igmp group hash: %s\n", strerror(errno));
+    }
+    igmp_interface->group_hash_mask = hash_size - 1;
+
+    // Add the configured groups to the hash
+    for (group_index = 0; group_index < igmp_interface->group_list_count; group_index += 1)
+    {
+        igmp_group_hash_add(igmp_interface, &igmp_interface->group_list[group_index]);
+    }
+
+    // Allocate the free list, with the lowest index at the top
+    igmp_interface->group_free_list = calloc(non_configured_groups + 1, sizeof(unsigned int));
+    if (igmp_interface->group_free_list == NULL)
+    {
+        fatal("Cannot allocate memory for igmp group free list: %s\n", strerror(errno));
+    }
+    for (group_index = igmp_interface->group_list_allocated; group_index > igmp_interface->group_list_fixed_limit; group_index -= 1)
+    {
+        igmp_interface->group_free_list[igmp_interface->group_free_list_count] = group_index - 1;
+        igmp_interface->group_free_list_count += 1;
+    }
+}
+
+
+//
+// Get the number of timers required by the interfaces
+//
+// NB: Timers are embedded in the interface and group structures, and the heap holds
+//     at most one entry for each. Each interface has three timers (MRD, general query
+//     and querier) and each group slot has four (group, v1 host, query and source),
+//     so the count is exact.
+//
+static unsigned int igmp_timer_count(void)
+{
+    unsigned int                interface_index;
+    unsigned int                total_groups = 0;
+
+    for (interface_index = 0; interface_index < igmp_interface_list_count; interface_index += 1)
+    {
+        total_groups += igmp_interface_list[interface_index]->group_list_allocated;
+    }
+
+    return igmp_interface_list_count * 3 + total_groups * 4;
+}
+
+
+//
+// Finalize the interface and group tables and create the event manager
+//
+static void igmp_finalize_interfaces(void)
+{
+    unsigned int                interface_index;
+    uint32_t                    haddr;
+
     // Initialize special addresses
     haddr = htonl(MCB_IP4_ALL_SYSTEMS);
     MCB_IP4_ADDR_CPY(allhosts_addr, &haddr);
@@ -1622,57 +2261,108 @@ void initialize_igmp(
     // Finalize the interfaces and groups
     for (interface_index = 0; interface_index < igmp_interface_list_count; interface_index += 1)
     {
-        igmp_interface = &igmp_interface_list[interface_index];
-
-        // Set the fixed group limit
-        igmp_interface->group_list_fixed_limit = igmp_interface->group_list_count;
+        igmp_finalize_interface(igmp_interface_list[interface_index]);
+    }
 
-        // Adjust the group list size to allow for non configured groups
-        igmp_interface->group_list_allocated = igmp_interface->group_list_count + non_configured_groups;
-        igmp_interface->group_list = realloc(igmp_interface->group_list, igmp_interface->group_list_allocated * sizeof(igmp_group_t));
-        if (igmp_interface->group_list == NULL)
-        {
-            fatal("Cannot allocate memory for igmp group list: %s\n", strerror(errno));
-        }
+    // Create the event manager
+    igmp_evm = evm_create(igmp_interface_list_count, igmp_timer_count());
+    if (igmp_evm == NULL)
+    {
+        fatal("Cannot create event manager\n");
+    }
+}
 
-        // Initialize the new groups
-        memset(&igmp_interface->group_list[igmp_interface->group_list_count], 0,
-            (igmp_interface->group_list_allocated - igmp_interface->group_list_count) * sizeof(igmp_group_t));
 
-        // Now that all the (re)allocation is done, set the interface pointers in the groups
-        for (group_index = 0; group_index < igmp_interface->group_list_count; group_index += 1)
-        {
-            igmp_group = &igmp_interface->group_list[group_index];
-            igmp_group->igmp_interface = igmp_interface;
-        }
+//
+// Initialize the IGMP infrastructure
+//
+void initialize_igmp(
+    unsigned int                dump_config)
+{
+    igmp_interface_t *          igmp_interface;
+    unsigned int                interface_index;
 
-        total_groups += igmp_interface->group_list_allocated;
+    // Nothing to do if there are no interfaces
+    if (igmp_interface_list_count < 1)
+    {
+        return;
     }
 
-    // Create the event manager
-    // NB: The number of timers is a theoretical maximum. In actual use, the number of timers
-    //     is expected to be significantly less than half of this number.
-    igmp_evm = evm_create(igmp_interface_list_count, igmp_interface_list_count * 2 + total_groups * 2);
-    if (igmp_evm == NULL)
+    // Dump the IGMP configuration
+    if (dump_config)
     {
-        fatal("Cannot create event manager\n");
+        igmp_dump_config();
     }
 
+    // Finalize the interfaces and groups
+    igmp_finalize_interfaces();
+
     // Create the pcap instances and register them with the event manager
     for (interface_index = 0; interface_index < igmp_interface_list_count; interface_index += 1)
     {
-        igmp_interface = &igmp_interface_list[interface_index];
+        igmp_interface = igmp_interface_list[interface_index];
         igmp_pcap_create(igmp_interface);
     }
 }
 
 
+//
+// Set the default querier values for an interface
+//
+static void igmp_set_default_querier(
+    igmp_interface_t *          igmp_interface)
+{
+    igmp_interface->querier_robustness = MCB_IGMP_ROBUSTNESS;
+    igmp_interface->querier_interval_sec = MCB_IGMP_QUERY_INTERVAL;
+    igmp_interface->querier_response_interval_tenths = MCB_IGMP_RESPONSE_INTERVAL;
+    igmp_interface->querier_lastmbr_interval_tenths = MCB_IGMP_LASTMBR_INTERVAL;
+
+    // Set the querier address to all ones allowing anyone to win an election
+    MCB_IP4_ADDR_SET(igmp_interface->querier_addr, 0xff);
+}
+
+
+//
+// Start the querier and router advertisements of an interface
+//
+static void igmp_start_interface(
+    igmp_interface_t *          igmp_interface)
+{
+    // Build the multicast router advertisement packet
+    igmp_build_mrd_advertisement_packet(igmp_interface);
+
+    // Send the first multicast router advertisement (no jitter)
+    igmp_interface->mrd_initial_advertisements_remaining = MCB_MRD_INITIAL_COUNT - 1;
+    igmp_send_mrd_advertisement(igmp_interface);
+
+    // Build the query packets
+    igmp_build_query_packets(igmp_interface);
+
+    // Is quick querier mode enabled?
+    if (igmp_querier_mode == QUERIER_MODE_QUICK)
+    {
+        igmp_activate_querier_mode(igmp_interface);
+    }
+    else
+    {
+        // Set default querier values
+        igmp_set_default_querier(igmp_interface);
+
+        // Is querier mode enabled?
+        if (igmp_querier_mode)
+        {
+            // Set a timer to activate as a querier (125.5 seconds)
+            evm_add_timer(igmp_evm, &igmp_interface->querier_timer, 125500, igmp_querier_timeout, igmp_interface);
+        }
+    }
+}
+
+
 //
 // Start the IGMP thread
 //
 void start_igmp(void)
 {
-    igmp_interface_t *          igmp_interface;
     unsigned int                interface_index;
     pthread_t                   thread_id;
     long                        seed;
@@ -1693,47 +2383,319 @@ void start_igmp(void)
     // Set up the querier for each interface
     for (interface_index = 0; interface_index < igmp_interface_list_count; interface_index += 1)
     {
-        igmp_interface = &igmp_interface_list[interface_index];
+        igmp_start_interface(igmp_interface_list[interface_index]);
+    }
 
-        // Build the multicast router advertisement packet
-        igmp_build_mrd_advertisement_packet(igmp_interface);
+    // Start the thread
+    r = pthread_create(&thread_id, NULL, &igmp_thread, NULL);
+    if (r != 0)
+    {
+        fatal("cannot create IGMP thread: %s\n", strerror(r));
+    }
+}
 
-        // Send the first multicast router advertisement (no jitter)
-        igmp_interface->mrd_initial_advertisements_remaining = MCB_MRD_INITIAL_COUNT - 1;
-        igmp_send_mrd_advertisement(igmp_interface);
 
-        // Build the query packets
-        igmp_build_query_packets(igmp_interface);
+// Request to add or remove a bridge interface, run on the IGMP thread
+typedef struct igmp_call
+{
+    bridge_interface_t *        bridge_interface;
+    const struct in_addr *      mcast_addr;
+} igmp_call_t;
+
+
+//
+// Add a bridge interface to a group (IGMP thread)
+//
+static void igmp_add_interface_call(
+    void *                      arg)
+{
+    igmp_call_t *               call = arg;
+    bridge_interface_t *        bridge_interface = call->bridge_interface;
+    igmp_interface_t *          igmp_interface;
+    igmp_group_t *              igmp_group;
+    unsigned int                entry;
+    unsigned int                group_index;
+    char                        addr_str[INET_ADDRSTRLEN] = "unknown";
+
+    // If the interface is new, create, finalize and start it
+    igmp_interface = igmp_find_interface(bridge_interface->if_index);
+    if (igmp_interface == NULL)
+    {
+        igmp_interface = igmp_create_interface(bridge_interface);
+        igmp_group_add_bridge_interface(igmp_add_group(igmp_interface, call->mcast_addr), bridge_interface);
+        igmp_finalize_interface(igmp_interface);
+        evm_grow(igmp_evm, igmp_interface_list_count, igmp_timer_count());
+        igmp_pcap_create(igmp_interface);
+        igmp_start_interface(igmp_interface);
+        return;
+    }
 
-        // Is quick querier mode enabled?
-        if (igmp_querier_mode == QUERIER_MODE_QUICK)
+    // Look for the group in the hash
+    entry = igmp_group_hash_entry(igmp_interface, (const uint8_t *) call->mcast_addr);
+    if (igmp_interface->group_hash[entry])
+    {
+        igmp_group = &igmp_interface->group_list[igmp_interface->group_hash[entry] - 1];
+    }
+    else
+    {
+        // Take a non configured slot for the group
+        // NB: The group list cannot be reallocated while its timers are scheduled
+        if (igmp_interface->group_free_list_count == 0)
         {
-            igmp_activate_querier_mode(igmp_interface);
+            inet_ntop(AF_INET, call->mcast_addr, addr_str, sizeof(addr_str));
+            logger("IGMP(%s) [%s]: Group list full -- registration of %s requires a restart\n",
+                igmp_interface->name, addr_str, bridge_interface->name);
+            return;
         }
-        else
+        igmp_interface->group_free_list_count -= 1;
+        group_index = igmp_interface->group_free_list[igmp_interface->group_free_list_count];
+        igmp_group = &igmp_interface->group_list[group_index];
+        if (group_index >= igmp_interface->group_list_count)
         {
-            // Set default querier values
-            igmp_interface->querier_robustness = MCB_IGMP_ROBUSTNESS;
-            igmp_interface->querier_interval_sec = MCB_IGMP_QUERY_INTERVAL;
-            igmp_interface->querier_response_interval_tenths = MCB_IGMP_RESPONSE_INTERVAL;
-            igmp_interface->querier_lastmbr_interval_tenths = MCB_IGMP_LASTMBR_INTERVAL;
+            igmp_interface->group_list_count = group_index + 1;
+        }
+
+        // Cancel any timers remaining from the slot's previous use, then clear the
+        // slot and add the group to the hash
+        evm_del_timer(igmp_evm, &igmp_group->group_timer);
+        evm_del_timer(igmp_evm, &igmp_group->v1_host_timer);
+        evm_del_timer(igmp_evm, &igmp_group->query_timer);
+        evm_del_timer(igmp_evm, &igmp_group->source_timer);
+        memset(igmp_group, 0, sizeof(*igmp_group));
+        igmp_group->igmp_interface = igmp_interface;
+        MCB_IP4_ADDR_CPY(igmp_group->mcast_addr, call->mcast_addr);
+        igmp_group_hash_add(igmp_interface, igmp_group);
+    }
 
-            // Set the querier address to all ones allowing anyone to win an election
-            MCB_IP4_ADDR_SET(igmp_interface->querier_addr, 0xff);
+    igmp_group_add_bridge_interface(igmp_group, bridge_interface);
 
-            // Is querier mode enabled?
-            if (igmp_querier_mode)
+    // If the group is active, start forwarding to the new interface
+    // NB: Sources are not tracked for a group that had no bridge interfaces, and without
+    //     a published filter the interface forwards any source
+    if (igmp_group->active)
+    {
+        interface_activate_outbound(bridge_interface);
+        if (igmp_group->source_filter_published)
+        {
+            igmp_group_update_sources(igmp_group, 1);
+        }
+    }
+}
+
+
+//
+// Delete an igmp interface (IGMP thread)
+//
+static void igmp_delete_interface(
+    unsigned int                interface_index)
+{
+    igmp_interface_t *          igmp_interface = igmp_interface_list[interface_index];
+    igmp_group_t *              igmp_group;
+    unsigned int                group_index;
+
+    igmp_log(igmp_interface, NULL, "Interface removed");
+
+    // Cancel the timers of the interface and its groups
+    evm_del_timer(igmp_evm, &igmp_interface->mrd_timer);
+    evm_del_timer(igmp_evm, &igmp_interface->general_query_timer);
+    evm_del_timer(igmp_evm, &igmp_interface->querier_timer);
+    for (group_index = 0; group_index < igmp_interface->group_list_allocated; group_index += 1)
+    {
+        igmp_group = &igmp_interface->group_list[group_index];
+        evm_del_timer(igmp_evm, &igmp_group->group_timer);
+        evm_del_timer(igmp_evm, &igmp_group->v1_host_timer);
+        evm_del_timer(igmp_evm, &igmp_group->query_timer);
+        evm_del_timer(igmp_evm, &igmp_group->source_timer);
+        free(igmp_group->bridge_interface_list);
+    }
+
+    // Close the pcap session
+    evm_del_socket(igmp_evm, pcap_get_selectable_fd(igmp_interface->pcap));
+    pcap_close(igmp_interface->pcap);
+
+    free(igmp_interface->group_list);
+    free(igmp_interface->group_hash);
+    free(igmp_interface->group_free_list);
+    free(igmp_interface->name);
+    free(igmp_interface);
+
+    // Remove the interface from the list
+    igmp_interface_list_count -= 1;
+    memmove(&igmp_interface_list[interface_index], &igmp_interface_list[interface_index + 1],
+        (igmp_interface_list_count - interface_index) * sizeof(igmp_interface_t *));
+}
+
+
+//
+// Remove a bridge interface from all groups (IGMP thread)
+//
+static void igmp_remove_interface_call(
+    void *                      arg)
+{
+    igmp_call_t *               call = arg;
+    igmp_interface_t *          igmp_interface;
+    igmp_group_t *              igmp_group;
+    unsigned int                interface_index;
+    unsigned int                group_index;
+    unsigned int                bridge_interface_index;
+    unsigned int                in_use = 0;
+
+    for (interface_index = 0; interface_index < igmp_interface_list_count; interface_index += 1)
+    {
+        if (igmp_interface_list[interface_index]->if_index == call->bridge_interface->if_index)
+        {
+            break;
+        }
+    }
+    if (interface_index >= igmp_interface_list_count)
+    {
+        return;
+    }
+    igmp_interface = igmp_interface_list[interface_index];
+
+    for (group_index = 0; group_index < igmp_interface->group_list_count; group_index += 1)
+    {
+        igmp_group = &igmp_interface->group_list[group_index];
+
+        for (bridge_interface_index = 0; bridge_interface_index < igmp_group->bridge_interface_list_count; bridge_interface_index += 1)
+        {
+            if (igmp_group->bridge_interface_list[bridge_interface_index] == call->bridge_interface)
             {
-                // Set a timer to activate as a querier (125.5 seconds)
-                evm_add_timer(igmp_evm, 125500, igmp_querier_timeout, igmp_interface);
+                break;
             }
         }
+        if (bridge_interface_index >= igmp_group->bridge_interface_list_count)
+        {
+            in_use |= igmp_group->bridge_interface_list_count;
+            continue;
+        }
+
+        // Remove the bridge interface from the group
+        igmp_group->bridge_interface_list_count -= 1;
+        memmove(&igmp_group->bridge_interface_list[bridge_interface_index], &igmp_group->bridge_interface_list[bridge_interface_index + 1],
+            (igmp_group->bridge_interface_list_count - bridge_interface_index) * sizeof(bridge_interface_t *));
+        in_use |= igmp_group->bridge_interface_list_count;
+
+        // If an inactive non configured group is no longer registered, return the slot to the free list
+        // NB: An active group is returned to the free list when it times out
+        if (igmp_group->bridge_interface_list_count == 0 && igmp_group->active == 0 &&
+            group_index >= igmp_interface->group_list_fixed_limit)
+        {
+            free(igmp_group->bridge_interface_list);
+            igmp_group->bridge_interface_list = NULL;
+            igmp_group->bridge_interface_list_allocated = 0;
+
+            igmp_group_hash_del(igmp_interface, igmp_group);
+            igmp_interface->group_free_list[igmp_interface->group_free_list_count] = group_index;
+            igmp_interface->group_free_list_count += 1;
+        }
     }
 
-    // Start the thread
-    r = pthread_create(&thread_id, NULL, &igmp_thread, NULL);
-    if (r != 0)
+    // If no bridge interfaces remain, the interface is no longer monitored
+    if (in_use == 0)
     {
-        fatal("cannot create IGMP thread: %s\n", strerror(r));
+        igmp_delete_interface(interface_index);
     }
 }
+
+
+//
+// Register a bridge interface for IGMP monitoring of a group after startup
+//
+// NB: Called by the main thread on reload. IGMP is started if it was not already.
+//
+void igmp_add_interface(
+    bridge_interface_t *        bridge_interface,
+    const struct in_addr *      mcast_addr)
+{
+    igmp_call_t                 call;
+
+    if (igmp_evm == NULL)
+    {
+        igmp_register_interface(bridge_interface, mcast_addr);
+        initialize_igmp(0);
+        start_igmp();
+        return;
+    }
+
+    call.bridge_interface = bridge_interface;
+    call.mcast_addr = mcast_addr;
+    evm_call(igmp_evm, igmp_add_interface_call, &call);
+}
+
+
+//
+// Remove a bridge interface from IGMP monitoring
+//
+// NB: Called by the main thread on reload. On return, the IGMP thread no longer
+//     references the bridge interface.
+//
+void igmp_remove_interface(
+    bridge_interface_t *        bridge_interface)
+{
+    igmp_call_t                 call;
+
+    if (igmp_evm == NULL)
+    {
+        return;
+    }
+
+    call.bridge_interface = bridge_interface;
+    call.mcast_addr = NULL;
+    evm_call(igmp_evm, igmp_remove_interface_call, &call);
+}
+
+
+#if defined(IGMP_BENCH)
+//
+// Benchmark support
+//
+// NB: These entry points run the group table and packet parser without pcap
+//     sessions or the IGMP thread. They are only built for bench/igmp-bench,
+//     which compiles this file with IGMP_BENCH defined.
+//
+
+//
+// Finalize the registered interfaces for benchmarking
+//
+void igmp_bench_initialize(void)
+{
+    unsigned int                interface_index;
+
+    if (igmp_interface_list_count < 1)
+    {
+        fatal("No IGMP interfaces registered\n");
+    }
+
+    igmp_finalize_interfaces();
+    for (interface_index = 0; interface_index < igmp_interface_list_count; interface_index += 1)
+    {
+        igmp_set_default_querier(igmp_interface_list[interface_index]);
+    }
+}
+
+
+//
+// Look up a group on an interface
+//
+// Returns non-zero if the group was found or a free slot is available
+//
+unsigned int igmp_bench_find_group(
+    unsigned int                interface_index,
+    const uint8_t *             mcast_addr)
+{
+    return igmp_interface_find_group(igmp_interface_list[interface_index], mcast_addr) != NULL;
+}
+
+
+//
+// Process a packet as if received on an interface
+//
+void igmp_bench_process_packet(
+    unsigned int                interface_index,
+    const unsigned char *       packet,
+    unsigned int                packet_len)
+{
+    igmp_process_packet(igmp_interface_list[interface_index], packet, packet_len);
+}
+#endif
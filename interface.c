@@ -29,6 +29,7 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -41,6 +42,63 @@
 #include "common.h"
 
 
+// Busy poll time and budget for sockets of busy poll bridges
+#define INTERFACE_BUSY_POLL_USECS       50
+#define INTERFACE_BUSY_POLL_BUDGET      64
+
+
+
+#if defined(USE_BUSY_POLL)
+//
+// Enable busy polling on an interface socket
+//
+// NB: Setting a busy poll time above the system default (net.core.busy_read),
+//     preferring busy polling, and raising the busy poll budget require
+//     CAP_NET_ADMIN.
+//
+static void interface_set_busy_poll(
+    bridge_interface_t *        bridge_interface,
+    int                         sock)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    const int                   usecs = INTERFACE_BUSY_POLL_USECS;
+    int                         r;
+
+    r = setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, (void *) &usecs, sizeof(usecs));
+    if (r == -1)
+    {
+        fatal("setsockopt (SO_BUSY_POLL) for %s on %s failed: %s\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge_interface->name, strerror(errno));
+    }
+
+#if defined(SO_PREFER_BUSY_POLL)
+    {
+        const int               on = 1;
+
+        r = setsockopt(sock, SOL_SOCKET, SO_PREFER_BUSY_POLL, (void *) &on, sizeof(on));
+        if (r == -1)
+        {
+            fatal("setsockopt (SO_PREFER_BUSY_POLL) for %s on %s failed: %s\n",
+                AF_FAMILY_TO_STRING(bridge->family), bridge_interface->name, strerror(errno));
+        }
+    }
+#endif
+
+#if defined(SO_BUSY_POLL_BUDGET)
+    {
+        const int               budget = INTERFACE_BUSY_POLL_BUDGET;
+
+        r = setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL_BUDGET, (void *) &budget, sizeof(budget));
+        if (r == -1)
+        {
+            fatal("setsockopt (SO_BUSY_POLL_BUDGET) for %s on %s failed: %s\n",
+                AF_FAMILY_TO_STRING(bridge->family), bridge_interface->name, strerror(errno));
+        }
+    }
+#endif
+}
+#endif
+
 
 //
 // Bind an IPv4 socket for an interface
@@ -48,11 +106,14 @@
 static void interface_bind_ipv4(
     bridge_interface_t *        bridge_interface)
 {
-    bridge_instance_t *         bridge = &bridge_list[bridge_interface->bridge_index];
+    bridge_instance_t *         bridge = bridge_interface->bridge;
     int                         sock;
     const int                   on = 1;
     const int                   off = 0;
     const int                   ttl = 1;
+#if defined(USE_PACING_RATE)
+    unsigned int                pacing_rate;
+#endif
     int                         r;
 
     struct sockaddr_in          sin;
@@ -120,6 +181,78 @@ static void interface_bind_ipv4(
         fatal("setsockopt (IP_MULTICAST_LOOP) for IPv4 on %s failed: %s\n", bridge_interface->name, strerror(errno));
     }
 
+#if defined(IP_MULTICAST_ALL)
+    // Only receive the groups joined on this socket
+    r = setsockopt(sock, IPPROTO_IP, IP_MULTICAST_ALL, (void *) &off, sizeof(off));
+    if (r == -1)
+    {
+        fatal("setsockopt (IP_MULTICAST_ALL) for IPv4 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+#endif
+
+#if defined(USE_GROUP_LIST)
+    // Report the destination group of received packets if the bridge has more than one group
+    if (bridge->group_count > 1)
+    {
+        r = setsockopt(sock, IPPROTO_IP, IP_PKTINFO, (void *) &on, sizeof(on));
+        if (r == -1)
+        {
+            fatal("setsockopt (IP_PKTINFO) for IPv4 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+#endif
+
+#if defined(USE_UDP_OFFLOAD)
+    // Enable receive coalescing if requested
+    if (bridge->udp_offload)
+    {
+        r = setsockopt(sock, IPPROTO_UDP, UDP_GRO, (void *) &on, sizeof(on));
+        if (r == -1)
+        {
+            fatal("setsockopt (UDP_GRO) for IPv4 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+#endif
+
+#if defined(USE_RXQ_OVFL)
+    // Report the number of packets dropped by the kernel
+    r = setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, (void *) &on, sizeof(on));
+    if (r == -1)
+    {
+        fatal("setsockopt (SO_RXQ_OVFL) for IPv4 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+#endif
+
+#if defined(USE_RX_TIMESTAMP)
+    // Timestamp received packets for forwarding latency
+    r = setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, (void *) &on, sizeof(on));
+    if (r == -1)
+    {
+        fatal("setsockopt (SO_TIMESTAMPNS) for IPv4 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+#endif
+
+#if defined(USE_PACING_RATE)
+    // Pace packets sent to a rate limited interface (requires the fq qdisc)
+    if (bridge_interface->rate_limit)
+    {
+        pacing_rate = bridge_interface->rate_limit < UINT32_MAX ? (unsigned int) bridge_interface->rate_limit : UINT32_MAX - 1;
+        r = setsockopt(sock, SOL_SOCKET, SO_MAX_PACING_RATE, (void *) &pacing_rate, sizeof(pacing_rate));
+        if (r == -1)
+        {
+            fatal("setsockopt (SO_MAX_PACING_RATE) for IPv4 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+#endif
+
+#if defined(USE_BUSY_POLL)
+    // Busy poll the socket if requested
+    if (bridge->busy_poll)
+    {
+        interface_set_busy_poll(bridge_interface, sock);
+    }
+#endif
+
     // Bind the socket
     memset(&sin, 0, sizeof(sin));
     sin.sin_family = AF_INET;
@@ -144,11 +277,14 @@ static void interface_bind_ipv4(
 static void interface_bind_ipv6(
     bridge_interface_t *        bridge_interface)
 {
-    bridge_instance_t *         bridge = &bridge_list[bridge_interface->bridge_index];
+    bridge_instance_t *         bridge = bridge_interface->bridge;
     int                         sock;
     const int                   on = 1;
     const int                   off = 0;
     const int                   ttl = 1;
+#if defined(USE_PACING_RATE)
+    unsigned int                pacing_rate;
+#endif
     int                         r;
 
     struct sockaddr_in6         sin6;
@@ -223,6 +359,78 @@ static void interface_bind_ipv6(
         fatal("setsockopt (IPV6_MULTICAST_LOOP) for IPv6 on %s failed: %s\n", bridge_interface->name, strerror(errno));
     }
 
+#if defined(IPV6_MULTICAST_ALL)
+    // Only receive the groups joined on this socket
+    r = setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_ALL, (void *) &off, sizeof(off));
+    if (r == -1)
+    {
+        fatal("setsockopt (IPV6_MULTICAST_ALL) for IPv6 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+#endif
+
+#if defined(USE_GROUP_LIST)
+    // Report the destination group of received packets if the bridge has more than one group
+    if (bridge->group_count > 1)
+    {
+        r = setsockopt(sock, IPPROTO_IPV6, IPV6_RECVPKTINFO, (void *) &on, sizeof(on));
+        if (r == -1)
+        {
+            fatal("setsockopt (IPV6_RECVPKTINFO) for IPv6 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+#endif
+
+#if defined(USE_UDP_OFFLOAD)
+    // Enable receive coalescing if requested
+    if (bridge->udp_offload)
+    {
+        r = setsockopt(sock, IPPROTO_UDP, UDP_GRO, (void *) &on, sizeof(on));
+        if (r == -1)
+        {
+            fatal("setsockopt (UDP_GRO) for IPv6 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+#endif
+
+#if defined(USE_RXQ_OVFL)
+    // Report the number of packets dropped by the kernel
+    r = setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, (void *) &on, sizeof(on));
+    if (r == -1)
+    {
+        fatal("setsockopt (SO_RXQ_OVFL) for IPv6 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+#endif
+
+#if defined(USE_RX_TIMESTAMP)
+    // Timestamp received packets for forwarding latency
+    r = setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, (void *) &on, sizeof(on));
+    if (r == -1)
+    {
+        fatal("setsockopt (SO_TIMESTAMPNS) for IPv6 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+#endif
+
+#if defined(USE_PACING_RATE)
+    // Pace packets sent to a rate limited interface (requires the fq qdisc)
+    if (bridge_interface->rate_limit)
+    {
+        pacing_rate = bridge_interface->rate_limit < UINT32_MAX ? (unsigned int) bridge_interface->rate_limit : UINT32_MAX - 1;
+        r = setsockopt(sock, SOL_SOCKET, SO_MAX_PACING_RATE, (void *) &pacing_rate, sizeof(pacing_rate));
+        if (r == -1)
+        {
+            fatal("setsockopt (SO_MAX_PACING_RATE) for IPv6 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+#endif
+
+#if defined(USE_BUSY_POLL)
+    // Busy poll the socket if requested
+    if (bridge->busy_poll)
+    {
+        interface_set_busy_poll(bridge_interface, sock);
+    }
+#endif
+
     // Bind the socket
     memset(&sin6, 0, sizeof(sin6));
     sin6.sin6_family = AF_INET6;
@@ -241,15 +449,32 @@ static void interface_bind_ipv6(
 }
 
 
+//
+// Get the socket that receives for an inbound interface
+//
+static int interface_receive_socket(
+    const bridge_interface_t *  bridge_interface)
+{
+#if defined(USE_RECVIF_PKTINFO)
+    // NB: The bridge instance receives on the socket of its first interface
+    return bridge_interface->bridge->interface_list[0]->sock;
+#else
+    return bridge_interface->sock;
+#endif
+}
+
+
 //
 // Activate an inbound interface
 //
 static void interface_activate_inbound(
     bridge_interface_t *        bridge_interface)
 {
-    bridge_instance_t *         bridge = &bridge_list[bridge_interface->bridge_index];
+    bridge_instance_t *         bridge = bridge_interface->bridge;
     struct ip_mreqn             mreq;
     struct ipv6_mreq            mreq6;
+    int                         sock = interface_receive_socket(bridge_interface);
+    unsigned int                group_index;
     int                         r;
 
     // If the interface is already active, ignore the request
@@ -266,29 +491,32 @@ static void interface_activate_inbound(
             interface_config_type_to_string(bridge_interface->inbound_configuration));
     }
 
-    if (bridge->family == AF_INET)
+    for (group_index = 0; group_index < bridge->group_count; group_index++)
     {
-        memset(&mreq, 0, sizeof(mreq));
-        mreq.imr_ifindex = bridge_interface->if_index;
-        mreq.imr_multiaddr = bridge->dst_addr.sin.sin_addr;
-        mreq.imr_address = bridge_interface->ipv4_addr;
-        r = setsockopt(bridge_interface->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
-        if (r == -1)
+        if (bridge->family == AF_INET)
         {
-            logger("Bridge(IPv4/%u): setsockopt (IP_ADD_MEMBERSHIP) on interface %s failed: %s\n",
-                bridge->port, bridge_interface->name, strerror(errno));
+            memset(&mreq, 0, sizeof(mreq));
+            mreq.imr_ifindex = bridge_interface->if_index;
+            mreq.imr_multiaddr = bridge->group_list[group_index].sin.sin_addr;
+            mreq.imr_address = bridge_interface->ipv4_addr;
+            r = setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+            if (r == -1)
+            {
+                logger("Bridge(IPv4/%u): setsockopt (IP_ADD_MEMBERSHIP) on interface %s failed: %s\n",
+                    bridge->port, bridge_interface->name, strerror(errno));
+            }
         }
-    }
-    else
-    {
-        memset(&mreq6, 0, sizeof(mreq6));
-        mreq6.ipv6mr_interface = bridge_interface->if_index;
-        mreq6.ipv6mr_multiaddr = bridge->dst_addr.sin6.sin6_addr;
-        r = setsockopt(bridge_interface->sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq6, sizeof(mreq6));
-        if (r == -1)
+        else
         {
-            logger("Bridge(IPv6/%u): setsockopt (IPV6_JOIN_GROUP) on interface %s failed: %s\n",
-                bridge->port, bridge_interface->name, strerror(errno));
+            memset(&mreq6, 0, sizeof(mreq6));
+            mreq6.ipv6mr_interface = bridge_interface->if_index;
+            mreq6.ipv6mr_multiaddr = bridge->group_list[group_index].sin6.sin6_addr;
+            r = setsockopt(sock, IPPROTO_IPV6, IPV6_JOIN_GROUP, &mreq6, sizeof(mreq6));
+            if (r == -1)
+            {
+                logger("Bridge(IPv6/%u): setsockopt (IPV6_JOIN_GROUP) on interface %s failed: %s\n",
+                    bridge->port, bridge_interface->name, strerror(errno));
+            }
         }
     }
 
@@ -298,14 +526,16 @@ static void interface_activate_inbound(
 
 
 //
-// Deactivate an inbound interface
+// Deactivate an inbound interface, regardless of its configuration
 //
-static void interface_deactivate_inbound(
+static void interface_apply_deactivate_inbound(
     bridge_interface_t *        bridge_interface)
 {
-    bridge_instance_t *         bridge = &bridge_list[bridge_interface->bridge_index];
+    bridge_instance_t *         bridge = bridge_interface->bridge;
     struct ip_mreqn             mreq;
     struct ipv6_mreq            mreq6;
+    int                         sock = interface_receive_socket(bridge_interface);
+    unsigned int                group_index;
     int                         r;
 
     // If the interface is inactive, ignore the request
@@ -314,14 +544,6 @@ static void interface_deactivate_inbound(
         return;
     }
 
-    // If the interface is not dynamic, ignore the request
-    if (bridge_interface->inbound_configuration != INTERFACE_CONFIG_DYNAMIC)
-    {
-        logger("Bridge(%s/%u): Deactivating non-dynamic inbound interface %s\n",
-            AF_FAMILY_TO_STRING(bridge->family), bridge->port, bridge_interface->name);
-        return;
-    }
-
     // Debug logging
     if (debug_level)
     {
@@ -329,29 +551,32 @@ static void interface_deactivate_inbound(
             AF_FAMILY_TO_STRING(bridge->family), bridge->port, bridge_interface->name);
     }
 
-    if (bridge->family == AF_INET)
+    for (group_index = 0; group_index < bridge->group_count; group_index++)
     {
-        memset(&mreq, 0, sizeof(mreq));
-        mreq.imr_ifindex = bridge_interface->if_index;
-        mreq.imr_multiaddr = bridge->dst_addr.sin.sin_addr;
-        mreq.imr_address = bridge_interface->ipv4_addr;
-        r = setsockopt(bridge_interface->sock, IPPROTO_IP, IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
-        if (r == -1)
+        if (bridge->family == AF_INET)
         {
-            logger("Bridge(IPv4/%u): setsockopt (IP_DROP_MEMBERSHIP) on interface %s failed: %s\n",
-                bridge->port, bridge_interface->name, strerror(errno));
+            memset(&mreq, 0, sizeof(mreq));
+            mreq.imr_ifindex = bridge_interface->if_index;
+            mreq.imr_multiaddr = bridge->group_list[group_index].sin.sin_addr;
+            mreq.imr_address = bridge_interface->ipv4_addr;
+            r = setsockopt(sock, IPPROTO_IP, IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
+            if (r == -1)
+            {
+                logger("Bridge(IPv4/%u): setsockopt (IP_DROP_MEMBERSHIP) on interface %s failed: %s\n",
+                    bridge->port, bridge_interface->name, strerror(errno));
+            }
         }
-    }
-    else
-    {
-        memset(&mreq6, 0, sizeof(mreq6));
-        mreq6.ipv6mr_interface = bridge_interface->if_index;
-        mreq6.ipv6mr_multiaddr = bridge->dst_addr.sin6.sin6_addr;
-        r = setsockopt(bridge_interface->sock, IPPROTO_IPV6, IPV6_LEAVE_GROUP, &mreq6, sizeof(mreq6));
-        if (r == -1)
+        else
         {
-            logger("Bridge(IPv6/%u): setsockopt (IPV6_LEAVE_GROUP) on interface %s failed: %s\n",
-                bridge->port, bridge_interface->name, strerror(errno));
+            memset(&mreq6, 0, sizeof(mreq6));
+            mreq6.ipv6mr_interface = bridge_interface->if_index;
+            mreq6.ipv6mr_multiaddr = bridge->group_list[group_index].sin6.sin6_addr;
+            r = setsockopt(sock, IPPROTO_IPV6, IPV6_LEAVE_GROUP, &mreq6, sizeof(mreq6));
+            if (r == -1)
+            {
+                logger("Bridge(IPv6/%u): setsockopt (IPV6_LEAVE_GROUP) on interface %s failed: %s\n",
+                    bridge->port, bridge_interface->name, strerror(errno));
+            }
         }
     }
 
@@ -360,13 +585,95 @@ static void interface_deactivate_inbound(
 }
 
 
+//
+// Deactivate an inbound interface
+//
+static void interface_deactivate_inbound(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+
+    // If the interface is inactive, ignore the request
+    if (bridge_interface->inbound_active == 0)
+    {
+        return;
+    }
+
+    // If the interface is not dynamic, ignore the request
+    if (bridge_interface->inbound_configuration != INTERFACE_CONFIG_DYNAMIC)
+    {
+        logger("Bridge(%s/%u): Deactivating non-dynamic inbound interface %s\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port, bridge_interface->name);
+        return;
+    }
+
+    interface_apply_deactivate_inbound(bridge_interface);
+}
+
+
+//
+// Rebuild and publish the outbound fanout lists for a bridge instance
+//
+// NB: Before the workers are started this is called by the main thread, and
+//     after they are started only by the worker that owns the bridge instance,
+//     after applying the updates posted to its command channel. The fanout
+//     lists are only read by that worker while it forwards a batch, so a list
+//     is never rebuilt while it is in use.
+//
+void interface_update_fanout(
+    bridge_instance_t *         bridge)
+{
+    bridge_interface_t *        bridge_interface;
+    bridge_interface_t *        peer;
+    bridge_fanout_t *           fanout;
+    unsigned int                interface_index;
+    unsigned int                peer_index;
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        bridge_interface = bridge->interface_list[interface_index];
+
+        // Rebuild the list
+        fanout = bridge_interface->fanout;
+        fanout->peer_count = 0;
+        if (bridge_interface->inbound_active)
+        {
+            for (peer_index = 0; peer_index < bridge->interface_count; peer_index++)
+            {
+                peer = bridge->interface_list[peer_index];
+                if (peer != bridge_interface && peer->outbound_active)
+                {
+                    fanout->peer_list[fanout->peer_count] = peer;
+                    fanout->peer_count += 1;
+                }
+            }
+        }
+
+#if defined(USE_XDP)
+        // Synchronize the XDP device map
+        if (bridge->dataplane == DATAPLANE_XDP)
+        {
+            xdp_update_devmap(bridge_interface);
+        }
+#endif
+    }
+
+#if defined(USE_MROUTE)
+    // Synchronize the kernel forwarding entries
+    mroute_update_bridge(bridge);
+#endif
+}
+
+
 //
 // Activate an outbound interface
 //
-void interface_activate_outbound(
+// NB: The fanout lists are not updated
+//
+static void interface_apply_activate_outbound(
     bridge_interface_t *        bridge_interface)
 {
-    bridge_instance_t *         bridge = &bridge_list[bridge_interface->bridge_index];
+    bridge_instance_t *         bridge = bridge_interface->bridge;
     bridge_interface_t *        peer;
     unsigned int                peer_index;
 
@@ -390,7 +697,7 @@ void interface_activate_outbound(
     // Activate inbound dynamic peers
     for (peer_index = 0; peer_index < bridge->interface_count; peer_index++)
     {
-        peer = &bridge->interface_list[peer_index];
+        peer = bridge->interface_list[peer_index];
         if (peer == bridge_interface)
         {
             continue;
@@ -406,10 +713,12 @@ void interface_activate_outbound(
 //
 // Deactivate an outbound interface
 //
-void interface_deactivate_outbound(
+// NB: The fanout lists are not updated
+//
+static void interface_apply_deactivate_outbound(
     bridge_interface_t *        bridge_interface)
 {
-    bridge_instance_t *         bridge = &bridge_list[bridge_interface->bridge_index];
+    bridge_instance_t *         bridge = bridge_interface->bridge;
     bridge_interface_t *        peer;
     unsigned int                peer_index;
     bridge_interface_t *        peer2;
@@ -421,14 +730,6 @@ void interface_deactivate_outbound(
         return;
     }
 
-    // If the interface is not dynamic, ignore the request
-    if (bridge_interface->outbound_configuration != INTERFACE_CONFIG_DYNAMIC)
-    {
-        logger("Bridge(%s/%u): Deactivating non-dynamic outbound interface %s\n",
-            AF_FAMILY_TO_STRING(bridge->family), bridge->port, bridge_interface->name);
-        return;
-    }
-
     // Debug logging
     if (debug_level)
     {
@@ -442,7 +743,7 @@ void interface_deactivate_outbound(
     // Deactivate inbound dynamic peers if appropriate
     for (peer_index = 0; peer_index < bridge->interface_count; peer_index++)
     {
-        peer = &bridge->interface_list[peer_index];
+        peer = bridge->interface_list[peer_index];
         if (peer == bridge_interface || peer->inbound_configuration != INTERFACE_CONFIG_DYNAMIC)
         {
             continue;
@@ -450,7 +751,7 @@ void interface_deactivate_outbound(
 
         for (peer2_index = 0; peer2_index < bridge->interface_count; peer2_index++)
         {
-            peer2 = &bridge->interface_list[peer2_index];
+            peer2 = bridge->interface_list[peer2_index];
             if (peer2 == peer)
             {
                 continue;
@@ -470,65 +771,764 @@ void interface_deactivate_outbound(
 
 
 //
-// Initialize the interfaces
+// Replace the source filter for a group on an outbound interface
 //
-void initialize_interfaces(void)
+// NB: The filter replaced is freed, so this must only be called by the worker
+//     that owns the bridge instance (or before the workers are started)
+//
+static void interface_apply_source_filter(
+    bridge_interface_t *        bridge_interface,
+    bridge_source_filter_t *    filter)
 {
-    bridge_instance_t *         bridge;
-    bridge_interface_t *        bridge_interface;
-    unsigned int                bridge_index;
-    unsigned int                interface_index;
+    bridge_source_filter_t *    old_filter;
 
-    // Iterate over the bridge instances and bind the interface sockets
-    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    old_filter = bridge_interface->source_filter[filter->group_index];
+    if (filter->any_source)
+    {
+        bridge_interface->source_filter[filter->group_index] = NULL;
+        free(filter);
+    }
+    else
     {
-        bridge = &bridge_list[bridge_index];
+        bridge_interface->source_filter[filter->group_index] = filter;
+    }
+    free(old_filter);
+}
 
-        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
-        {
-            bridge_interface = &bridge->interface_list[interface_index];
-            if (bridge->family == AF_INET)
-            {
-                interface_bind_ipv4(bridge_interface);
-            }
-            else
-            {
-                interface_bind_ipv6(bridge_interface);
-            }
-        }
+
+//
+// Apply a changed outbound rate limit to an interface
+//
+// NB: This must only be called by the worker that owns the bridge instance
+//
+static void interface_apply_rate_limit(
+    bridge_interface_t *        bridge_interface)
+{
+#if defined(USE_PACING_RATE)
+    uint64_t                    rate_limit;
+    unsigned int                pacing_rate;
+    int                         r;
+#endif
+
+    if (bridge_update_shaper(bridge_interface) == 0)
+    {
+        return;
     }
 
-    // Iterate over the bridge instances and activate or register as appropriate
-    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+#if defined(USE_PACING_RATE)
+    rate_limit = __atomic_load_n(&bridge_interface->rate_limit, __ATOMIC_RELAXED);
+    pacing_rate = rate_limit < UINT32_MAX ? (unsigned int) rate_limit : UINT32_MAX - 1;
+    r = setsockopt(bridge_interface->sock, SOL_SOCKET, SO_MAX_PACING_RATE, (void *) &pacing_rate, sizeof(pacing_rate));
+    if (r == -1)
     {
-        bridge = &bridge_list[bridge_index];
+        logger("setsockopt (SO_MAX_PACING_RATE) on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+#endif
+}
 
-        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
-        {
-            bridge_interface = &bridge->interface_list[interface_index];
 
-            // If the inbound interface is not dynamic, activate it
-            if (bridge_interface->inbound_configuration != INTERFACE_CONFIG_DYNAMIC)
-            {
-                interface_activate_inbound(bridge_interface);
+//
+// Apply the requested outbound state of an interface
+//
+// NB: This must only be called by the worker that owns the bridge instance (or
+//     before the workers are started). The caller updates the fanout lists.
+//
+void interface_apply_update(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    bridge_source_filter_t *    filter;
+    unsigned int                group_index;
+
+    // Activate or deactivate the interface
+    if (__atomic_load_n(&bridge_interface->outbound_request, __ATOMIC_RELAXED))
+    {
+        interface_apply_activate_outbound(bridge_interface);
+    }
+    else
+    {
+        interface_apply_deactivate_outbound(bridge_interface);
+    }
+
+    // Replace the source filters
+    for (group_index = 0; group_index < bridge->group_count; group_index++)
+    {
+        filter = __atomic_exchange_n(&bridge_interface->source_filter_request[group_index], NULL, __ATOMIC_ACQUIRE);
+        if (filter)
+        {
+            interface_apply_source_filter(bridge_interface, filter);
+        }
+    }
+
+    // Change the rate limit
+    interface_apply_rate_limit(bridge_interface);
+}
+
+
+//
+// Add an interface to the interface list of its bridge instance and activate it
+//
+// The inbound interface is activated if it is not dynamic, or if another
+// interface is active outbound. The outbound interface is activated if it is
+// not dynamic.
+//
+// NB: This must only be called by the worker that owns the bridge instance. The
+//     caller updates the fanout lists.
+//
+void interface_apply_add(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    bridge_interface_t **       interface_list;
+    bridge_interface_t *        peer;
+    unsigned int                peer_index;
+    size_t                      fanout_size;
+
+    // Add the interface to the list
+    interface_list = realloc(bridge->interface_list, (bridge->interface_count + 1) * sizeof(bridge_interface_t *));
+    if (interface_list == NULL)
+    {
+        fatal("Cannot allocate memory for interface list: %s\n", strerror(errno));
+    }
+    interface_list[bridge->interface_count] = bridge_interface;
+    bridge->interface_list = interface_list;
+    bridge->interface_count += 1;
+
+    // Grow the fanout lists to hold every peer
+    fanout_size = sizeof(bridge_fanout_t) + bridge->interface_count * sizeof(bridge_interface_t *);
+    for (peer_index = 0; peer_index < bridge->interface_count; peer_index++)
+    {
+        peer = bridge->interface_list[peer_index];
+        peer->fanout = realloc(peer->fanout, fanout_size);
+        if (peer->fanout == NULL)
+        {
+            fatal("Cannot allocate memory for fanout list: %s\n", strerror(errno));
+        }
+    }
+
+    // Activate the inbound interface
+    if (bridge_interface->inbound_configuration != INTERFACE_CONFIG_DYNAMIC)
+    {
+        interface_activate_inbound(bridge_interface);
+    }
+    else
+    {
+        for (peer_index = 0; peer_index < bridge->interface_count; peer_index++)
+        {
+            peer = bridge->interface_list[peer_index];
+            if (peer != bridge_interface && peer->outbound_active)
+            {
+                interface_activate_inbound(bridge_interface);
+                break;
+            }
+        }
+    }
+
+    // Activate the outbound interface
+    if (bridge_interface->outbound_configuration != INTERFACE_CONFIG_DYNAMIC)
+    {
+        __atomic_store_n(&bridge_interface->outbound_request, 1, __ATOMIC_RELAXED);
+        interface_apply_activate_outbound(bridge_interface);
+    }
+}
+
+
+//
+// Deactivate an interface, leaving its groups, and remove it from the
+// interface list of its bridge instance
+//
+// NB: This must only be called by the worker that owns the bridge instance,
+//     once the interface is no longer registered for IGMP/MLD and no update of
+//     the interface is pending. The caller updates the fanout lists.
+//
+void interface_apply_remove(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    unsigned int                interface_index;
+
+    // Deactivate the interface regardless of its configuration
+    __atomic_store_n(&bridge_interface->outbound_request, 0, __ATOMIC_RELAXED);
+    interface_apply_deactivate_outbound(bridge_interface);
+    interface_apply_deactivate_inbound(bridge_interface);
+
+    // Remove the interface from the list
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        if (bridge->interface_list[interface_index] == bridge_interface)
+        {
+            memmove(&bridge->interface_list[interface_index], &bridge->interface_list[interface_index + 1],
+                (bridge->interface_count - interface_index - 1) * sizeof(bridge_interface_t *));
+            bridge->interface_count -= 1;
+            break;
+        }
+    }
+}
+
+
+//
+// Have the requested state of an interface applied
+//
+// Once the workers are started, the interface is posted to the worker that owns
+// the bridge instance unless it is already pending.
+//
+static void interface_request_update(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+
+    if (bridge->channel == NULL)
+    {
+        interface_apply_update(bridge_interface);
+        interface_update_fanout(bridge);
+        return;
+    }
+
+    if (__atomic_exchange_n(&bridge_interface->update_pending, 1, __ATOMIC_SEQ_CST) == 0)
+    {
+        bridge_post_update(bridge, bridge_interface);
+    }
+}
+
+
+//
+// Activate an outbound interface
+//
+// The worker that owns the bridge instance joins the groups and rebuilds the
+// fanout lists.
+//
+void interface_activate_outbound(
+    bridge_interface_t *        bridge_interface)
+{
+    // Count the active groups of a dynamic interface
+    if (bridge_interface->outbound_configuration == INTERFACE_CONFIG_DYNAMIC)
+    {
+        bridge_interface->outbound_group_count += 1;
+    }
+
+    // If the interface is already requested to be active, ignore the request
+    if (__atomic_load_n(&bridge_interface->outbound_request, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+
+    __atomic_store_n(&bridge_interface->outbound_request, 1, __ATOMIC_RELAXED);
+    interface_request_update(bridge_interface);
+}
+
+
+//
+// Deactivate an outbound interface
+//
+void interface_deactivate_outbound(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+
+    // If the interface is inactive, ignore the request
+    if (__atomic_load_n(&bridge_interface->outbound_request, __ATOMIC_RELAXED) == 0)
+    {
+        return;
+    }
+
+    // If the interface is not dynamic, ignore the request
+    if (bridge_interface->outbound_configuration != INTERFACE_CONFIG_DYNAMIC)
+    {
+        logger("Bridge(%s/%u): Deactivating non-dynamic outbound interface %s\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port, bridge_interface->name);
+        return;
+    }
+
+    // The interface remains active while any other group of the bridge is active
+    if (bridge_interface->outbound_group_count > 0)
+    {
+        bridge_interface->outbound_group_count -= 1;
+    }
+    if (bridge_interface->outbound_group_count)
+    {
+        return;
+    }
+
+    __atomic_store_n(&bridge_interface->outbound_request, 0, __ATOMIC_RELAXED);
+    interface_request_update(bridge_interface);
+}
+
+
+//
+// Set the source filter for a group on an outbound interface
+//
+// The source list holds source_count addresses of the bridge's address family.
+// A NULL source list removes the filter, so that packets from any source are
+// forwarded. The filter replaces any filter requested for the group that the
+// worker that owns the bridge instance has not yet applied.
+//
+void interface_set_source_filter(
+    bridge_interface_t *        bridge_interface,
+    const void *                mcast_addr,
+    const void *                source_list,
+    unsigned int                source_count)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    bridge_source_filter_t *    filter;
+    const uint8_t *             source;
+    unsigned int                address_len;
+    unsigned int                group_index;
+    unsigned int                index;
+    unsigned int                position;
+
+    // Find the group
+    for (group_index = 0; group_index < bridge->group_count; group_index++)
+    {
+        if (bridge->family == AF_INET)
+        {
+            if (memcmp(&bridge->group_list[group_index].sin.sin_addr, mcast_addr, sizeof(struct in_addr)) == 0)
+            {
+                break;
+            }
+        }
+        else
+        {
+            if (memcmp(&bridge->group_list[group_index].sin6.sin6_addr, mcast_addr, sizeof(struct in6_addr)) == 0)
+            {
+                break;
+            }
+        }
+    }
+    if (group_index >= bridge->group_count)
+    {
+        return;
+    }
+
+    // Build the filter with the sources in ascending order
+    // NB: Source lists are short, so an insertion sort is used
+    address_len = bridge->family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+    if (source_list == NULL)
+    {
+        source_count = 0;
+    }
+    filter = malloc(sizeof(bridge_source_filter_t) + source_count * address_len);
+    if (filter == NULL)
+    {
+        fatal("Cannot allocate memory for source filter: %s\n", strerror(errno));
+    }
+    filter->group_index = group_index;
+    filter->any_source = source_list == NULL;
+    filter->address_len = address_len;
+    filter->source_count = source_count;
+    for (index = 0; index < source_count; index++)
+    {
+        source = (const uint8_t *) source_list + index * address_len;
+        for (position = index; position > 0; position--)
+        {
+            if (memcmp(&filter->source_list[(position - 1) * address_len], source, address_len) <= 0)
+            {
+                break;
             }
+            memcpy(&filter->source_list[position * address_len], &filter->source_list[(position - 1) * address_len], address_len);
+        }
+        memcpy(&filter->source_list[position * address_len], source, address_len);
+    }
+
+    filter = __atomic_exchange_n(&bridge_interface->source_filter_request[group_index], filter, __ATOMIC_ACQ_REL);
+    free(filter);
+    interface_request_update(bridge_interface);
+}
+
+
+//
+// Change the outbound rate limit of a rate limited interface
+//
+void interface_set_rate_limit(
+    bridge_interface_t *        bridge_interface,
+    uint64_t                    rate_limit)
+{
+    __atomic_store_n(&bridge_interface->rate_limit, rate_limit, __ATOMIC_RELAXED);
+    interface_request_update(bridge_interface);
+}
+
+
+//
+// Change the duplicate suppression window of a bridge instance that
+// suppresses duplicates
+//
+// NB: The window is applied by the worker as part of an update of the first
+//     interface of the bridge instance
+//
+void interface_set_duplicate_window(
+    bridge_instance_t *         bridge,
+    unsigned int                duplicate_window)
+{
+    __atomic_store_n(&bridge->duplicate_window, duplicate_window, __ATOMIC_RELAXED);
+    interface_request_update(bridge->interface_list[0]);
+}
+
+
+//
+// Is a source address permitted by a source filter?
+//
+int interface_source_allowed(
+    const bridge_source_filter_t * filter,
+    const void *                src_addr)
+{
+    unsigned int                low = 0;
+    unsigned int                high = filter->source_count;
+    unsigned int                middle;
+    int                         r;
+
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        r = memcmp(src_addr, &filter->source_list[middle * filter->address_len], filter->address_len);
+        if (r == 0)
+        {
+            return 1;
+        }
+        if (r < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    return 0;
+}
+
+
+//
+// Bind the socket of an interface and allocate its forwarding structures
+//
+static void interface_open(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    size_t                      counters_size;
+    size_t                      fanout_size;
+    int                         r;
+
+    if (bridge->family == AF_INET)
+    {
+        interface_bind_ipv4(bridge_interface);
+    }
+    else
+    {
+        interface_bind_ipv6(bridge_interface);
+    }
+
+#if defined(USE_PACKET_RING)
+    // Create the packet ring if required
+    if (bridge->dataplane == DATAPLANE_PACKET_RING)
+    {
+        packet_ring_create(bridge_interface);
+    }
+#endif
+
+    // Allocate the counters on their own cache lines
+    counters_size = (sizeof(bridge_counters_t) + CACHE_LINE_SIZE - 1) & ~((size_t) CACHE_LINE_SIZE - 1);
+    r = posix_memalign((void **) &bridge_interface->counters, CACHE_LINE_SIZE, counters_size);
+    if (r != 0)
+    {
+        fatal("Cannot allocate memory for counters: %s\n", strerror(r));
+    }
+    memset(bridge_interface->counters, 0, counters_size);
+
+    // Allocate the fanout list
+    fanout_size = sizeof(bridge_fanout_t) + bridge->interface_count * sizeof(bridge_interface_t *);
+    bridge_interface->fanout = calloc(1, fanout_size);
+    if (bridge_interface->fanout == NULL)
+    {
+        fatal("Cannot allocate memory for fanout list: %s\n", strerror(errno));
+    }
+
+    // Allocate the source filter lists
+    bridge_interface->source_filter = calloc(bridge->group_count, sizeof(bridge_source_filter_t *));
+    bridge_interface->source_filter_request = calloc(bridge->group_count, sizeof(bridge_source_filter_t *));
+    if (bridge_interface->source_filter == NULL || bridge_interface->source_filter_request == NULL)
+    {
+        fatal("Cannot allocate memory for source filter list: %s\n", strerror(errno));
+    }
+}
+
+
+//
+// Close the socket of an interface and free its forwarding structures
+//
+// NB: The interface must no longer be in use by the worker that owned the
+//     bridge instance (see bridge_remove_interface)
+//
+static void interface_close(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    unsigned int                group_index;
+
+    close(bridge_interface->sock);
+    bridge_interface->sock = -1;
+
+    for (group_index = 0; group_index < bridge->group_count; group_index++)
+    {
+        free(bridge_interface->source_filter[group_index]);
+        free(bridge_interface->source_filter_request[group_index]);
+    }
+    free(bridge_interface->source_filter);
+    free(bridge_interface->source_filter_request);
+    free(bridge_interface->fanout);
+    free(bridge_interface->counters);
+}
+
+
+//
+// Bind the interface sockets of a bridge instance and allocate the forwarding
+// structures
+//
+static void interface_open_bridge(
+    bridge_instance_t *         bridge)
+{
+    unsigned int                interface_index;
+    size_t                      latency_size;
+    int                         r;
+
+    // Allocate the latency histogram on its own cache lines
+    latency_size = (sizeof(bridge_latency_t) + CACHE_LINE_SIZE - 1) & ~((size_t) CACHE_LINE_SIZE - 1);
+    r = posix_memalign((void **) &bridge->latency, CACHE_LINE_SIZE, latency_size);
+    if (r != 0)
+    {
+        fatal("Cannot allocate memory for latency histogram: %s\n", strerror(r));
+    }
+    memset(bridge->latency, 0, latency_size);
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        interface_open(bridge->interface_list[interface_index]);
+    }
+
+#if defined(USE_IO_URING)
+    // Create the io_uring engine if required
+    if (bridge->dataplane == DATAPLANE_IO_URING)
+    {
+        uring_create(bridge);
+    }
+#endif
+}
+
+
+//
+// Activate the non-dynamic directions of an interface of a bridge instance that
+// is not yet assigned to a worker
+//
+// NB: Dynamic inbound interfaces are activated with their outbound peers
+//
+static void interface_start(
+    bridge_interface_t *        bridge_interface)
+{
+    // If the inbound interface is not dynamic, activate it
+    if (bridge_interface->inbound_configuration != INTERFACE_CONFIG_DYNAMIC)
+    {
+        interface_activate_inbound(bridge_interface);
+    }
+
+    // If the outbound interface is not dynamic, activate it
+    if (bridge_interface->outbound_configuration != INTERFACE_CONFIG_DYNAMIC)
+    {
+        interface_activate_outbound(bridge_interface);
+    }
+}
+
+
+//
+// Register a dynamic outbound interface for IGMP/MLD after startup
+//
+static void interface_register(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    unsigned int                group_index;
+
+    if (bridge_interface->outbound_configuration != INTERFACE_CONFIG_DYNAMIC)
+    {
+        return;
+    }
+
+    for (group_index = 0; group_index < bridge->group_count; group_index++)
+    {
+        if (bridge->family == AF_INET)
+        {
+            igmp_add_interface(bridge_interface, &bridge->group_list[group_index].sin.sin_addr);
+        }
+        else
+        {
+            mld_add_interface(bridge_interface, &bridge->group_list[group_index].sin6.sin6_addr);
+        }
+    }
+}
+
 
-            // If the outbound interface is dynamic, register it, otherwise activate it
+//
+// Remove a dynamic outbound interface from IGMP/MLD
+//
+static void interface_unregister(
+    bridge_interface_t *        bridge_interface)
+{
+    if (bridge_interface->outbound_configuration != INTERFACE_CONFIG_DYNAMIC)
+    {
+        return;
+    }
+
+    if (bridge_interface->bridge->family == AF_INET)
+    {
+        igmp_remove_interface(bridge_interface);
+    }
+    else
+    {
+        mld_remove_interface(bridge_interface);
+    }
+}
+
+
+//
+// Initialize the interfaces
+//
+void initialize_interfaces(void)
+{
+    bridge_instance_t *         bridge;
+    bridge_interface_t *        bridge_interface;
+    unsigned int                bridge_index;
+    unsigned int                interface_index;
+    unsigned int                group_index;
+
+    // Iterate over the bridge instances and bind the interface sockets
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        interface_open_bridge(bridge_list[bridge_index]);
+    }
+
+#if defined(USE_XDP)
+    // Load and attach the XDP programs
+    xdp_initialize();
+#endif
+
+#if defined(USE_MROUTE)
+    // Add the interfaces of kernel bridges to the kernel multicast routing engine
+    mroute_initialize();
+#endif
+
+    // Iterate over the bridge instances and activate or register as appropriate
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+
+        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+        {
+            bridge_interface = bridge->interface_list[interface_index];
+            interface_start(bridge_interface);
+
+            // If the outbound interface is dynamic, register it
             if (bridge_interface->outbound_configuration == INTERFACE_CONFIG_DYNAMIC)
             {
-                if (bridge->family == AF_INET)
-                {
-                    igmp_register_interface(bridge_interface);
-                }
-                else
+                for (group_index = 0; group_index < bridge->group_count; group_index++)
                 {
-                    mld_register_interface(bridge_interface);
+                    if (bridge->family == AF_INET)
+                    {
+                        igmp_register_interface(bridge_interface, &bridge->group_list[group_index].sin.sin_addr);
+                    }
+                    else
+                    {
+                        mld_register_interface(bridge_interface, &bridge->group_list[group_index].sin6.sin6_addr);
+                    }
                 }
             }
-            else
-            {
-                interface_activate_outbound(bridge_interface);
-            }
         }
+
+        // Update the fanout lists
+        interface_update_fanout(bridge);
+    }
+}
+
+
+//
+// Add an interface to a socket dataplane bridge instance after startup
+//
+// The worker that owns the bridge instance adds the interface and activates
+// it, and a dynamic outbound interface is then registered for IGMP/MLD.
+//
+// NB: The caller holds bridge_list_lock
+//
+void interface_add(
+    bridge_interface_t *        bridge_interface)
+{
+    interface_open(bridge_interface);
+    bridge_add_interface(bridge_interface);
+    interface_register(bridge_interface);
+}
+
+
+//
+// Remove an interface from a socket dataplane bridge instance after startup
+//
+// The interface is removed from IGMP/MLD first, so that no further updates
+// are posted for it, and then deactivated and removed by the worker that owns
+// the bridge instance. The caller frees the interface.
+//
+// NB: The caller holds bridge_list_lock
+//
+void interface_remove(
+    bridge_interface_t *        bridge_interface)
+{
+    interface_unregister(bridge_interface);
+    bridge_remove_interface(bridge_interface);
+    interface_close(bridge_interface);
+}
+
+
+//
+// Add a socket dataplane bridge instance after startup
+//
+// The interfaces are activated before the bridge instance is assigned to a
+// worker, as they are at startup.
+//
+void interface_add_bridge(
+    bridge_instance_t *         bridge)
+{
+    unsigned int                interface_index;
+
+    interface_open_bridge(bridge);
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        interface_start(bridge->interface_list[interface_index]);
+    }
+    interface_update_fanout(bridge);
+
+    bridge_add_bridge(bridge);
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        interface_register(bridge->interface_list[interface_index]);
+    }
+}
+
+
+//
+// Remove a socket dataplane bridge instance after startup
+//
+// NB: The caller holds bridge_list_lock, and frees the bridge instance
+//
+void interface_remove_bridge(
+    bridge_instance_t *         bridge)
+{
+    unsigned int                interface_index;
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        interface_unregister(bridge->interface_list[interface_index]);
+    }
+
+    bridge_remove_bridge(bridge);
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        interface_close(bridge->interface_list[interface_index]);
     }
+    free(bridge->latency);
 }
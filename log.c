@@ -0,0 +1,703 @@
+
+//
+// Copyright (c) 2024-2026, Denny Page
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+
+#include "common.h"
+
+
+// Number of entries in each thread's log ring (must be a power of 2)
+#define LOG_RING_SIZE           512
+
+// Size of a log ring entry, and the space available in it for message text
+#define LOG_ENTRY_SIZE          256
+#define LOG_TEXT_SIZE           (LOG_ENTRY_SIZE - 24)
+
+// Size of the output buffer used to batch writes to stderr
+#define LOG_OUTPUT_SIZE         (64 * 1024)
+
+// Log entry
+typedef struct
+{
+    struct timespec             timestamp;
+    log_event_t                 event;
+    unsigned short              family;
+    unsigned short              port;
+    union
+    {
+        // LOG_EVENT_MESSAGE: the formatted message
+        char                    text[LOG_TEXT_SIZE];
+
+        // Bridge packet events: the parameters of the message
+        struct
+        {
+            unsigned int        len;
+            unsigned int        value;
+            uint8_t             src_addr[16];
+            char                inbound[IFNAMSIZ];
+            char                outbound[IFNAMSIZ];
+        } packet;
+    };
+} log_entry_t;
+
+// Per thread log ring
+// NB: The ring is lock free with a single producer (the owning thread) and a
+//     single consumer (whichever thread holds the drain mutex). The producer
+//     wakes the logging thread when the ring goes from empty to non-empty.
+typedef struct log_ring
+{
+    struct log_ring *           next;
+
+    // Producer state
+    unsigned int                tail __attribute__ ((aligned(CACHE_LINE_SIZE)));
+    unsigned int                lost;
+    unsigned int                sample_count;
+    time_t                      rate_second;
+    unsigned int                rate_count;
+    unsigned int                suppressed;
+
+    // Consumer state
+    unsigned int                head __attribute__ ((aligned(CACHE_LINE_SIZE)));
+    unsigned int                lost_reported;
+
+    log_entry_t                 entry_list[LOG_RING_SIZE];
+} log_ring_t;
+
+// Options
+static unsigned int             log_foreground = 0;
+static unsigned int             log_syslog = 0;
+
+// Set once the logging thread is running. Until then, messages are written
+// synchronously by the calling thread
+static unsigned int             log_thread_running = 0;
+
+// The thread local ring of each thread
+static pthread_key_t            log_ring_key;
+
+// List of all rings, and the mutex that protects additions to it
+static log_ring_t *             log_ring_list = NULL;
+static pthread_mutex_t          log_ring_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Mutex held by the consumer of the rings, also serializing synchronous writes
+static pthread_mutex_t          log_drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Wakeup of the logging thread. The condition is only signaled when a wakeup
+// is not already pending.
+static unsigned int             log_wakeup_pending = 0;
+static pthread_mutex_t          log_wakeup_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t           log_wakeup_cond = PTHREAD_COND_INITIALIZER;
+
+// Output buffer for batched writes to stderr
+static char                     log_output[LOG_OUTPUT_SIZE];
+static size_t                   log_output_len = 0;
+
+
+//
+// Write the output buffer to stderr
+//
+static void log_output_flush(void)
+{
+    size_t                      offset = 0;
+    ssize_t                     rs;
+
+    while (offset < log_output_len)
+    {
+        rs = write(STDERR_FILENO, log_output + offset, log_output_len - offset);
+        if (rs == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        offset += (size_t) rs;
+    }
+    log_output_len = 0;
+}
+
+
+//
+// Output a formatted message
+// NB: The caller must hold the drain mutex
+//
+static void log_output_message(
+    const struct timespec *     timestamp,
+    const char *                text)
+{
+    size_t                      len;
+    int                         r;
+
+    if (log_syslog)
+    {
+        syslog(LOG_WARNING, "%s", text);
+        return;
+    }
+
+    len = strlen(text);
+    if (log_output_len + len + 32 > sizeof(log_output))
+    {
+        log_output_flush();
+    }
+
+    // If foreground and debug is enabled, prepend a timestamp
+    if (log_foreground && debug_level)
+    {
+        r = snprintf(log_output + log_output_len, sizeof(log_output) - log_output_len, "%ld.%06ld: ",
+                     (long) timestamp->tv_sec, timestamp->tv_nsec / 1000);
+        if (r > 0)
+        {
+            log_output_len += (size_t) r;
+        }
+    }
+
+    if (len > sizeof(log_output) - log_output_len)
+    {
+        len = sizeof(log_output) - log_output_len;
+    }
+    memcpy(log_output + log_output_len, text, len);
+    log_output_len += len;
+}
+
+
+//
+// Format and output a log entry
+// NB: The caller must hold the drain mutex
+//
+static void log_output_entry(
+    const log_entry_t *         entry)
+{
+    char                        src_str[INET6_ADDRSTRLEN];
+    char                        text[LOG_ENTRY_SIZE + 2 * INET6_ADDRSTRLEN];
+    char *                      p;
+    size_t                      size;
+    int                         r;
+
+    if (entry->event == LOG_EVENT_MESSAGE)
+    {
+        log_output_message(&entry->timestamp, entry->text);
+        return;
+    }
+
+    r = snprintf(text, sizeof(text), "Bridge(%s/%u): ", AF_FAMILY_TO_STRING(entry->family), entry->port);
+    p = text + r;
+    size = sizeof(text) - (size_t) r;
+    inet_ntop(entry->family, entry->packet.src_addr, src_str, sizeof(src_str));
+
+    switch (entry->event)
+    {
+    case LOG_EVENT_FORWARDED:
+        snprintf(p, size, "Forwarded %u bytes from %s on %s to %s\n",
+                 entry->packet.len, src_str, entry->packet.inbound, entry->packet.outbound);
+        break;
+    case LOG_EVENT_FORWARDED_SEGMENTS:
+        snprintf(p, size, "Forwarded %u bytes in %u byte segments from %s on %s to %s\n",
+                 entry->packet.len, entry->packet.value, src_str, entry->packet.inbound, entry->packet.outbound);
+        break;
+    case LOG_EVENT_FORWARDED_FRAME:
+        snprintf(p, size, "Forwarded %u byte frame from %s on %s to %s\n",
+                 entry->packet.len, src_str, entry->packet.inbound, entry->packet.outbound);
+        break;
+    case LOG_EVENT_DROPPED_TOO_LARGE:
+        snprintf(p, size, "Dropped datagram on %s: exceeds maximum packet size of %u\n",
+                 entry->packet.inbound, entry->packet.value);
+        break;
+    case LOG_EVENT_DROPPED_DUPLICATE:
+        snprintf(p, size, "Dropped duplicate datagram on %s\n", entry->packet.inbound);
+        break;
+    case LOG_EVENT_DROPPED_MTU:
+        snprintf(p, size, "Dropped %u byte frame from %s on %s: exceeds MTU of %s\n",
+                 entry->packet.len, src_str, entry->packet.inbound, entry->packet.outbound);
+        break;
+    case LOG_EVENT_DROPPED_RING_FULL:
+        snprintf(p, size, "Dropped %u byte frame from %s on %s: transmit ring full on %s\n",
+                 entry->packet.len, src_str, entry->packet.inbound, entry->packet.outbound);
+        break;
+    case LOG_EVENT_DROPPED_NO_SEND_SLOTS:
+        snprintf(p, size, "Dropped %u bytes for %s (no send slots)\n", entry->packet.len, entry->packet.outbound);
+        break;
+    case LOG_EVENT_DROPPED_QUEUE_FULL:
+        snprintf(p, size, "Dropped %u bytes for %s (submission queue full)\n", entry->packet.len, entry->packet.outbound);
+        break;
+    default:
+        snprintf(p, size, "Unknown log event %u\n", (unsigned int) entry->event);
+        break;
+    }
+
+    log_output_message(&entry->timestamp, text);
+}
+
+
+//
+// Drain all rings, merging the entries of the rings in timestamp order
+// NB: The caller must hold the drain mutex
+//
+static unsigned int log_drain_locked(void)
+{
+    log_ring_t *                ring;
+    log_ring_t *                oldest;
+    const log_entry_t *         entry;
+    const log_entry_t *         oldest_entry;
+    unsigned int                lost;
+    unsigned int                drained = 0;
+    struct timespec             now;
+    char                        text[64];
+
+    ring = __atomic_load_n(&log_ring_list, __ATOMIC_ACQUIRE);
+    if (ring == NULL)
+    {
+        return 0;
+    }
+
+    // Report events lost to full rings
+    clock_gettime(CLOCK_REALTIME, &now);
+    for (; ring; ring = ring->next)
+    {
+        lost = __atomic_load_n(&ring->lost, __ATOMIC_RELAXED);
+        if (lost != ring->lost_reported)
+        {
+            snprintf(text, sizeof(text), "Log ring full: %u debug events lost\n", lost - ring->lost_reported);
+            log_output_message(&now, text);
+            ring->lost_reported = lost;
+        }
+    }
+
+    while (1)
+    {
+        // Find the ring with the oldest pending entry
+        oldest = NULL;
+        oldest_entry = NULL;
+        for (ring = log_ring_list; ring; ring = ring->next)
+        {
+            // NB: Sequentially consistent with log_publish_entry, so that either
+            //     the producer sees the ring as empty and wakes the logging
+            //     thread, or the consumer sees the entry
+            if (ring->head == __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST))
+            {
+                continue;
+            }
+
+            entry = &ring->entry_list[ring->head & (LOG_RING_SIZE - 1)];
+            if (oldest_entry == NULL ||
+                entry->timestamp.tv_sec < oldest_entry->timestamp.tv_sec ||
+                (entry->timestamp.tv_sec == oldest_entry->timestamp.tv_sec &&
+                 entry->timestamp.tv_nsec < oldest_entry->timestamp.tv_nsec))
+            {
+                oldest = ring;
+                oldest_entry = entry;
+            }
+        }
+        if (oldest == NULL)
+        {
+            break;
+        }
+
+        log_output_entry(oldest_entry);
+        __atomic_store_n(&oldest->head, oldest->head + 1, __ATOMIC_SEQ_CST);
+        drained += 1;
+    }
+
+    log_output_flush();
+    return drained;
+}
+
+
+//
+// Write any pending log entries
+//
+void log_flush(void)
+{
+    (void) pthread_mutex_lock(&log_drain_mutex);
+    (void) log_drain_locked();
+    (void) pthread_mutex_unlock(&log_drain_mutex);
+}
+
+
+//
+// Wake the logging thread if a wakeup is not already pending
+//
+static void log_wakeup(void)
+{
+    if (__atomic_exchange_n(&log_wakeup_pending, 1, __ATOMIC_SEQ_CST) == 0)
+    {
+        (void) pthread_mutex_lock(&log_wakeup_mutex);
+        (void) pthread_cond_signal(&log_wakeup_cond);
+        (void) pthread_mutex_unlock(&log_wakeup_mutex);
+    }
+}
+
+
+//
+// Logging thread
+//
+// The thread sleeps until a ring goes from empty to non-empty, and drains
+// all the rings each time it is woken.
+//
+__attribute__ ((noreturn))
+static void * log_thread(
+    __attribute__ ((unused))
+    void *                      arg)
+{
+    while (1)
+    {
+        // Clear the wakeup before draining, so that an entry published after
+        // its ring is found to be empty signals a new wakeup
+        __atomic_store_n(&log_wakeup_pending, 0, __ATOMIC_SEQ_CST);
+
+        (void) pthread_mutex_lock(&log_drain_mutex);
+        (void) log_drain_locked();
+        (void) pthread_mutex_unlock(&log_drain_mutex);
+
+        (void) pthread_mutex_lock(&log_wakeup_mutex);
+        while (__atomic_load_n(&log_wakeup_pending, __ATOMIC_SEQ_CST) == 0)
+        {
+            (void) pthread_cond_wait(&log_wakeup_cond, &log_wakeup_mutex);
+        }
+        (void) pthread_mutex_unlock(&log_wakeup_mutex);
+    }
+}
+
+
+//
+// Get the log ring of the calling thread, creating it if necessary
+//
+static log_ring_t * log_get_ring(void)
+{
+    log_ring_t *                ring;
+
+    ring = pthread_getspecific(log_ring_key);
+    if (ring)
+    {
+        return ring;
+    }
+
+    ring = calloc(1, sizeof(log_ring_t));
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    (void) pthread_setspecific(log_ring_key, ring);
+
+    (void) pthread_mutex_lock(&log_ring_list_mutex);
+    ring->next = log_ring_list;
+    __atomic_store_n(&log_ring_list, ring, __ATOMIC_RELEASE);
+    (void) pthread_mutex_unlock(&log_ring_list_mutex);
+
+    return ring;
+}
+
+
+//
+// Reserve the next entry of a ring, or NULL if the ring is full
+//
+static log_entry_t * log_reserve_entry(
+    log_ring_t *                ring)
+{
+    if (ring->tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE)
+    {
+        return NULL;
+    }
+
+    return &ring->entry_list[ring->tail & (LOG_RING_SIZE - 1)];
+}
+
+
+//
+// Publish the entry reserved in a ring, waking the logging thread if the ring
+// was empty
+//
+static void log_publish_entry(
+    log_ring_t *                ring)
+{
+    unsigned int                tail = ring->tail;
+
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == tail)
+    {
+        log_wakeup();
+    }
+}
+
+
+//
+// Write a message synchronously, after any pending entries
+//
+static void log_write_sync(
+    int                         priority,
+    const char *                format,
+    va_list                     args)
+{
+    struct timespec             ts;
+
+    (void) pthread_mutex_lock(&log_drain_mutex);
+    (void) log_drain_locked();
+
+    if (log_syslog)
+    {
+        vsyslog(priority, format, args);
+        (void) pthread_mutex_unlock(&log_drain_mutex);
+        return;
+    }
+
+    // If foreground and debug is enabled, prepend a timestamp
+    if (log_foreground && debug_level && priority != LOG_ERR)
+    {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        fprintf(stderr, "%ld.%06ld: ", (long) ts.tv_sec, ts.tv_nsec / 1000);
+    }
+    vfprintf(stderr, format, args);
+    (void) pthread_mutex_unlock(&log_drain_mutex);
+}
+
+
+//
+// Log abnormal events
+//
+__attribute__ ((format (printf, 1, 2)))
+void logger(
+    const char *                format,
+    ...)
+{
+    log_ring_t *                ring = NULL;
+    log_entry_t *               entry = NULL;
+    va_list                     args;
+    int                         len;
+
+    if (__atomic_load_n(&log_thread_running, __ATOMIC_ACQUIRE))
+    {
+        ring = log_get_ring();
+        if (ring)
+        {
+            entry = log_reserve_entry(ring);
+        }
+    }
+
+    if (entry)
+    {
+        va_start(args, format);
+        len = vsnprintf(entry->text, sizeof(entry->text), format, args);
+        va_end(args);
+
+        if (len >= 0 && (size_t) len < sizeof(entry->text))
+        {
+            clock_gettime(CLOCK_REALTIME, &entry->timestamp);
+            entry->event = LOG_EVENT_MESSAGE;
+            log_publish_entry(ring);
+            return;
+        }
+    }
+
+    // The ring is full, the message is too long for an entry, or the logging
+    // thread is not running
+    va_start(args, format);
+    log_write_sync(LOG_WARNING, format, args);
+    va_end(args);
+}
+
+
+//
+// Report a fatal error
+//
+__attribute__ ((noreturn, format (printf, 1, 2)))
+void fatal(
+    const char *                format,
+    ...)
+{
+    va_list                     args;
+
+    va_start(args, format);
+    log_write_sync(LOG_ERR, format, args);
+    va_end(args);
+
+    exit(EXIT_FAILURE);
+}
+
+
+//
+// Record a bridge packet forwarding debug event
+// NB: Formatting of the event is deferred to the logging thread
+//
+void log_packet(
+    log_event_t                 event,
+    const bridge_instance_t *   bridge,
+    const char *                inbound,
+    const char *                outbound,
+    const void *                src_addr,
+    unsigned int                len,
+    unsigned int                value)
+{
+    log_ring_t *                ring;
+    log_entry_t *               entry;
+    struct timespec             ts;
+    size_t                      name_len;
+
+    // Per packet events are only recorded once the logging thread is running
+    if (__atomic_load_n(&log_thread_running, __ATOMIC_ACQUIRE) == 0)
+    {
+        return;
+    }
+
+    ring = log_get_ring();
+    if (ring == NULL)
+    {
+        return;
+    }
+
+    // Sampling
+    if (debug_log_sample > 1)
+    {
+        ring->sample_count += 1;
+        if (ring->sample_count < debug_log_sample)
+        {
+            return;
+        }
+        ring->sample_count = 0;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    // Rate limiting
+    if (debug_log_rate)
+    {
+        if (ts.tv_sec != ring->rate_second)
+        {
+            if (ring->suppressed)
+            {
+                entry = log_reserve_entry(ring);
+                if (entry)
+                {
+                    entry->timestamp = ts;
+                    entry->event = LOG_EVENT_MESSAGE;
+                    snprintf(entry->text, sizeof(entry->text), "Debug log rate limit: %u events suppressed\n",
+                             ring->suppressed);
+                    log_publish_entry(ring);
+                }
+                ring->suppressed = 0;
+            }
+            ring->rate_second = ts.tv_sec;
+            ring->rate_count = 0;
+        }
+
+        if (ring->rate_count >= debug_log_rate)
+        {
+            ring->suppressed += 1;
+            return;
+        }
+        ring->rate_count += 1;
+    }
+
+    entry = log_reserve_entry(ring);
+    if (entry == NULL)
+    {
+        // Wake the logging thread so that the loss is reported even if no
+        // further entries are published
+        __atomic_store_n(&ring->lost, ring->lost + 1, __ATOMIC_RELAXED);
+        log_wakeup();
+        return;
+    }
+
+    entry->timestamp = ts;
+    entry->event = event;
+    entry->family = bridge->family;
+    entry->port = bridge->port;
+    entry->packet.len = len;
+    entry->packet.value = value;
+    if (src_addr)
+    {
+        memcpy(entry->packet.src_addr, src_addr, bridge->family == AF_INET ? 4 : 16);
+    }
+    else
+    {
+        memset(entry->packet.src_addr, 0, sizeof(entry->packet.src_addr));
+    }
+
+    entry->packet.inbound[0] = '\0';
+    if (inbound)
+    {
+        name_len = strnlen(inbound, IFNAMSIZ - 1);
+        memcpy(entry->packet.inbound, inbound, name_len);
+        entry->packet.inbound[name_len] = '\0';
+    }
+    entry->packet.outbound[0] = '\0';
+    if (outbound)
+    {
+        name_len = strnlen(outbound, IFNAMSIZ - 1);
+        memcpy(entry->packet.outbound, outbound, name_len);
+        entry->packet.outbound[name_len] = '\0';
+    }
+
+    log_publish_entry(ring);
+}
+
+
+//
+// Initialize logging
+//
+void initialize_log(
+    unsigned int                foreground,
+    unsigned int                use_syslog)
+{
+    int                         r;
+
+    log_foreground = foreground;
+    log_syslog = use_syslog;
+
+    r = pthread_key_create(&log_ring_key, NULL);
+    if (r)
+    {
+        fatal("pthread_key_create: %s\n", strerror(r));
+    }
+}
+
+
+//
+// Start the logging thread
+//
+void start_log(void)
+{
+    pthread_t                   thread_id;
+    int                         r;
+
+    r = pthread_create(&thread_id, NULL, &log_thread, NULL);
+    if (r != 0)
+    {
+        fatal("cannot create logging thread: %s\n", strerror(r));
+    }
+
+    __atomic_store_n(&log_thread_running, 1, __ATOMIC_RELEASE);
+}
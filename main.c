@@ -31,11 +31,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <stdarg.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
-#include <syslog.h>
 #include <pthread.h>
 #include <sys/file.h>
 
@@ -48,10 +46,15 @@ static const char *             progname;
 // Command line options
 static unsigned int             foreground = 0;
 static unsigned int             flag_syslog = 0;
+static unsigned int             flag_test = 0;
 unsigned int                    debug_level = 0;
 unsigned int                    non_configured_groups = 100;
 querier_mode_type_t             igmp_querier_mode = QUERIER_MODE_QUICK;
 querier_mode_type_t             mld_querier_mode = QUERIER_MODE_QUICK;
+unsigned int                    worker_thread_count = 0;
+const char *                    stats_socket_path = NULL;
+unsigned int                    debug_log_sample = 0;
+unsigned int                    debug_log_rate = 0;
 
 
 // Process ID file
@@ -65,74 +68,46 @@ const char *                    config_filename = DEFAULT_CONFIG_FILE;
 static volatile sig_atomic_t term_pending = 0;
 static volatile sig_atomic_t term_signum = 0;
 
+// Statistics dump handling
+static volatile sig_atomic_t stats_pending = 0;
+
+// Configuration reload handling
+static volatile sig_atomic_t reload_pending = 0;
+
 
 //
-// Log abnormal events
+// Termination handler
 //
-__attribute__ ((format (printf, 1, 2)))
-void logger(
-    const char *                format,
-    ...)
+static void term_handler(
+    int                         signum)
 {
-    va_list                     args;
-
-    va_start(args, format);
-    if (flag_syslog)
-    {
-        vsyslog(LOG_WARNING, format, args);
-    }
-    else
+    if (term_pending == 0)
     {
-        // If foreground and debug is enabled, prepend a timestamp
-        if (foreground && debug_level)
-        {
-            struct timespec ts;
-            clock_gettime(CLOCK_REALTIME, &ts);
-            fprintf(stderr, "%ld.%06ld: ", (long) ts.tv_sec, ts.tv_nsec / 1000);
-        }
-
-        vfprintf(stderr, format, args);
+        term_pending = 1;
+        term_signum = signum;
     }
-    va_end(args);
 }
 
 
 //
-// Report a fatal error
+// Statistics dump handler
 //
-__attribute__ ((noreturn, format (printf, 1, 2)))
-void fatal(
-    const char *                format,
-    ...)
+static void stats_handler(
+    __attribute__ ((unused))
+    int                         signum)
 {
-    va_list                     args;
-
-    va_start(args, format);
-    if (flag_syslog)
-    {
-        vsyslog(LOG_ERR, format, args);
-    }
-    else
-    {
-        vfprintf(stderr, format, args);
-    }
-    va_end(args);
-
-    exit(EXIT_FAILURE);
+    stats_pending = 1;
 }
 
 
 //
-// Termination handler
+// Configuration reload handler
 //
-static void term_handler(
+static void reload_handler(
+    __attribute__ ((unused))
     int                         signum)
 {
-    if (term_pending == 0)
-    {
-        term_pending = 1;
-        term_signum = signum;
-    }
+    reload_pending = 1;
 }
 
 
@@ -144,11 +119,12 @@ static void usage(
     void)
 {
     fprintf(stderr, "Usage:\n");
-    fprintf(stderr, "  %s [-h] [-f] [-s] [-c config_file] [-p pid_file] [-I IGMP_querier_mode] [-M MLD_querier_mode] [-D debug_level]\n", progname);
+    fprintf(stderr, "  %s [-h] [-f] [-s] [-t] [-c config_file] [-p pid_file] [-I IGMP_querier_mode] [-M MLD_querier_mode] [-D debug_level]\n", progname);
     fprintf(stderr, "  Options:\n");
     fprintf(stderr, "    -h display usage\n");
     fprintf(stderr, "    -f run in foreground\n");
     fprintf(stderr, "    -s log notifications via syslog\n");
+    fprintf(stderr, "    -t test the configuration file and exit\n");
     fprintf(stderr, "    -c configuration file name\n");
     fprintf(stderr, "    -p process id file name\n");
     fprintf(stderr, "    -I IGMP querier mode\n");
@@ -208,7 +184,7 @@ static void parse_args(
 
     progname = argv[0];
 
-    while((opt = getopt(argc, argv, "hfsc:p:I:M:D:")) != -1)
+    while((opt = getopt(argc, argv, "hfstc:p:I:M:D:")) != -1)
     {
         switch (opt)
         {
@@ -218,6 +194,9 @@ static void parse_args(
         case 's':
             flag_syslog = 1;
             break;
+        case 't':
+            flag_test = 1;
+            break;
         case 'c':
             config_filename = optarg;
             break;
@@ -350,19 +329,32 @@ int main(
     int                         pidfile_fd = -1;
     pid_t                       pid;
     struct sigaction            act;
+    sigset_t                    sigset;
 
     // Handle command line args
     parse_args(argc, argv);
 
+    // Initialize logging
+    initialize_log(foreground, flag_syslog);
+
     // Read config file
     read_config();
 
+    // Stop here if only testing the config file
+    if (flag_test)
+    {
+        exit(EXIT_SUCCESS);
+    }
+
     // Dump the configuration
     if (foreground)
     {
         dump_config();
     }
 
+    // Select the checksum implementation
+    initialize_inet_csum();
+
     // Initialize the interfaces
     initialize_interfaces();
 
@@ -372,6 +364,18 @@ int main(
     (void) sigaction(SIGTERM, &act, NULL);
     (void) sigaction(SIGINT, &act, NULL);
 
+    // Statistics dump handler
+    act.sa_handler = (void (*)(int)) stats_handler;
+    (void) sigaction(SIGUSR1, &act, NULL);
+
+    // Configuration reload handler
+    act.sa_handler = (void (*)(int)) reload_handler;
+    (void) sigaction(SIGHUP, &act, NULL);
+
+    // Errors writing to statistics clients are handled inline
+    act.sa_handler = SIG_IGN;
+    (void) sigaction(SIGPIPE, &act, NULL);
+
     // Create pid file if requested
     if (pidfile_name)
     {
@@ -408,27 +412,71 @@ int main(
     initialize_igmp(foreground);
     initialize_mld(foreground);
 
+    // Initialize the statistics socket
+    initialize_stats();
+
     // Drop privileges
     (void) setgid(getgid());
     (void) setuid(getuid());
 
+    // Block the handled signals in the threads so that they are delivered to
+    // the main thread
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGTERM);
+    sigaddset(&sigset, SIGINT);
+    sigaddset(&sigset, SIGUSR1);
+    sigaddset(&sigset, SIGHUP);
+    (void) pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+    // Start the logging thread
+    start_log();
+
+    // Start the bridge(s)
+    // NB: The bridges are started before IGMP & MLD so that all interface changes
+    //     made by IGMP & MLD are posted to the bridge workers
+    start_bridges();
+
     // Start IGMP & MLD
     start_igmp();
     start_mld();
 
-    // Start the bridge(s)
-    start_bridges();
+#if defined(USE_MROUTE)
+    // Start the kernel dataplane
+    start_mroute();
+#endif
+
+    // Start the statistics socket
+    start_stats();
+
+    (void) pthread_sigmask(SIG_UNBLOCK, &sigset, NULL);
 
     // Wait (forever)
     while (term_pending == 0)
     {
         pause();
+
+        if (stats_pending)
+        {
+            stats_pending = 0;
+            stats_log();
+        }
+
+        if (reload_pending)
+        {
+            reload_pending = 0;
+            reload_config();
+        }
     }
 
     if (pidfile_name)
     {
         (void) unlink(pidfile_name);
     }
+    if (stats_socket_path)
+    {
+        (void) unlink(stats_socket_path);
+    }
     logger("exiting on signal %d\n", (int) term_signum);
+    log_flush();
     exit(EXIT_SUCCESS);
 }
@@ -27,9 +27,15 @@
 //
 
 
+// Linux requires _GNU_SOURCE for recvmmsg/sendmmsg
+#if defined(__linux__)
+# define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <time.h>
@@ -52,6 +58,77 @@
 #define DEFAULT_PORT            7500
 #define DEFAULT_TTL             1
 
+// Batched socket I/O (recvmmsg/sendmmsg)
+#if defined(__linux__) || defined(__FreeBSD__)
+# define USE_MMSG
+#endif
+
+// Load generation and analysis defaults and limits
+#define DEFAULT_PAYLOAD_SIZE    64
+#define DEFAULT_BURST           1
+#define DEFAULT_INTERVAL        1
+#define MAX_PAYLOAD_SIZE        65507
+#define MAX_BURST               64
+#define MAX_RATE                100000000
+
+// Receive batch size and timeout used by the analyzer. The timeout ensures
+// that reports are produced when no packets are arriving.
+#define ANALYZE_BATCH_SIZE      64
+#define ANALYZE_TIMEOUT_USEC    100000
+
+// Sequence window used by the analyzer to detect duplicates (power of 2).
+// Packets older than the window are counted as late.
+#define ANALYZE_WINDOW_SIZE     65536
+
+// Latency histogram (see the forwarding latency histogram in common.h)
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_BUCKET_COUNT    1024
+#define LATENCY_LINEAR_LIMIT    (1u << (LATENCY_SUB_BUCKET_BITS + 1))
+
+// Header of each load datagram. All fields are in network byte order.
+//
+// The stream identifier distinguishes senders, and restarts of a sender.
+// The send time is CLOCK_MONOTONIC in nanoseconds, and is only meaningful
+// to a receiver sharing the same clock, such as network namespaces on the
+// same host.
+#define LOAD_MAGIC              0x4d435352
+typedef struct
+{
+    uint32_t                    magic;
+    uint32_t                    stream;
+    uint64_t                    sequence;
+    uint64_t                    send_time;
+} load_header_t;
+
+// Receive analysis state
+typedef struct
+{
+    // Stream being analyzed
+    uint32_t                    stream;
+    unsigned int                active;
+
+    // Highest sequence number seen, and the first sequence number of the stream
+    uint64_t                    first_sequence;
+    uint64_t                    highest_sequence;
+
+    // Sequence numbers seen in the window below the highest
+    uint8_t                     window[ANALYZE_WINDOW_SIZE / 8];
+
+    // Totals since the start of the stream
+    uint64_t                    total_packets;
+    uint64_t                    total_reordered;
+    uint64_t                    total_duplicates;
+
+    // Counts for the current interval
+    uint64_t                    packets;
+    uint64_t                    bytes;
+    uint64_t                    reordered;
+    uint64_t                    duplicates;
+    uint64_t                    invalid;
+    uint64_t                    latency_max;
+    uint64_t                    latency[LATENCY_BUCKET_COUNT];
+} analyze_state_t;
+
 // Who we are
 static const char *             progname;
 
@@ -63,6 +140,14 @@ static char *                   interface_name = "(default)";
 static unsigned int             interface_index = 0;
 static unsigned int             port = DEFAULT_PORT;
 static unsigned int             ttl = DEFAULT_TTL;
+static unsigned int             analyze_mode = 0;
+static unsigned long            rate_pps = 0;
+static unsigned long            rate_mbps = 0;
+static unsigned int             payload_size = DEFAULT_PAYLOAD_SIZE;
+static unsigned int             burst = DEFAULT_BURST;
+static unsigned int             duration = 0;
+static unsigned int             report_interval = DEFAULT_INTERVAL;
+static unsigned int             json = 0;
 
 // Group address structures
 static struct sockaddr_in       ipv4_group_sockaddr_in;
@@ -89,6 +174,57 @@ void fatal(
 }
 
 
+//
+// Get the current monotonic time in nanoseconds
+//
+static uint64_t monotonic_ns(void)
+{
+    struct timespec             ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+//
+// Convert a 64 bit value between host and network byte order
+//
+static uint64_t swap64(
+    uint64_t                    value)
+{
+    if (htonl(1) == 1)
+    {
+        return value;
+    }
+
+    return ((uint64_t) htonl((uint32_t) value) << 32) | htonl((uint32_t) (value >> 32));
+}
+
+
+//
+// Parse a numeric command line option
+//
+static unsigned long parse_number(
+    const char *                str,
+    unsigned long               min,
+    unsigned long               max,
+    const char *                name)
+{
+    unsigned long               value = 0;
+
+    if (strlen(str) && strspn(str, "0123456789") == strlen(str))
+    {
+        value = strtoul(str, NULL, 10);
+    }
+    if (value < min || value > max)
+    {
+        fatal("Invalid %s \"%s\"\n", name, str);
+    }
+
+    return value;
+}
+
+
 //
 // Bind for IPv4
 //
@@ -97,7 +233,7 @@ static int bind_ipv4(
 {
     int                         sock;
     const int                   on = 1;
-    const int                   ttl = 5;
+    const int                   mcast_ttl = (int) ttl;
     struct ip_mreqn             mreqn;
     int                         r;
     struct sockaddr_in          bind_sockaddr =
@@ -156,7 +292,7 @@ static int bind_ipv4(
     }
 
     // Set the ttl
-    r = setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    r = setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &mcast_ttl, sizeof(mcast_ttl));
     if (r == -1)
     {
         fatal("setsockopt (IP_MULTICAST_TTL) for IPv4 on %s failed: %s\n", interface_name, strerror(errno));
@@ -192,7 +328,7 @@ static int bind_ipv6(
 {
     int                         sock;
     const int                   on = 1;
-    const int                   ttl = 1;
+    const int                   mcast_ttl = (int) ttl;
     struct ipv6_mreq            mreq6;
     int                         r;
     struct sockaddr_in6         bind_sockaddr =
@@ -258,7 +394,7 @@ static int bind_ipv6(
     }
 
     // Set the ttl
-    r = setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &ttl, sizeof(ttl));
+    r = setsockopt(sock, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &mcast_ttl, sizeof(mcast_ttl));
     if (r == -1)
     {
         fatal("setsockopt (IPV6_MULTICAST_HOPS) for IPv6 on %s failed: %s\n", interface_name, strerror(errno));
@@ -358,6 +494,596 @@ static void receiver(
 }
 
 
+//
+// Send a burst of load datagrams
+//
+// Returns the number of datagrams dropped due to a lack of buffer space
+//
+static unsigned int load_send_burst(
+    int                         sock,
+    unsigned char *             buffers,
+    unsigned int                count)
+{
+    unsigned int                dropped = 0;
+    unsigned int                sent = 0;
+    int                         r;
+
+#if defined(USE_MMSG)
+    struct mmsghdr              msgs[MAX_BURST];
+    struct iovec                iovecs[MAX_BURST];
+    unsigned int                index;
+
+    memset(msgs, 0, sizeof(msgs[0]) * count);
+    for (index = 0; index < count; index++)
+    {
+        iovecs[index].iov_base = buffers + index * payload_size;
+        iovecs[index].iov_len = payload_size;
+        msgs[index].msg_hdr.msg_name = group_addr;
+        msgs[index].msg_hdr.msg_namelen = group_addr_len;
+        msgs[index].msg_hdr.msg_iov = &iovecs[index];
+        msgs[index].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (sent < count)
+    {
+        r = sendmmsg(sock, &msgs[sent], count - sent, 0);
+        if (r == -1)
+        {
+            if (errno != ENOBUFS && errno != EAGAIN && errno != EINTR)
+            {
+                fatal("sendmmsg error: %s\n", strerror(errno));
+            }
+
+            // Skip the datagram that could not be sent
+            dropped += 1;
+            sent += 1;
+            continue;
+        }
+        sent += (unsigned int) r;
+    }
+#else
+    for (sent = 0; sent < count; sent++)
+    {
+        r = sendto(sock, buffers + sent * payload_size, payload_size, 0, group_addr, group_addr_len);
+        if (r == -1)
+        {
+            if (errno != ENOBUFS && errno != EAGAIN && errno != EINTR)
+            {
+                fatal("sendto error: %s\n", strerror(errno));
+            }
+            dropped += 1;
+        }
+    }
+#endif
+
+    return dropped;
+}
+
+
+//
+// Load sender loop
+//
+__attribute__ ((noreturn))
+static void load_sender(
+    int                         sock)
+{
+    unsigned char *             buffers;
+    load_header_t *             header;
+    uint32_t                    stream;
+    uint64_t                    sequence = 0;
+    uint64_t                    pps;
+    uint64_t                    burst_interval;
+    uint64_t                    start;
+    uint64_t                    now;
+    uint64_t                    next;
+    uint64_t                    report_time;
+    uint64_t                    report_start;
+    uint64_t                    end_time = 0;
+    uint64_t                    wait;
+    uint64_t                    packets = 0;
+    uint64_t                    dropped = 0;
+    uint64_t                    total_packets = 0;
+    uint64_t                    total_dropped = 0;
+    struct timespec             ts;
+    double                      elapsed;
+    unsigned int                index;
+    unsigned int                count;
+
+    // Determine the packet rate
+    if (rate_mbps)
+    {
+        pps = (uint64_t) rate_mbps * 1000000 / ((uint64_t) payload_size * 8);
+        if (pps == 0)
+        {
+            pps = 1;
+        }
+    }
+    else
+    {
+        pps = rate_pps;
+    }
+    burst_interval = (uint64_t) burst * 1000000000 / pps;
+
+    buffers = calloc(burst, payload_size);
+    if (buffers == NULL)
+    {
+        fatal("Cannot allocate memory for send buffers\n");
+    }
+
+    now = monotonic_ns();
+    stream = (uint32_t) (now ^ ((uint64_t) getpid() << 16));
+
+    if (json)
+    {
+        printf("{\"report\":\"start\",\"stream\":\"%08x\",\"size\":%lu,\"rate_pps\":%llu,\"burst\":%u}\n",
+            stream, (unsigned long) payload_size, (unsigned long long) pps, burst);
+    }
+    else
+    {
+        printf("Sending %lu byte datagrams at %llu pps (%.2f Mbit/s) in bursts of %u, stream %08x\n",
+            (unsigned long) payload_size, (unsigned long long) pps,
+            (double) pps * payload_size * 8 / 1000000, burst, stream);
+    }
+    fflush(stdout);
+
+    start = now;
+    next = now;
+    report_start = now;
+    report_time = now + (uint64_t) report_interval * 1000000000;
+    if (duration)
+    {
+        end_time = now + (uint64_t) duration * 1000000000;
+    }
+
+    while (1)
+    {
+        now = monotonic_ns();
+
+        // Report the interval
+        if (now >= report_time || (end_time && now >= end_time))
+        {
+            elapsed = (double) (now - report_start) / 1000000000;
+            if (json)
+            {
+                printf("{\"report\":\"interval\",\"time\":%.1f,\"packets\":%llu,\"pps\":%.0f,\"mbps\":%.2f,\"dropped\":%llu}\n",
+                    (double) (now - start) / 1000000000, (unsigned long long) packets,
+                    (double) packets / elapsed, (double) packets * payload_size * 8 / elapsed / 1000000,
+                    (unsigned long long) dropped);
+            }
+            else
+            {
+                printf("%8.1fs: sent %llu pkts, %.0f pps, %.2f Mbit/s, dropped %llu\n",
+                    (double) (now - start) / 1000000000, (unsigned long long) packets,
+                    (double) packets / elapsed, (double) packets * payload_size * 8 / elapsed / 1000000,
+                    (unsigned long long) dropped);
+            }
+            fflush(stdout);
+
+            total_packets += packets;
+            total_dropped += dropped;
+            packets = 0;
+            dropped = 0;
+            report_start = now;
+            report_time += (uint64_t) report_interval * 1000000000;
+
+            if (end_time && now >= end_time)
+            {
+                elapsed = (double) (now - start) / 1000000000;
+                if (json)
+                {
+                    printf("{\"report\":\"total\",\"time\":%.1f,\"packets\":%llu,\"pps\":%.0f,\"mbps\":%.2f,\"dropped\":%llu}\n",
+                        elapsed, (unsigned long long) total_packets,
+                        (double) total_packets / elapsed, (double) total_packets * payload_size * 8 / elapsed / 1000000,
+                        (unsigned long long) total_dropped);
+                }
+                else
+                {
+                    printf("Total: sent %llu pkts in %.1fs, %.0f pps, %.2f Mbit/s, dropped %llu\n",
+                        (unsigned long long) total_packets, elapsed,
+                        (double) total_packets / elapsed, (double) total_packets * payload_size * 8 / elapsed / 1000000,
+                        (unsigned long long) total_dropped);
+                }
+                exit(EXIT_SUCCESS);
+            }
+        }
+
+        // Wait for the next burst
+        if (now < next)
+        {
+            wait = next - now;
+            if (now + wait > report_time)
+            {
+                wait = report_time - now;
+            }
+            ts.tv_sec = (time_t) (wait / 1000000000);
+            ts.tv_nsec = (long) (wait % 1000000000);
+            (void) nanosleep(&ts, NULL);
+            continue;
+        }
+
+        // Stamp and send the burst
+        count = burst;
+        for (index = 0; index < count; index++)
+        {
+            header = (load_header_t *) (buffers + index * payload_size);
+            header->magic = htonl(LOAD_MAGIC);
+            header->stream = htonl(stream);
+            header->sequence = swap64(sequence++);
+            header->send_time = swap64(now);
+        }
+        index = load_send_burst(sock, buffers, count);
+        packets += count - index;
+        dropped += index;
+
+        // Schedule the next burst. If the sender has fallen more than a
+        // second behind, restart the schedule rather than bursting to catch up.
+        next += burst_interval;
+        if (now > next + 1000000000)
+        {
+            next = now;
+        }
+    }
+}
+
+
+//
+// Record a one way latency in the analyzer histogram
+//
+static void analyze_latency(
+    analyze_state_t *           state,
+    uint64_t                    value)
+{
+    unsigned int                exponent;
+    unsigned int                index;
+
+    if (value < LATENCY_LINEAR_LIMIT)
+    {
+        index = (unsigned int) value;
+    }
+    else
+    {
+        exponent = 63 - (unsigned int) __builtin_clzll(value);
+        index = LATENCY_LINEAR_LIMIT +
+            (exponent - LATENCY_SUB_BUCKET_BITS - 1) * (1u << LATENCY_SUB_BUCKET_BITS) +
+            (unsigned int) ((value >> (exponent - LATENCY_SUB_BUCKET_BITS)) & ((1u << LATENCY_SUB_BUCKET_BITS) - 1));
+        if (index >= LATENCY_BUCKET_COUNT)
+        {
+            index = LATENCY_BUCKET_COUNT - 1;
+        }
+    }
+
+    state->latency[index] += 1;
+    if (value > state->latency_max)
+    {
+        state->latency_max = value;
+    }
+}
+
+
+//
+// Determine a latency percentile (in parts per thousand) from the analyzer histogram
+//
+static double analyze_percentile(
+    const analyze_state_t *     state,
+    uint64_t                    count,
+    unsigned int                permille)
+{
+    uint64_t                    rank = (count * permille + 999) / 1000;
+    uint64_t                    total = 0;
+    uint64_t                    value;
+    unsigned int                exponent;
+    unsigned int                index;
+
+    for (index = 0; index < LATENCY_BUCKET_COUNT; index++)
+    {
+        total += state->latency[index];
+        if (total && total >= rank)
+        {
+            break;
+        }
+    }
+
+    // Use the largest value recorded in the bucket
+    if (index < LATENCY_LINEAR_LIMIT)
+    {
+        value = index;
+    }
+    else
+    {
+        exponent = (index - LATENCY_LINEAR_LIMIT) / (1u << LATENCY_SUB_BUCKET_BITS) + LATENCY_SUB_BUCKET_BITS + 1;
+        value = ((uint64_t) ((1u << LATENCY_SUB_BUCKET_BITS) + (index - LATENCY_LINEAR_LIMIT) % (1u << LATENCY_SUB_BUCKET_BITS) + 1)
+            << (exponent - LATENCY_SUB_BUCKET_BITS)) - 1;
+    }
+    if (value > state->latency_max)
+    {
+        value = state->latency_max;
+    }
+
+    return (double) value / 1000;
+}
+
+
+//
+// Analyze a received datagram
+//
+static void analyze_packet(
+    analyze_state_t *           state,
+    const unsigned char *       buffer,
+    size_t                      len,
+    uint64_t                    now)
+{
+    load_header_t               header;
+    uint32_t                    stream;
+    uint64_t                    sequence;
+    uint64_t                    send_time;
+    uint64_t                    seq;
+
+    if (len < sizeof(header))
+    {
+        state->invalid += 1;
+        return;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    if (ntohl(header.magic) != LOAD_MAGIC)
+    {
+        state->invalid += 1;
+        return;
+    }
+    stream = ntohl(header.stream);
+    sequence = swap64(header.sequence);
+    send_time = swap64(header.send_time);
+
+    if (state->active == 0 || stream != state->stream)
+    {
+        // Start a new stream
+        if (json)
+        {
+            printf("{\"report\":\"start\",\"stream\":\"%08x\"}\n", stream);
+        }
+        else
+        {
+            printf("Receiving stream %08x\n", stream);
+        }
+        memset(state->window, 0, sizeof(state->window));
+        state->stream = stream;
+        state->active = 1;
+        state->first_sequence = sequence;
+        state->highest_sequence = sequence;
+        state->total_packets = 0;
+        state->total_reordered = 0;
+        state->total_duplicates = 0;
+    }
+    else if (sequence > state->highest_sequence)
+    {
+        // Advance the window, clearing the sequence numbers skipped
+        if (sequence - state->highest_sequence >= ANALYZE_WINDOW_SIZE)
+        {
+            memset(state->window, 0, sizeof(state->window));
+        }
+        else
+        {
+            for (seq = state->highest_sequence + 1; seq < sequence; seq++)
+            {
+                state->window[(seq % ANALYZE_WINDOW_SIZE) / 8] &= (uint8_t) ~(1u << (seq % 8));
+            }
+        }
+        state->highest_sequence = sequence;
+    }
+    else if (state->highest_sequence - sequence >= ANALYZE_WINDOW_SIZE)
+    {
+        // Too old to check for duplication
+        state->reordered += 1;
+        state->total_reordered += 1;
+        if (sequence < state->first_sequence)
+        {
+            state->first_sequence = sequence;
+        }
+    }
+    else if (state->window[(sequence % ANALYZE_WINDOW_SIZE) / 8] & (1u << (sequence % 8)))
+    {
+        state->duplicates += 1;
+        state->total_duplicates += 1;
+        return;
+    }
+    else
+    {
+        state->reordered += 1;
+        state->total_reordered += 1;
+        if (sequence < state->first_sequence)
+        {
+            state->first_sequence = sequence;
+        }
+    }
+
+    if (state->highest_sequence - sequence < ANALYZE_WINDOW_SIZE)
+    {
+        state->window[(sequence % ANALYZE_WINDOW_SIZE) / 8] |= (uint8_t) (1u << (sequence % 8));
+    }
+    state->packets += 1;
+    state->bytes += len;
+    state->total_packets += 1;
+
+    // Ignore send times from a different clock
+    if (now >= send_time)
+    {
+        analyze_latency(state, now - send_time);
+    }
+}
+
+
+//
+// Report and reset the analyzer interval
+//
+static void analyze_report(
+    analyze_state_t *           state,
+    uint64_t                    elapsed,
+    double                      offset,
+    uint64_t *                  last_lost)
+{
+    uint64_t                    lost = 0;
+    uint64_t                    interval_lost;
+    uint64_t                    samples = 0;
+    unsigned int                index;
+    double                      seconds = (double) elapsed / 1000000000;
+
+    if (state->active)
+    {
+        lost = state->highest_sequence - state->first_sequence + 1 - state->total_packets;
+    }
+    interval_lost = lost >= *last_lost ? lost - *last_lost : 0;
+    *last_lost = lost;
+
+    for (index = 0; index < LATENCY_BUCKET_COUNT; index++)
+    {
+        samples += state->latency[index];
+    }
+
+    if (json)
+    {
+        printf("{\"report\":\"interval\",\"time\":%.1f,\"packets\":%llu,\"pps\":%.0f,\"mbps\":%.2f,"
+            "\"lost\":%llu,\"reordered\":%llu,\"duplicates\":%llu,\"invalid\":%llu",
+            offset, (unsigned long long) state->packets, (double) state->packets / seconds,
+            (double) state->bytes * 8 / seconds / 1000000, (unsigned long long) interval_lost,
+            (unsigned long long) state->reordered, (unsigned long long) state->duplicates,
+            (unsigned long long) state->invalid);
+        if (samples)
+        {
+            printf(",\"latency_us\":{\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}",
+                analyze_percentile(state, samples, 500), analyze_percentile(state, samples, 990),
+                analyze_percentile(state, samples, 999), (double) state->latency_max / 1000);
+        }
+        printf("}\n");
+    }
+    else
+    {
+        printf("%8.1fs: %llu pkts, %.0f pps, %.2f Mbit/s, lost %llu (%.3f%%), reordered %llu, duplicates %llu",
+            offset, (unsigned long long) state->packets, (double) state->packets / seconds,
+            (double) state->bytes * 8 / seconds / 1000000, (unsigned long long) interval_lost,
+            state->packets + interval_lost ? (double) interval_lost * 100 / (double) (state->packets + interval_lost) : 0.0,
+            (unsigned long long) state->reordered, (unsigned long long) state->duplicates);
+        if (state->invalid)
+        {
+            printf(", invalid %llu", (unsigned long long) state->invalid);
+        }
+        if (samples)
+        {
+            printf(", latency p50 %.1fus p99 %.1fus p99.9 %.1fus max %.1fus",
+                analyze_percentile(state, samples, 500), analyze_percentile(state, samples, 990),
+                analyze_percentile(state, samples, 999), (double) state->latency_max / 1000);
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+
+    state->packets = 0;
+    state->bytes = 0;
+    state->reordered = 0;
+    state->duplicates = 0;
+    state->invalid = 0;
+    state->latency_max = 0;
+    memset(state->latency, 0, sizeof(state->latency));
+}
+
+
+//
+// Load analyzer loop
+//
+__attribute__ ((noreturn))
+static void load_receiver(
+    int                         sock)
+{
+    analyze_state_t *           state;
+    unsigned char *             buffers;
+    struct timeval              tv;
+    const int                   rcvbuf = 4 * 1024 * 1024;
+    uint64_t                    start;
+    uint64_t                    now;
+    uint64_t                    report_start;
+    uint64_t                    report_time;
+    uint64_t                    last_lost = 0;
+    unsigned int                count;
+    unsigned int                index;
+    ssize_t                     bytes;
+    int                         r;
+
+#if defined(USE_MMSG)
+    struct mmsghdr              msgs[ANALYZE_BATCH_SIZE];
+    struct iovec                iovecs[ANALYZE_BATCH_SIZE];
+#endif
+
+    state = calloc(1, sizeof(*state));
+    buffers = malloc((size_t) ANALYZE_BATCH_SIZE * MAX_PAYLOAD_SIZE);
+    if (state == NULL || buffers == NULL)
+    {
+        fatal("Cannot allocate memory for analysis\n");
+    }
+
+    // Ensure reports are produced when no packets are arriving
+    tv.tv_sec = 0;
+    tv.tv_usec = ANALYZE_TIMEOUT_USEC;
+    r = setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (r == -1)
+    {
+        fatal("setsockopt (SO_RCVTIMEO) failed: %s\n", strerror(errno));
+    }
+
+    // Request a larger receive buffer to absorb bursts (failure is not fatal)
+    (void) setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+#if defined(USE_MMSG)
+    memset(msgs, 0, sizeof(msgs));
+    for (index = 0; index < ANALYZE_BATCH_SIZE; index++)
+    {
+        iovecs[index].iov_base = buffers + index * MAX_PAYLOAD_SIZE;
+        iovecs[index].iov_len = MAX_PAYLOAD_SIZE;
+        msgs[index].msg_hdr.msg_iov = &iovecs[index];
+        msgs[index].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+
+    fflush(stdout);
+    start = monotonic_ns();
+    report_start = start;
+    report_time = start + (uint64_t) report_interval * 1000000000;
+
+    while (1)
+    {
+#if defined(USE_MMSG)
+        r = recvmmsg(sock, msgs, ANALYZE_BATCH_SIZE, MSG_WAITFORONE, NULL);
+        count = r > 0 ? (unsigned int) r : 0;
+#else
+        bytes = recv(sock, buffers, MAX_PAYLOAD_SIZE, 0);
+        r = bytes >= 0 ? 1 : -1;
+        count = r > 0 ? 1 : 0;
+#endif
+        if (r == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            fatal("recv error: %s\n", strerror(errno));
+        }
+
+        now = monotonic_ns();
+        for (index = 0; index < count; index++)
+        {
+#if defined(USE_MMSG)
+            bytes = msgs[index].msg_len;
+#endif
+            analyze_packet(state, buffers + index * MAX_PAYLOAD_SIZE, (size_t) bytes, now);
+        }
+
+        if (now >= report_time)
+        {
+            analyze_report(state, now - report_start, (double) (now - start) / 1000000000, &last_lost);
+            report_start = now;
+            report_time += (uint64_t) report_interval * 1000000000;
+            if (report_time <= now)
+            {
+                report_time = now + (uint64_t) report_interval * 1000000000;
+            }
+        }
+    }
+}
+
+
 //
 // Parse command line arguments
 //
@@ -371,7 +1097,7 @@ static void parse_args(
 
     progname = argv[0];
 
-    while((opt = getopt(argc, argv, "h46nsi:p:t:")) != -1)
+    while((opt = getopt(argc, argv, "h46nsaji:p:t:r:b:l:B:d:I:")) != -1)
     {
         switch (opt)
         {
@@ -391,6 +1117,38 @@ static void parse_args(
             send_mode = 1;
             break;
 
+        case 'a':
+            analyze_mode = 1;
+            break;
+
+        case 'j':
+            json = 1;
+            break;
+
+        case 'r':
+            rate_pps = parse_number(optarg, 1, MAX_RATE, "packet rate");
+            break;
+
+        case 'b':
+            rate_mbps = parse_number(optarg, 1, MAX_RATE, "bit rate");
+            break;
+
+        case 'l':
+            payload_size = (unsigned int) parse_number(optarg, sizeof(load_header_t), MAX_PAYLOAD_SIZE, "payload size");
+            break;
+
+        case 'B':
+            burst = (unsigned int) parse_number(optarg, 1, MAX_BURST, "burst size");
+            break;
+
+        case 'd':
+            duration = (unsigned int) parse_number(optarg, 1, 86400, "duration");
+            break;
+
+        case 'I':
+            report_interval = (unsigned int) parse_number(optarg, 1, 3600, "report interval");
+            break;
+
         case 'i':
             interface_name = optarg;
             interface_index = if_nametoindex(interface_name);
@@ -430,6 +1188,8 @@ static void parse_args(
         default:
             fprintf(stderr, "Usage:\n");
             fprintf(stderr, "  %s [-4|-6] [-n] [-s] [-i interface] [-p port] [-t ttl] [multicast address]\n", progname);
+            fprintf(stderr, "  %s -s [-4|-6] -r pps|-b Mbit/s [-l size] [-B burst] [-d seconds] [-I seconds] [-j] [-i interface] [-p port] [-t ttl] [multicast address]\n", progname);
+            fprintf(stderr, "  %s -a [-4|-6] [-I seconds] [-j] [-i interface] [-p port] [multicast address]\n", progname);
             fprintf(stderr, "\n");
             fprintf(stderr, "  options:\n");
             fprintf(stderr, "    -4 IP version 4 (default)\n");
@@ -440,6 +1200,16 @@ static void parse_args(
             fprintf(stderr, "    -p UDP port (default is 7500)\n");
             fprintf(stderr, "    -t Multicast TTL (default is 1)\n");
             fprintf(stderr, "\n");
+            fprintf(stderr, "  load options:\n");
+            fprintf(stderr, "    -r send load datagrams at the given rate in packets per second\n");
+            fprintf(stderr, "    -b send load datagrams at the given rate in Mbit/s (UDP payload)\n");
+            fprintf(stderr, "    -l load datagram payload size (default is %u)\n", DEFAULT_PAYLOAD_SIZE);
+            fprintf(stderr, "    -B load datagrams sent per burst (default is %u, maximum is %u)\n", DEFAULT_BURST, MAX_BURST);
+            fprintf(stderr, "    -d stop sending after the given number of seconds (default is no limit)\n");
+            fprintf(stderr, "    -a analyze received load datagrams\n");
+            fprintf(stderr, "    -I report interval in seconds for load modes (default is %u)\n", DEFAULT_INTERVAL);
+            fprintf(stderr, "    -j report load statistics as JSON, one object per line\n");
+            fprintf(stderr, "\n");
             fprintf(stderr, "  the default multicast address for IP version 4 is %s\n",
                 inet_ntop(AF_INET, &ipv4_group_sockaddr_in.sin_addr, addr_str, sizeof(addr_str)));
             fprintf(stderr, "  the default multicast address for IP version 6 is %s\n",
@@ -468,6 +1238,20 @@ static void parse_args(
             }
         }
     }
+
+    // Check the load options
+    if (rate_pps && rate_mbps)
+    {
+        fatal("Only one of -r and -b may be specified\n");
+    }
+    if ((rate_pps || rate_mbps) && send_mode == 0)
+    {
+        fatal("-r and -b require sender mode (-s)\n");
+    }
+    if (analyze_mode && send_mode)
+    {
+        fatal("-a cannot be used with sender mode (-s)\n");
+    }
  }
 
 
@@ -532,10 +1316,18 @@ int main(
     // Enter the send or receive loop
     if (send_mode)
     {
+        if (rate_pps || rate_mbps)
+        {
+            load_sender(sock);
+        }
         sender(sock);
     }
     else
     {
+        if (analyze_mode)
+        {
+            load_receiver(sock);
+        }
         receiver(sock);
     }
 }
@@ -41,6 +41,10 @@
 #include "common.h"
 #include "protocols.h"
 
+#if defined(USE_PACKET_ALLMULTI)
+# include <linux/if_packet.h>
+#endif
+
 
 //
 // The MLD implementation herein is primarily based on RFC 2236 and RFC 9976.
@@ -49,10 +53,12 @@
 //
 //  1. The implementation ignores all link-local scope multicast addresses (ff02::/16).
 //
-//  2. The MLDv2 implementation works at the IP group level only, ignoring all source
-//     specific address information. This is similar to some switches or routers with
-//     the forwarding method set to "IP Group Address" instead of "Source Specific IP
-//     Group Address".
+//  2. The MLDv2 implementation tracks the sources of include mode listeners only.
+//     Exclude mode records, and v1 reports, are treated as listeners for any source,
+//     ignoring the sources excluded. No multicast address and source specific queries
+//     are sent. When a listener blocks sources or changes to include mode, a multicast
+//     address specific query is sent instead, and the sources of the listeners that
+//     remain are refreshed by their reports.
 //
 //  3. The implementation offers multiple querier modes:
 //     * Never - The querier function is disabled.
@@ -101,6 +107,24 @@
 // Grace period for protocol timeouts in milliseconds
 #define GRACE_MILLIS            10
 
+// Capture length for MLD packets
+// NB: MLD messages are not fragmented, so they cannot exceed the link MTU. This allows
+//     for a VLAN tag and jumbo frames.
+#define MLD_SNAPLEN             (sizeof(mcb_ethernet_t) + 4 + 9216)
+
+// Maximum number of packets processed per pcap dispatch
+#define MLD_DISPATCH_COUNT      64
+
+// Maximum number of pcap dispatches per interface per event wait
+#define MLD_DRAIN_BUDGET        4
+
+
+// MLD source structure
+typedef struct mld_source
+{
+    uint8_t                     addr[MCB_IP6_ADDR_LEN];
+    struct timespec             deadline;
+} mld_source_t;
 
 // MLD group structure
 typedef struct mld_interface    mld_interface_t;
@@ -122,6 +146,24 @@ typedef struct mld_group
 
     // MLD parameters
     unsigned int                group_queries_remaining;
+
+    // Group membership deadline. Reports only move the deadline, and the group
+    // timer is rearmed for the remaining time if it expires before the deadline.
+    struct timespec             group_deadline;
+
+    // Source filter state. Listeners for any source hold the any source deadline,
+    // and include mode listeners hold the deadlines of their sources.
+    struct timespec             any_source_deadline;
+    mld_source_t                source_list[MAX_GROUP_SOURCES];
+    unsigned int                source_count;
+
+    // Is a source filter published to the bridge interfaces?
+    unsigned int                source_filter_published;
+
+    // Timers for group membership, group specific queries and source expiry
+    evm_timer_t                 group_timer;
+    evm_timer_t                 query_timer;
+    evm_timer_t                 source_timer;
 } mld_group_t;
 
 // MLD interface structure
@@ -133,6 +175,15 @@ typedef struct mld_interface
     unsigned int                group_list_count;
     unsigned int                group_list_fixed_limit;
 
+    // Hash index of the group list by group address
+    // NB: Entries are group list indexes plus one, with zero indicating an empty entry
+    unsigned int *              group_hash;
+    unsigned int                group_hash_mask;
+
+    // Free list (stack) of group list indexes available for non configured groups
+    unsigned int *              group_free_list;
+    unsigned int                group_free_list_count;
+
     // Interface name, index and address
     char *                      name;
     unsigned int                if_index;
@@ -155,6 +206,11 @@ typedef struct mld_interface
     // Number of startup queries remaining
     unsigned int                startup_queries_remaining;
 
+    // Timers for multicast router advertisements, general queries and querier timeout
+    evm_timer_t                 mrd_timer;
+    evm_timer_t                 general_query_timer;
+    evm_timer_t                 querier_timer;
+
     // Packet for multicast router advertisements
     uint8_t                     mrd_advertisement_packet[MLD_MRD_BUFFER_SIZE];
 
@@ -168,7 +224,9 @@ typedef struct mld_interface
 static evm_t *                  mld_evm;
 
 // MLD interface list
-static mld_interface_t *        mld_interface_list = NULL;
+// NB: Interfaces are not moved once allocated, as their groups and timers are
+//     referenced by the event manager
+static mld_interface_t **       mld_interface_list = NULL;
 static unsigned int             mld_interface_list_allocated = 0;
 static unsigned int             mld_interface_list_count = 0;
 
@@ -379,7 +437,7 @@ static void mld_send_mrd_advertisement(
     }
 
     // Set a timer for the next advertisement
-    evm_add_timer(mld_evm, millis, mld_send_mrd_advertisement, mld_interface);
+    evm_add_timer(mld_evm, &mld_interface->mrd_timer, millis, mld_send_mrd_advertisement, mld_interface);
 }
 
 
@@ -418,7 +476,7 @@ static void mld_send_general_query(
     }
 
     // Set a timer for the next query
-    evm_add_timer(mld_evm, millis, mld_send_general_query, mld_interface);
+    evm_add_timer(mld_evm, &mld_interface->general_query_timer, millis, mld_send_general_query, mld_interface);
 }
 
 
@@ -484,7 +542,7 @@ static void send_group_specific_query(
     mld_group->group_queries_remaining -= 1;
     if (mld_group->group_queries_remaining)
     {
-        evm_add_timer(mld_evm, mld_interface->querier_lastmbr_interval_millis, send_group_specific_query, mld_group);
+        evm_add_timer(mld_evm, &mld_group->query_timer, mld_interface->querier_lastmbr_interval_millis, send_group_specific_query, mld_group);
         return;
     }
 }
@@ -538,6 +596,353 @@ static void mld_querier_timeout(
 }
 
 
+//
+// Find the group hash entry for a group address
+//
+// NB: Returns the entry holding the address, or the empty entry that ends the probe sequence
+//
+static unsigned int mld_group_hash_entry(
+    const mld_interface_t *     mld_interface,
+    const uint8_t *             mcast_addr)
+{
+    unsigned int                entry;
+
+    entry = addr_hash(mcast_addr, MCB_IP6_ADDR_LEN) & mld_interface->group_hash_mask;
+    while (mld_interface->group_hash[entry])
+    {
+        if (MCB_IP6_ADDR_CMP(mld_interface->group_list[mld_interface->group_hash[entry] - 1].mcast_addr, mcast_addr) == 0)
+        {
+            break;
+        }
+        entry = (entry + 1) & mld_interface->group_hash_mask;
+    }
+
+    return entry;
+}
+
+
+//
+// Add a group to the group hash
+//
+static void mld_group_hash_add(
+    mld_interface_t *           mld_interface,
+    const mld_group_t *         mld_group)
+{
+    unsigned int                entry;
+
+    entry = mld_group_hash_entry(mld_interface, mld_group->mcast_addr);
+    mld_interface->group_hash[entry] = (unsigned int) (mld_group - mld_interface->group_list) + 1;
+}
+
+
+//
+// Delete a group from the group hash
+//
+static void mld_group_hash_del(
+    mld_interface_t *           mld_interface,
+    const mld_group_t *         mld_group)
+{
+    unsigned int                mask = mld_interface->group_hash_mask;
+    unsigned int                entry;
+    unsigned int                next;
+    unsigned int                home;
+
+    entry = mld_group_hash_entry(mld_interface, mld_group->mcast_addr);
+    if (mld_interface->group_hash[entry] == 0)
+    {
+        return;
+    }
+
+    // Close the gap by shifting back any following entries in the probe sequence that
+    // would otherwise become unreachable
+    next = entry;
+    while (1)
+    {
+        next = (next + 1) & mask;
+        if (mld_interface->group_hash[next] == 0)
+        {
+            break;
+        }
+
+        home = addr_hash(mld_interface->group_list[mld_interface->group_hash[next] - 1].mcast_addr, MCB_IP6_ADDR_LEN) & mask;
+        if (((next - home) & mask) >= ((next - entry) & mask))
+        {
+            mld_interface->group_hash[entry] = mld_interface->group_hash[next];
+            entry = next;
+        }
+    }
+
+    mld_interface->group_hash[entry] = 0;
+}
+
+
+//
+// Get the group membership interval in milliseconds
+//
+static unsigned int mld_membership_interval_millis(
+    const mld_interface_t *     mld_interface)
+{
+    return mld_interface->querier_robustness * mld_interface->querier_interval_sec * 1000 +
+           mld_interface->querier_response_interval_millis + GRACE_MILLIS;
+}
+
+
+// Update the source filter of a group on expiry of the source timer
+static void mld_source_timeout(
+    void *                      arg);
+
+
+//
+// Update the source filter of a group
+//
+// Expired sources are removed, the filter is published to the bridge interfaces
+// of the group if it has changed, and the source timer is scheduled for the next
+// deadline.
+//
+static void mld_group_update_sources(
+    mld_group_t *               mld_group,
+    unsigned int                changed)
+{
+    mld_source_t *              source;
+    uint8_t                     source_list[MAX_GROUP_SOURCES][MCB_IP6_ADDR_LEN];
+    struct timespec             now;
+    struct timespec             next;
+    unsigned int                have_next = 0;
+    unsigned int                any_source;
+    unsigned int                source_index;
+    unsigned int                interface_index;
+    char                        group_addr_str[INET6_ADDRSTRLEN] = "unknown";
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Is there a listener for any source?
+    any_source = timespec_delta_millis(&now, &mld_group->any_source_deadline) > 0;
+    if (any_source)
+    {
+        next = mld_group->any_source_deadline;
+        have_next = 1;
+    }
+
+    // Remove the expired sources and find the next deadline
+    source_index = 0;
+    while (source_index < mld_group->source_count)
+    {
+        source = &mld_group->source_list[source_index];
+        if (timespec_delta_millis(&now, &source->deadline) <= 0)
+        {
+            mld_group->source_count -= 1;
+            *source = mld_group->source_list[mld_group->source_count];
+            changed = 1;
+            continue;
+        }
+
+        if (have_next == 0 || timespec_delta_millis(&next, &source->deadline) < 0)
+        {
+            next = source->deadline;
+            have_next = 1;
+        }
+        MCB_IP6_ADDR_CPY(source_list[source_index], source->addr);
+        source_index += 1;
+    }
+
+    // Publish the filter if it has changed
+    if (any_source)
+    {
+        changed = mld_group->source_filter_published;
+        mld_group->source_filter_published = 0;
+    }
+    else if (mld_group->source_filter_published == 0)
+    {
+        changed = 1;
+        mld_group->source_filter_published = 1;
+    }
+    if (changed)
+    {
+        // Debug logging
+        if (debug_level >= 3)
+        {
+            inet_ntop(AF_INET6, mld_group->mcast_addr, group_addr_str, sizeof(group_addr_str));
+            if (any_source)
+            {
+                logger("MLD(%s) [%s]: forwarding any source\n", mld_group->mld_interface->name, group_addr_str);
+            }
+            else
+            {
+                logger("MLD(%s) [%s]: forwarding %u sources\n", mld_group->mld_interface->name,
+                    group_addr_str, source_index);
+            }
+        }
+
+        for (interface_index = 0; interface_index < mld_group->bridge_interface_list_count; interface_index += 1)
+        {
+            interface_set_source_filter(mld_group->bridge_interface_list[interface_index], mld_group->mcast_addr,
+                any_source ? NULL : source_list, source_index);
+        }
+    }
+
+    // Schedule the source timer for the next deadline
+    // NB: As with the group timer, a timer that will expire before the deadline is left alone
+    if (have_next &&
+        (mld_group->source_timer.heap_index == 0 ||
+         timespec_delta_millis(&next, &mld_group->source_timer.timespec) > 0))
+    {
+        evm_add_timer(mld_evm, &mld_group->source_timer, (unsigned int) timespec_delta_millis(&now, &next),
+            mld_source_timeout, mld_group);
+    }
+}
+
+
+//
+// IGMP source timeout
+//
+static void mld_source_timeout(
+    void *                      arg)
+{
+    mld_group_update_sources(arg, 0);
+}
+
+
+//
+// Add sources to the source filter state of a group
+//
+// NB: A NULL source list indicates a listener for any source
+//
+static void mld_group_add_sources(
+    mld_interface_t *           mld_interface,
+    mld_group_t *               mld_group,
+    const uint8_t *             srcs,
+    unsigned int                num_srcs)
+{
+    struct timespec             deadline;
+    unsigned int                changed = 0;
+    unsigned int                src_index;
+    unsigned int                source_index;
+
+    // Sources are only tracked for registered groups
+    if (mld_group->bridge_interface_list_count == 0 || (srcs && num_srcs == 0))
+    {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    timespec_add_millis(&deadline, mld_membership_interval_millis(mld_interface));
+
+    if (srcs == NULL)
+    {
+        mld_group->any_source_deadline = deadline;
+    }
+    for (src_index = 0; src_index < num_srcs; src_index += 1)
+    {
+        for (source_index = 0; source_index < mld_group->source_count; source_index += 1)
+        {
+            if (MCB_IP6_ADDR_CMP(mld_group->source_list[source_index].addr, srcs + src_index * MCB_IP6_ADDR_LEN) == 0)
+            {
+                break;
+            }
+        }
+
+        // If the source is new, add it
+        if (source_index >= mld_group->source_count)
+        {
+            if (mld_group->source_count >= MAX_GROUP_SOURCES)
+            {
+                mld_log(mld_interface, mld_group->mcast_addr, "Source list full -- forwarding any source");
+                mld_group->any_source_deadline = deadline;
+                break;
+            }
+            MCB_IP6_ADDR_CPY(mld_group->source_list[source_index].addr, srcs + src_index * MCB_IP6_ADDR_LEN);
+            mld_group->source_count += 1;
+            changed = 1;
+        }
+        mld_group->source_list[source_index].deadline = deadline;
+    }
+
+    mld_group_update_sources(mld_group, changed);
+}
+
+
+//
+// Does the source filter state of a group hold any of a list of sources?
+//
+static unsigned int mld_group_has_sources(
+    const mld_group_t *         mld_group,
+    const uint8_t *             srcs,
+    unsigned int                num_srcs)
+{
+    unsigned int                src_index;
+    unsigned int                source_index;
+
+    for (src_index = 0; src_index < num_srcs; src_index += 1)
+    {
+        for (source_index = 0; source_index < mld_group->source_count; source_index += 1)
+        {
+            if (MCB_IP6_ADDR_CMP(mld_group->source_list[source_index].addr, srcs + src_index * MCB_IP6_ADDR_LEN) == 0)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+//
+// Lower the source deadlines of a group
+//
+// NB: Listeners that remain respond to the group specific queries, restoring
+//     the deadlines of their sources
+//
+static void mld_group_lower_sources(
+    mld_group_t *               mld_group,
+    unsigned int                millis)
+{
+    struct timespec             deadline;
+    unsigned int                source_index;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    timespec_add_millis(&deadline, millis);
+
+    if (timespec_delta_millis(&deadline, &mld_group->any_source_deadline) > 0)
+    {
+        mld_group->any_source_deadline = deadline;
+    }
+    for (source_index = 0; source_index < mld_group->source_count; source_index += 1)
+    {
+        if (timespec_delta_millis(&deadline, &mld_group->source_list[source_index].deadline) > 0)
+        {
+            mld_group->source_list[source_index].deadline = deadline;
+        }
+    }
+
+    mld_group_update_sources(mld_group, 0);
+}
+
+
+//
+// Clear the source filter state of a group
+//
+static void mld_group_clear_sources(
+    mld_group_t *               mld_group)
+{
+    unsigned int                interface_index;
+
+    evm_del_timer(mld_evm, &mld_group->source_timer);
+    memset(&mld_group->any_source_deadline, 0, sizeof(mld_group->any_source_deadline));
+    mld_group->source_count = 0;
+
+    // Remove any published filter
+    if (mld_group->source_filter_published)
+    {
+        mld_group->source_filter_published = 0;
+        for (interface_index = 0; interface_index < mld_group->bridge_interface_list_count; interface_index += 1)
+        {
+            interface_set_source_filter(mld_group->bridge_interface_list[interface_index], mld_group->mcast_addr, NULL, 0);
+        }
+    }
+}
+
+
 //
 // MLD group timeout
 //
@@ -548,32 +953,63 @@ static void mld_group_timeout(
     mld_interface_t *           mld_interface = mld_group->mld_interface;
     unsigned int                group_index;
     unsigned int                bridge_interface_index;
+    struct timespec             now;
+    long                        millis;
+
+    // If the deadline has been extended, rearm the timer for the remaining time
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    millis = timespec_delta_millis(&now, &mld_group->group_deadline);
+    if (millis > 0)
+    {
+        evm_add_timer(mld_evm, &mld_group->group_timer, (unsigned int) millis, mld_group_timeout, mld_group);
+        return;
+    }
 
     mld_log(mld_interface, mld_group->mcast_addr, "Group membership timeout");
 
     // Mark the group as inactive
     mld_group->active = 0;
+    mld_group_clear_sources(mld_group);
 
-    // Is this one of the registered groups?
-    if (mld_group->bridge_interface_list_count)
+    // Deactivate the outbound interfaces of a registered group
+    for (bridge_interface_index = 0; bridge_interface_index < mld_group->bridge_interface_list_count; bridge_interface_index += 1)
+    {
+        interface_deactivate_outbound(mld_group->bridge_interface_list[bridge_interface_index]);
+    }
+
+    // Configured and registered groups remain in the hash
+    group_index = (unsigned int) (mld_group - mld_interface->group_list);
+    if (mld_group->bridge_interface_list_count || group_index < mld_interface->group_list_fixed_limit)
     {
-        // deactivate the outbound interfaces
-        for (bridge_interface_index = 0; bridge_interface_index < mld_group->bridge_interface_list_count; bridge_interface_index += 1)
-        {
-            interface_deactivate_outbound(mld_group->bridge_interface_list[bridge_interface_index]);
-        }
         return;
     }
 
-    // Tighten up the group list count if possible
-    for (group_index = mld_interface->group_list_count - 1; group_index > mld_interface->group_list_fixed_limit; group_index -= 1)
+    // Remove the group from the hash and return the slot to the free list
+    mld_group_hash_del(mld_interface, mld_group);
+    mld_interface->group_free_list[mld_interface->group_free_list_count] = group_index;
+    mld_interface->group_free_list_count += 1;
+}
+
+
+//
+// Set the group membership deadline
+//
+// NB: Extending the deadline of a scheduled group timer only records the new
+//     deadline. The timer is only rescheduled if the deadline moves earlier.
+//
+static void mld_group_set_deadline(
+    mld_group_t *               mld_group,
+    unsigned int                millis)
+{
+    clock_gettime(CLOCK_MONOTONIC, &mld_group->group_deadline);
+    timespec_add_millis(&mld_group->group_deadline, millis);
+
+    if (mld_group->group_timer.heap_index &&
+        timespec_delta_millis(&mld_group->group_timer.timespec, &mld_group->group_deadline) >= 0)
     {
-        if (mld_interface->group_list[group_index].active)
-        {
-            break;
-        }
-        mld_interface->group_list_count -= 1;
+        return;
     }
+    evm_add_timer(mld_evm, &mld_group->group_timer, millis, mld_group_timeout, mld_group);
 }
 
 
@@ -584,8 +1020,8 @@ static mld_group_t * mld_interface_find_group(
     mld_interface_t *           mld_interface,
     const uint8_t *             mcast_addr)
 {
-    mld_group_t *               mld_group;
-    mld_group_t *               first_empty_slot = NULL;
+    mld_group_t *               first_empty_slot;
+    unsigned int                entry;
     unsigned int                group_index;
 
     // Ignore local scope multicast addresses (ff02::/16)
@@ -594,55 +1030,33 @@ static mld_group_t * mld_interface_find_group(
         return NULL;
     }
 
-    // Look for the group in the fixed group list for the interface
-    for (group_index = 0; group_index < mld_interface->group_list_fixed_limit; group_index += 1)
+    // Look for the group in the hash
+    // NB: The hash holds all configured groups and the active non configured groups
+    entry = mld_group_hash_entry(mld_interface, mcast_addr);
+    if (mld_interface->group_hash[entry])
     {
-        mld_group = &mld_interface->group_list[group_index];
-
-        // If the group matches, return it
-        if (MCB_IP6_ADDR_CMP(mld_group->mcast_addr, mcast_addr) == 0)
-        {
-            return mld_group;
-        }
+        return &mld_interface->group_list[mld_interface->group_hash[entry] - 1];
     }
 
-    // Look for the group in the dynamic group list for the interface
-    for (group_index = mld_interface->group_list_fixed_limit; group_index < mld_interface->group_list_count; group_index += 1)
+    // If the group was not found, use the slot at the top of the free list
+    // NB: The slot remains on the free list until the group is activated
+    if (mld_interface->group_free_list_count == 0)
     {
-        mld_group = &mld_interface->group_list[group_index];
-
-        // Is this slot active?
-        if (mld_group->active)
-        {
-            // If the group exists, return it
-            if (MCB_IP6_ADDR_CMP(mld_group->mcast_addr, mcast_addr) == 0)
-            {
-                return mld_group;
-            }
-        }
-        else if (first_empty_slot == NULL)
-        {
-            // Make note the first empty slot we see
-            first_empty_slot = mld_group;
-        }
+        mld_log(mld_interface, mcast_addr, "Group list full -- group ignored");
+        return NULL;
     }
-
-    // If the group was not found, and no existing empty slot was seen, see if we can add one
-    if (first_empty_slot == NULL)
+    group_index = mld_interface->group_free_list[mld_interface->group_free_list_count - 1];
+    first_empty_slot = &mld_interface->group_list[group_index];
+    if (group_index >= mld_interface->group_list_count)
     {
-        // Is the group list full?
-        if (mld_interface->group_list_count >= mld_interface->group_list_allocated)
-        {
-            mld_log(mld_interface, mcast_addr, "Group list full -- group ignored");
-            return NULL;
-        }
-
-        // Increase the list count
-        first_empty_slot = &mld_interface->group_list[mld_interface->group_list_count];
-        mld_interface->group_list_count += 1;
+        mld_interface->group_list_count = group_index + 1;
     }
 
-    // Clear the empty slot and set the address
+    // Cancel any timers remaining from the slot's previous use, then clear the
+    // empty slot and set the address
+    evm_del_timer(mld_evm, &first_empty_slot->group_timer);
+    evm_del_timer(mld_evm, &first_empty_slot->query_timer);
+    evm_del_timer(mld_evm, &first_empty_slot->source_timer);
     memset(first_empty_slot, 0, sizeof(*first_empty_slot));
     first_empty_slot->mld_interface = mld_interface;
     MCB_IP6_ADDR_CPY(first_empty_slot->mcast_addr, mcast_addr);
@@ -668,7 +1082,7 @@ static void handle_mld_mrd_solicitation(
         logger("MLD(%s) [%s]: received Multicast Router Solicitation\n", mld_interface->name, src_addr_str);
     }
 
-    evm_del_timer(mld_evm, mld_send_mrd_advertisement, mld_interface);
+    evm_del_timer(mld_evm, &mld_interface->mrd_timer);
     mld_send_mrd_advertisement(mld_interface);
 }
 
@@ -724,7 +1138,7 @@ static void handle_mld_query(
                 mld_querier_mode == QUERIER_MODE_DEFER)
             {
                 new_querier = 1;
-                evm_del_timer(mld_evm, mld_send_general_query, mld_interface);
+                evm_del_timer(mld_evm, &mld_interface->general_query_timer);
             }
             else
             {
@@ -764,13 +1178,10 @@ static void handle_mld_query(
         mld_interface->querier_response_interval_millis = timecode_16bit_decode(ntohs(query->response));
     }
 
-    // Remove the existing querier timeout timer
-    evm_del_timer(mld_evm, mld_querier_timeout, mld_interface);
-
-    // Set a timer to re-enable querying if the active querier times out
+    // Set (or reset) a timer to re-enable querying if the active querier times out
     millis = (mld_interface->querier_robustness * mld_interface->querier_interval_sec * 1000 +
               mld_interface->querier_response_interval_millis / 2);
-    evm_add_timer(mld_evm, millis, mld_querier_timeout, mld_interface);
+    evm_add_timer(mld_evm, &mld_interface->querier_timer, millis, mld_querier_timeout, mld_interface);
 
     // If the S flag is set, we're done
     if (v2_flag && query->s_flag)
@@ -794,12 +1205,9 @@ static void handle_mld_query(
             return;
         }
 
-        // Remove the existing group membership timer
-        evm_del_timer(mld_evm, mld_group_timeout, mld_group);
-
-        // Set the group membership timer
+        // Reset the group membership timer
         millis = mld_interface->querier_robustness * mld_interface->querier_response_interval_millis + GRACE_MILLIS;
-        evm_add_timer(mld_evm, millis, mld_group_timeout, mld_group);
+        mld_group_set_deadline(mld_group, millis);
     }
 }
 
@@ -812,18 +1220,22 @@ static void mld_join_common(
     mld_group_t *               mld_group)
 {
     unsigned int                interface_index;
-    unsigned int                millis;
 
-    // Was the group already active?
-    if (mld_group->active)
-    {
-        // Cancel the existing group timeout
-        evm_del_timer(mld_evm, mld_group_timeout, mld_group);
-    }
-    else
+    // Is the group becoming active?
+    if (mld_group->active == 0)
     {
         mld_group->active = 1;
 
+        // If this is a non configured group, take the slot off the free list and add the group to the hash
+        // NB: The slot is at the top of the free list (see mld_interface_find_group). Groups registered
+        //     after startup are already in the hash.
+        if ((unsigned int) (mld_group - mld_interface->group_list) >= mld_interface->group_list_fixed_limit &&
+            mld_group->bridge_interface_list_count == 0)
+        {
+            mld_interface->group_free_list_count -= 1;
+            mld_group_hash_add(mld_interface, mld_group);
+        }
+
         // Activate the outbound interfaces
         for (interface_index = 0; interface_index < mld_group->bridge_interface_list_count; interface_index += 1)
         {
@@ -831,10 +1243,8 @@ static void mld_join_common(
         }
     }
 
-    // Set a timer for the group
-    millis = mld_interface->querier_robustness * mld_interface->querier_interval_sec * 1000 +
-             mld_interface->querier_response_interval_millis + GRACE_MILLIS;
-    evm_add_timer(mld_evm, millis, mld_group_timeout, mld_group);
+    // Set (or reset) the timer for the group
+    mld_group_set_deadline(mld_group, mld_membership_interval_millis(mld_interface));
 }
 
 
@@ -865,12 +1275,10 @@ static void mld_leave_common(
         return;
     }
 
-    // Remove the existing group membership timer
-    evm_del_timer(mld_evm, mld_group_timeout, mld_group);
-
-    // Set the group membership timer
+    // Reset the group membership timer and the source deadlines
     millis = mld_interface->querier_robustness * mld_interface->querier_lastmbr_interval_millis + GRACE_MILLIS;
-    evm_add_timer(mld_evm, millis, mld_group_timeout, mld_group);
+    mld_group_set_deadline(mld_group, millis);
+    mld_group_lower_sources(mld_group, millis);
 
     // Send the first query
     mld_group->group_queries_remaining = mld_interface->querier_robustness;
@@ -915,6 +1323,7 @@ static void handle_mld_v1_report(
     }
 
     // Update the group
+    mld_group_add_sources(mld_interface, mld_group, NULL, 0);
     mld_join_common(mld_interface, mld_group);
 }
 
@@ -1019,7 +1428,9 @@ static void handle_mld_v2_report(
                 break;
 
             case MCB_REC_BLOCK_OLD_SOURCES:
-                if (group_record->num_srcs)
+                // Blocking sources that are not being forwarded changes nothing
+                if (group_record->num_srcs &&
+                    mld_group_has_sources(mld_group, (const uint8_t *) group_record->srcs, num_srcs) == 0)
                 {
                     continue;
                 }
@@ -1034,9 +1445,26 @@ static void handle_mld_v2_report(
         // Update the group
         if (is_join)
         {
+            // NB: The sources are updated before the group is activated so that
+            //     the filter is in place before packets are forwarded
+            if (group_record->type == MCB_REC_MODE_IS_EXCLUDE || group_record->type == MCB_REC_CHANGE_TO_EXCLUDE)
+            {
+                mld_group_add_sources(mld_interface, mld_group, NULL, 0);
+            }
+            else
+            {
+                mld_group_add_sources(mld_interface, mld_group, (const uint8_t *) group_record->srcs, num_srcs);
+            }
             mld_join_common(mld_interface, mld_group);
-        }
-        else
+
+            // A change to include mode may end the listener's interest in other
+            // sources, so query for the sources that remain wanted
+            if (group_record->type == MCB_REC_CHANGE_TO_INCLUDE && mld_group->bridge_interface_list_count)
+            {
+                mld_leave_common(mld_interface, mld_group);
+            }
+        }
+        else
         {
             mld_leave_common(mld_interface, mld_group);
         }
@@ -1087,13 +1515,11 @@ static void handle_mld_v1_done(
 //
 // Process an incoming packet
 //
-static void mld_receive(
-    void *                      arg)
+static void mld_process_packet(
+    mld_interface_t *           mld_interface,
+    const unsigned char *       packet,
+    unsigned int                packet_len)
 {
-    mld_interface_t *           mld_interface = arg;
-    struct pcap_pkthdr          pkthdr;
-    const unsigned char *       packet;
-    unsigned int                packet_len;
     const mcb_ethernet_t *      eth;
     const mcb_ip6_t *           ip;
     const mcb_ip6_hbh_t *       hop_by_hop;
@@ -1101,14 +1527,6 @@ static void mld_receive(
     unsigned int                ip_payload_len;
     uint16_t                    calculated_csum;
 
-    // Read the packet
-    packet = pcap_next(mld_interface->pcap, &pkthdr);
-    if (packet == NULL)
-    {
-        return;
-    }
-    packet_len = pkthdr.caplen;
-
     // Confirm the header is large enough to contain ethernet and IPv6 headers
     if (packet_len < sizeof(mcb_ethernet_t) + sizeof(mcb_ip6_t))
     {
@@ -1233,12 +1651,58 @@ static void mld_receive(
 }
 
 
+//
+// Process a packet delivered by pcap_dispatch
+//
+static void mld_dispatch_packet(
+    unsigned char *             arg,
+    const struct pcap_pkthdr *  pkthdr,
+    const unsigned char *       packet)
+{
+    mld_interface_t *           mld_interface = (mld_interface_t *) arg;
+
+    // Ignore packets that were truncated by the capture length
+    if (pkthdr->caplen < pkthdr->len)
+    {
+        mld_log(mld_interface, NULL, "Packet exceeds the capture length -- packet ignored");
+        return;
+    }
+
+    mld_process_packet(mld_interface, packet, pkthdr->caplen);
+}
+
+
+//
+// Receive all queued incoming packets (up to the dispatch count)
+//
+// Returns non-zero if more packets may be queued
+//
+static unsigned int mld_receive(
+    void *                      arg)
+{
+    mld_interface_t *           mld_interface = arg;
+    int                         r;
+
+    r = pcap_dispatch(mld_interface->pcap, MLD_DISPATCH_COUNT, mld_dispatch_packet, (unsigned char *) mld_interface);
+    if (r < 0)
+    {
+        logger("MLD(%s): pcap_dispatch failed: %s\n", mld_interface->name, pcap_geterr(mld_interface->pcap));
+        return 0;
+    }
+
+    return r >= MLD_DISPATCH_COUNT;
+}
+
+
 // Pcap
 void mld_pcap_create(
     mld_interface_t *           mld_interface)
 {
     pcap_t *                    pcap;
     struct bpf_program          program;
+#if defined(USE_PACKET_ALLMULTI)
+    struct packet_mreq          mreq;
+#endif
 
     int                         r;
     int                         fd;
@@ -1252,12 +1716,17 @@ void mld_pcap_create(
     }
 
     // Set pcap options
-    r = pcap_set_snaplen(pcap, MCAST_MAX_PACKET_SIZE);
+    r = pcap_set_snaplen(pcap, MLD_SNAPLEN);
     if (r != 0)
     {
         fatal("pcap_set_snaplen failed: %d\n", r);
     }
+#if defined(USE_PACKET_ALLMULTI)
+    // NB: All multicast membership is added after activation
+    r = pcap_set_promisc(pcap, 0);
+#else
     r = pcap_set_promisc(pcap, 1);
+#endif
     if (r != 0)
     {
         fatal("pcap_set_promisc failed: %d\n", r);
@@ -1290,13 +1759,36 @@ void mld_pcap_create(
     }
     pcap_freecode(&program);
 
-    // Add the fd to the event manager
+    // Set non-blocking
+    r = pcap_setnonblock(pcap, 1, errbuf);
+    if (r != 0)
+    {
+        fatal("pcap_setnonblock failed: %s\n", errbuf);
+    }
+
+    // Get the fd
     fd = pcap_get_selectable_fd(pcap);
     if (fd < 0)
     {
         fatal("pcap_get_selectable_fd for MLD interface %s failed: %s\n", mld_interface->name, pcap_geterr(pcap));
     }
-    evm_add_socket(mld_evm, fd, mld_receive, mld_interface);
+
+#if defined(USE_PACKET_ALLMULTI)
+    // Receive all multicast packets on the interface
+    // NB: The pcap fd is the AF_PACKET socket. Reports are sent to the group address, so
+    //     all multicast is required, but unicast traffic does not need to be received.
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.mr_ifindex = mld_interface->if_index;
+    mreq.mr_type = PACKET_MR_ALLMULTI;
+    r = setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+    if (r == -1)
+    {
+        fatal("setsockopt (PACKET_ADD_MEMBERSHIP) for MLD interface %s failed: %s\n", mld_interface->name, strerror(errno));
+    }
+#endif
+
+    // Add the fd to the event manager
+    evm_add_drain_socket(mld_evm, fd, mld_receive, mld_interface, MLD_DRAIN_BUDGET);
 
     // Store the pcap session
     mld_interface->pcap = pcap;
@@ -1304,114 +1796,146 @@ void mld_pcap_create(
 
 
 //
-// Register a bridge interface for MLD monitoring
+// Find the mld interface for an interface index
 //
-void mld_register_interface(
-    bridge_interface_t *        bridge_interface)
+static mld_interface_t * mld_find_interface(
+    unsigned int                if_index)
 {
-    bridge_instance_t *         bridge = &bridge_list[bridge_interface->bridge_index];
-    mld_interface_t *           mld_interface;
-    mld_group_t *               mld_group;
     unsigned int                interface_index;
-    unsigned int                group_index;
 
-    // Is the interface already in the mld interface list?
     for (interface_index = 0; interface_index < mld_interface_list_count; interface_index += 1)
     {
-        mld_interface = &mld_interface_list[interface_index];
-
-        if (bridge_interface->if_index == mld_interface->if_index)
+        if (mld_interface_list[interface_index]->if_index == if_index)
         {
-            break;
+            return mld_interface_list[interface_index];
         }
     }
 
-    // If the interface wasn't found, add it
-    if (interface_index >= mld_interface_list_count)
+    return NULL;
+}
+
+
+//
+// Create an mld interface for a bridge interface and add it to the list
+//
+static mld_interface_t * mld_create_interface(
+    const bridge_interface_t *  bridge_interface)
+{
+    mld_interface_t *           mld_interface;
+
+    // Do we need to (re)allocate the mld interface list?
+    if (mld_interface_list_count >= mld_interface_list_allocated)
     {
-        // Do we need to (re)allocate the mld interface list?
-        if (interface_index >= mld_interface_list_allocated)
+        // Determine the new allocation size
+        if (mld_interface_list_allocated == 0)
         {
-            // Determine the new allocation size
-            if (mld_interface_list_allocated == 0)
-            {
-                mld_interface_list_allocated = 2;
-            }
-            else
-            {
-                mld_interface_list_allocated *= 2;
-            }
+            mld_interface_list_allocated = 2;
+        }
+        else
+        {
+            mld_interface_list_allocated *= 2;
+        }
 
-            mld_interface_list = realloc(mld_interface_list, mld_interface_list_allocated * sizeof(mld_interface_t));
-            if (mld_interface_list == NULL)
-            {
-                fatal("Cannot allocate memory for mld interface list: %s\n", strerror(errno));
-            }
+        mld_interface_list = realloc(mld_interface_list, mld_interface_list_allocated * sizeof(mld_interface_t *));
+        if (mld_interface_list == NULL)
+        {
+            fatal("Cannot allocate memory for mld interface list: %s\n", strerror(errno));
         }
+    }
 
-        // Add the new mld interface to the list
-        mld_interface = &mld_interface_list[interface_index];
-        mld_interface_list_count += 1;
+    // Allocate the new mld interface and add it to the list
+    mld_interface = calloc(1, sizeof(mld_interface_t));
+    if (mld_interface == NULL)
+    {
+        fatal("Cannot allocate memory for mld interface: %s\n", strerror(errno));
+    }
+    mld_interface_list[mld_interface_list_count] = mld_interface;
+    mld_interface_list_count += 1;
 
-        // Initialize the new mld interface
-        memset(mld_interface, 0, sizeof(*mld_interface));
-        mld_interface->name = bridge_interface->name;
-        mld_interface->if_index = bridge_interface->if_index;
-        MCB_ETH_ADDR_CPY(mld_interface->if_mac_addr, bridge_interface->mac_addr);
-        MCB_IP6_ADDR_CPY(mld_interface->if_addr, &bridge_interface->ipv6_addr_ll);
+    // Initialize the new mld interface
+    mld_interface->name = strdup(bridge_interface->name);
+    if (mld_interface->name == NULL)
+    {
+        fatal("Cannot allocate memory for interface name: %s\n", strerror(errno));
+    }
+    mld_interface->if_index = bridge_interface->if_index;
+    MCB_ETH_ADDR_CPY(mld_interface->if_mac_addr, bridge_interface->mac_addr);
+    MCB_IP6_ADDR_CPY(mld_interface->if_addr, &bridge_interface->ipv6_addr_ll);
 
-        // Safety check: Ensure the link-local address is valid
-        if (mld_interface->if_addr[0] != 0xfe || (mld_interface->if_addr[1] & 0xc0) != 0x80)
-        {
-            char ll_addr_str[INET6_ADDRSTRLEN] = "unknown";
-            inet_ntop(AF_INET6, mld_interface->if_addr, ll_addr_str, sizeof(ll_addr_str));
-            fatal("Interface %s has an invalid IPv6 link-local address: %s\n", mld_interface->name, ll_addr_str);
-        }
+    // Safety check: Ensure the link-local address is valid
+    if (mld_interface->if_addr[0] != 0xfe || (mld_interface->if_addr[1] & 0xc0) != 0x80)
+    {
+        char ll_addr_str[INET6_ADDRSTRLEN] = "unknown";
+        inet_ntop(AF_INET6, mld_interface->if_addr, ll_addr_str, sizeof(ll_addr_str));
+        fatal("Interface %s has an invalid IPv6 link-local address: %s\n", mld_interface->name, ll_addr_str);
     }
 
+    return mld_interface;
+}
+
+
+//
+// Find or add a configured group of an mld interface
+//
+// NB: Only used before the group list is finalized
+//
+static mld_group_t * mld_add_group(
+    mld_interface_t *           mld_interface,
+    const struct in6_addr *     mcast_addr)
+{
+    mld_group_t *               mld_group;
+    unsigned int                group_index;
+
     // Is the group already in the list for this mld interface?
     for (group_index = 0; group_index < mld_interface->group_list_count; group_index += 1)
     {
         mld_group = &mld_interface->group_list[group_index];
-        if (MCB_IP6_ADDR_CMP(mld_group->mcast_addr, &bridge->dst_addr.sin6.sin6_addr) == 0)
+        if (MCB_IP6_ADDR_CMP(mld_group->mcast_addr, mcast_addr) == 0)
         {
-            break;
+            return mld_group;
         }
     }
 
-    // If the group wasn't found, add it
-    if (group_index >= mld_interface->group_list_count)
+    // Do we need to (re)allocate the group list?
+    if (group_index >= mld_interface->group_list_allocated)
     {
-        // Do we need to (re)allocate the group list?
-        if (group_index >= mld_interface->group_list_allocated)
+        // Determine the new allocation size
+        if (mld_interface->group_list_allocated == 0)
         {
-            // Determine the new allocation size
-            if (mld_interface->group_list_allocated == 0)
-            {
-                mld_interface->group_list_allocated = 1;
-            }
-            else
-            {
-                mld_interface->group_list_allocated *= 2;
-            }
+            mld_interface->group_list_allocated = 1;
+        }
+        else
+        {
+            mld_interface->group_list_allocated *= 2;
+        }
 
-            mld_interface->group_list = realloc(mld_interface->group_list, mld_interface->group_list_allocated * sizeof(mld_group_t));
-            if (mld_interface->group_list == NULL)
-            {
-                fatal("Cannot allocate memory for mld group list: %s\n", strerror(errno));
-            }
+        mld_interface->group_list = realloc(mld_interface->group_list, mld_interface->group_list_allocated * sizeof(mld_group_t));
+        if (mld_interface->group_list == NULL)
+        {
+            fatal("Cannot allocate memory for mld group list: %s\n", strerror(errno));
         }
+    }
 
-        // Add a new mld group to the mld interface's list
-        mld_group = &mld_interface->group_list[group_index];
-        mld_interface->group_list_count += 1;
+    // Add a new mld group to the mld interface's list
+    mld_group = &mld_interface->group_list[group_index];
+    mld_interface->group_list_count += 1;
 
-        // Initialize the new group
-        memset(mld_group, 0, sizeof(*mld_group));
-        // NB: mld->mld_interface will be set after the group list is finalized
-        MCB_IP6_ADDR_CPY(mld_group->mcast_addr, &bridge->dst_addr.sin6.sin6_addr);
-    }
+    // Initialize the new group
+    memset(mld_group, 0, sizeof(*mld_group));
+    // NB: mld->mld_interface will be set after the group list is finalized
+    MCB_IP6_ADDR_CPY(mld_group->mcast_addr, mcast_addr);
 
+    return mld_group;
+}
+
+
+//
+// Add a bridge interface to the list of bridge interfaces of a group
+//
+static void mld_group_add_bridge_interface(
+    mld_group_t *               mld_group,
+    bridge_interface_t *        bridge_interface)
+{
     // Do we need to (re)allocate the list of bridge interfaces for this group?
     if (mld_group->bridge_interface_list_count >= mld_group->bridge_interface_list_allocated)
     {
@@ -1438,6 +1962,26 @@ void mld_register_interface(
 }
 
 
+//
+// Register a bridge interface for MLD monitoring of a group
+//
+void mld_register_interface(
+    bridge_interface_t *        bridge_interface,
+    const struct in6_addr *     mcast_addr)
+{
+    mld_interface_t *           mld_interface;
+
+    // If the interface isn't already in the mld interface list, add it
+    mld_interface = mld_find_interface(bridge_interface->if_index);
+    if (mld_interface == NULL)
+    {
+        mld_interface = mld_create_interface(bridge_interface);
+    }
+
+    mld_group_add_bridge_interface(mld_add_group(mld_interface, mcast_addr), bridge_interface);
+}
+
+
 //
 // MLD thread
 //
@@ -1482,7 +2026,7 @@ static void mld_dump_config(void)
 
     for (interface_index = 0; interface_index < mld_interface_list_count; interface_index += 1)
     {
-        mld_interface = &mld_interface_list[interface_index];
+        mld_interface = mld_interface_list[interface_index];
         if (inet_ntop(AF_INET6, mld_interface->if_addr, addr_str, sizeof(addr_str)) == NULL)
         {
             snprintf(addr_str, sizeof(addr_str), "[unknown]");
@@ -1508,6 +2052,93 @@ static void mld_dump_config(void)
 }
 
 
+//
+// Finalize the group table of an interface
+//
+static void mld_finalize_interface(
+    mld_interface_t *           mld_interface)
+{
+    mld_group_t *               mld_group;
+    unsigned int                group_index;
+    unsigned int                hash_size;
+
+    // Set the fixed group limit
+    mld_interface->group_list_fixed_limit = mld_interface->group_list_count;
+
+    // Adjust the group list size to allow for non configured groups
+    mld_interface->group_list_allocated = mld_interface->group_list_count + non_configured_groups;
+    mld_interface->group_list = realloc(mld_interface->group_list, mld_interface->group_list_allocated * sizeof(mld_group_t));
+    if (mld_interface->group_list == NULL)
+    {
+        fatal("Cannot allocate memory for mld group list: %s\n", strerror(errno));
+    }
+
+    // Initialize the new groups
+    memset(&mld_interface->group_list[mld_interface->group_list_count], 0,
+        (mld_interface->group_list_allocated - mld_interface->group_list_count) * sizeof(mld_group_t));
+
+    // Now that all the (re)allocation is done, set the interface pointers in the groups
+    for (group_index = 0; group_index < mld_interface->group_list_count; group_index += 1)
+    {
+        mld_group = &mld_interface->group_list[group_index];
+        mld_group->mld_interface = mld_interface;
+    }
+
+    // Allocate the group hash with a load factor of at most one half
+    hash_size = 8;
+    while (hash_size < mld_interface->group_list_allocated * 2)
+    {
+        hash_size *= 2;
+    }
+    mld_interface->group_hash = calloc(hash_size, sizeof(unsigned int));
+    if (mld_interface->group_hash == NULL)
+    {
+        fatal("Cannot allocate memory for mld group hash: %s\n", strerror(errno));
+    }
+    mld_interface->group_hash_mask = hash_size - 1;
+
+    // Add the configured groups to the hash
+    for (group_index = 0; group_index < mld_interface->group_list_count; group_index += 1)
+    {
+        mld_group_hash_add(mld_interface, &mld_interface->group_list[group_index]);
+    }
+
+    // Allocate the free list, with the lowest index at the top
+    mld_interface->group_free_list = calloc(non_configured_groups + 1, sizeof(unsigned int));
+    if (mld_interface->group_free_list == NULL)
+    {
+        fatal("Cannot allocate memory for mld group free list: %s\n", strerror(errno));
+    }
+    for (group_index = mld_interface->group_list_allocated; group_index > mld_interface->group_list_fixed_limit; group_index -= 1)
+    {
+        mld_interface->group_free_list[mld_interface->group_free_list_count] = group_index - 1;
+        mld_interface->group_free_list_count += 1;
+    }
+}
+
+
+//
+// Get the number of timers required by the interfaces
+//
+// NB: Timers are embedded in the interface and group structures, and the heap holds
+//     at most one entry for each. Each interface has three timers (MRD, general query
+//     and querier) and each group slot has three (group, query and source), so the
+//     count is exact.
+//
+static unsigned int mld_timer_count(void)
+{
+    unsigned int                interface_index;
+    unsigned int                total_groups = 0;
+
+    for (interface_index = 0; interface_index < mld_interface_list_count; interface_index += 1)
+    {
+        total_groups += mld_interface_list[interface_index]->group_list_allocated;
+    }
+
+    return mld_interface_list_count * 3 + total_groups * 3;
+}
+
+
 //
 // Initialize the MLD infrastructure
 //
@@ -1515,10 +2146,7 @@ void initialize_mld(
     unsigned int                dump_config)
 {
     mld_interface_t *           mld_interface;
-    mld_group_t *               mld_group;
     unsigned int                interface_index;
-    unsigned int                group_index;
-    unsigned int                total_groups = 0;
 
     // Nothing to do if there are no interfaces
     if (mld_interface_list_count < 1)
@@ -1532,40 +2160,14 @@ void initialize_mld(
         mld_dump_config();
     }
 
-     // Finalize the interfaces and groups
+    // Finalize the interfaces and groups
     for (interface_index = 0; interface_index < mld_interface_list_count; interface_index += 1)
     {
-        mld_interface = &mld_interface_list[interface_index];
-
-        // Set the fixed group limit
-        mld_interface->group_list_fixed_limit = mld_interface->group_list_count;
-
-        // Adjust the group list size to allow for non configured groups
-        mld_interface->group_list_allocated = mld_interface->group_list_count + non_configured_groups;
-        mld_interface->group_list = realloc(mld_interface->group_list, mld_interface->group_list_allocated * sizeof(mld_group_t));
-        if (mld_interface->group_list == NULL)
-        {
-            fatal("Cannot allocate memory for mld group list: %s\n", strerror(errno));
-        }
-
-        // Initialize the new groups
-        memset(&mld_interface->group_list[mld_interface->group_list_count], 0,
-            (mld_interface->group_list_allocated - mld_interface->group_list_count) * sizeof(mld_group_t));
-
-        // Now that all the (re)allocation is done, set the interface pointers in the groups
-        for (group_index = 0; group_index < mld_interface->group_list_count; group_index += 1)
-        {
-            mld_group = &mld_interface->group_list[group_index];
-            mld_group->mld_interface = mld_interface;
-        }
-
-        total_groups += mld_interface->group_list_allocated;
+        mld_finalize_interface(mld_interface_list[interface_index]);
     }
 
     // Create the event manager
-    // NB: The number of timers is a theoretical maximum. In actual use, the number of timers
-    //     is expected to be significantly less than half of this number.
-    mld_evm = evm_create(mld_interface_list_count, mld_interface_list_count * 2 + total_groups * 2);
+    mld_evm = evm_create(mld_interface_list_count, mld_timer_count());
     if (mld_evm == NULL)
     {
         fatal("Cannot create event manager\n");
@@ -1574,18 +2176,59 @@ void initialize_mld(
     // Create the pcap instances and register them with the event manager
     for (interface_index = 0; interface_index < mld_interface_list_count; interface_index += 1)
     {
-        mld_interface = &mld_interface_list[interface_index];
+        mld_interface = mld_interface_list[interface_index];
         mld_pcap_create(mld_interface);
     }
 }
 
 
+//
+// Start the querier and router advertisements of an interface
+//
+static void mld_start_interface(
+    mld_interface_t *           mld_interface)
+{
+    // Build the multicast router advertisement packet
+    mld_build_mrd_advertisement_packet(mld_interface);
+
+    // Send the first multicast router advertisement (no jitter)
+    mld_interface->mrd_initial_advertisements_remaining = MCB_MRD_INITIAL_COUNT - 1;
+    mld_send_mrd_advertisement(mld_interface);
+
+    // Build the query packets
+    mld_build_query_packets(mld_interface);
+
+    // Is quick querier mode enabled?
+    if (mld_querier_mode == QUERIER_MODE_QUICK)
+    {
+        mld_activate_querier_mode(mld_interface);
+    }
+    else
+    {
+        // Set default querier values
+        mld_interface->querier_robustness = MCB_MLD_ROBUSTNESS;
+        mld_interface->querier_interval_sec = MCB_MLD_QUERY_INTERVAL;
+        mld_interface->querier_response_interval_millis = MCB_MLD_RESPONSE_INTERVAL;
+        mld_interface->querier_lastmbr_interval_millis = MCB_MLD_LASTMBR_INTERVAL;
+
+        // Set the querier address to all ones allowing anyone to win an election
+        MCB_IP6_ADDR_SET(mld_interface->querier_addr, 0xff);
+
+        // Is querier mode enabled?
+        if (mld_querier_mode)
+        {
+            // Set a timer to activate as a querier (125.5 seconds)
+            evm_add_timer(mld_evm, &mld_interface->querier_timer, 125500, mld_querier_timeout, mld_interface);
+        }
+    }
+}
+
+
 //
 // Start the MLD thread
 //
 void start_mld(void)
 {
-    mld_interface_t *           mld_interface;
     unsigned int                interface_index;
     pthread_t                   thread_id;
     long                        seed;
@@ -1606,47 +2249,262 @@ void start_mld(void)
     // Set up the querier for each interface
     for (interface_index = 0; interface_index < mld_interface_list_count; interface_index += 1)
     {
-        mld_interface = &mld_interface_list[interface_index];
+        mld_start_interface(mld_interface_list[interface_index]);
+    }
+
+    // Start the thread
+    r = pthread_create(&thread_id, NULL, &mld_thread, NULL);
+    if (r != 0)
+    {
+        fatal("cannot create MLD thread: %s\n", strerror(r));
+    }
+}
 
-        // Build the multicast router advertisement packet
-        mld_build_mrd_advertisement_packet(mld_interface);
 
-        // Send the first multicast router advertisement (no jitter)
-        mld_interface->mrd_initial_advertisements_remaining = MCB_MRD_INITIAL_COUNT - 1;
-        mld_send_mrd_advertisement(mld_interface);
+// Request to add or remove a bridge interface, run on the MLD thread
+typedef struct mld_call
+{
+    bridge_interface_t *        bridge_interface;
+    const struct in6_addr *     mcast_addr;
+} mld_call_t;
 
-        // Build the query packets
-        mld_build_query_packets(mld_interface);
 
-        // Is quick querier mode enabled?
-        if (mld_querier_mode == QUERIER_MODE_QUICK)
+//
+// Add a bridge interface to a group (MLD thread)
+//
+static void mld_add_interface_call(
+    void *                      arg)
+{
+    mld_call_t *                call = arg;
+    bridge_interface_t *        bridge_interface = call->bridge_interface;
+    mld_interface_t *           mld_interface;
+    mld_group_t *               mld_group;
+    unsigned int                entry;
+    unsigned int                group_index;
+    char                        addr_str[INET6_ADDRSTRLEN] = "unknown";
+
+    // If the interface is new, create, finalize and start it
+    mld_interface = mld_find_interface(bridge_interface->if_index);
+    if (mld_interface == NULL)
+    {
+        mld_interface = mld_create_interface(bridge_interface);
+        mld_group_add_bridge_interface(mld_add_group(mld_interface, call->mcast_addr), bridge_interface);
+        mld_finalize_interface(mld_interface);
+        evm_grow(mld_evm, mld_interface_list_count, mld_timer_count());
+        mld_pcap_create(mld_interface);
+        mld_start_interface(mld_interface);
+        return;
+    }
+
+    // Look for the group in the hash
+    entry = mld_group_hash_entry(mld_interface, (const uint8_t *) call->mcast_addr);
+    if (mld_interface->group_hash[entry])
+    {
+        mld_group = &mld_interface->group_list[mld_interface->group_hash[entry] - 1];
+    }
+    else
+    {
+        // Take a non configured slot for the group
+        // NB: The group list cannot be reallocated while its timers are scheduled
+        if (mld_interface->group_free_list_count == 0)
         {
-            mld_activate_querier_mode(mld_interface);
+            inet_ntop(AF_INET6, call->mcast_addr, addr_str, sizeof(addr_str));
+            logger("MLD(%s) [%s]: Group list full -- registration of %s requires a restart\n",
+                mld_interface->name, addr_str, bridge_interface->name);
+            return;
         }
-        else
+        mld_interface->group_free_list_count -= 1;
+        group_index = mld_interface->group_free_list[mld_interface->group_free_list_count];
+        mld_group = &mld_interface->group_list[group_index];
+        if (group_index >= mld_interface->group_list_count)
+        {
+            mld_interface->group_list_count = group_index + 1;
+        }
+
+        // Cancel any timers remaining from the slot's previous use, then clear the
+        // slot and add the group to the hash
+        evm_del_timer(mld_evm, &mld_group->group_timer);
+        evm_del_timer(mld_evm, &mld_group->query_timer);
+        evm_del_timer(mld_evm, &mld_group->source_timer);
+        memset(mld_group, 0, sizeof(*mld_group));
+        mld_group->mld_interface = mld_interface;
+        MCB_IP6_ADDR_CPY(mld_group->mcast_addr, call->mcast_addr);
+        mld_group_hash_add(mld_interface, mld_group);
+    }
+
+    mld_group_add_bridge_interface(mld_group, bridge_interface);
+
+    // If the group is active, start forwarding to the new interface
+    // NB: Sources are not tracked for a group that had no bridge interfaces, and without
+    //     a published filter the interface forwards any source
+    if (mld_group->active)
+    {
+        interface_activate_outbound(bridge_interface);
+        if (mld_group->source_filter_published)
         {
-            // Set default querier values
-            mld_interface->querier_robustness = MCB_MLD_ROBUSTNESS;
-            mld_interface->querier_interval_sec = MCB_MLD_QUERY_INTERVAL;
-            mld_interface->querier_response_interval_millis = MCB_MLD_RESPONSE_INTERVAL;
-            mld_interface->querier_lastmbr_interval_millis = MCB_MLD_LASTMBR_INTERVAL;
+            mld_group_update_sources(mld_group, 1);
+        }
+    }
+}
+
+
+//
+// Delete an mld interface (MLD thread)
+//
+static void mld_delete_interface(
+    unsigned int                interface_index)
+{
+    mld_interface_t *           mld_interface = mld_interface_list[interface_index];
+    mld_group_t *               mld_group;
+    unsigned int                group_index;
+
+    mld_log(mld_interface, NULL, "Interface removed");
+
+    // Cancel the timers of the interface and its groups
+    evm_del_timer(mld_evm, &mld_interface->mrd_timer);
+    evm_del_timer(mld_evm, &mld_interface->general_query_timer);
+    evm_del_timer(mld_evm, &mld_interface->querier_timer);
+    for (group_index = 0; group_index < mld_interface->group_list_allocated; group_index += 1)
+    {
+        mld_group = &mld_interface->group_list[group_index];
+        evm_del_timer(mld_evm, &mld_group->group_timer);
+        evm_del_timer(mld_evm, &mld_group->query_timer);
+        evm_del_timer(mld_evm, &mld_group->source_timer);
+        free(mld_group->bridge_interface_list);
+    }
+
+    // Close the pcap session
+    evm_del_socket(mld_evm, pcap_get_selectable_fd(mld_interface->pcap));
+    pcap_close(mld_interface->pcap);
+
+    free(mld_interface->group_list);
+    free(mld_interface->group_hash);
+    free(mld_interface->group_free_list);
+    free(mld_interface->name);
+    free(mld_interface);
+
+    // Remove the interface from the list
+    mld_interface_list_count -= 1;
+    memmove(&mld_interface_list[interface_index], &mld_interface_list[interface_index + 1],
+        (mld_interface_list_count - interface_index) * sizeof(mld_interface_t *));
+}
+
+
+//
+// Remove a bridge interface from all groups (MLD thread)
+//
+static void mld_remove_interface_call(
+    void *                      arg)
+{
+    mld_call_t *                call = arg;
+    mld_interface_t *           mld_interface;
+    mld_group_t *               mld_group;
+    unsigned int                interface_index;
+    unsigned int                group_index;
+    unsigned int                bridge_interface_index;
+    unsigned int                in_use = 0;
 
-            // Set the querier address to all ones allowing anyone to win an election
-            MCB_IP6_ADDR_SET(mld_interface->querier_addr, 0xff);
+    for (interface_index = 0; interface_index < mld_interface_list_count; interface_index += 1)
+    {
+        if (mld_interface_list[interface_index]->if_index == call->bridge_interface->if_index)
+        {
+            break;
+        }
+    }
+    if (interface_index >= mld_interface_list_count)
+    {
+        return;
+    }
+    mld_interface = mld_interface_list[interface_index];
 
-            // Is querier mode enabled?
-            if (mld_querier_mode)
+    for (group_index = 0; group_index < mld_interface->group_list_count; group_index += 1)
+    {
+        mld_group = &mld_interface->group_list[group_index];
+
+        for (bridge_interface_index = 0; bridge_interface_index < mld_group->bridge_interface_list_count; bridge_interface_index += 1)
+        {
+            if (mld_group->bridge_interface_list[bridge_interface_index] == call->bridge_interface)
             {
-                // Set a timer to activate as a querier (125.5 seconds)
-                evm_add_timer(mld_evm, 125500, mld_querier_timeout, mld_interface);
+                break;
             }
         }
+        if (bridge_interface_index >= mld_group->bridge_interface_list_count)
+        {
+            in_use |= mld_group->bridge_interface_list_count;
+            continue;
+        }
+
+        // Remove the bridge interface from the group
+        mld_group->bridge_interface_list_count -= 1;
+        memmove(&mld_group->bridge_interface_list[bridge_interface_index], &mld_group->bridge_interface_list[bridge_interface_index + 1],
+            (mld_group->bridge_interface_list_count - bridge_interface_index) * sizeof(bridge_interface_t *));
+        in_use |= mld_group->bridge_interface_list_count;
+
+        // If an inactive non configured group is no longer registered, return the slot to the free list
+        // NB: An active group is returned to the free list when it times out
+        if (mld_group->bridge_interface_list_count == 0 && mld_group->active == 0 &&
+            group_index >= mld_interface->group_list_fixed_limit)
+        {
+            free(mld_group->bridge_interface_list);
+            mld_group->bridge_interface_list = NULL;
+            mld_group->bridge_interface_list_allocated = 0;
+
+            mld_group_hash_del(mld_interface, mld_group);
+            mld_interface->group_free_list[mld_interface->group_free_list_count] = group_index;
+            mld_interface->group_free_list_count += 1;
+        }
     }
 
-    // Start the thread
-    r = pthread_create(&thread_id, NULL, &mld_thread, NULL);
-    if (r != 0)
+    // If no bridge interfaces remain, the interface is no longer monitored
+    if (in_use == 0)
     {
-        fatal("cannot create MLD thread: %s\n", strerror(r));
+        mld_delete_interface(interface_index);
     }
 }
+
+
+//
+// Register a bridge interface for MLD monitoring of a group after startup
+//
+// NB: Called by the main thread on reload. MLD is started if it was not already.
+//
+void mld_add_interface(
+    bridge_interface_t *        bridge_interface,
+    const struct in6_addr *     mcast_addr)
+{
+    mld_call_t                  call;
+
+    if (mld_evm == NULL)
+    {
+        mld_register_interface(bridge_interface, mcast_addr);
+        initialize_mld(0);
+        start_mld();
+        return;
+    }
+
+    call.bridge_interface = bridge_interface;
+    call.mcast_addr = mcast_addr;
+    evm_call(mld_evm, mld_add_interface_call, &call);
+}
+
+
+//
+// Remove a bridge interface from MLD monitoring
+//
+// NB: Called by the main thread on reload. On return, the MLD thread no longer
+//     references the bridge interface.
+//
+void mld_remove_interface(
+    bridge_interface_t *        bridge_interface)
+{
+    mld_call_t                  call;
+
+    if (mld_evm == NULL)
+    {
+        return;
+    }
+
+    call.bridge_interface = bridge_interface;
+    call.mcast_addr = NULL;
+    evm_call(mld_evm, mld_remove_interface_call, &call);
+}
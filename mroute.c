@@ -0,0 +1,975 @@
+
+//
+// Copyright (c) 2024-2026, Denny Page
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+//
+// Kernel multicast forwarding dataplane (Linux and FreeBSD)
+//
+// Each interface of a kernel bridge is added to the kernel multicast routing
+// engine as a virtual interface (a VIF for IPv4, a MIF for IPv6). When the
+// kernel receives a packet for a source and group it has no forwarding entry
+// for, it queues the packet and sends an upcall with the source, group and
+// incoming virtual interface. The upcall is answered with an (S,G) entry that
+// forwards to the active outbound peers of the inbound interface. The entries
+// of a bridge are updated whenever its fanout lists change, and removed once
+// they have been idle for an expiry interval.
+//
+// The kernel forwards the whole group regardless of UDP port, does not
+// rewrite the source address, and decrements the TTL/hop limit. Packets that
+// arrive with a TTL/hop limit of 1 cannot be forwarded by the kernel, and are
+// forwarded by the bridge's socket dataplane as usual. Packets the kernel
+// forwards are dropped from the bridge's sockets, with a socket filter where
+// available.
+//
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "common.h"
+
+#if defined(USE_MROUTE)
+
+#include <sys/ioctl.h>
+#include <net/if.h>
+#if defined(__linux__)
+# include <linux/filter.h>
+# include <linux/if_packet.h>
+# include <linux/mroute.h>
+# include <linux/mroute6.h>
+#else
+# include <netinet/ip_mroute.h>
+# include <netinet6/ip6_mroute.h>
+#endif
+
+#include "protocols.h"
+
+
+// Maximum number of virtual interfaces per address family
+#if MAXVIFS > MAXMIFS
+# define MROUTE_MAX_VIFS        MAXVIFS
+#else
+# define MROUTE_MAX_VIFS        MAXMIFS
+#endif
+
+// Maximum number of forwarding entries per address family
+#define MROUTE_MAX_ENTRIES      1024
+
+// Interval between checks for idle forwarding entries
+#define MROUTE_EXPIRE_MILLIS    60000
+
+// Size of the upcall receive buffer
+#define MROUTE_UPCALL_SIZE      256
+
+
+// Source or group address of a forwarding entry
+typedef union
+{
+    struct in_addr              ipv4;
+    struct in6_addr             ipv6;
+} mroute_addr_t;
+
+// Forwarding entry
+typedef struct
+{
+    mroute_addr_t               source;
+    mroute_addr_t               group;
+    unsigned int                parent;
+
+    // Inbound interface the entry forwards for (NULL if the packets are not
+    // for a kernel bridge and are discarded)
+    bridge_interface_t *        inbound;
+
+    // Packet count at the last expiry check
+    unsigned long               pkt_count;
+} mroute_entry_t;
+
+// Multicast routing table of an address family
+typedef struct
+{
+    unsigned short              family;
+
+    // Multicast routing socket (-1 if not in use)
+    int                         sock;
+
+    // Interface index of each virtual interface
+    unsigned int                vif_if_index[MROUTE_MAX_VIFS];
+    unsigned int                vif_count;
+    unsigned int                vif_max;
+
+    // Forwarding entries
+    mroute_entry_t *            entry_list;
+    unsigned int                entry_count;
+} mroute_table_t;
+
+
+// Routing tables for IPv4 and IPv6
+static mroute_table_t           mroute_table[2] =
+{
+    { .family = AF_INET, .sock = -1, .vif_max = MAXVIFS },
+    { .family = AF_INET6, .sock = -1, .vif_max = MAXMIFS }
+};
+
+// The routing tables are updated by both the kernel forwarding thread and the
+// IGMP and MLD threads
+static pthread_mutex_t          mroute_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Event manager and expiry timer
+static evm_t *                  mroute_evm = NULL;
+static evm_timer_t              mroute_expire_timer;
+
+
+//
+// Compare two addresses of a family
+//
+static int mroute_addr_equal(
+    unsigned short              family,
+    const mroute_addr_t *       addr1,
+    const mroute_addr_t *       addr2)
+{
+    if (family == AF_INET)
+    {
+        return addr1->ipv4.s_addr == addr2->ipv4.s_addr;
+    }
+    return memcmp(&addr1->ipv6, &addr2->ipv6, sizeof(addr1->ipv6)) == 0;
+}
+
+
+//
+// Get the group address of a bridge instance
+//
+static void mroute_bridge_group(
+    const bridge_instance_t *   bridge,
+    mroute_addr_t *             group)
+{
+    if (bridge->family == AF_INET)
+    {
+        group->ipv4 = bridge->dst_addr.sin.sin_addr;
+    }
+    else
+    {
+        group->ipv6 = bridge->dst_addr.sin6.sin6_addr;
+    }
+}
+
+
+//
+// Validate the groups of the kernel bridges
+//
+static void mroute_check_groups(void)
+{
+    bridge_instance_t *         bridge;
+    bridge_instance_t *         other;
+    unsigned int                bridge_index;
+    unsigned int                other_index;
+    unsigned int                group_index;
+    mroute_addr_t               group;
+    mroute_addr_t               other_group;
+
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+        if (bridge->dataplane != DATAPLANE_KERNEL)
+        {
+            continue;
+        }
+        mroute_bridge_group(bridge, &group);
+
+        // The kernel does not forward link local groups
+        if ((bridge->family == AF_INET && (ntohl(group.ipv4.s_addr) & 0xffffff00) == 0xe0000000) ||
+            (bridge->family == AF_INET6 && (IN6_IS_ADDR_MC_NODELOCAL(&group.ipv6) || IN6_IS_ADDR_MC_LINKLOCAL(&group.ipv6))))
+        {
+            fatal("Bridge(%s/%u): Link local groups cannot be used with the kernel dataplane\n",
+                AF_FAMILY_TO_STRING(bridge->family), bridge->port);
+        }
+
+        // The kernel forwards the whole group, so no other bridge instance may use it
+        for (other_index = 0; other_index < bridge_list_count; other_index++)
+        {
+            other = bridge_list[other_index];
+            if (other == bridge || other->family != bridge->family)
+            {
+                continue;
+            }
+            for (group_index = 0; group_index < other->group_count; group_index++)
+            {
+                if (bridge->family == AF_INET)
+                {
+                    other_group.ipv4 = other->group_list[group_index].sin.sin_addr;
+                }
+                else
+                {
+                    other_group.ipv6 = other->group_list[group_index].sin6.sin6_addr;
+                }
+                if (mroute_addr_equal(bridge->family, &group, &other_group))
+                {
+                    fatal("Bridge(%s/%u): The group of a kernel dataplane bridge cannot be used by another bridge (port %u)\n",
+                        AF_FAMILY_TO_STRING(bridge->family), bridge->port, other->port);
+                }
+            }
+        }
+    }
+}
+
+
+//
+// Open the multicast routing socket of a table
+//
+static int mroute_open(
+    mroute_table_t *            table)
+{
+    int                         on = 1;
+    int                         sock;
+    int                         r;
+
+    if (table->family == AF_INET)
+    {
+        sock = socket(AF_INET, SOCK_RAW, IPPROTO_IGMP);
+        if (sock == -1)
+        {
+            return -1;
+        }
+        r = setsockopt(sock, IPPROTO_IP, MRT_INIT, (void *) &on, sizeof(on));
+    }
+    else
+    {
+        sock = socket(AF_INET6, SOCK_RAW, IPPROTO_ICMPV6);
+        if (sock == -1)
+        {
+            return -1;
+        }
+        r = setsockopt(sock, IPPROTO_IPV6, MRT6_INIT, (void *) &on, sizeof(on));
+    }
+    if (r == -1)
+    {
+        r = errno;
+        (void) close(sock);
+        errno = r;
+        return -1;
+    }
+
+    table->sock = sock;
+    return 0;
+}
+
+
+//
+// Find the virtual interface for an interface index
+//
+static int mroute_find_vif(
+    const mroute_table_t *      table,
+    unsigned int                if_index)
+{
+    unsigned int                vif;
+
+    for (vif = 0; vif < table->vif_count; vif++)
+    {
+        if (table->vif_if_index[vif] == if_index)
+        {
+            return (int) vif;
+        }
+    }
+    return -1;
+}
+
+
+//
+// Add an interface to the kernel as a virtual interface
+//
+static void mroute_add_vif(
+    mroute_table_t *            table,
+    const bridge_interface_t *  bridge_interface)
+{
+    struct vifctl               vif_ctl;
+    struct mif6ctl              mif_ctl;
+    unsigned int                vif;
+    int                         r;
+
+    // Interfaces may be shared by several bridge instances
+    if (mroute_find_vif(table, bridge_interface->if_index) >= 0)
+    {
+        return;
+    }
+    if (table->vif_count >= table->vif_max)
+    {
+        fatal("Kernel dataplane: Too many IPv%u interfaces (maximum %u)\n",
+            (table->family == AF_INET) ? 4 : 6, table->vif_max);
+    }
+    vif = table->vif_count;
+
+    if (table->family == AF_INET)
+    {
+        memset(&vif_ctl, 0, sizeof(vif_ctl));
+        vif_ctl.vifc_vifi = (vifi_t) vif;
+        vif_ctl.vifc_threshold = 1;
+#if defined(VIFF_USE_IFINDEX)
+        vif_ctl.vifc_flags = VIFF_USE_IFINDEX;
+        vif_ctl.vifc_lcl_ifindex = (int) bridge_interface->if_index;
+#else
+        vif_ctl.vifc_lcl_addr = bridge_interface->ipv4_addr;
+#endif
+        r = setsockopt(table->sock, IPPROTO_IP, MRT_ADD_VIF, (void *) &vif_ctl, sizeof(vif_ctl));
+        if (r == -1)
+        {
+            fatal("setsockopt (MRT_ADD_VIF) for %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+    else
+    {
+        memset(&mif_ctl, 0, sizeof(mif_ctl));
+        mif_ctl.mif6c_mifi = (mifi_t) vif;
+        mif_ctl.mif6c_pifi = (unsigned short) bridge_interface->if_index;
+        r = setsockopt(table->sock, IPPROTO_IPV6, MRT6_ADD_MIF, (void *) &mif_ctl, sizeof(mif_ctl));
+        if (r == -1)
+        {
+            fatal("setsockopt (MRT6_ADD_MIF) for %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+
+    table->vif_if_index[vif] = bridge_interface->if_index;
+    table->vif_count += 1;
+}
+
+
+//
+// Drop the packets the kernel forwards from the socket of an interface
+//
+static void mroute_configure_socket(
+    const bridge_interface_t *  bridge_interface,
+    unsigned short              family)
+{
+    int                         r;
+#if defined(SO_ATTACH_FILTER)
+    struct sock_fprog           program;
+    struct sock_filter          ipv4_filter[] =
+    {
+        // Drop copies of forwarded packets looped back to the outbound interfaces
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_LOOPBACK, 2, 0),
+        // Accept packets with a TTL of 1 or less
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF + (int) offsetof(mcb_ip4_t, ttl)),
+        BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 1, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff)
+    };
+    struct sock_filter          ipv6_filter[] =
+    {
+        // Drop copies of forwarded packets looped back to the outbound interfaces
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PACKET_LOOPBACK, 2, 0),
+        // Accept packets with a hop limit of 1 or less
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, SKF_NET_OFF + (int) offsetof(mcb_ip6_t, hop_limit)),
+        BPF_JUMP(BPF_JMP | BPF_JGT | BPF_K, 1, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff)
+    };
+
+    if (family == AF_INET)
+    {
+        program.len = sizeof(ipv4_filter) / sizeof(ipv4_filter[0]);
+        program.filter = ipv4_filter;
+    }
+    else
+    {
+        program.len = sizeof(ipv6_filter) / sizeof(ipv6_filter[0]);
+        program.filter = ipv6_filter;
+    }
+    r = setsockopt(bridge_interface->sock, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program));
+    if (r == -1)
+    {
+        fatal("setsockopt (SO_ATTACH_FILTER) on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+#else
+    int                         on = 1;
+
+    // The bridge discards packets by TTL/hop limit as they are received
+    if (family == AF_INET)
+    {
+        r = setsockopt(bridge_interface->sock, IPPROTO_IP, IP_RECVTTL, (void *) &on, sizeof(on));
+        if (r == -1)
+        {
+            fatal("setsockopt (IP_RECVTTL) for IPv4 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+    else
+    {
+        r = setsockopt(bridge_interface->sock, IPPROTO_IPV6, IPV6_RECVHOPLIMIT, (void *) &on, sizeof(on));
+        if (r == -1)
+        {
+            fatal("setsockopt (IPV6_RECVHOPLIMIT) for IPv6 on %s failed: %s\n", bridge_interface->name, strerror(errno));
+        }
+    }
+#endif
+}
+
+
+//
+// Install or update a forwarding entry in the kernel
+//
+// NB: Must be called with the mroute mutex held
+//
+static void mroute_add_mfc(
+    mroute_table_t *            table,
+    const mroute_entry_t *      entry)
+{
+    const bridge_instance_t *   bridge;
+    const bridge_interface_t *  peer;
+    struct mfcctl               mfc_ctl;
+    struct mf6cctl              mf6c_ctl;
+    unsigned int                peer_index;
+    int                         vif;
+    int                         r;
+
+    memset(&mfc_ctl, 0, sizeof(mfc_ctl));
+    memset(&mf6c_ctl, 0, sizeof(mf6c_ctl));
+    if (table->family == AF_INET)
+    {
+        mfc_ctl.mfcc_origin = entry->source.ipv4;
+        mfc_ctl.mfcc_mcastgrp = entry->group.ipv4;
+        mfc_ctl.mfcc_parent = (vifi_t) entry->parent;
+    }
+    else
+    {
+        mf6c_ctl.mf6cc_origin.sin6_family = AF_INET6;
+        mf6c_ctl.mf6cc_origin.sin6_addr = entry->source.ipv6;
+        mf6c_ctl.mf6cc_mcastgrp.sin6_family = AF_INET6;
+        mf6c_ctl.mf6cc_mcastgrp.sin6_addr = entry->group.ipv6;
+        mf6c_ctl.mf6cc_parent = (mifi_t) entry->parent;
+        IF_ZERO(&mf6c_ctl.mf6cc_ifset);
+    }
+
+    // Forward to the active outbound peers of an active inbound interface
+    if (entry->inbound && __atomic_load_n(&entry->inbound->inbound_active, __ATOMIC_RELAXED))
+    {
+        bridge = entry->inbound->bridge;
+        for (peer_index = 0; peer_index < bridge->interface_count; peer_index++)
+        {
+            peer = bridge->interface_list[peer_index];
+            if (peer == entry->inbound || __atomic_load_n(&peer->outbound_active, __ATOMIC_RELAXED) == 0)
+            {
+                continue;
+            }
+            vif = mroute_find_vif(table, peer->if_index);
+            if (vif < 0)
+            {
+                continue;
+            }
+            if (table->family == AF_INET)
+            {
+                mfc_ctl.mfcc_ttls[vif] = 1;
+            }
+            else
+            {
+                IF_SET(vif, &mf6c_ctl.mf6cc_ifset);
+            }
+        }
+    }
+
+    if (table->family == AF_INET)
+    {
+        r = setsockopt(table->sock, IPPROTO_IP, MRT_ADD_MFC, (void *) &mfc_ctl, sizeof(mfc_ctl));
+    }
+    else
+    {
+        r = setsockopt(table->sock, IPPROTO_IPV6, MRT6_ADD_MFC, (void *) &mf6c_ctl, sizeof(mf6c_ctl));
+    }
+    if (r == -1)
+    {
+        logger("Kernel dataplane: Cannot add IPv%u forwarding entry: %s\n",
+            (table->family == AF_INET) ? 4 : 6, strerror(errno));
+    }
+}
+
+
+//
+// Remove a forwarding entry from the kernel
+//
+// NB: Must be called with the mroute mutex held
+//
+static void mroute_del_mfc(
+    mroute_table_t *            table,
+    const mroute_entry_t *      entry)
+{
+    struct mfcctl               mfc_ctl;
+    struct mf6cctl              mf6c_ctl;
+
+    // Errors are ignored, the entry may have been removed with its interface
+    if (table->family == AF_INET)
+    {
+        memset(&mfc_ctl, 0, sizeof(mfc_ctl));
+        mfc_ctl.mfcc_origin = entry->source.ipv4;
+        mfc_ctl.mfcc_mcastgrp = entry->group.ipv4;
+        mfc_ctl.mfcc_parent = (vifi_t) entry->parent;
+        (void) setsockopt(table->sock, IPPROTO_IP, MRT_DEL_MFC, (void *) &mfc_ctl, sizeof(mfc_ctl));
+    }
+    else
+    {
+        memset(&mf6c_ctl, 0, sizeof(mf6c_ctl));
+        mf6c_ctl.mf6cc_origin.sin6_family = AF_INET6;
+        mf6c_ctl.mf6cc_origin.sin6_addr = entry->source.ipv6;
+        mf6c_ctl.mf6cc_mcastgrp.sin6_family = AF_INET6;
+        mf6c_ctl.mf6cc_mcastgrp.sin6_addr = entry->group.ipv6;
+        mf6c_ctl.mf6cc_parent = (mifi_t) entry->parent;
+        (void) setsockopt(table->sock, IPPROTO_IPV6, MRT6_DEL_MFC, (void *) &mf6c_ctl, sizeof(mf6c_ctl));
+    }
+}
+
+
+//
+// Get the packet count of a forwarding entry
+//
+// NB: Must be called with the mroute mutex held
+//
+static int mroute_get_count(
+    const mroute_table_t *      table,
+    const mroute_entry_t *      entry,
+    unsigned long *             pkt_count)
+{
+    struct sioc_sg_req          sg_req;
+    struct sioc_sg_req6         sg_req6;
+    int                         r;
+
+    if (table->family == AF_INET)
+    {
+        memset(&sg_req, 0, sizeof(sg_req));
+        sg_req.src = entry->source.ipv4;
+        sg_req.grp = entry->group.ipv4;
+        r = ioctl(table->sock, SIOCGETSGCNT, &sg_req);
+        *pkt_count = sg_req.pktcnt;
+    }
+    else
+    {
+        memset(&sg_req6, 0, sizeof(sg_req6));
+        sg_req6.src.sin6_family = AF_INET6;
+        sg_req6.src.sin6_addr = entry->source.ipv6;
+        sg_req6.grp.sin6_family = AF_INET6;
+        sg_req6.grp.sin6_addr = entry->group.ipv6;
+        r = ioctl(table->sock, SIOCGETSGCNT_IN6, &sg_req6);
+        *pkt_count = sg_req6.pktcnt;
+    }
+    return r;
+}
+
+
+//
+// Find the inbound interface of the kernel bridge for a group received on an interface
+//
+static bridge_interface_t * mroute_find_inbound(
+    const mroute_table_t *      table,
+    unsigned int                if_index,
+    const mroute_addr_t *       group)
+{
+    bridge_instance_t *         bridge;
+    bridge_interface_t *        bridge_interface = NULL;
+    unsigned int                bridge_index;
+    unsigned int                interface_index;
+    mroute_addr_t               bridge_group;
+
+    // NB: Kernel bridge instances are never removed, but the bridge list may be
+    //     changed by a reload
+    pthread_mutex_lock(&bridge_list_lock);
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+        if (bridge->dataplane != DATAPLANE_KERNEL || bridge->family != table->family)
+        {
+            continue;
+        }
+        mroute_bridge_group(bridge, &bridge_group);
+        if (mroute_addr_equal(table->family, group, &bridge_group) == 0)
+        {
+            continue;
+        }
+
+        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+        {
+            if (bridge->interface_list[interface_index]->if_index == if_index)
+            {
+                bridge_interface = bridge->interface_list[interface_index];
+                break;
+            }
+        }
+
+        // Groups are unique to a kernel bridge
+        break;
+    }
+    pthread_mutex_unlock(&bridge_list_lock);
+
+    return bridge_interface;
+}
+
+
+//
+// Add a forwarding entry for a source and group received on a virtual interface
+//
+static void mroute_resolve(
+    mroute_table_t *            table,
+    unsigned int                vif,
+    const mroute_addr_t *       source,
+    const mroute_addr_t *       group)
+{
+    mroute_entry_t *            entry = NULL;
+    bridge_instance_t *         bridge;
+    unsigned int                entry_index;
+    char                        source_str[INET6_ADDRSTRLEN];
+
+    if (vif >= table->vif_count)
+    {
+        return;
+    }
+
+    (void) pthread_mutex_lock(&mroute_mutex);
+
+    // An entry may already exist if an earlier upcall was queued behind it
+    for (entry_index = 0; entry_index < table->entry_count; entry_index++)
+    {
+        if (mroute_addr_equal(table->family, &table->entry_list[entry_index].source, source) &&
+            mroute_addr_equal(table->family, &table->entry_list[entry_index].group, group))
+        {
+            entry = &table->entry_list[entry_index];
+            break;
+        }
+    }
+
+    if (entry == NULL)
+    {
+        if (table->entry_count >= MROUTE_MAX_ENTRIES)
+        {
+            if (debug_level >= 4)
+            {
+                logger("Kernel dataplane: IPv%u forwarding entry table is full\n", (table->family == AF_INET) ? 4 : 6);
+            }
+            (void) pthread_mutex_unlock(&mroute_mutex);
+            return;
+        }
+        entry = &table->entry_list[table->entry_count];
+        table->entry_count += 1;
+    }
+
+    entry->source = *source;
+    entry->group = *group;
+    entry->parent = vif;
+    entry->inbound = mroute_find_inbound(table, table->vif_if_index[vif], group);
+    entry->pkt_count = 0;
+    mroute_add_mfc(table, entry);
+
+    // Debug logging
+    if (debug_level && entry->inbound)
+    {
+        bridge = entry->inbound->bridge;
+        if (inet_ntop(table->family, source, source_str, sizeof(source_str)) == NULL)
+        {
+            fatal("inet_ntop failed for IPv%u address: %s\n", (table->family == AF_INET) ? 4 : 6, strerror(errno));
+        }
+        logger("Bridge(%s/%u): Kernel forwarding source %s on %s\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port, source_str, entry->inbound->name);
+    }
+
+    (void) pthread_mutex_unlock(&mroute_mutex);
+}
+
+
+//
+// Receive an upcall from the kernel
+//
+static void mroute_receive(
+    void *                      arg)
+{
+    mroute_table_t *            table = arg;
+    unsigned char               buffer[MROUTE_UPCALL_SIZE];
+    struct igmpmsg              igmp_msg;
+    struct mrt6msg              mrt6_msg;
+    mroute_addr_t               source;
+    mroute_addr_t               group;
+    ssize_t                     len;
+
+    len = recv(table->sock, buffer, sizeof(buffer), 0);
+    if (len == -1)
+    {
+        if (errno != EINTR && errno != EAGAIN)
+        {
+            logger("Kernel dataplane: recv failed: %s\n", strerror(errno));
+        }
+        return;
+    }
+
+    // Upcalls are distinguished from IGMP/ICMPv6 packets by a zero field
+    // where the packets have a non-zero protocol or message type
+    if (table->family == AF_INET)
+    {
+        if ((size_t) len < sizeof(igmp_msg))
+        {
+            return;
+        }
+        memcpy(&igmp_msg, buffer, sizeof(igmp_msg));
+        if (igmp_msg.im_mbz != 0 || igmp_msg.im_msgtype != IGMPMSG_NOCACHE)
+        {
+            return;
+        }
+        source.ipv4 = igmp_msg.im_src;
+        group.ipv4 = igmp_msg.im_dst;
+        mroute_resolve(table, igmp_msg.im_vif, &source, &group);
+    }
+    else
+    {
+        if ((size_t) len < sizeof(mrt6_msg))
+        {
+            return;
+        }
+        memcpy(&mrt6_msg, buffer, sizeof(mrt6_msg));
+        if (mrt6_msg.im6_mbz != 0 || mrt6_msg.im6_msgtype != MRT6MSG_NOCACHE)
+        {
+            return;
+        }
+        source.ipv6 = mrt6_msg.im6_src;
+        group.ipv6 = mrt6_msg.im6_dst;
+        mroute_resolve(table, mrt6_msg.im6_mif, &source, &group);
+    }
+}
+
+
+//
+// Remove idle forwarding entries
+//
+static void mroute_expire(
+    __attribute__ ((unused))
+    void *                      arg)
+{
+    mroute_table_t *            table;
+    mroute_entry_t *            entry;
+    bridge_instance_t *         bridge;
+    unsigned int                table_index;
+    unsigned int                entry_index;
+    unsigned long               pkt_count;
+    char                        source_str[INET6_ADDRSTRLEN];
+
+    (void) pthread_mutex_lock(&mroute_mutex);
+
+    for (table_index = 0; table_index < 2; table_index++)
+    {
+        table = &mroute_table[table_index];
+        entry_index = 0;
+        while (entry_index < table->entry_count)
+        {
+            entry = &table->entry_list[entry_index];
+
+            // Keep entries that have forwarded packets since the last check
+            if (mroute_get_count(table, entry, &pkt_count) == 0 && pkt_count != entry->pkt_count)
+            {
+                entry->pkt_count = pkt_count;
+                entry_index += 1;
+                continue;
+            }
+
+            // Debug logging
+            if (debug_level && entry->inbound)
+            {
+                bridge = entry->inbound->bridge;
+                if (inet_ntop(table->family, &entry->source, source_str, sizeof(source_str)) == NULL)
+                {
+                    fatal("inet_ntop failed for IPv%u address: %s\n", (table->family == AF_INET) ? 4 : 6, strerror(errno));
+                }
+                logger("Bridge(%s/%u): Kernel forwarding source %s on %s expired\n",
+                    AF_FAMILY_TO_STRING(bridge->family), bridge->port, source_str, entry->inbound->name);
+            }
+
+            // Remove the entry, replacing it with the last entry
+            mroute_del_mfc(table, entry);
+            table->entry_count -= 1;
+            *entry = table->entry_list[table->entry_count];
+        }
+    }
+
+    (void) pthread_mutex_unlock(&mroute_mutex);
+
+    evm_add_timer(mroute_evm, &mroute_expire_timer, MROUTE_EXPIRE_MILLIS, mroute_expire, NULL);
+}
+
+
+//
+// Synchronize the forwarding entries of a kernel bridge with its fanout lists
+//
+void mroute_update_bridge(
+    bridge_instance_t *         bridge)
+{
+    mroute_table_t *            table;
+    unsigned int                entry_index;
+
+    if (bridge->dataplane != DATAPLANE_KERNEL)
+    {
+        return;
+    }
+    table = &mroute_table[bridge->family == AF_INET6];
+
+    (void) pthread_mutex_lock(&mroute_mutex);
+    for (entry_index = 0; entry_index < table->entry_count; entry_index++)
+    {
+        if (table->entry_list[entry_index].inbound &&
+            table->entry_list[entry_index].inbound->bridge == bridge)
+        {
+            mroute_add_mfc(table, &table->entry_list[entry_index]);
+        }
+    }
+    (void) pthread_mutex_unlock(&mroute_mutex);
+}
+
+
+//
+// Initialize the kernel dataplane
+//
+void mroute_initialize(void)
+{
+    mroute_table_t *            table;
+    bridge_instance_t *         bridge;
+    bridge_interface_t *        bridge_interface;
+    unsigned int                table_index;
+    unsigned int                bridge_index;
+    unsigned int                interface_index;
+    unsigned int                bridge_count;
+    unsigned int                table_count = 0;
+
+    mroute_check_groups();
+
+    for (table_index = 0; table_index < 2; table_index++)
+    {
+        table = &mroute_table[table_index];
+
+        // Count the kernel bridges of the family
+        bridge_count = 0;
+        for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+        {
+            if (bridge_list[bridge_index]->dataplane == DATAPLANE_KERNEL &&
+                bridge_list[bridge_index]->family == table->family)
+            {
+                bridge_count += 1;
+            }
+        }
+        if (bridge_count == 0)
+        {
+            continue;
+        }
+
+        // If the kernel cannot forward multicast, or another multicast router owns
+        // the routing table, the bridges fall back to the socket dataplane
+        if (mroute_open(table) == -1)
+        {
+            logger("Kernel multicast forwarding for IPv%u is not available (%s), using the socket dataplane\n",
+                (table->family == AF_INET) ? 4 : 6, strerror(errno));
+            for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+            {
+                bridge = bridge_list[bridge_index];
+                if (bridge->dataplane == DATAPLANE_KERNEL && bridge->family == table->family)
+                {
+                    bridge->dataplane = DATAPLANE_SOCKET;
+                }
+            }
+            continue;
+        }
+
+        // Add the interfaces of the bridges
+        for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+        {
+            bridge = bridge_list[bridge_index];
+            if (bridge->dataplane != DATAPLANE_KERNEL || bridge->family != table->family)
+            {
+                continue;
+            }
+
+            for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+            {
+                bridge_interface = bridge->interface_list[interface_index];
+                mroute_add_vif(table, bridge_interface);
+                mroute_configure_socket(bridge_interface, bridge->family);
+            }
+        }
+
+        table->entry_list = calloc(MROUTE_MAX_ENTRIES, sizeof(mroute_entry_t));
+        if (table->entry_list == NULL)
+        {
+            fatal("Cannot allocate memory for forwarding entries: %s\n", strerror(errno));
+        }
+        table_count += 1;
+    }
+
+    if (table_count == 0)
+    {
+        return;
+    }
+
+    // Create the event manager
+    mroute_evm = evm_create(2, 1);
+    for (table_index = 0; table_index < 2; table_index++)
+    {
+        if (mroute_table[table_index].sock != -1)
+        {
+            evm_add_socket(mroute_evm, mroute_table[table_index].sock, mroute_receive, &mroute_table[table_index]);
+        }
+    }
+    evm_add_timer(mroute_evm, &mroute_expire_timer, MROUTE_EXPIRE_MILLIS, mroute_expire, NULL);
+}
+
+
+//
+// Kernel dataplane thread
+//
+__attribute__ ((noreturn))
+static void * mroute_thread(
+    __attribute__ ((unused))
+    void *                      arg)
+{
+    // Run the event loop
+    evm_loop(mroute_evm);
+}
+
+
+//
+// Start the kernel dataplane
+//
+void start_mroute(void)
+{
+    pthread_t                   thread_id;
+    int                         r;
+
+    if (mroute_evm == NULL)
+    {
+        return;
+    }
+
+    r = pthread_create(&thread_id, NULL, &mroute_thread, NULL);
+    if (r != 0)
+    {
+        fatal("cannot create kernel dataplane thread: %s\n", strerror(r));
+    }
+}
+
+#endif // USE_MROUTE
@@ -0,0 +1,723 @@
+
+//
+// Copyright (c) 2024-2026, Denny Page
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+//
+// Packet ring dataplane (Linux only)
+//
+// Frames for the bridge's group and port are received from an mmap'd
+// TPACKET_V3 receive ring attached to each interface, and forwarded by
+// copying them directly into the mmap'd transmit ring of each active
+// outbound peer with the Ethernet source, IP source and TTL/hop limit
+// rewritten for the peer. Payload never passes through the UDP stack.
+//
+// The UDP socket of each interface is retained to hold the multicast
+// group membership, but has a filter attached that discards everything
+// it would otherwise receive.
+//
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "common.h"
+
+#if defined(USE_PACKET_RING)
+
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+
+#include "protocols.h"
+
+
+// Receive ring geometry
+#define PACKET_RX_BLOCK_SIZE    (1 << 18)
+#define PACKET_RX_BLOCK_COUNT   16
+#define PACKET_RX_FRAME_SIZE    2048
+
+// Receive block retire timeout in milliseconds
+#define PACKET_RX_BLOCK_TIMEOUT 1
+
+// Transmit ring geometry
+#define PACKET_TX_BLOCK_SIZE    (1 << 16)
+#define PACKET_TX_FRAME_COUNT   512
+#define PACKET_TX_MIN_FRAME     2048
+
+// Offset of frame data in a transmit ring frame
+#define PACKET_TX_DATA_OFFSET   (TPACKET3_HDRLEN - sizeof(struct sockaddr_ll))
+
+// Maximum size of a VLAN tag
+#define PACKET_VLAN_TAG_LEN     4
+
+// Maximum number of receive blocks processed per interface per event wait
+#define PACKET_DRAIN_BUDGET     4
+
+// Read a 16 bit big endian value
+#define PACKET_GET16(p)         ((uint16_t) (((p)[0] << 8) | (p)[1]))
+
+// Write a 16 bit big endian value
+#define PACKET_SET16(p, v)      do { (p)[0] = (uint8_t) ((v) >> 8); (p)[1] = (uint8_t) (v); } while (0)
+
+
+// Packet ring structure
+struct packet_ring
+{
+    int                         sock;
+
+    // Mapped region containing the receive ring followed by the transmit ring
+    uint8_t *                   map;
+    size_t                      map_size;
+
+    // Receive ring
+    uint8_t *                   rx_ring;
+    unsigned int                rx_block_index;
+
+    // Transmit ring
+    uint8_t *                   tx_ring;
+    unsigned int                tx_frame_size;
+    unsigned int                tx_frame_count;
+    unsigned int                tx_frame_index;
+    unsigned int                tx_pending;
+
+    // Interface MTU
+    unsigned int                mtu;
+};
+
+
+
+//
+// Fold a checksum into 16 bits
+//
+static uint16_t packet_csum_fold(
+    uint32_t                    sum)
+{
+    sum = (sum >> 16) + (sum & 0xffff);
+    sum += (sum >> 16);
+
+    return (uint16_t) sum;
+}
+
+
+//
+// Incrementally update a checksum for a change in data (RFC 1624)
+//
+static void packet_csum_update(
+    uint8_t *                   csum,
+    const uint8_t *             old_data,
+    const uint8_t *             new_data,
+    unsigned int                len)
+{
+    uint32_t                    sum;
+    unsigned int                index;
+
+    sum = (uint16_t) ~PACKET_GET16(csum);
+    for (index = 0; index < len; index += 2)
+    {
+        sum += (uint16_t) ~PACKET_GET16(old_data + index);
+        sum += PACKET_GET16(new_data + index);
+    }
+    sum = (uint16_t) ~packet_csum_fold(sum);
+
+    PACKET_SET16(csum, sum);
+}
+
+
+//
+// Calculate the full UDP checksum of a packet
+//
+static void packet_udp_csum(
+    uint8_t *                   udp,
+    unsigned int                udp_len,
+    const uint8_t *             src_addr,
+    const uint8_t *             dst_addr,
+    unsigned int                addr_len)
+{
+    uint8_t *                   csum = udp + offsetof(mcb_udp_t, csum);
+    uint64_t                    sum;
+    uint16_t                    value;
+
+    // Pseudo header
+    // NB: The checksum is calculated in network byte order
+    sum = inet_csum_partial(0, src_addr, addr_len);
+    sum = inet_csum_partial(sum, dst_addr, addr_len);
+    sum += htons(MCB_IP4_PROTOCOL_UDP);
+    sum += htons((uint16_t) udp_len);
+
+    // UDP header and payload
+    PACKET_SET16(csum, 0);
+    value = (uint16_t) ~inet_csum_fold(inet_csum_partial(sum, udp, udp_len));
+    if (value == 0)
+    {
+        value = 0xffff;
+    }
+
+    memcpy(csum, &value, sizeof(value));
+}
+
+
+//
+// Rewrite a frame for transmission on a peer interface
+//
+static void packet_rewrite_frame(
+    bridge_instance_t *         bridge,
+    bridge_interface_t *        peer,
+    uint8_t *                   frame,
+    unsigned int                frame_len,
+    unsigned int                udp_offset,
+    unsigned int                csum_not_ready)
+{
+    uint8_t *                   ip = frame + sizeof(mcb_ethernet_t);
+    uint8_t *                   udp = frame + udp_offset;
+    uint8_t *                   udp_csum = udp + offsetof(mcb_udp_t, csum);
+    uint8_t                     old_src[MCB_IP6_ADDR_LEN];
+    uint8_t                     old_ttl[2];
+
+    // Ethernet source
+    MCB_ETH_ADDR_CPY(frame + offsetof(mcb_ethernet_t, src), peer->mac_addr);
+
+    if (bridge->family == AF_INET)
+    {
+        // Source address and TTL
+        MCB_IP4_ADDR_CPY(old_src, ip + offsetof(mcb_ip4_t, src));
+        memcpy(old_ttl, ip + offsetof(mcb_ip4_t, ttl), sizeof(old_ttl));
+        MCB_IP4_ADDR_CPY(ip + offsetof(mcb_ip4_t, src), &peer->ipv4_addr);
+        ip[offsetof(mcb_ip4_t, ttl)] = 1;
+
+        // IP header checksum
+        packet_csum_update(ip + offsetof(mcb_ip4_t, csum), old_ttl, ip + offsetof(mcb_ip4_t, ttl), sizeof(old_ttl));
+        packet_csum_update(ip + offsetof(mcb_ip4_t, csum), old_src, ip + offsetof(mcb_ip4_t, src), MCB_IP4_ADDR_LEN);
+
+        // UDP checksum (optional for IPv4)
+        if (csum_not_ready)
+        {
+            packet_udp_csum(udp, frame_len - udp_offset,
+                ip + offsetof(mcb_ip4_t, src), ip + offsetof(mcb_ip4_t, dst), MCB_IP4_ADDR_LEN);
+        }
+        else if (PACKET_GET16(udp_csum) != 0)
+        {
+            packet_csum_update(udp_csum, old_src, ip + offsetof(mcb_ip4_t, src), MCB_IP4_ADDR_LEN);
+            if (PACKET_GET16(udp_csum) == 0)
+            {
+                PACKET_SET16(udp_csum, 0xffff);
+            }
+        }
+    }
+    else
+    {
+        // Source address and hop limit
+        MCB_IP6_ADDR_CPY(old_src, ip + offsetof(mcb_ip6_t, src));
+        MCB_IP6_ADDR_CPY(ip + offsetof(mcb_ip6_t, src), &peer->ipv6_addr);
+        ip[offsetof(mcb_ip6_t, hop_limit)] = 1;
+
+        // UDP checksum (mandatory for IPv6)
+        if (csum_not_ready)
+        {
+            packet_udp_csum(udp, frame_len - udp_offset,
+                ip + offsetof(mcb_ip6_t, src), ip + offsetof(mcb_ip6_t, dst), MCB_IP6_ADDR_LEN);
+        }
+        else
+        {
+            packet_csum_update(udp_csum, old_src, ip + offsetof(mcb_ip6_t, src), MCB_IP6_ADDR_LEN);
+            if (PACKET_GET16(udp_csum) == 0)
+            {
+                PACKET_SET16(udp_csum, 0xffff);
+            }
+        }
+    }
+}
+
+
+//
+// Forward a received frame to the outbound peers
+//
+static void packet_forward_frame(
+    bridge_interface_t *        bridge_interface,
+    const bridge_fanout_t *     fanout,
+    struct tpacket3_hdr *       ppd)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    const struct sockaddr_ll *  sll;
+    const uint8_t *             frame;
+    const uint8_t *             ip;
+    unsigned int                frame_len;
+    unsigned int                udp_offset;
+    unsigned int                payload_len;
+    unsigned int                csum_not_ready;
+    struct packet_ring *        ring;
+    struct tpacket3_hdr *       tx_hdr;
+    uint8_t *                   tx_frame;
+    const uint8_t *             src_addr;
+    bridge_interface_t *        peer;
+    unsigned int                peer_index;
+    unsigned int                queued = 0;
+
+    // Ignore frames we transmitted
+    sll = (const struct sockaddr_ll *) ((uint8_t *) ppd + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    if (sll->sll_pkttype == PACKET_OUTGOING)
+    {
+        return;
+    }
+
+    // Ignore truncated frames
+    if (ppd->tp_snaplen != ppd->tp_len)
+    {
+        COUNTER_ADD(bridge_interface->counters->rx_errors, 1);
+        return;
+    }
+    frame = (const uint8_t *) ppd + ppd->tp_mac;
+    ip = frame + sizeof(mcb_ethernet_t);
+    csum_not_ready = (ppd->tp_status & TP_STATUS_CSUMNOTREADY) != 0;
+
+    // Determine the frame length, excluding any Ethernet padding
+    // NB: The receive filter has already confirmed the frame is an unfragmented
+    //     UDP packet for the bridge's group and port.
+    if (bridge->family == AF_INET)
+    {
+        udp_offset = sizeof(mcb_ethernet_t) + (ip[0] & 0x0f) * 4;
+        frame_len = sizeof(mcb_ethernet_t) + PACKET_GET16(ip + offsetof(mcb_ip4_t, total_len));
+    }
+    else
+    {
+        udp_offset = sizeof(mcb_ethernet_t) + sizeof(mcb_ip6_t);
+        frame_len = udp_offset + PACKET_GET16(ip + offsetof(mcb_ip6_t, payload_len));
+    }
+    if (frame_len > ppd->tp_snaplen || udp_offset + sizeof(mcb_udp_t) > frame_len)
+    {
+        COUNTER_ADD(bridge_interface->counters->rx_errors, 1);
+        return;
+    }
+
+    // Count the frame by its UDP payload as with the socket dataplane
+    payload_len = frame_len - udp_offset - sizeof(mcb_udp_t);
+    COUNTER_ADD(bridge_interface->counters->rx_packets, 1);
+    COUNTER_ADD(bridge_interface->counters->rx_bytes, payload_len);
+    if (fanout->peer_count == 0)
+    {
+        if (__atomic_load_n(&bridge_interface->inbound_active, __ATOMIC_RELAXED) == 0)
+        {
+            COUNTER_ADD(bridge_interface->counters->rx_inactive, 1);
+        }
+        else
+        {
+            COUNTER_ADD(bridge_interface->counters->rx_no_outbound, 1);
+        }
+        return;
+    }
+
+    src_addr = ip + (bridge->family == AF_INET ? offsetof(mcb_ip4_t, src) : offsetof(mcb_ip6_t, src));
+    for (peer_index = 0; peer_index < fanout->peer_count; peer_index++)
+    {
+        peer = fanout->peer_list[peer_index];
+        ring = peer->packet_ring;
+
+        // Drop frames from sources the peer's listeners have not asked for
+        if (peer->source_filter[0] && interface_source_allowed(peer->source_filter[0], src_addr) == 0)
+        {
+            COUNTER_ADD(peer->counters->tx_filtered, 1);
+            continue;
+        }
+
+        // Ensure the frame will fit the peer
+        if (frame_len - sizeof(mcb_ethernet_t) > ring->mtu ||
+            PACKET_TX_DATA_OFFSET + frame_len > ring->tx_frame_size)
+        {
+            if (debug_level >= 4)
+            {
+                log_packet(LOG_EVENT_DROPPED_MTU, bridge, bridge_interface->name, peer->name, src_addr, frame_len, 0);
+            }
+            COUNTER_ADD(peer->counters->tx_dropped, 1);
+            continue;
+        }
+
+        // Get the next transmit frame
+        tx_hdr = (struct tpacket3_hdr *) (ring->tx_ring + ring->tx_frame_index * ring->tx_frame_size);
+        if (__atomic_load_n(&tx_hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE)
+        {
+            if (debug_level >= 4)
+            {
+                log_packet(LOG_EVENT_DROPPED_RING_FULL, bridge, bridge_interface->name, peer->name, src_addr, frame_len, 0);
+            }
+            COUNTER_ADD(peer->counters->tx_dropped, 1);
+            continue;
+        }
+
+        // Copy and rewrite the frame
+        tx_frame = (uint8_t *) tx_hdr + PACKET_TX_DATA_OFFSET;
+        memcpy(tx_frame, frame, frame_len);
+        packet_rewrite_frame(bridge, peer, tx_frame, frame_len, udp_offset, csum_not_ready);
+
+        // Queue the frame for transmission
+        tx_hdr->tp_len = frame_len;
+        tx_hdr->tp_snaplen = frame_len;
+        tx_hdr->tp_next_offset = 0;
+        __atomic_store_n(&tx_hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+        ring->tx_frame_index = (ring->tx_frame_index + 1) % ring->tx_frame_count;
+        ring->tx_pending = 1;
+        queued = 1;
+        COUNTER_ADD(peer->counters->tx_packets, 1);
+        COUNTER_ADD(peer->counters->tx_bytes, payload_len);
+
+        if (debug_level >= 4)
+        {
+            log_packet(LOG_EVENT_FORWARDED_FRAME, bridge, bridge_interface->name, peer->name, src_addr, frame_len, 0);
+        }
+    }
+
+    // Record the forwarding latency from the ring timestamp to queuing for transmission
+    if (queued)
+    {
+        latency_record(bridge->latency, (uint64_t) ppd->tp_sec * 1000000000 + ppd->tp_nsec, latency_now());
+    }
+}
+
+
+//
+// Process a block of received frames
+//
+// Returns non-zero if a block was processed
+//
+static unsigned int packet_ring_receive(
+    void *                      arg)
+{
+    bridge_interface_t *        bridge_interface = arg;
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    struct packet_ring *        ring = bridge_interface->packet_ring;
+    struct tpacket_block_desc * block;
+    struct tpacket3_hdr *       ppd;
+    const bridge_fanout_t *     fanout;
+    bridge_interface_t *        peer;
+    unsigned int                peer_index;
+    unsigned int                frame_index;
+    struct tpacket_stats_v3     stats;
+    socklen_t                   stats_len;
+    ssize_t                     rs;
+
+    // Is the next block ready?
+    block = (struct tpacket_block_desc *) (ring->rx_ring + ring->rx_block_index * PACKET_RX_BLOCK_SIZE);
+    if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0)
+    {
+        return 0;
+    }
+
+    // Forward the frames
+    fanout = bridge_interface->fanout;
+    ppd = (struct tpacket3_hdr *) ((uint8_t *) block + block->hdr.bh1.offset_to_first_pkt);
+    for (frame_index = 0; frame_index < block->hdr.bh1.num_pkts; frame_index++)
+    {
+        packet_forward_frame(bridge_interface, fanout, ppd);
+        ppd = (struct tpacket3_hdr *) ((uint8_t *) ppd + ppd->tp_next_offset);
+    }
+
+    // Start transmission on the peers
+    for (peer_index = 0; peer_index < fanout->peer_count; peer_index++)
+    {
+        peer = fanout->peer_list[peer_index];
+        if (peer->packet_ring->tx_pending == 0)
+        {
+            continue;
+        }
+
+        peer->packet_ring->tx_pending = 0;
+        rs = send(peer->packet_ring->sock, NULL, 0, MSG_DONTWAIT);
+        if (rs == -1)
+        {
+            if (errno == EAGAIN || errno == ENOBUFS)
+            {
+                COUNTER_ADD(peer->counters->tx_nobufs, 1);
+            }
+            else if (errno != ENETDOWN)
+            {
+                logger("Bridge(%s/%u): packet ring send error on interface %s: %s\n",
+                    AF_FAMILY_TO_STRING(bridge->family), bridge->port,
+                    peer->name, strerror(errno));
+                COUNTER_ADD(peer->counters->tx_errors, 1);
+            }
+        }
+    }
+
+    // Return the block to the kernel
+    __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    ring->rx_block_index = (ring->rx_block_index + 1) % PACKET_RX_BLOCK_COUNT;
+
+    // Collect the number of frames dropped by the kernel (reading resets the count)
+    stats_len = sizeof(stats);
+    if (getsockopt(ring->sock, SOL_PACKET, PACKET_STATISTICS, &stats, &stats_len) == 0 && stats.tp_drops)
+    {
+        COUNTER_ADD(bridge_interface->counters->rx_overflow, stats.tp_drops);
+    }
+
+    return 1;
+}
+
+
+//
+// Attach a classic BPF filter to a socket
+//
+static void packet_attach_filter(
+    int                         sock,
+    struct sock_filter *        filter,
+    unsigned int                filter_len,
+    const char *                name)
+{
+    struct sock_fprog           program;
+    int                         r;
+
+    program.len = filter_len;
+    program.filter = filter;
+    r = setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program));
+    if (r == -1)
+    {
+        fatal("setsockopt (SO_ATTACH_FILTER) on %s failed: %s\n", name, strerror(errno));
+    }
+}
+
+
+//
+// Create the packet ring for an interface
+//
+void packet_ring_create(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    struct packet_ring *        ring;
+    struct tpacket_req3         req;
+    struct sockaddr_ll          sll;
+    struct ifreq                ifr;
+    size_t                      rx_size;
+    size_t                      tx_size;
+    unsigned int                frames_per_block;
+    uint32_t                    group[4];
+    unsigned int                index;
+    const int                   on = 1;
+    const int                   version = TPACKET_V3;
+    int                         sock;
+    int                         r;
+
+    // Discard everything received on the UDP socket
+    struct sock_filter          drop_filter[] =
+    {
+        BPF_STMT(BPF_RET | BPF_K, 0)
+    };
+
+    // Accept unfragmented IPv4 UDP packets for the group and port
+    struct sock_filter          ipv4_filter[] =
+    {
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, offsetof(mcb_ethernet_t, type)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, MCB_ETHERNET_TYPE_IP4, 0, 10),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, sizeof(mcb_ethernet_t) + offsetof(mcb_ip4_t, protocol)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, MCB_IP4_PROTOCOL_UDP, 0, 8),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, sizeof(mcb_ethernet_t) + offsetof(mcb_ip4_t, offset)),
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, MCB_IP4_OFF_MF | MCB_IP4_OFF_MASK, 6, 0),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, sizeof(mcb_ethernet_t) + offsetof(mcb_ip4_t, dst)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ntohl(bridge->dst_addr.sin.sin_addr.s_addr), 0, 4),
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, sizeof(mcb_ethernet_t)),
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, sizeof(mcb_ethernet_t) + offsetof(mcb_udp_t, dst_port)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, bridge->port, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+        BPF_STMT(BPF_RET | BPF_K, 0)
+    };
+
+    // Accept IPv6 UDP packets (without extension headers) for the group and port
+    struct sock_filter          ipv6_filter[] =
+    {
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, offsetof(mcb_ethernet_t, type)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, MCB_ETHERNET_TYPE_IP6, 0, 13),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, sizeof(mcb_ethernet_t) + offsetof(mcb_ip6_t, next_header)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, MCB_IP6_PROTO_UDP, 0, 11),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, sizeof(mcb_ethernet_t) + offsetof(mcb_ip6_t, dst)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 9),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, sizeof(mcb_ethernet_t) + offsetof(mcb_ip6_t, dst) + 4),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 7),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, sizeof(mcb_ethernet_t) + offsetof(mcb_ip6_t, dst) + 8),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 5),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, sizeof(mcb_ethernet_t) + offsetof(mcb_ip6_t, dst) + 12),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 3),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, sizeof(mcb_ethernet_t) + sizeof(mcb_ip6_t) + offsetof(mcb_udp_t, dst_port)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, bridge->port, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+        BPF_STMT(BPF_RET | BPF_K, 0)
+    };
+
+    // Fill in the IPv6 group address
+    memcpy(group, &bridge->dst_addr.sin6.sin6_addr, sizeof(group));
+    for (index = 0; index < 4; index++)
+    {
+        ipv6_filter[5 + index * 2].k = ntohl(group[index]);
+    }
+
+    // Allocate the ring structure
+    ring = calloc(1, sizeof(struct packet_ring));
+    if (ring == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+
+    // Discard packets on the UDP socket
+    packet_attach_filter(bridge_interface->sock, drop_filter, sizeof(drop_filter) / sizeof(drop_filter[0]), bridge_interface->name);
+
+    // Get the interface MTU
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, bridge_interface->name, sizeof(ifr.ifr_name) - 1);
+    r = ioctl(bridge_interface->sock, SIOCGIFMTU, &ifr);
+    if (r == -1)
+    {
+        fatal("ioctl (SIOCGIFMTU) on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+    ring->mtu = ifr.ifr_mtu;
+
+    // Create the socket (with no protocol, so nothing is received before the ring is ready)
+    sock = socket(AF_PACKET, SOCK_RAW, 0);
+    if (sock == -1)
+    {
+        fatal("Packet socket creation failed: %s\n", strerror(errno));
+    }
+
+    // Attach the receive filter
+    if (bridge->family == AF_INET)
+    {
+        packet_attach_filter(sock, ipv4_filter, sizeof(ipv4_filter) / sizeof(ipv4_filter[0]), bridge_interface->name);
+    }
+    else
+    {
+        packet_attach_filter(sock, ipv6_filter, sizeof(ipv6_filter) / sizeof(ipv6_filter[0]), bridge_interface->name);
+    }
+
+    // Set the ring version
+    r = setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version));
+    if (r == -1)
+    {
+        fatal("setsockopt (PACKET_VERSION) on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+
+    // Ignore frames we transmit
+#if defined(PACKET_IGNORE_OUTGOING)
+    r = setsockopt(sock, SOL_PACKET, PACKET_IGNORE_OUTGOING, &on, sizeof(on));
+    if (r == -1)
+    {
+        fatal("setsockopt (PACKET_IGNORE_OUTGOING) on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+#endif
+
+    // Bypass the queuing discipline on transmit
+    r = setsockopt(sock, SOL_PACKET, PACKET_QDISC_BYPASS, &on, sizeof(on));
+    if (r == -1)
+    {
+        fatal("setsockopt (PACKET_QDISC_BYPASS) on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+
+    // Discard malformed transmit frames rather than stopping the ring
+    r = setsockopt(sock, SOL_PACKET, PACKET_LOSS, &on, sizeof(on));
+    if (r == -1)
+    {
+        fatal("setsockopt (PACKET_LOSS) on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+
+    // Create the receive ring
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = PACKET_RX_BLOCK_SIZE;
+    req.tp_block_nr = PACKET_RX_BLOCK_COUNT;
+    req.tp_frame_size = PACKET_RX_FRAME_SIZE;
+    req.tp_frame_nr = (PACKET_RX_BLOCK_SIZE / PACKET_RX_FRAME_SIZE) * PACKET_RX_BLOCK_COUNT;
+    req.tp_retire_blk_tov = PACKET_RX_BLOCK_TIMEOUT;
+    r = setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+    if (r == -1)
+    {
+        fatal("setsockopt (PACKET_RX_RING) on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+    rx_size = (size_t) req.tp_block_size * req.tp_block_nr;
+
+    // Determine the transmit frame size (a power of 2 that holds a full MTU frame)
+    ring->tx_frame_size = PACKET_TX_MIN_FRAME;
+    while (ring->tx_frame_size < PACKET_TX_DATA_OFFSET + sizeof(mcb_ethernet_t) + PACKET_VLAN_TAG_LEN + ring->mtu &&
+           ring->tx_frame_size < PACKET_TX_BLOCK_SIZE)
+    {
+        ring->tx_frame_size *= 2;
+    }
+    frames_per_block = PACKET_TX_BLOCK_SIZE / ring->tx_frame_size;
+
+    // Create the transmit ring
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = PACKET_TX_BLOCK_SIZE;
+    req.tp_block_nr = (PACKET_TX_FRAME_COUNT + frames_per_block - 1) / frames_per_block;
+    req.tp_frame_size = ring->tx_frame_size;
+    req.tp_frame_nr = frames_per_block * req.tp_block_nr;
+    r = setsockopt(sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req));
+    if (r == -1)
+    {
+        fatal("setsockopt (PACKET_TX_RING) on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+    tx_size = (size_t) req.tp_block_size * req.tp_block_nr;
+    ring->tx_frame_count = req.tp_frame_nr;
+
+    // Map the rings
+    ring->map_size = rx_size + tx_size;
+    ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sock, 0);
+    if (ring->map == MAP_FAILED)
+    {
+        fatal("mmap of packet ring for %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+    ring->rx_ring = ring->map;
+    ring->tx_ring = ring->map + rx_size;
+
+    // Bind the socket to the interface
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(bridge->family == AF_INET ? ETH_P_IP : ETH_P_IPV6);
+    sll.sll_ifindex = bridge_interface->if_index;
+    r = bind(sock, (struct sockaddr *) &sll, sizeof(sll));
+    if (r == -1)
+    {
+        fatal("Packet socket bind on %s failed: %s\n", bridge_interface->name, strerror(errno));
+    }
+
+    ring->sock = sock;
+    bridge_interface->packet_ring = ring;
+}
+
+
+//
+// Add the packet ring for an interface to an event manager
+//
+void packet_ring_register(
+    evm_t *                     evm,
+    bridge_interface_t *        bridge_interface)
+{
+    evm_add_drain_socket(evm, bridge_interface->packet_ring->sock,
+        packet_ring_receive, bridge_interface, PACKET_DRAIN_BUDGET);
+}
+
+#endif // USE_PACKET_RING
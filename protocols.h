@@ -65,6 +65,9 @@
 
 // IPv4 Types
 #define MCB_IP4_PROTOCOL_IGMP       2
+#define MCB_IP4_PROTOCOL_UDP        17
+#define MCB_IP4_OFF_MF              0x2000
+#define MCB_IP4_OFF_MASK            0x1fff
 #define MCB_IP4_OFF_DF              0x4000
 #define MCB_IP4_OPT_RA              0x94
 #define MCB_IP4_TOS_IC              0xc0
@@ -105,6 +108,7 @@
 #define MCB_IP6_OPT_HOP             0x00
 #define MCB_IP6_OPT_RA              0x05
 #define MCB_IP6_PROTO_ICMPV6        0x3a
+#define MCB_IP6_PROTO_UDP           0x11
 
 // MLD Types
 #define MCB_MLD_QUERY               0x82    // General query (group address zero) sent to all systems group
@@ -327,6 +331,20 @@ typedef struct __attribute__((packed))
     uint8_t                     dst[MCB_IP6_ADDR_LEN];
 } mcb_ip6_t;
 
+// UDP header structure
+typedef struct __attribute__((packed))
+{
+    // Source Port
+    uint16_t                    src_port;
+    // Destination Port
+    uint16_t                    dst_port;
+    // Length
+    uint16_t                    length;
+    // Checksum
+    uint16_t                    csum;
+} mcb_udp_t;
+
+
 // IPv6 hop-by-hop structure
 typedef struct __attribute__((packed))
 {
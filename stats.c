@@ -0,0 +1,537 @@
+
+//
+// Copyright (c) 2024-2026, Denny Page
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "common.h"
+
+
+// Time to wait for a request from a statistics client, in milliseconds
+#define STATS_REQUEST_TIMEOUT   100
+
+// Request that selects JSON output
+#define STATS_REQUEST_JSON      "json"
+
+// Listening socket for statistics requests
+static int                      stats_sock = -1;
+
+// Latency percentiles reported, in parts per thousand
+#define LATENCY_PERCENTILE_COUNT 3
+static const unsigned int       latency_percentile_list[LATENCY_PERCENTILE_COUNT] = { 500, 990, 999 };
+static const char *             latency_percentile_names[LATENCY_PERCENTILE_COUNT] = { "p50", "p99", "p99.9" };
+
+// Smallest value recorded in the log-linear portion of the latency histogram
+#define LATENCY_LINEAR_LIMIT    (1u << (LATENCY_SUB_BUCKET_BITS + 1))
+
+// Summary of a latency histogram
+typedef struct
+{
+    uint64_t                    count;
+    uint64_t                    max;
+    uint64_t                    percentile[LATENCY_PERCENTILE_COUNT];
+} latency_summary_t;
+
+
+
+//
+// Get the current time for latency recording, in nanoseconds
+//
+// NB: Kernel receive timestamps are CLOCK_REALTIME
+//
+uint64_t latency_now(void)
+{
+    struct timespec             ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+//
+// Record the forwarding latency of a packet received at rx_time
+//
+void latency_record(
+    bridge_latency_t *          latency,
+    uint64_t                    rx_time,
+    uint64_t                    now)
+{
+    uint64_t                    value;
+    unsigned int                exponent;
+    unsigned int                index;
+
+    // Ignore packets without a timestamp and clock steps
+    if (rx_time == 0 || now < rx_time)
+    {
+        return;
+    }
+    value = now - rx_time;
+
+    if (value < LATENCY_LINEAR_LIMIT)
+    {
+        index = (unsigned int) value;
+    }
+    else
+    {
+        exponent = 63 - (unsigned int) __builtin_clzll(value);
+        index = LATENCY_LINEAR_LIMIT +
+            (exponent - LATENCY_SUB_BUCKET_BITS - 1) * (1u << LATENCY_SUB_BUCKET_BITS) +
+            (unsigned int) ((value >> (exponent - LATENCY_SUB_BUCKET_BITS)) & ((1u << LATENCY_SUB_BUCKET_BITS) - 1));
+        if (index >= LATENCY_BUCKET_COUNT)
+        {
+            index = LATENCY_BUCKET_COUNT - 1;
+        }
+    }
+
+    COUNTER_ADD(latency->bucket[index], 1);
+    if (value > latency->max)
+    {
+        COUNTER_SET(latency->max, value);
+    }
+}
+
+
+//
+// Determine the largest value recorded in a latency histogram bucket
+//
+static uint64_t latency_bucket_value(
+    unsigned int                index)
+{
+    unsigned int                exponent;
+    unsigned int                sub_bucket;
+
+    if (index < LATENCY_LINEAR_LIMIT)
+    {
+        return index;
+    }
+
+    exponent = (index - LATENCY_LINEAR_LIMIT) / (1u << LATENCY_SUB_BUCKET_BITS) + LATENCY_SUB_BUCKET_BITS + 1;
+    sub_bucket = (index - LATENCY_LINEAR_LIMIT) % (1u << LATENCY_SUB_BUCKET_BITS);
+    return ((uint64_t) ((1u << LATENCY_SUB_BUCKET_BITS) + sub_bucket + 1) << (exponent - LATENCY_SUB_BUCKET_BITS)) - 1;
+}
+
+
+//
+// Summarize a latency histogram
+//
+static void latency_summarize(
+    const bridge_latency_t *    latency,
+    latency_summary_t *         summary)
+{
+    uint64_t                    bucket[LATENCY_BUCKET_COUNT];
+    uint64_t                    rank[LATENCY_PERCENTILE_COUNT];
+    uint64_t                    total;
+    unsigned int                index;
+    unsigned int                percentile_index;
+
+    // Take a copy of the buckets so that the percentiles are consistent
+    summary->count = 0;
+    for (index = 0; index < LATENCY_BUCKET_COUNT; index++)
+    {
+        bucket[index] = COUNTER_GET(latency->bucket[index]);
+        summary->count += bucket[index];
+    }
+    summary->max = COUNTER_GET(latency->max);
+
+    for (percentile_index = 0; percentile_index < LATENCY_PERCENTILE_COUNT; percentile_index++)
+    {
+        rank[percentile_index] = (summary->count * latency_percentile_list[percentile_index] + 999) / 1000;
+        summary->percentile[percentile_index] = 0;
+    }
+
+    total = 0;
+    percentile_index = 0;
+    for (index = 0; index < LATENCY_BUCKET_COUNT && percentile_index < LATENCY_PERCENTILE_COUNT; index++)
+    {
+        total += bucket[index];
+        while (percentile_index < LATENCY_PERCENTILE_COUNT && total && total >= rank[percentile_index])
+        {
+            summary->percentile[percentile_index] = latency_bucket_value(index);
+            if (summary->percentile[percentile_index] > summary->max)
+            {
+                summary->percentile[percentile_index] = summary->max;
+            }
+            percentile_index += 1;
+        }
+    }
+}
+
+
+
+//
+// Format the forwarding statistics for all bridges
+//
+// NB: Counters are read without synchronizing with the bridge threads. Each
+//     counter is individually consistent, but counters of an interface are
+//     not a snapshot taken at a single point in time. The bridge list lock is
+//     held so that bridge instances and interfaces are not removed while they
+//     are formatted.
+//
+static void stats_format(
+    FILE *                      fp,
+    unsigned int                json)
+{
+    bridge_instance_t *         bridge;
+    bridge_interface_t *        bridge_interface;
+    bridge_counters_t *         counters;
+    latency_summary_t           summary;
+    unsigned int                bridge_index;
+    unsigned int                interface_index;
+    unsigned int                group_index;
+    unsigned int                percentile_index;
+    char                        addr_str[INET6_ADDRSTRLEN];
+
+    if (json)
+    {
+        fprintf(fp, "{\"bridges\":[");
+    }
+
+    pthread_mutex_lock(&bridge_list_lock);
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+        latency_summarize(bridge->latency, &summary);
+
+        // Header with all groups of the bridge instance
+        if (json)
+        {
+            fprintf(fp, "%s{\"family\":\"%s\",\"port\":%u,\"addresses\":[",
+                bridge_index ? "," : "", AF_FAMILY_TO_STRING(bridge->family), bridge->port);
+        }
+        else
+        {
+            fprintf(fp, "Bridge(%s/%u): %s ", AF_FAMILY_TO_STRING(bridge->family), bridge->port,
+                (bridge->group_count > 1) ? "groups" : "group");
+        }
+        for (group_index = 0; group_index < bridge->group_count; group_index++)
+        {
+            if (bridge->family == AF_INET)
+            {
+                inet_ntop(AF_INET, &bridge->group_list[group_index].sin.sin_addr, addr_str, sizeof(addr_str));
+            }
+            else
+            {
+                inet_ntop(AF_INET6, &bridge->group_list[group_index].sin6.sin6_addr, addr_str, sizeof(addr_str));
+            }
+
+            if (json)
+            {
+                fprintf(fp, "%s\"%s\"", group_index ? "," : "", addr_str);
+            }
+            else
+            {
+                fprintf(fp, "%s%s", group_index ? ", " : "", addr_str);
+            }
+        }
+
+        if (json)
+        {
+            fprintf(fp, "],\"dataplane\":\"%s\",", dataplane_type_to_string(bridge->dataplane));
+            fprintf(fp, "\"latency_ns\":{\"count\":%llu", (unsigned long long) summary.count);
+            for (percentile_index = 0; percentile_index < LATENCY_PERCENTILE_COUNT; percentile_index++)
+            {
+                fprintf(fp, ",\"%s\":%llu", latency_percentile_names[percentile_index],
+                    (unsigned long long) summary.percentile[percentile_index]);
+            }
+            fprintf(fp, ",\"max\":%llu},\"interfaces\":[", (unsigned long long) summary.max);
+        }
+        else
+        {
+            fprintf(fp, ", dataplane %s\n", dataplane_type_to_string(bridge->dataplane));
+            fprintf(fp, "  latency: count %llu", (unsigned long long) summary.count);
+            for (percentile_index = 0; percentile_index < LATENCY_PERCENTILE_COUNT; percentile_index++)
+            {
+                fprintf(fp, " %s %.1fus", latency_percentile_names[percentile_index],
+                    (double) summary.percentile[percentile_index] / 1000.0);
+            }
+            fprintf(fp, " max %.1fus\n", (double) summary.max / 1000.0);
+        }
+
+        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+        {
+            bridge_interface = bridge->interface_list[interface_index];
+            counters = bridge_interface->counters;
+
+            if (json)
+            {
+                fprintf(fp, "%s{\"name\":\"%s\","
+                    "\"rx\":{\"packets\":%llu,\"bytes\":%llu,\"inactive\":%llu,\"no_outbound\":%llu,\"errors\":%llu,\"overflow\":%llu,\"duplicates\":%llu,\"calls\":%llu},"
+                    "\"tx\":{\"packets\":%llu,\"bytes\":%llu,\"errors\":%llu,\"nobufs\":%llu,\"dropped\":%llu,\"filtered\":%llu,\"calls\":%llu}}",
+                    interface_index ? "," : "", bridge_interface->name,
+                    (unsigned long long) COUNTER_GET(counters->rx_packets),
+                    (unsigned long long) COUNTER_GET(counters->rx_bytes),
+                    (unsigned long long) COUNTER_GET(counters->rx_inactive),
+                    (unsigned long long) COUNTER_GET(counters->rx_no_outbound),
+                    (unsigned long long) COUNTER_GET(counters->rx_errors),
+                    (unsigned long long) COUNTER_GET(counters->rx_overflow),
+                    (unsigned long long) COUNTER_GET(counters->rx_duplicates),
+                    (unsigned long long) COUNTER_GET(counters->rx_calls),
+                    (unsigned long long) COUNTER_GET(counters->tx_packets),
+                    (unsigned long long) COUNTER_GET(counters->tx_bytes),
+                    (unsigned long long) COUNTER_GET(counters->tx_errors),
+                    (unsigned long long) COUNTER_GET(counters->tx_nobufs),
+                    (unsigned long long) COUNTER_GET(counters->tx_dropped),
+                    (unsigned long long) COUNTER_GET(counters->tx_filtered),
+                    (unsigned long long) COUNTER_GET(counters->tx_calls));
+            }
+            else
+            {
+                fprintf(fp, "  %s: rx packets %llu bytes %llu inactive %llu no-outbound %llu errors %llu overflow %llu duplicates %llu calls %llu\n",
+                    bridge_interface->name,
+                    (unsigned long long) COUNTER_GET(counters->rx_packets),
+                    (unsigned long long) COUNTER_GET(counters->rx_bytes),
+                    (unsigned long long) COUNTER_GET(counters->rx_inactive),
+                    (unsigned long long) COUNTER_GET(counters->rx_no_outbound),
+                    (unsigned long long) COUNTER_GET(counters->rx_errors),
+                    (unsigned long long) COUNTER_GET(counters->rx_overflow),
+                    (unsigned long long) COUNTER_GET(counters->rx_duplicates),
+                    (unsigned long long) COUNTER_GET(counters->rx_calls));
+                fprintf(fp, "  %s: tx packets %llu bytes %llu errors %llu nobufs %llu dropped %llu filtered %llu calls %llu\n",
+                    bridge_interface->name,
+                    (unsigned long long) COUNTER_GET(counters->tx_packets),
+                    (unsigned long long) COUNTER_GET(counters->tx_bytes),
+                    (unsigned long long) COUNTER_GET(counters->tx_errors),
+                    (unsigned long long) COUNTER_GET(counters->tx_nobufs),
+                    (unsigned long long) COUNTER_GET(counters->tx_dropped),
+                    (unsigned long long) COUNTER_GET(counters->tx_filtered),
+                    (unsigned long long) COUNTER_GET(counters->tx_calls));
+            }
+        }
+
+        if (json)
+        {
+            fprintf(fp, "]}");
+        }
+    }
+    pthread_mutex_unlock(&bridge_list_lock);
+
+    if (json)
+    {
+        fprintf(fp, "]}\n");
+    }
+}
+
+
+//
+// Log the forwarding statistics
+//
+void stats_log(void)
+{
+    FILE *                      fp;
+    char *                      buffer = NULL;
+    size_t                      size = 0;
+    char *                      line;
+    char *                      next;
+
+    fp = open_memstream(&buffer, &size);
+    if (fp == NULL)
+    {
+        logger("open_memstream for statistics failed: %s\n", strerror(errno));
+        return;
+    }
+    stats_format(fp, 0);
+    (void) fclose(fp);
+
+    // Log line by line so that each line is a separate syslog message
+    for (line = buffer; line && *line; line = next)
+    {
+        next = strchr(line, '\n');
+        if (next)
+        {
+            *next++ = '\0';
+        }
+        logger("%s\n", line);
+    }
+    free(buffer);
+}
+
+
+//
+// Answer a single statistics client
+//
+static void stats_client(
+    int                         sock)
+{
+    struct pollfd               pfd;
+    char                        request[64];
+    unsigned int                json = 0;
+    FILE *                      fp;
+    char *                      buffer = NULL;
+    size_t                      size = 0;
+    size_t                      offset;
+    ssize_t                     rs;
+    int                         r;
+
+    // Wait briefly for an optional request
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    r = poll(&pfd, 1, STATS_REQUEST_TIMEOUT);
+    if (r > 0)
+    {
+        rs = read(sock, request, sizeof(request) - 1);
+        if (rs > 0)
+        {
+            request[rs] = '\0';
+            if (strncmp(request, STATS_REQUEST_JSON, strlen(STATS_REQUEST_JSON)) == 0)
+            {
+                json = 1;
+            }
+        }
+    }
+
+    fp = open_memstream(&buffer, &size);
+    if (fp == NULL)
+    {
+        logger("open_memstream for statistics failed: %s\n", strerror(errno));
+        return;
+    }
+    stats_format(fp, json);
+    (void) fclose(fp);
+
+    for (offset = 0; offset < size; offset += (size_t) rs)
+    {
+        rs = write(sock, buffer + offset, size - offset);
+        if (rs <= 0)
+        {
+            if (rs == -1 && errno == EINTR)
+            {
+                rs = 0;
+                continue;
+            }
+            break;
+        }
+    }
+    free(buffer);
+}
+
+
+//
+// Statistics socket thread
+//
+__attribute__ ((noreturn))
+static void * stats_thread(
+    __attribute__ ((unused))
+    void *                      arg)
+{
+    int                         sock;
+
+    while (1)
+    {
+        sock = accept(stats_sock, NULL, NULL);
+        if (sock == -1)
+        {
+            if (errno != EINTR && errno != ECONNABORTED)
+            {
+                logger("accept on statistics socket failed: %s\n", strerror(errno));
+            }
+            continue;
+        }
+
+        stats_client(sock);
+        (void) close(sock);
+    }
+}
+
+
+//
+// Initialize the statistics socket
+//
+// NB: This is called prior to dropping privileges so that the socket may be
+//     created in a privileged directory.
+//
+void initialize_stats(void)
+{
+    struct sockaddr_un          addr;
+    int                         r;
+
+    if (stats_socket_path == NULL)
+    {
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(stats_socket_path) >= sizeof(addr.sun_path))
+    {
+        fatal("statistics socket path %s is too long\n", stats_socket_path);
+    }
+    strcpy(addr.sun_path, stats_socket_path);
+
+    stats_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (stats_sock == -1)
+    {
+        fatal("socket for statistics failed: %s\n", strerror(errno));
+    }
+
+    // Remove a stale socket from a previous instance
+    (void) unlink(stats_socket_path);
+
+    r = bind(stats_sock, (struct sockaddr *) &addr, sizeof(addr));
+    if (r == -1)
+    {
+        fatal("bind of statistics socket %s failed: %s\n", stats_socket_path, strerror(errno));
+    }
+
+    r = listen(stats_sock, 4);
+    if (r == -1)
+    {
+        fatal("listen on statistics socket %s failed: %s\n", stats_socket_path, strerror(errno));
+    }
+}
+
+
+//
+// Start the statistics thread
+//
+void start_stats(void)
+{
+    pthread_t                   thread_id;
+    int                         r;
+
+    if (stats_sock == -1)
+    {
+        return;
+    }
+
+    r = pthread_create(&thread_id, NULL, &stats_thread, NULL);
+    if (r != 0)
+    {
+        fatal("cannot create statistics thread: %s\n", strerror(r));
+    }
+}
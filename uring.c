@@ -0,0 +1,844 @@
+
+//
+// Copyright (c) 2024-2026, Denny Page
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+//
+// io_uring dataplane (Linux only)
+//
+// Each bridge instance has an io_uring with a multishot recvmsg armed on
+// the socket of every interface. Received packets land in a ring of
+// provided buffers, and are forwarded by queuing a send to each active
+// outbound peer directly from the receive buffer. The buffer is returned
+// to the kernel once all of its sends have completed. Large packets are
+// sent with zero copy from the same buffers, which are also registered
+// as a fixed buffer.
+//
+// The completion queue becomes readable when completions are posted, so
+// the ring is added to the bridge worker's event manager as a drain
+// socket, and all sends queued while processing a batch of completions
+// are submitted with a single io_uring_enter.
+//
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "common.h"
+
+#if defined(USE_IO_URING)
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+
+// Ring geometry
+#define URING_SQ_ENTRIES        256
+#define URING_CQ_ENTRIES        1024
+
+// Size of the receive control message area
+#if defined(USE_RXQ_OVFL) || defined(USE_RX_TIMESTAMP)
+# define URING_RECV_CONTROL
+# define URING_CMSG_SIZE        (CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(struct timespec)))
+#else
+# define URING_CMSG_SIZE        0
+#endif
+
+// Provided buffers (count must be a power of 2)
+#define URING_BUFFER_COUNT      64
+#define URING_BUFFER_GROUP      0
+#define URING_PAYLOAD_SIZE      65536
+#define URING_BUFFER_SIZE       (sizeof(struct io_uring_recvmsg_out) + sizeof(socket_address_t) + URING_CMSG_SIZE + URING_PAYLOAD_SIZE)
+
+// Maximum number of sends in flight
+#define URING_SEND_SLOTS        512
+
+// Minimum packet size for zero copy sends
+#define URING_ZEROCOPY_MIN      8192
+
+// Maximum number of completions processed per callback
+#define URING_CQE_BATCH         256
+
+// Maximum number of callbacks per event wait
+#define URING_DRAIN_BUDGET      4
+
+// Completion tags
+#define URING_TAG_RECV          (1ULL << 32)
+#define URING_TAG_SEND          (2ULL << 32)
+#define URING_TAG_MASK          (0xffffffffULL << 32)
+#define URING_TAG_INDEX(data)   ((unsigned int) ((data) & 0xffffffffULL))
+
+
+// Send slot
+typedef struct uring_send
+{
+    bridge_interface_t *        inbound;
+    bridge_interface_t *        peer;
+    socket_address_t            dst_addr;
+    unsigned int                buffer_id;
+    unsigned int                len;
+} uring_send_t;
+
+// io_uring engine structure
+struct uring_engine
+{
+    int                         ring_fd;
+
+    // Submission queue
+    uint8_t *                   sq_map;
+    size_t                      sq_map_size;
+    unsigned int *              sq_head;
+    unsigned int *              sq_tail;
+    unsigned int                sq_mask;
+    unsigned int                sq_entries;
+    struct io_uring_sqe *       sqes;
+    size_t                      sqes_size;
+    unsigned int                sq_local_tail;
+    unsigned int                sq_pending;
+
+    // Completion queue
+    uint8_t *                   cq_map;
+    size_t                      cq_map_size;
+    unsigned int *              cq_head;
+    unsigned int *              cq_tail;
+    unsigned int                cq_mask;
+    struct io_uring_cqe *       cqes;
+
+    // Provided buffers
+    struct io_uring_buf_ring *  buf_ring;
+    size_t                      buf_ring_size;
+    unsigned short              buf_ring_tail;
+    uint8_t *                   buffers;
+    size_t                      buffers_size;
+    unsigned int                buffer_refs[URING_BUFFER_COUNT];
+    unsigned int                buffers_available;
+#if defined(USE_RX_TIMESTAMP)
+    uint64_t                    buffer_rx_time[URING_BUFFER_COUNT];
+#endif
+
+    // Receive message template
+    struct msghdr               recv_msg;
+
+    // Receive armed state of each interface
+    unsigned int *              recv_armed;
+
+    // Send slots
+    uring_send_t                send_list[URING_SEND_SLOTS];
+    unsigned int                send_free[URING_SEND_SLOTS];
+    unsigned int                send_free_count;
+};
+
+
+
+//
+// io_uring system calls
+//
+static int uring_setup(
+    unsigned int                entries,
+    struct io_uring_params *    params)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(
+    int                         ring_fd,
+    unsigned int                to_submit,
+    unsigned int                min_complete,
+    unsigned int                flags)
+{
+    return (int) syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(
+    int                         ring_fd,
+    unsigned int                opcode,
+    void *                      arg,
+    unsigned int                nr_args)
+{
+    return (int) syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+
+//
+// Submit pending submission queue entries
+//
+static void uring_submit(
+    bridge_instance_t *         bridge,
+    struct uring_engine *       engine)
+{
+    int                         r;
+
+    if (engine->sq_pending == 0)
+    {
+        return;
+    }
+
+    __atomic_store_n(engine->sq_tail, engine->sq_local_tail, __ATOMIC_RELEASE);
+    r = uring_enter(engine->ring_fd, engine->sq_pending, 0, 0);
+    if (r == -1)
+    {
+        if (errno != EAGAIN && errno != EBUSY && errno != EINTR)
+        {
+            logger("Bridge(%s/%u): io_uring_enter error: %s\n",
+                AF_FAMILY_TO_STRING(bridge->family), bridge->port, strerror(errno));
+        }
+        return;
+    }
+    engine->sq_pending -= (unsigned int) r;
+}
+
+
+//
+// Get a free submission queue entry
+//
+// Returns NULL if the submission queue is full
+//
+static struct io_uring_sqe * uring_get_sqe(
+    bridge_instance_t *         bridge,
+    struct uring_engine *       engine)
+{
+    struct io_uring_sqe *       sqe;
+
+    // If the submission queue is full, submit what is pending
+    if (engine->sq_local_tail - __atomic_load_n(engine->sq_head, __ATOMIC_ACQUIRE) >= engine->sq_entries)
+    {
+        uring_submit(bridge, engine);
+        if (engine->sq_local_tail - __atomic_load_n(engine->sq_head, __ATOMIC_ACQUIRE) >= engine->sq_entries)
+        {
+            return NULL;
+        }
+    }
+
+    sqe = &engine->sqes[engine->sq_local_tail & engine->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    engine->sq_local_tail += 1;
+    engine->sq_pending += 1;
+
+    return sqe;
+}
+
+
+//
+// Return a buffer to the provided buffer ring
+//
+static void uring_recycle_buffer(
+    struct uring_engine *       engine,
+    unsigned int                buffer_id)
+{
+    struct io_uring_buf *       buf;
+
+    buf = &engine->buf_ring->bufs[engine->buf_ring_tail & (URING_BUFFER_COUNT - 1)];
+    buf->addr = (uint64_t) (uintptr_t) (engine->buffers + buffer_id * URING_BUFFER_SIZE);
+    buf->len = URING_BUFFER_SIZE;
+    buf->bid = (uint16_t) buffer_id;
+
+    engine->buf_ring_tail += 1;
+    __atomic_store_n(&engine->buf_ring->tail, engine->buf_ring_tail, __ATOMIC_RELEASE);
+    engine->buffers_available += 1;
+}
+
+
+//
+// Release a reference to a receive buffer
+//
+static void uring_release_buffer(
+    struct uring_engine *       engine,
+    unsigned int                buffer_id)
+{
+    engine->buffer_refs[buffer_id] -= 1;
+    if (engine->buffer_refs[buffer_id] == 0)
+    {
+        uring_recycle_buffer(engine, buffer_id);
+    }
+}
+
+
+//
+// Arm the multishot receive on an interface
+//
+static void uring_arm_receive(
+    bridge_instance_t *         bridge,
+    struct uring_engine *       engine,
+    unsigned int                interface_index)
+{
+    struct io_uring_sqe *       sqe;
+
+    sqe = uring_get_sqe(bridge, engine);
+    if (sqe == NULL)
+    {
+        return;
+    }
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = bridge->interface_list[interface_index]->sock;
+    sqe->addr = (uint64_t) (uintptr_t) &engine->recv_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = URING_TAG_RECV | interface_index;
+
+    engine->recv_armed[interface_index] = 1;
+}
+
+
+//
+// Queue a send of a receive buffer to a peer
+//
+static void uring_queue_send(
+    bridge_instance_t *         bridge,
+    struct uring_engine *       engine,
+    bridge_interface_t *        inbound,
+    bridge_interface_t *        peer,
+    unsigned int                buffer_id,
+    const uint8_t *             payload,
+    unsigned int                len)
+{
+    struct io_uring_sqe *       sqe;
+    uring_send_t *              send;
+    unsigned int                slot;
+
+    if (engine->send_free_count == 0)
+    {
+        if (debug_level >= 4)
+        {
+            log_packet(LOG_EVENT_DROPPED_NO_SEND_SLOTS, bridge, NULL, peer->name, NULL, len, 0);
+        }
+        COUNTER_ADD(peer->counters->tx_dropped, 1);
+        return;
+    }
+
+    sqe = uring_get_sqe(bridge, engine);
+    if (sqe == NULL)
+    {
+        if (debug_level >= 4)
+        {
+            log_packet(LOG_EVENT_DROPPED_QUEUE_FULL, bridge, NULL, peer->name, NULL, len, 0);
+        }
+        COUNTER_ADD(peer->counters->tx_dropped, 1);
+        return;
+    }
+
+    // Allocate a send slot
+    engine->send_free_count -= 1;
+    slot = engine->send_free[engine->send_free_count];
+    send = &engine->send_list[slot];
+    send->inbound = inbound;
+    send->peer = peer;
+    send->buffer_id = buffer_id;
+    send->len = len;
+    memcpy(&send->dst_addr, &bridge->dst_addr, sizeof(send->dst_addr));
+    if (bridge->family == AF_INET6)
+    {
+        send->dst_addr.sin6.sin6_scope_id = peer->if_index;
+    }
+
+    // Large packets are sent from the fixed buffer without copying
+    if (len >= URING_ZEROCOPY_MIN)
+    {
+        sqe->opcode = IORING_OP_SEND_ZC;
+        sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = 0;
+    }
+    else
+    {
+        sqe->opcode = IORING_OP_SEND;
+    }
+    sqe->fd = peer->sock;
+    sqe->addr = (uint64_t) (uintptr_t) payload;
+    sqe->len = len;
+    sqe->addr2 = (uint64_t) (uintptr_t) &send->dst_addr;
+    sqe->addr_len = (uint16_t) bridge->dst_addr_len;
+    sqe->user_data = URING_TAG_SEND | slot;
+
+    engine->buffer_refs[buffer_id] += 1;
+}
+
+
+#if defined(URING_RECV_CONTROL)
+//
+// Process the control messages of a received packet
+//
+// Updates the kernel drop count of the interface and records the kernel
+// receive timestamp of the buffer
+//
+static void uring_receive_control(
+    struct uring_engine *       engine,
+    bridge_interface_t *        inbound,
+    unsigned int                buffer_id,
+    struct io_uring_recvmsg_out * out)
+{
+    struct msghdr               msg;
+    struct cmsghdr *            cmsg;
+#if defined(USE_RXQ_OVFL)
+    uint32_t                    drops;
+#endif
+#if defined(USE_RX_TIMESTAMP)
+    struct timespec             ts;
+
+    engine->buffer_rx_time[buffer_id] = 0;
+#else
+    (void) buffer_id;
+#endif
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = (uint8_t *) (out + 1) + engine->recv_msg.msg_namelen;
+    msg.msg_controllen = out->controllen;
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET)
+        {
+            continue;
+        }
+#if defined(USE_RXQ_OVFL)
+        if (cmsg->cmsg_type == SO_RXQ_OVFL)
+        {
+            memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+            COUNTER_SET(inbound->counters->rx_overflow, drops);
+        }
+#endif
+#if defined(USE_RX_TIMESTAMP)
+        if (cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            engine->buffer_rx_time[buffer_id] = (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+        }
+#endif
+    }
+}
+#endif
+
+
+//
+// Process a receive completion
+//
+static void uring_receive_complete(
+    bridge_instance_t *         bridge,
+    struct uring_engine *       engine,
+    struct io_uring_cqe *       cqe)
+{
+    unsigned int                interface_index = URING_TAG_INDEX(cqe->user_data);
+    bridge_interface_t *        inbound = bridge->interface_list[interface_index];
+    struct io_uring_recvmsg_out * out;
+    const bridge_fanout_t *     fanout;
+    const socket_address_t *    src_addr;
+    const void *                src;
+    bridge_interface_t *        peer;
+    const uint8_t *             payload;
+    unsigned int                peer_index;
+    unsigned int                buffer_id;
+
+    // Has the multishot receive terminated?
+    if ((cqe->flags & IORING_CQE_F_MORE) == 0)
+    {
+        engine->recv_armed[interface_index] = 0;
+    }
+
+    if (cqe->res < 0)
+    {
+        // NB: Receives are armed again once buffers have been returned
+        if (cqe->res != -ENOBUFS)
+        {
+            logger("Bridge(%s/%u): io_uring recvmsg error on interface %s: %s\n",
+                AF_FAMILY_TO_STRING(bridge->family), bridge->port,
+                inbound->name, strerror(-cqe->res));
+            COUNTER_ADD(inbound->counters->rx_errors, 1);
+        }
+        return;
+    }
+
+    if ((cqe->flags & IORING_CQE_F_BUFFER) == 0)
+    {
+        return;
+    }
+    buffer_id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    engine->buffers_available -= 1;
+
+    // Hold a reference while the sends are queued
+    engine->buffer_refs[buffer_id] = 1;
+
+    out = (struct io_uring_recvmsg_out *) (engine->buffers + buffer_id * URING_BUFFER_SIZE);
+    src_addr = (const socket_address_t *) (out + 1);
+    payload = (const uint8_t *) (out + 1) + engine->recv_msg.msg_namelen + engine->recv_msg.msg_controllen;
+
+#if defined(URING_RECV_CONTROL)
+    uring_receive_control(engine, inbound, buffer_id, out);
+#endif
+
+    if (out->flags & MSG_TRUNC)
+    {
+        COUNTER_ADD(inbound->counters->rx_errors, 1);
+        uring_release_buffer(engine, buffer_id);
+        return;
+    }
+    COUNTER_ADD(inbound->counters->rx_packets, 1);
+    COUNTER_ADD(inbound->counters->rx_bytes, out->payloadlen);
+
+    fanout = inbound->fanout;
+    if (fanout->peer_count == 0)
+    {
+        if (__atomic_load_n(&inbound->inbound_active, __ATOMIC_RELAXED) == 0)
+        {
+            COUNTER_ADD(inbound->counters->rx_inactive, 1);
+        }
+        else
+        {
+            COUNTER_ADD(inbound->counters->rx_no_outbound, 1);
+        }
+    }
+    src = bridge->family == AF_INET ? (const void *) &src_addr->sin.sin_addr : (const void *) &src_addr->sin6.sin6_addr;
+    for (peer_index = 0; peer_index < fanout->peer_count; peer_index++)
+    {
+        peer = fanout->peer_list[peer_index];
+
+        // Drop packets from sources the peer's listeners have not asked for
+        if (peer->source_filter[0] && interface_source_allowed(peer->source_filter[0], src) == 0)
+        {
+            COUNTER_ADD(peer->counters->tx_filtered, 1);
+            continue;
+        }
+        uring_queue_send(bridge, engine, inbound, peer, buffer_id, payload, out->payloadlen);
+    }
+
+    uring_release_buffer(engine, buffer_id);
+}
+
+
+//
+// Process a send completion
+//
+static void uring_send_complete(
+    bridge_instance_t *         bridge,
+    struct uring_engine *       engine,
+    struct io_uring_cqe *       cqe)
+{
+    unsigned int                slot = URING_TAG_INDEX(cqe->user_data);
+    uring_send_t *              send = &engine->send_list[slot];
+    struct io_uring_recvmsg_out * out;
+    socket_address_t *          src_addr;
+
+    // Zero copy sends post a notification when the buffer is no longer in use
+    if ((cqe->flags & IORING_CQE_F_NOTIF) == 0)
+    {
+        if (cqe->res < 0)
+        {
+            if (cqe->res == -ENOBUFS || cqe->res == -EAGAIN)
+            {
+                COUNTER_ADD(send->peer->counters->tx_nobufs, 1);
+            }
+            else
+            {
+                COUNTER_ADD(send->peer->counters->tx_errors, 1);
+            }
+
+            if (cqe->res != -ENETDOWN)
+            {
+                logger("Bridge(%s/%u): io_uring send error on interface %s: %s\n",
+                    AF_FAMILY_TO_STRING(bridge->family), bridge->port,
+                    send->peer->name, strerror(-cqe->res));
+            }
+        }
+        else
+        {
+            COUNTER_ADD(send->peer->counters->tx_packets, 1);
+            COUNTER_ADD(send->peer->counters->tx_bytes, send->len);
+#if defined(USE_RX_TIMESTAMP)
+            latency_record(bridge->latency, engine->buffer_rx_time[send->buffer_id], latency_now());
+#endif
+        }
+
+        if (cqe->res >= 0 && debug_level >= 4)
+        {
+            out = (struct io_uring_recvmsg_out *) (engine->buffers + send->buffer_id * URING_BUFFER_SIZE);
+            src_addr = (socket_address_t *) (out + 1);
+            log_packet(LOG_EVENT_FORWARDED, bridge, send->inbound->name, send->peer->name,
+                bridge->family == AF_INET ? (const void *) &src_addr->sin.sin_addr : (const void *) &src_addr->sin6.sin6_addr,
+                send->len, 0);
+        }
+
+        // Wait for the notification if one will follow
+        if (cqe->flags & IORING_CQE_F_MORE)
+        {
+            return;
+        }
+    }
+
+    // Release the slot and the buffer
+    uring_release_buffer(engine, send->buffer_id);
+    engine->send_free[engine->send_free_count] = slot;
+    engine->send_free_count += 1;
+}
+
+
+//
+// Process completions
+//
+// Returns non-zero if more completions may be waiting
+//
+static unsigned int uring_receive(
+    void *                      arg)
+{
+    bridge_instance_t *         bridge = arg;
+    struct uring_engine *       engine = bridge->uring;
+    struct io_uring_cqe *       cqe;
+    unsigned int                head;
+    unsigned int                tail;
+    unsigned int                count = 0;
+    unsigned int                interface_index;
+
+    head = *engine->cq_head;
+    tail = __atomic_load_n(engine->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail && count < URING_CQE_BATCH)
+    {
+        cqe = &engine->cqes[head & engine->cq_mask];
+        switch (cqe->user_data & URING_TAG_MASK)
+        {
+            case URING_TAG_RECV:
+                uring_receive_complete(bridge, engine, cqe);
+                break;
+            case URING_TAG_SEND:
+                uring_send_complete(bridge, engine, cqe);
+                break;
+            default:
+                break;
+        }
+
+        head += 1;
+        count += 1;
+    }
+    __atomic_store_n(engine->cq_head, head, __ATOMIC_RELEASE);
+
+    // Arm receives that have terminated, if buffers are available
+    if (engine->buffers_available)
+    {
+        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+        {
+            if (engine->recv_armed[interface_index] == 0)
+            {
+                uring_arm_receive(bridge, engine, interface_index);
+            }
+        }
+    }
+
+    // Submit the queued sends
+    uring_submit(bridge, engine);
+
+    return count == URING_CQE_BATCH;
+}
+
+
+//
+// Map a region of the ring
+//
+static void * uring_map(
+    int                         ring_fd,
+    size_t                      size,
+    off_t                       offset)
+{
+    void *                      map;
+
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+    if (map == MAP_FAILED)
+    {
+        fatal("Cannot map io_uring: %s\n", strerror(errno));
+    }
+
+    return map;
+}
+
+
+//
+// Create the io_uring engine for a bridge
+//
+void uring_create(
+    bridge_instance_t *         bridge)
+{
+    struct uring_engine *       engine;
+    struct io_uring_params      params;
+    struct io_uring_probe *     probe;
+    struct io_uring_buf_reg     buf_reg;
+    struct iovec                iovec;
+    unsigned int                index;
+    int                         r;
+
+    engine = calloc(1, sizeof(struct uring_engine));
+    if (engine == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+
+    engine->recv_armed = calloc(bridge->interface_count, sizeof(unsigned int));
+    if (engine->recv_armed == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+
+    // Create the ring
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+    params.cq_entries = URING_CQ_ENTRIES;
+    engine->ring_fd = uring_setup(URING_SQ_ENTRIES, &params);
+    if (engine->ring_fd == -1)
+    {
+        fatal("Bridge(%s/%u): io_uring_setup failed: %s\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port, strerror(errno));
+    }
+    if ((params.features & IORING_FEAT_NODROP) == 0)
+    {
+        fatal("Bridge(%s/%u): The io_uring dataplane requires Linux 6.0 or later\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port);
+    }
+
+    // Ensure that zero copy send is supported (multishot recvmsg was added in the same release)
+    probe = calloc(1, sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+    if (probe == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+    r = uring_register(engine->ring_fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST);
+    if (r == -1 || probe->last_op < IORING_OP_SEND_ZC || (probe->ops[IORING_OP_SEND_ZC].flags & IO_URING_OP_SUPPORTED) == 0)
+    {
+        fatal("Bridge(%s/%u): The io_uring dataplane requires Linux 6.0 or later\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port);
+    }
+    free(probe);
+
+    // Map the submission and completion queues
+    engine->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    engine->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (engine->cq_map_size > engine->sq_map_size)
+        {
+            engine->sq_map_size = engine->cq_map_size;
+        }
+        engine->sq_map = uring_map(engine->ring_fd, engine->sq_map_size, IORING_OFF_SQ_RING);
+        engine->cq_map = engine->sq_map;
+    }
+    else
+    {
+        engine->sq_map = uring_map(engine->ring_fd, engine->sq_map_size, IORING_OFF_SQ_RING);
+        engine->cq_map = uring_map(engine->ring_fd, engine->cq_map_size, IORING_OFF_CQ_RING);
+    }
+    engine->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    engine->sqes = uring_map(engine->ring_fd, engine->sqes_size, IORING_OFF_SQES);
+
+    engine->sq_head = (unsigned int *) (engine->sq_map + params.sq_off.head);
+    engine->sq_tail = (unsigned int *) (engine->sq_map + params.sq_off.tail);
+    engine->sq_mask = *(unsigned int *) (engine->sq_map + params.sq_off.ring_mask);
+    engine->sq_entries = params.sq_entries;
+    engine->sq_local_tail = *engine->sq_tail;
+    engine->cq_head = (unsigned int *) (engine->cq_map + params.cq_off.head);
+    engine->cq_tail = (unsigned int *) (engine->cq_map + params.cq_off.tail);
+    engine->cq_mask = *(unsigned int *) (engine->cq_map + params.cq_off.ring_mask);
+    engine->cqes = (struct io_uring_cqe *) (engine->cq_map + params.cq_off.cqes);
+
+    // Submission queue entries are used in ring order
+    for (index = 0; index < params.sq_entries; index++)
+    {
+        ((unsigned int *) (engine->sq_map + params.sq_off.array))[index] = index;
+    }
+
+    // Allocate the buffers and register them as a fixed buffer for zero copy sends
+    engine->buffers_size = URING_BUFFER_COUNT * URING_BUFFER_SIZE;
+    engine->buffers = mmap(NULL, engine->buffers_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (engine->buffers == MAP_FAILED)
+    {
+        fatal("Cannot allocate io_uring buffers: %s\n", strerror(errno));
+    }
+    iovec.iov_base = engine->buffers;
+    iovec.iov_len = engine->buffers_size;
+    r = uring_register(engine->ring_fd, IORING_REGISTER_BUFFERS, &iovec, 1);
+    if (r == -1)
+    {
+        fatal("Bridge(%s/%u): Cannot register io_uring buffers: %s\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port, strerror(errno));
+    }
+
+    // Create and register the provided buffer ring
+    engine->buf_ring_size = URING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    engine->buf_ring = mmap(NULL, engine->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (engine->buf_ring == MAP_FAILED)
+    {
+        fatal("Cannot allocate io_uring buffer ring: %s\n", strerror(errno));
+    }
+    memset(&buf_reg, 0, sizeof(buf_reg));
+    buf_reg.ring_addr = (uint64_t) (uintptr_t) engine->buf_ring;
+    buf_reg.ring_entries = URING_BUFFER_COUNT;
+    buf_reg.bgid = URING_BUFFER_GROUP;
+    r = uring_register(engine->ring_fd, IORING_REGISTER_PBUF_RING, &buf_reg, 1);
+    if (r == -1)
+    {
+        fatal("Bridge(%s/%u): Cannot register io_uring buffer ring: %s\n",
+            AF_FAMILY_TO_STRING(bridge->family), bridge->port, strerror(errno));
+    }
+    for (index = 0; index < URING_BUFFER_COUNT; index++)
+    {
+        uring_recycle_buffer(engine, index);
+    }
+
+    // The receive template holds the source address and control messages ahead of the payload
+    engine->recv_msg.msg_namelen = sizeof(socket_address_t);
+    engine->recv_msg.msg_controllen = URING_CMSG_SIZE;
+
+    // All send slots are free
+    for (index = 0; index < URING_SEND_SLOTS; index++)
+    {
+        engine->send_free[index] = URING_SEND_SLOTS - index - 1;
+    }
+    engine->send_free_count = URING_SEND_SLOTS;
+
+    bridge->uring = engine;
+}
+
+
+//
+// Add the io_uring engine for a bridge to an event manager
+//
+void uring_register_bridge(
+    evm_t *                     evm,
+    bridge_instance_t *         bridge)
+{
+    struct uring_engine *       engine = bridge->uring;
+    unsigned int                interface_index;
+
+    // Arm the receives
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        uring_arm_receive(bridge, engine, interface_index);
+    }
+    uring_submit(bridge, engine);
+
+    evm_add_drain_socket(evm, engine->ring_fd, uring_receive, bridge, URING_DRAIN_BUDGET);
+}
+
+#endif // USE_IO_URING
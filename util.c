@@ -33,6 +33,13 @@
 
 #include "common.h"
 
+#if defined(USE_CSUM_SSE2) || defined(USE_CSUM_AVX2)
+# include <immintrin.h>
+#endif
+#if defined(USE_CSUM_NEON)
+# include <arm_neon.h>
+#endif
+
 
 
 //
@@ -58,36 +65,340 @@ long timespec_delta_millis(
 
 
 //
-// Calculate an internet checksum
+// Add a number of milliseconds to a timespec
 //
-uint16_t inet_csum(
-    const uint16_t *            addr,
-    int                         len)
+void timespec_add_millis(
+    struct timespec *           ts,
+    unsigned int                millis)
+{
+    ts->tv_sec += millis / 1000;
+    ts->tv_nsec += (long) (millis % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_sec += 1;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+
+//
+// Calculate a hash of an address
+//
+// NB: The address length must be a multiple of 4 (IPv4 and IPv6 addresses)
+//
+uint32_t addr_hash(
+    const uint8_t *             addr,
+    unsigned int                len)
 {
-    uint32_t                    sum = 0;
-    uint16_t                    answer;
+    uint32_t                    hash = 0;
+    uint32_t                    word;
+    unsigned int                index;
 
-    // Sum all 16-bit words
-    while (len > 1)
+    for (index = 0; index < len; index += sizeof(word))
     {
-        sum += *addr++;
-        len -= sizeof(*addr);
+        memcpy(&word, addr + index, sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b1;
     }
 
-    // Add the remaining byte, if any
-    if (len == 1)
+    return hash ^ (hash >> 16);
+}
+
+
+//
+// Add data to a partial internet checksum a word at a time
+//
+// The data is summed as 32 bit words in native byte order into a 64 bit
+// accumulator, which defers the end around carries to the fold. The one's
+// complement sum is independent of byte order, so the folded result is in
+// the byte order of the data.
+//
+// NB: The data does not need to be aligned
+//
+static uint64_t inet_csum_partial_word(
+    uint64_t                    sum,
+    const void *                data,
+    unsigned int                len)
+{
+    const uint8_t *             ptr = data;
+    uint32_t                    word[4];
+    uint16_t                    half = 0;
+
+    // Sum 16 bytes at a time
+    while (len >= sizeof(word))
     {
-        sum += *(uint8_t *) addr;
+        memcpy(word, ptr, sizeof(word));
+        sum += (uint64_t) word[0] + word[1] + word[2] + word[3];
+        ptr += sizeof(word);
+        len -= sizeof(word);
     }
 
-    // Add carries from the upper 16 bits to the lower 16 bits
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum += (sum >> 16);
+    // Sum the remaining 32 bit words
+    while (len >= sizeof(word[0]))
+    {
+        memcpy(word, ptr, sizeof(word[0]));
+        sum += word[0];
+        ptr += sizeof(word[0]);
+        len -= sizeof(word[0]);
+    }
 
-    // One's complement
-    answer = (uint16_t) ~sum;
+    // Sum the remaining 16 bit word, and the remaining byte padded with zero
+    if (len >= sizeof(half))
+    {
+        memcpy(&half, ptr, sizeof(half));
+        sum += half;
+        ptr += sizeof(half);
+        len -= sizeof(half);
+    }
+    if (len)
+    {
+        half = 0;
+        memcpy(&half, ptr, 1);
+        sum += half;
+    }
 
-    return answer;
+    return sum;
+}
+
+#if defined(USE_CSUM_SSE2)
+//
+// Add data to a partial internet checksum with SSE2
+//
+// Each 16 byte block is split into two pairs of 32 bit words, which are zero
+// extended and summed into 64 bit lanes. This is the same sum of native 32 bit
+// words as the word at a time version, which finishes the remaining data.
+//
+__attribute__ ((target("sse2")))
+static uint64_t inet_csum_partial_sse2(
+    uint64_t                    sum,
+    const void *                data,
+    unsigned int                len)
+{
+    const uint8_t *             ptr = data;
+    __m128i                     zero = _mm_setzero_si128();
+    __m128i                     acc[2];
+    __m128i                     block;
+    uint64_t                    lane[2];
+
+    acc[0] = zero;
+    acc[1] = zero;
+
+    // Sum 16 bytes at a time
+    while (len >= sizeof(block))
+    {
+        block = _mm_loadu_si128((const __m128i *) ptr);
+        acc[0] = _mm_add_epi64(acc[0], _mm_unpacklo_epi32(block, zero));
+        acc[1] = _mm_add_epi64(acc[1], _mm_unpackhi_epi32(block, zero));
+        ptr += sizeof(block);
+        len -= sizeof(block);
+    }
+
+    // Add the lanes to the sum
+    _mm_storeu_si128((__m128i *) lane, _mm_add_epi64(acc[0], acc[1]));
+    sum += lane[0];
+    sum += lane[1];
+
+    return inet_csum_partial_word(sum, ptr, len);
+}
+#endif
+
+
+#if defined(USE_CSUM_AVX2)
+//
+// Add data to a partial internet checksum with AVX2
+//
+// As for SSE2, with 32 byte blocks.
+//
+__attribute__ ((target("avx2")))
+static uint64_t inet_csum_partial_avx2(
+    uint64_t                    sum,
+    const void *                data,
+    unsigned int                len)
+{
+    const uint8_t *             ptr = data;
+    __m256i                     zero = _mm256_setzero_si256();
+    __m256i                     acc[2];
+    __m256i                     block;
+    __m128i                     total;
+    uint64_t                    lane[2];
+
+    acc[0] = zero;
+    acc[1] = zero;
+
+    // Sum 32 bytes at a time
+    while (len >= sizeof(block))
+    {
+        block = _mm256_loadu_si256((const __m256i *) ptr);
+        acc[0] = _mm256_add_epi64(acc[0], _mm256_unpacklo_epi32(block, zero));
+        acc[1] = _mm256_add_epi64(acc[1], _mm256_unpackhi_epi32(block, zero));
+        ptr += sizeof(block);
+        len -= sizeof(block);
+    }
+
+    // Add the lanes to the sum
+    acc[0] = _mm256_add_epi64(acc[0], acc[1]);
+    total = _mm_add_epi64(_mm256_castsi256_si128(acc[0]), _mm256_extracti128_si256(acc[0], 1));
+    _mm_storeu_si128((__m128i *) lane, total);
+    sum += lane[0];
+    sum += lane[1];
+
+    return inet_csum_partial_word(sum, ptr, len);
+}
+#endif
+
+
+#if defined(USE_CSUM_NEON)
+//
+// Add data to a partial internet checksum with NEON
+//
+// Each 16 byte block is loaded as four 32 bit words, which are added in pairs
+// into 64 bit lanes.
+//
+static uint64_t inet_csum_partial_neon(
+    uint64_t                    sum,
+    const void *                data,
+    unsigned int                len)
+{
+    const uint8_t *             ptr = data;
+    uint64x2_t                  acc[2];
+
+    acc[0] = vdupq_n_u64(0);
+    acc[1] = vdupq_n_u64(0);
+
+    // Sum 32 bytes at a time
+    while (len >= 32)
+    {
+        acc[0] = vpadalq_u32(acc[0], vreinterpretq_u32_u8(vld1q_u8(ptr)));
+        acc[1] = vpadalq_u32(acc[1], vreinterpretq_u32_u8(vld1q_u8(ptr + 16)));
+        ptr += 32;
+        len -= 32;
+    }
+
+    // Add the lanes to the sum
+    acc[0] = vaddq_u64(acc[0], acc[1]);
+    sum += vgetq_lane_u64(acc[0], 0);
+    sum += vgetq_lane_u64(acc[0], 1);
+
+    return inet_csum_partial_word(sum, ptr, len);
+}
+#endif
+
+
+// Checksum implementations, in order of preference
+static const inet_csum_impl_t   inet_csum_impl_table[] =
+{
+#if defined(USE_CSUM_AVX2)
+    { "avx2",                   inet_csum_partial_avx2 },
+#endif
+#if defined(USE_CSUM_SSE2)
+    { "sse2",                   inet_csum_partial_sse2 },
+#endif
+#if defined(USE_CSUM_NEON)
+    { "neon",                   inet_csum_partial_neon },
+#endif
+    { "word",                   inet_csum_partial_word }
+};
+#define INET_CSUM_IMPL_COUNT    (sizeof(inet_csum_impl_table) / sizeof(inet_csum_impl_table[0]))
+
+// The selected checksum implementation
+static const inet_csum_impl_t * inet_csum_impl_selected = &inet_csum_impl_table[INET_CSUM_IMPL_COUNT - 1];
+
+
+//
+// Get a checksum implementation supported by the CPU
+//
+// Returns NULL when the index is past the last supported implementation. The
+// first implementation is the preferred one.
+//
+const inet_csum_impl_t * inet_csum_impl(
+    unsigned int                index)
+{
+    const inet_csum_impl_t *    impl;
+    unsigned int                table_index;
+
+    for (table_index = 0; table_index < INET_CSUM_IMPL_COUNT; table_index++)
+    {
+        impl = &inet_csum_impl_table[table_index];
+
+#if defined(USE_CSUM_AVX2)
+        if (impl->partial == inet_csum_partial_avx2 && !__builtin_cpu_supports("avx2"))
+        {
+            continue;
+        }
+#endif
+#if defined(USE_CSUM_SSE2)
+        if (impl->partial == inet_csum_partial_sse2 && !__builtin_cpu_supports("sse2"))
+        {
+            continue;
+        }
+#endif
+
+        if (index == 0)
+        {
+            return impl;
+        }
+        index -= 1;
+    }
+
+    return NULL;
+}
+
+
+//
+// Select the checksum implementation
+//
+// NB: This must be called before any other threads are started
+//
+void inet_csum_select(
+    const inet_csum_impl_t *    impl)
+{
+    inet_csum_impl_selected = impl;
+}
+
+
+//
+// Select the preferred checksum implementation supported by the CPU
+//
+void initialize_inet_csum(void)
+{
+    inet_csum_select(inet_csum_impl(0));
+}
+
+
+//
+// Add data to a partial internet checksum
+//
+uint64_t inet_csum_partial(
+    uint64_t                    sum,
+    const void *                data,
+    unsigned int                len)
+{
+    return inet_csum_impl_selected->partial(sum, data, len);
+}
+
+
+//
+// Fold a partial internet checksum into 16 bits
+//
+uint16_t inet_csum_fold(
+    uint64_t                    sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+
+    return (uint16_t) sum;
+}
+
+
+//
+// Calculate an internet checksum
+//
+uint16_t inet_csum(
+    const uint16_t *            addr,
+    int                         len)
+{
+    return (uint16_t) ~inet_csum_fold(inet_csum_partial(0, addr, (unsigned int) len));
 }
 
 
@@ -101,55 +412,27 @@ uint16_t inet6_csum(
     const uint16_t *            dst_addr,
     uint8_t                     next_header)
 {
-    uint32_t                    sum = 0;
-    uint16_t                    answer;
-    unsigned int                i;
+    uint64_t                    sum;
     struct {
         uint32_t                length;
         uint8_t                 zero[3];
         uint8_t                 next_header;
     } pseudo_header;
 
-    // First, the 16 half words of source and destination address
-    for (i = 0; i < 8; i++)
-    {
-        sum += (src_addr)[i];
-    }
-    for (i = 0; i < 8; i++)
-    {
-        sum += (dst_addr)[i];
-    }
+    // First, the source and destination address
+    sum = inet_csum_partial(0, src_addr, 16);
+    sum = inet_csum_partial(sum, dst_addr, 16);
 
-    // Then, the remaining 4 half words of the pseudo header
+    // Then, the length and next header
     memset(&pseudo_header, 0, sizeof(pseudo_header));
     pseudo_header.length = htonl(len);
     pseudo_header.next_header = next_header;
-    for (i = 0; i < 4; i++)
-    {
-        sum += ((uint16_t *)&pseudo_header)[i];
-    }
-
-    // Sum all 16-bit words
-    while (len > 1)
-    {
-        sum += *addr++;
-        len -= sizeof(*addr);
-    }
-
-    // Add the remaining byte, if any
-    if (len == 1)
-    {
-        sum += *(uint8_t *) addr;
-    }
-
-    // Add carries from the upper 16 bits to the lower 16 bits
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum += (sum >> 16);
+    sum = inet_csum_partial(sum, &pseudo_header, sizeof(pseudo_header));
 
-    // One's complement
-    answer = (uint16_t) ~sum;
+    // Finally, the data
+    sum = inet_csum_partial(sum, addr, (unsigned int) len);
 
-    return answer;
+    return (uint16_t) ~inet_csum_fold(sum);
 }
 
 
@@ -0,0 +1,912 @@
+//
+// Copyright (c) 2024-2026, Denny Page
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+// PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+// TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+
+
+//
+// XDP redirect dataplane (Linux only)
+//
+// An XDP program attached to each interface of an XDP bridge matches the
+// group and UDP port of the bridges the interface belongs to, and
+// broadcasts matching frames to a device map that mirrors the fanout list
+// of the interface in the bridge. An egress program attached to each
+// device map entry rewrites the Ethernet source, IP source and TTL/hop
+// limit for the egress interface.
+//
+// Frames the XDP program cannot handle (IPv4 options or fragments, IPv6
+// extension headers) are passed to the kernel stack, where they are
+// forwarded by the bridge's socket dataplane as usual.
+//
+// The programs are generated at startup with the bridge parameters as
+// immediate values and loaded with the bpf system call, so no BPF
+// toolchain or library is required.
+//
+
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "common.h"
+
+#if defined(USE_XDP)
+
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+
+#include "protocols.h"
+
+
+// Maximum number of instructions in a generated program
+#define XDP_MAX_INSNS           4096
+
+// Maximum number of forward jumps to the pass label
+#define XDP_MAX_PASS_JUMPS      64
+
+// Size of the verifier log buffer
+#define XDP_LOG_SIZE            (1 << 16)
+
+// License of the generated programs
+#define XDP_LICENSE             "Dual BSD/GPL"
+
+// XDP metadata offsets (struct xdp_md)
+#define XDP_MD_DATA             offsetof(struct xdp_md, data)
+#define XDP_MD_DATA_END         offsetof(struct xdp_md, data_end)
+#define XDP_MD_EGRESS_IFINDEX   offsetof(struct xdp_md, egress_ifindex)
+
+// Frame offsets
+#define ETH_LEN                 sizeof(mcb_ethernet_t)
+#define IP4_OFFSET(field)       (ETH_LEN + offsetof(mcb_ip4_t, field))
+#define IP6_OFFSET(field)       (ETH_LEN + offsetof(mcb_ip6_t, field))
+#define UDP4_OFFSET(field)      (ETH_LEN + sizeof(mcb_ip4_t) + offsetof(mcb_udp_t, field))
+#define UDP6_OFFSET(field)      (ETH_LEN + sizeof(mcb_ip6_t) + offsetof(mcb_udp_t, field))
+#define UDP4_FRAME_MIN          (ETH_LEN + sizeof(mcb_ip4_t) + sizeof(mcb_udp_t))
+#define UDP6_FRAME_MIN          (ETH_LEN + sizeof(mcb_ip6_t) + sizeof(mcb_udp_t))
+
+// Instruction encoding
+#define XDP_INSN(CODE, DST, SRC, OFF, IMM) \
+    ((struct bpf_insn) { .code = (CODE), .dst_reg = (DST), .src_reg = (SRC), .off = (OFF), .imm = (IMM) })
+#define XDP_MOV64_REG(DST, SRC)             XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, DST, SRC, 0, 0)
+#define XDP_MOV64_IMM(DST, IMM)             XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, DST, 0, 0, IMM)
+#define XDP_MOV32_REG(DST, SRC)             XDP_INSN(BPF_ALU | BPF_MOV | BPF_X, DST, SRC, 0, 0)
+#define XDP_ALU64_IMM(OP, DST, IMM)         XDP_INSN(BPF_ALU64 | (OP) | BPF_K, DST, 0, 0, IMM)
+#define XDP_ALU64_REG(OP, DST, SRC)         XDP_INSN(BPF_ALU64 | (OP) | BPF_X, DST, SRC, 0, 0)
+#define XDP_LDX_MEM(SIZE, DST, SRC, OFF)    XDP_INSN(BPF_LDX | (SIZE) | BPF_MEM, DST, SRC, OFF, 0)
+#define XDP_STX_MEM(SIZE, DST, SRC, OFF)    XDP_INSN(BPF_STX | (SIZE) | BPF_MEM, DST, SRC, OFF, 0)
+#define XDP_ST_MEM(SIZE, DST, OFF, IMM)     XDP_INSN(BPF_ST | (SIZE) | BPF_MEM, DST, 0, OFF, IMM)
+#define XDP_JMP32_IMM(OP, DST, IMM, OFF)    XDP_INSN(BPF_JMP32 | (OP) | BPF_K, DST, 0, OFF, IMM)
+#define XDP_JMP_IMM(OP, DST, IMM, OFF)      XDP_INSN(BPF_JMP | (OP) | BPF_K, DST, 0, OFF, IMM)
+#define XDP_JMP_REG(OP, DST, SRC, OFF)      XDP_INSN(BPF_JMP | (OP) | BPF_X, DST, SRC, OFF, 0)
+#define XDP_JA(OFF)                         XDP_INSN(BPF_JMP | BPF_JA, 0, 0, OFF, 0)
+#define XDP_CALL(FUNC)                      XDP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, FUNC)
+#define XDP_EXIT()                          XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+#define XDP_LD_IMM64_LO(DST, SRC, IMM)      XDP_INSN(BPF_LD | BPF_DW | BPF_IMM, DST, SRC, 0, IMM)
+#define XDP_LD_IMM64_HI(IMM)                XDP_INSN(0, 0, 0, 0, IMM)
+
+// Redirect flags
+#define XDP_REDIRECT_FLAGS      BPF_F_BROADCAST
+
+
+// Program builder
+typedef struct
+{
+    struct bpf_insn             insns[XDP_MAX_INSNS];
+    unsigned int                count;
+
+    // Forward jumps to the pass label
+    unsigned int                pass_jumps[XDP_MAX_PASS_JUMPS];
+    unsigned int                pass_jump_count;
+} xdp_program_t;
+
+// Device map value
+typedef struct
+{
+    uint32_t                    ifindex;
+    int32_t                     prog_fd;
+} xdp_devmap_value_t;
+
+// Egress map value
+typedef struct
+{
+    uint8_t                     mac_addr[MCB_ETH_ADDR_LEN];
+    uint8_t                     pad[2];
+    uint8_t                     ipv4_addr[MCB_IP4_ADDR_LEN];
+    uint8_t                     ipv6_addr[MCB_IP6_ADDR_LEN];
+} xdp_egress_value_t;
+
+#define XDP_EGRESS_MAC          offsetof(xdp_egress_value_t, mac_addr)
+#define XDP_EGRESS_IPV4         offsetof(xdp_egress_value_t, ipv4_addr)
+#define XDP_EGRESS_IPV6         offsetof(xdp_egress_value_t, ipv6_addr)
+
+
+// Egress map and program
+static int                      xdp_egress_map_fd = -1;
+static int                      xdp_egress_prog_fd = -1;
+
+
+
+//
+// Call the bpf system call
+//
+static int xdp_bpf(
+    enum bpf_cmd                cmd,
+    union bpf_attr *            attr)
+{
+    return (int) syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+
+//
+// Create a map
+//
+static int xdp_create_map(
+    enum bpf_map_type           map_type,
+    unsigned int                key_size,
+    unsigned int                value_size,
+    unsigned int                max_entries,
+    const char *                name)
+{
+    union bpf_attr              attr;
+    int                         fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = map_type;
+    attr.key_size = key_size;
+    attr.value_size = value_size;
+    attr.max_entries = max_entries;
+    strncpy(attr.map_name, name, sizeof(attr.map_name) - 1);
+
+    fd = xdp_bpf(BPF_MAP_CREATE, &attr);
+    if (fd == -1)
+    {
+        fatal("Cannot create XDP map %s: %s\n", name, strerror(errno));
+    }
+
+    return fd;
+}
+
+
+//
+// Update a map element
+//
+static int xdp_map_update(
+    int                         map_fd,
+    const void *                key,
+    const void *                value)
+{
+    union bpf_attr              attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = map_fd;
+    attr.key = (uint64_t) (uintptr_t) key;
+    attr.value = (uint64_t) (uintptr_t) value;
+    attr.flags = BPF_ANY;
+
+    return xdp_bpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+
+//
+// Delete a map element
+//
+static int xdp_map_delete(
+    int                         map_fd,
+    const void *                key)
+{
+    union bpf_attr              attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = map_fd;
+    attr.key = (uint64_t) (uintptr_t) key;
+
+    return xdp_bpf(BPF_MAP_DELETE_ELEM, &attr);
+}
+
+
+//
+// Add an instruction to a program
+//
+static unsigned int xdp_emit(
+    xdp_program_t *             program,
+    struct bpf_insn             insn)
+{
+    if (program->count >= XDP_MAX_INSNS)
+    {
+        fatal("XDP program exceeds maximum size (%u instructions)\n", XDP_MAX_INSNS);
+    }
+
+    program->insns[program->count] = insn;
+    program->count += 1;
+
+    return program->count - 1;
+}
+
+
+//
+// Add a conditional jump to the pass label
+//
+static void xdp_emit_pass_jump(
+    xdp_program_t *             program,
+    struct bpf_insn             insn)
+{
+    if (program->pass_jump_count >= XDP_MAX_PASS_JUMPS)
+    {
+        fatal("XDP program exceeds maximum pass jumps (%u)\n", XDP_MAX_PASS_JUMPS);
+    }
+
+    program->pass_jumps[program->pass_jump_count] = xdp_emit(program, insn);
+    program->pass_jump_count += 1;
+}
+
+
+//
+// Add the instructions to load a map reference
+//
+static void xdp_emit_ld_map_fd(
+    xdp_program_t *             program,
+    unsigned int                reg,
+    int                         map_fd)
+{
+    xdp_emit(program, XDP_LD_IMM64_LO(reg, BPF_PSEUDO_MAP_FD, map_fd));
+    xdp_emit(program, XDP_LD_IMM64_HI(0));
+}
+
+
+//
+// Resolve a forward jump to the current position
+//
+static void xdp_resolve_jump(
+    xdp_program_t *             program,
+    unsigned int                index)
+{
+    program->insns[index].off = (int16_t) (program->count - index - 1);
+}
+
+
+//
+// Add the pass label (return XDP_PASS) and resolve the jumps to it
+//
+static void xdp_emit_pass(
+    xdp_program_t *             program)
+{
+    unsigned int                index;
+
+    for (index = 0; index < program->pass_jump_count; index++)
+    {
+        xdp_resolve_jump(program, program->pass_jumps[index]);
+    }
+    program->pass_jump_count = 0;
+
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_0, XDP_PASS));
+    xdp_emit(program, XDP_EXIT());
+}
+
+
+//
+// Fold the checksum in r0 and complement it
+//
+static void xdp_emit_csum_fold(
+    xdp_program_t *             program)
+{
+    xdp_emit(program, XDP_MOV32_REG(BPF_REG_0, BPF_REG_0));
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_1, BPF_REG_0));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_RSH, BPF_REG_1, 16));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_AND, BPF_REG_0, 0xffff));
+    xdp_emit(program, XDP_ALU64_REG(BPF_ADD, BPF_REG_0, BPF_REG_1));
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_1, BPF_REG_0));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_RSH, BPF_REG_1, 16));
+    xdp_emit(program, XDP_ALU64_REG(BPF_ADD, BPF_REG_0, BPF_REG_1));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_AND, BPF_REG_0, 0xffff));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_XOR, BPF_REG_0, 0xffff));
+}
+
+
+//
+// Incrementally update the UDP checksum at csum_offset in the frame (r7)
+// for a change of source address from the frame to the egress value (r8)
+//
+static void xdp_emit_udp_csum_update(
+    xdp_program_t *             program,
+    unsigned int                csum_offset,
+    unsigned int                src_offset,
+    unsigned int                value_offset,
+    unsigned int                addr_len)
+{
+    // Seed with the complement of the current checksum
+    xdp_emit(program, XDP_LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_7, csum_offset));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_XOR, BPF_REG_5, 0xffff));
+
+    // Calculate the difference
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_1, BPF_REG_7));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_ADD, BPF_REG_1, src_offset));
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_2, addr_len));
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_3, BPF_REG_8));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_ADD, BPF_REG_3, value_offset));
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_4, addr_len));
+    xdp_emit(program, XDP_CALL(BPF_FUNC_csum_diff));
+    xdp_emit_csum_fold(program);
+
+    // A computed UDP checksum of zero is transmitted as all ones
+    xdp_emit(program, XDP_JMP32_IMM(BPF_JNE, BPF_REG_0, 0, 1));
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_0, 0xffff));
+    xdp_emit(program, XDP_STX_MEM(BPF_H, BPF_REG_7, BPF_REG_0, csum_offset));
+}
+
+
+//
+// Copy bytes from the egress value (r8) to the frame (r7)
+//
+static void xdp_emit_copy(
+    xdp_program_t *             program,
+    unsigned int                frame_offset,
+    unsigned int                value_offset,
+    unsigned int                len)
+{
+    unsigned int                index;
+
+    for (index = 0; index < len; index += 2)
+    {
+        xdp_emit(program, XDP_LDX_MEM(BPF_H, BPF_REG_4, BPF_REG_8, value_offset + index));
+        xdp_emit(program, XDP_STX_MEM(BPF_H, BPF_REG_7, BPF_REG_4, frame_offset + index));
+    }
+}
+
+
+//
+// Load a program
+//
+static int xdp_load_program(
+    xdp_program_t *             program,
+    enum bpf_attach_type        attach_type,
+    const char *                name)
+{
+    union bpf_attr              attr;
+    char *                      log_buf;
+    int                         fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.expected_attach_type = attach_type;
+    attr.insns = (uint64_t) (uintptr_t) program->insns;
+    attr.insn_cnt = program->count;
+    attr.license = (uint64_t) (uintptr_t) XDP_LICENSE;
+    strncpy(attr.prog_name, name, sizeof(attr.prog_name) - 1);
+
+    fd = xdp_bpf(BPF_PROG_LOAD, &attr);
+    if (fd != -1)
+    {
+        return fd;
+    }
+
+    // Load again with the verifier log to report the failure
+    log_buf = calloc(1, XDP_LOG_SIZE);
+    if (log_buf)
+    {
+        attr.log_level = 1;
+        attr.log_size = XDP_LOG_SIZE;
+        attr.log_buf = (uint64_t) (uintptr_t) log_buf;
+        (void) xdp_bpf(BPF_PROG_LOAD, &attr);
+        logger("XDP verifier log for %s:\n%s\n", name, log_buf);
+    }
+    fatal("Cannot load XDP program %s: %s\n", name, strerror(errno));
+}
+
+
+//
+// Build and load the egress program
+//
+// The egress program runs for each device map entry, and rewrites frames
+// for the egress interface using the egress map.
+//
+// Registers:
+//   r6: context
+//   r7: frame data
+//   r8: egress map value
+//
+static int xdp_load_egress_program(void)
+{
+    xdp_program_t *             program;
+    unsigned int                jump_v6;
+    unsigned int                jump_no_csum;
+    int                         fd;
+
+    program = calloc(1, sizeof(xdp_program_t));
+    if (program == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+
+    // Look up the egress interface
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_6, BPF_REG_1));
+    xdp_emit(program, XDP_LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_6, XDP_MD_EGRESS_IFINDEX));
+    xdp_emit(program, XDP_STX_MEM(BPF_W, BPF_REG_10, BPF_REG_2, -4));
+    xdp_emit_ld_map_fd(program, BPF_REG_1, xdp_egress_map_fd);
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_2, BPF_REG_10));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_ADD, BPF_REG_2, -4));
+    xdp_emit(program, XDP_CALL(BPF_FUNC_map_lookup_elem));
+    xdp_emit_pass_jump(program, XDP_JMP_IMM(BPF_JEQ, BPF_REG_0, 0, 0));
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_8, BPF_REG_0));
+
+    // Ensure the frame holds at least an Ethernet, IPv4 and UDP header
+    xdp_emit(program, XDP_LDX_MEM(BPF_W, BPF_REG_7, BPF_REG_6, XDP_MD_DATA));
+    xdp_emit(program, XDP_LDX_MEM(BPF_W, BPF_REG_3, BPF_REG_6, XDP_MD_DATA_END));
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_4, BPF_REG_7));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_ADD, BPF_REG_4, UDP4_FRAME_MIN));
+    xdp_emit_pass_jump(program, XDP_JMP_REG(BPF_JGT, BPF_REG_4, BPF_REG_3, 0));
+
+    // Ethernet source
+    xdp_emit_copy(program, offsetof(mcb_ethernet_t, src), XDP_EGRESS_MAC, MCB_ETH_ADDR_LEN);
+
+    // Ethernet type
+    xdp_emit(program, XDP_LDX_MEM(BPF_H, BPF_REG_4, BPF_REG_7, offsetof(mcb_ethernet_t, type)));
+    jump_v6 = xdp_emit(program, XDP_JMP32_IMM(BPF_JEQ, BPF_REG_4, htons(MCB_ETHERNET_TYPE_IP6), 0));
+    xdp_emit_pass_jump(program, XDP_JMP32_IMM(BPF_JNE, BPF_REG_4, htons(MCB_ETHERNET_TYPE_IP4), 0));
+
+    // IPv4: Update the UDP checksum if present
+    xdp_emit(program, XDP_LDX_MEM(BPF_H, BPF_REG_4, BPF_REG_7, UDP4_OFFSET(csum)));
+    jump_no_csum = xdp_emit(program, XDP_JMP32_IMM(BPF_JEQ, BPF_REG_4, 0, 0));
+    xdp_emit_udp_csum_update(program, UDP4_OFFSET(csum), IP4_OFFSET(src), XDP_EGRESS_IPV4, MCB_IP4_ADDR_LEN);
+    xdp_resolve_jump(program, jump_no_csum);
+
+    // IPv4: Source address and TTL
+    xdp_emit_copy(program, IP4_OFFSET(src), XDP_EGRESS_IPV4, MCB_IP4_ADDR_LEN);
+    xdp_emit(program, XDP_ST_MEM(BPF_B, BPF_REG_7, IP4_OFFSET(ttl), 1));
+
+    // IPv4: Recalculate the header checksum
+    xdp_emit(program, XDP_ST_MEM(BPF_H, BPF_REG_7, IP4_OFFSET(csum), 0));
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_1, 0));
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_2, 0));
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_3, BPF_REG_7));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_ADD, BPF_REG_3, ETH_LEN));
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_4, sizeof(mcb_ip4_t)));
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_5, 0));
+    xdp_emit(program, XDP_CALL(BPF_FUNC_csum_diff));
+    xdp_emit_csum_fold(program);
+    xdp_emit(program, XDP_STX_MEM(BPF_H, BPF_REG_7, BPF_REG_0, IP4_OFFSET(csum)));
+    xdp_emit_pass_jump(program, XDP_JA(0));
+
+    // IPv6: Ensure the frame holds at least an Ethernet, IPv6 and UDP header
+    xdp_resolve_jump(program, jump_v6);
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_4, BPF_REG_7));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_ADD, BPF_REG_4, UDP6_FRAME_MIN));
+    xdp_emit_pass_jump(program, XDP_JMP_REG(BPF_JGT, BPF_REG_4, BPF_REG_3, 0));
+
+    // IPv6: Update the UDP checksum, source address and hop limit
+    xdp_emit_udp_csum_update(program, UDP6_OFFSET(csum), IP6_OFFSET(src), XDP_EGRESS_IPV6, MCB_IP6_ADDR_LEN);
+    xdp_emit_copy(program, IP6_OFFSET(src), XDP_EGRESS_IPV6, MCB_IP6_ADDR_LEN);
+    xdp_emit(program, XDP_ST_MEM(BPF_B, BPF_REG_7, IP6_OFFSET(hop_limit), 1));
+
+    // Transmit
+    xdp_emit_pass(program);
+
+    fd = xdp_load_program(program, BPF_XDP_DEVMAP, "mcb_egress");
+    free(program);
+
+    return fd;
+}
+
+
+//
+// Add the instructions to redirect to an interface's device map
+//
+static void xdp_emit_redirect(
+    xdp_program_t *             program,
+    bridge_interface_t *        bridge_interface)
+{
+    xdp_emit_ld_map_fd(program, BPF_REG_1, bridge_interface->xdp_devmap_fd);
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_2, 0));
+    xdp_emit(program, XDP_MOV64_IMM(BPF_REG_3, XDP_REDIRECT_FLAGS));
+    xdp_emit(program, XDP_CALL(BPF_FUNC_redirect_map));
+    xdp_emit(program, XDP_EXIT());
+}
+
+
+//
+// Find an interface in an XDP bridge
+//
+static bridge_interface_t * xdp_find_interface(
+    bridge_instance_t *         bridge,
+    unsigned int                if_index)
+{
+    unsigned int                interface_index;
+
+    if (bridge->dataplane != DATAPLANE_XDP)
+    {
+        return NULL;
+    }
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        if (bridge->interface_list[interface_index]->if_index == if_index)
+        {
+            return bridge->interface_list[interface_index];
+        }
+    }
+
+    return NULL;
+}
+
+
+//
+// Build and load the ingress program for an interface
+//
+// The ingress program matches the group and port of each XDP bridge the
+// interface belongs to, and redirects matching frames to the device map of
+// the interface in the bridge.
+//
+// Registers:
+//   r2: frame data
+//   r3: frame data end
+//   r4, r5: scratch
+//
+static int xdp_load_ingress_program(
+    unsigned int                if_index)
+{
+    xdp_program_t *             program;
+    bridge_instance_t *         bridge;
+    bridge_interface_t *        bridge_interface;
+    unsigned int                bridge_index;
+    unsigned int                jump_family[2] = {0};
+    unsigned int                has_family[2] = {0};
+    unsigned int                jump_skip[5];
+    unsigned int                skip_count;
+    unsigned int                index;
+    uint32_t                    group[4];
+    int                         fd;
+
+    program = calloc(1, sizeof(xdp_program_t));
+    if (program == NULL)
+    {
+        fatal("Cannot allocate memory: %s\n", strerror(errno));
+    }
+
+    // Which families are bridged on the interface?
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+        if (xdp_find_interface(bridge, if_index))
+        {
+            has_family[bridge->family == AF_INET ? 0 : 1] = 1;
+        }
+    }
+
+    // Ensure the frame holds at least an Ethernet, IPv4 and UDP header
+    xdp_emit(program, XDP_LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_1, XDP_MD_DATA));
+    xdp_emit(program, XDP_LDX_MEM(BPF_W, BPF_REG_3, BPF_REG_1, XDP_MD_DATA_END));
+    xdp_emit(program, XDP_MOV64_REG(BPF_REG_4, BPF_REG_2));
+    xdp_emit(program, XDP_ALU64_IMM(BPF_ADD, BPF_REG_4, UDP4_FRAME_MIN));
+    xdp_emit_pass_jump(program, XDP_JMP_REG(BPF_JGT, BPF_REG_4, BPF_REG_3, 0));
+
+    // Dispatch on the Ethernet type
+    xdp_emit(program, XDP_LDX_MEM(BPF_H, BPF_REG_4, BPF_REG_2, offsetof(mcb_ethernet_t, type)));
+    if (has_family[0])
+    {
+        jump_family[0] = xdp_emit(program, XDP_JMP32_IMM(BPF_JEQ, BPF_REG_4, htons(MCB_ETHERNET_TYPE_IP4), 0));
+    }
+    if (has_family[1])
+    {
+        jump_family[1] = xdp_emit(program, XDP_JMP32_IMM(BPF_JEQ, BPF_REG_4, htons(MCB_ETHERNET_TYPE_IP6), 0));
+    }
+    xdp_emit_pass_jump(program, XDP_JA(0));
+
+    // IPv4
+    if (has_family[0])
+    {
+        xdp_resolve_jump(program, jump_family[0]);
+
+        // Unfragmented UDP without IP options
+        xdp_emit(program, XDP_LDX_MEM(BPF_B, BPF_REG_5, BPF_REG_2, ETH_LEN));
+        xdp_emit_pass_jump(program, XDP_JMP32_IMM(BPF_JNE, BPF_REG_5, 0x45, 0));
+        xdp_emit(program, XDP_LDX_MEM(BPF_B, BPF_REG_5, BPF_REG_2, IP4_OFFSET(protocol)));
+        xdp_emit_pass_jump(program, XDP_JMP32_IMM(BPF_JNE, BPF_REG_5, MCB_IP4_PROTOCOL_UDP, 0));
+        xdp_emit(program, XDP_LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_2, IP4_OFFSET(offset)));
+        xdp_emit_pass_jump(program, XDP_JMP32_IMM(BPF_JSET, BPF_REG_5, htons(MCB_IP4_OFF_MF | MCB_IP4_OFF_MASK), 0));
+
+        // Match the group and port of each bridge
+        xdp_emit(program, XDP_LDX_MEM(BPF_W, BPF_REG_4, BPF_REG_2, IP4_OFFSET(dst)));
+        xdp_emit(program, XDP_LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_2, UDP4_OFFSET(dst_port)));
+        for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+        {
+            bridge = bridge_list[bridge_index];
+            bridge_interface = xdp_find_interface(bridge, if_index);
+            if (bridge_interface == NULL || bridge->family != AF_INET)
+            {
+                continue;
+            }
+
+            jump_skip[0] = xdp_emit(program, XDP_JMP32_IMM(BPF_JNE, BPF_REG_4, (int32_t) bridge->dst_addr.sin.sin_addr.s_addr, 0));
+            jump_skip[1] = xdp_emit(program, XDP_JMP32_IMM(BPF_JNE, BPF_REG_5, htons(bridge->port), 0));
+            xdp_emit_redirect(program, bridge_interface);
+            xdp_resolve_jump(program, jump_skip[0]);
+            xdp_resolve_jump(program, jump_skip[1]);
+        }
+        xdp_emit_pass_jump(program, XDP_JA(0));
+    }
+
+    // IPv6
+    if (has_family[1])
+    {
+        xdp_resolve_jump(program, jump_family[1]);
+
+        // Ensure the frame holds at least an Ethernet, IPv6 and UDP header
+        xdp_emit(program, XDP_MOV64_REG(BPF_REG_4, BPF_REG_2));
+        xdp_emit(program, XDP_ALU64_IMM(BPF_ADD, BPF_REG_4, UDP6_FRAME_MIN));
+        xdp_emit_pass_jump(program, XDP_JMP_REG(BPF_JGT, BPF_REG_4, BPF_REG_3, 0));
+
+        // UDP without extension headers
+        xdp_emit(program, XDP_LDX_MEM(BPF_B, BPF_REG_5, BPF_REG_2, IP6_OFFSET(next_header)));
+        xdp_emit_pass_jump(program, XDP_JMP32_IMM(BPF_JNE, BPF_REG_5, MCB_IP6_PROTO_UDP, 0));
+
+        // Match the group and port of each bridge
+        xdp_emit(program, XDP_LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_2, UDP6_OFFSET(dst_port)));
+        for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+        {
+            bridge = bridge_list[bridge_index];
+            bridge_interface = xdp_find_interface(bridge, if_index);
+            if (bridge_interface == NULL || bridge->family != AF_INET6)
+            {
+                continue;
+            }
+
+            memcpy(group, &bridge->dst_addr.sin6.sin6_addr, sizeof(group));
+            skip_count = 0;
+            jump_skip[skip_count++] = xdp_emit(program, XDP_JMP32_IMM(BPF_JNE, BPF_REG_5, htons(bridge->port), 0));
+            for (index = 0; index < 4; index++)
+            {
+                xdp_emit(program, XDP_LDX_MEM(BPF_W, BPF_REG_4, BPF_REG_2, IP6_OFFSET(dst) + index * 4));
+                jump_skip[skip_count++] = xdp_emit(program, XDP_JMP32_IMM(BPF_JNE, BPF_REG_4, (int32_t) group[index], 0));
+            }
+            xdp_emit_redirect(program, bridge_interface);
+            for (index = 0; index < skip_count; index++)
+            {
+                xdp_resolve_jump(program, jump_skip[index]);
+            }
+        }
+        xdp_emit_pass_jump(program, XDP_JA(0));
+    }
+
+    // Not for us
+    xdp_emit_pass(program);
+
+    fd = xdp_load_program(program, BPF_XDP, "mcb_ingress");
+    free(program);
+
+    return fd;
+}
+
+
+//
+// Attach an ingress program to an interface
+//
+static void xdp_attach(
+    int                         prog_fd,
+    unsigned int                if_index,
+    const char *                name)
+{
+    union bpf_attr              attr;
+    int                         fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = prog_fd;
+    attr.link_create.target_ifindex = if_index;
+    attr.link_create.attach_type = BPF_XDP;
+
+    // NB: The link remains attached for the life of the process
+    fd = xdp_bpf(BPF_LINK_CREATE, &attr);
+    if (fd == -1)
+    {
+        fatal("Cannot attach XDP program to %s: %s\n", name, strerror(errno));
+    }
+}
+
+
+//
+// Initialize the XDP dataplane
+//
+// Must be called after the interfaces are bound and before they are activated.
+//
+void xdp_initialize(void)
+{
+    bridge_instance_t *         bridge;
+    bridge_interface_t *        bridge_interface;
+    bridge_interface_t *        other_interface;
+    unsigned int                bridge_index;
+    unsigned int                interface_index;
+    unsigned int                other_bridge_index;
+    unsigned int                total_interfaces = 0;
+    unsigned int                attached;
+    xdp_egress_value_t          egress_value;
+    uint32_t                    key;
+    int                         prog_fd;
+
+    // Count the XDP bridge interfaces
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+        if (bridge->dataplane == DATAPLANE_XDP)
+        {
+            total_interfaces += bridge->interface_count;
+        }
+    }
+    if (total_interfaces == 0)
+    {
+        return;
+    }
+
+    // Create and populate the egress map
+    xdp_egress_map_fd = xdp_create_map(BPF_MAP_TYPE_HASH, sizeof(uint32_t), sizeof(xdp_egress_value_t), total_interfaces, "mcb_egress");
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+        if (bridge->dataplane != DATAPLANE_XDP)
+        {
+            continue;
+        }
+
+        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+        {
+            bridge_interface = bridge->interface_list[interface_index];
+
+            // Find the existing entry for the interface, if any
+            key = bridge_interface->if_index;
+            memset(&egress_value, 0, sizeof(egress_value));
+            for (other_bridge_index = 0; other_bridge_index < bridge_list_count; other_bridge_index++)
+            {
+                other_interface = xdp_find_interface(bridge_list[other_bridge_index], key);
+                if (other_interface == NULL)
+                {
+                    continue;
+                }
+
+                MCB_ETH_ADDR_CPY(egress_value.mac_addr, other_interface->mac_addr);
+                if (bridge_list[other_bridge_index]->family == AF_INET)
+                {
+                    MCB_IP4_ADDR_CPY(egress_value.ipv4_addr, &other_interface->ipv4_addr);
+                }
+                else
+                {
+                    MCB_IP6_ADDR_CPY(egress_value.ipv6_addr, &other_interface->ipv6_addr);
+                }
+            }
+
+            if (xdp_map_update(xdp_egress_map_fd, &key, &egress_value) == -1)
+            {
+                fatal("Cannot update XDP egress map for %s: %s\n", bridge_interface->name, strerror(errno));
+            }
+        }
+    }
+
+    // Load the egress program
+    xdp_egress_prog_fd = xdp_load_egress_program();
+
+    // Create the device maps
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+        if (bridge->dataplane != DATAPLANE_XDP)
+        {
+            continue;
+        }
+
+        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+        {
+            bridge->interface_list[interface_index]->xdp_devmap_fd = xdp_create_map(BPF_MAP_TYPE_DEVMAP_HASH,
+                sizeof(uint32_t), sizeof(xdp_devmap_value_t), bridge->interface_count, "mcb_devmap");
+        }
+    }
+
+    // Load and attach the ingress program for each interface
+    for (bridge_index = 0; bridge_index < bridge_list_count; bridge_index++)
+    {
+        bridge = bridge_list[bridge_index];
+        if (bridge->dataplane != DATAPLANE_XDP)
+        {
+            continue;
+        }
+
+        for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+        {
+            bridge_interface = bridge->interface_list[interface_index];
+
+            // Has the interface already been attached by an earlier bridge?
+            attached = 0;
+            for (other_bridge_index = 0; other_bridge_index < bridge_index && attached == 0; other_bridge_index++)
+            {
+                if (xdp_find_interface(bridge_list[other_bridge_index], bridge_interface->if_index))
+                {
+                    attached = 1;
+                }
+            }
+            if (attached)
+            {
+                continue;
+            }
+
+            prog_fd = xdp_load_ingress_program(bridge_interface->if_index);
+            xdp_attach(prog_fd, bridge_interface->if_index, bridge_interface->name);
+
+            if (debug_level)
+            {
+                logger("XDP program attached to interface %s\n", bridge_interface->name);
+            }
+        }
+    }
+}
+
+
+//
+// Synchronize the device map of an interface with its fanout list
+//
+void xdp_update_devmap(
+    bridge_interface_t *        bridge_interface)
+{
+    bridge_instance_t *         bridge = bridge_interface->bridge;
+    bridge_fanout_t *           fanout = bridge_interface->fanout;
+    bridge_interface_t *        peer;
+    unsigned int                interface_index;
+    unsigned int                peer_index;
+    xdp_devmap_value_t          value;
+    uint32_t                    key;
+
+    for (interface_index = 0; interface_index < bridge->interface_count; interface_index++)
+    {
+        peer = bridge->interface_list[interface_index];
+        key = peer->if_index;
+
+        for (peer_index = 0; peer_index < fanout->peer_count; peer_index++)
+        {
+            if (fanout->peer_list[peer_index] == peer)
+            {
+                break;
+            }
+        }
+
+        if (peer_index < fanout->peer_count)
+        {
+            value.ifindex = peer->if_index;
+            value.prog_fd = xdp_egress_prog_fd;
+            if (xdp_map_update(bridge_interface->xdp_devmap_fd, &key, &value) == -1)
+            {
+                logger("Bridge(%s/%u): Cannot add %s to XDP device map of %s: %s\n", AF_FAMILY_TO_STRING(bridge->family),
+                    bridge->port, peer->name, bridge_interface->name, strerror(errno));
+            }
+        }
+        else
+        {
+            if (xdp_map_delete(bridge_interface->xdp_devmap_fd, &key) == -1 && errno != ENOENT)
+            {
+                logger("Bridge(%s/%u): Cannot remove %s from XDP device map of %s: %s\n", AF_FAMILY_TO_STRING(bridge->family),
+                    bridge->port, peer->name, bridge_interface->name, strerror(errno));
+            }
+        }
+    }
+}
+
+#endif // USE_XDP